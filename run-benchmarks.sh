@@ -0,0 +1,115 @@
+#!/bin/bash
+
+set -u
+
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+NC='\033[0m'
+
+ROOT_DIR=$(CDPATH='' cd -- "$(dirname -- "$0")" && pwd)
+BUILD_DIR=${BUILD_DIR:-$(pwd)}
+BENCH_DIR=${BENCH_DIR:-tests.bench}
+WORK_DIR=$(mktemp -d)
+CC_BIN=${CC:-cc}
+BENCH_CFLAGS=${BENCH_CFLAGS:-"-O2 -g"}
+BENCH_LDFLAGS=${BENCH_LDFLAGS:-""}
+
+read -r -a EXTRA_CFLAGS <<< "$BENCH_CFLAGS"
+read -r -a EXTRA_LDFLAGS <<< "$BENCH_LDFLAGS"
+
+PROJECT_SOURCES=(
+    "$ROOT_DIR/src/ipset.c"
+    "$ROOT_DIR/src/ipset_binary.c"
+    "$ROOT_DIR/src/ipset_bitmap.c"
+    "$ROOT_DIR/src/ipset_combine.c"
+    "$ROOT_DIR/src/ipset_common.c"
+    "$ROOT_DIR/src/ipset_compare.c"
+    "$ROOT_DIR/src/ipset_copy.c"
+    "$ROOT_DIR/src/ipset_count.c"
+    "$ROOT_DIR/src/ipset_coverage.c"
+    "$ROOT_DIR/src/ipset_diff.c"
+    "$ROOT_DIR/src/ipset_dns.c"
+    "$ROOT_DIR/src/ipset_exclude.c"
+    "$ROOT_DIR/src/ipset_kmerge.c"
+    "$ROOT_DIR/src/ipset_load.c"
+    "$ROOT_DIR/src/ipset_membership.c"
+    "$ROOT_DIR/src/ipset_merge.c"
+    "$ROOT_DIR/src/ipset_optimize.c"
+    "$ROOT_DIR/src/ipset_output.c"
+    "$ROOT_DIR/src/ipset_parallel.c"
+    "$ROOT_DIR/src/ipset_predicate.c"
+    "$ROOT_DIR/src/ipset_print.c"
+    "$ROOT_DIR/src/ipset_reduce.c"
+    "$ROOT_DIR/src/ipset_shard.c"
+    "$ROOT_DIR/src/ipset_sort.c"
+)
+
+cleanup() {
+    rm -rf "$WORK_DIR"
+}
+
+trap cleanup EXIT
+
+if [ ! -f "$BUILD_DIR/config.h" ] && [ -f "$ROOT_DIR/config.h" ]; then
+    BUILD_DIR="$ROOT_DIR"
+fi
+
+if [ ! -f "$BUILD_DIR/config.h" ]; then
+    echo -e "${RED}Error: config.h not found in $BUILD_DIR or $ROOT_DIR${NC}"
+    exit 1
+fi
+
+if [ ! -d "$ROOT_DIR/$BENCH_DIR" ]; then
+    echo -e "${RED}Error: benchmark directory $ROOT_DIR/$BENCH_DIR not found${NC}"
+    exit 1
+fi
+
+run_benchmark() {
+    local src="$1"
+    local name
+    local bin
+
+    name=$(basename "$src" .c)
+    bin="$WORK_DIR/$name"
+
+    echo -e "${YELLOW}Running benchmark: $name${NC}"
+
+    if ! "$CC_BIN" \
+        -DHAVE_CONFIG_H \
+        -I"$BUILD_DIR" \
+        -I"$ROOT_DIR" \
+        -I"$ROOT_DIR/src" \
+        -pthread \
+        "${EXTRA_CFLAGS[@]}" \
+        "$src" \
+        "${PROJECT_SOURCES[@]}" \
+        "${EXTRA_LDFLAGS[@]}" \
+        -o "$bin"; then
+        echo -e "${RED}Benchmark build failed${NC}"
+        return 1
+    fi
+
+    if ! "$bin"; then
+        echo -e "${RED}Benchmark failed${NC}"
+        return 1
+    fi
+}
+
+failed=0
+
+for src in "$ROOT_DIR"/"$BENCH_DIR"/*.c; do
+    [ -f "$src" ] || continue
+    if [ $# -gt 0 ] && [ "$1" != "$(basename "$src" .c)" ]; then
+        continue
+    fi
+    run_benchmark "$src" || failed=$((failed + 1))
+    echo ""
+done
+
+if [ $failed -gt 0 ]; then
+    echo -e "${RED}Failed benchmarks: $failed${NC}"
+    exit 1
+fi
+
+echo -e "${GREEN}Benchmarks completed${NC}"
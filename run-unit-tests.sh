@@ -21,17 +21,28 @@ read -r -a EXTRA_LDFLAGS <<< "$TEST_LDFLAGS"
 PROJECT_SOURCES=(
     "$ROOT_DIR/src/ipset.c"
     "$ROOT_DIR/src/ipset_binary.c"
+    "$ROOT_DIR/src/ipset_bitmap.c"
     "$ROOT_DIR/src/ipset_combine.c"
     "$ROOT_DIR/src/ipset_common.c"
+    "$ROOT_DIR/src/ipset_compare.c"
     "$ROOT_DIR/src/ipset_copy.c"
+    "$ROOT_DIR/src/ipset_count.c"
+    "$ROOT_DIR/src/ipset_coverage.c"
     "$ROOT_DIR/src/ipset_diff.c"
     "$ROOT_DIR/src/ipset_dns.c"
     "$ROOT_DIR/src/ipset_exclude.c"
+    "$ROOT_DIR/src/ipset_kmerge.c"
     "$ROOT_DIR/src/ipset_load.c"
+    "$ROOT_DIR/src/ipset_membership.c"
     "$ROOT_DIR/src/ipset_merge.c"
     "$ROOT_DIR/src/ipset_optimize.c"
+    "$ROOT_DIR/src/ipset_output.c"
+    "$ROOT_DIR/src/ipset_parallel.c"
+    "$ROOT_DIR/src/ipset_predicate.c"
     "$ROOT_DIR/src/ipset_print.c"
     "$ROOT_DIR/src/ipset_reduce.c"
+    "$ROOT_DIR/src/ipset_shard.c"
+    "$ROOT_DIR/src/ipset_sort.c"
 )
 
 cleanup() {
@@ -21,13 +21,11 @@ int default_prefix = 32;
 /* address family: 0 = default (IPv4), 4 = explicit IPv4, 6 = explicit IPv6 */
 int active_family = 0;
 
-/* count of IPv6 lines dropped in IPv4 mode (for one-time warning) */
-unsigned long ipv6_dropped_in_ipv4_mode = 0;
-
 /* forward declaration for IPv6 mode execution */
 extern int iprange6_run(int argc, char **argv, int mode, IPSET_PRINT_CMD print,
                         int header, int quiet, size_t ipset_reduce_factor,
-                        size_t ipset_reduce_min_accepted);
+                        size_t ipset_reduce_min_accepted, int coverage_op,
+                        size_t coverage_depth);
 
 static inline uint64_t ipset_report_unique_ips(ipset *ips, size_t *entries)
 {
@@ -87,6 +85,18 @@ static void iprange_csv_write_unique_row(const char *name, size_t entries, uint6
     fputc('\n', stdout);
 }
 
+/* merges all the ipsets linked to 'next' from ips into it, naming it name */
+static void ipset_merge_side(ipset *ips, const char *name) {
+    ipset *next;
+
+    for(next = ips->next; next ;next = next->next)
+        if(unlikely(ipset_merge(ips, next))) {
+            fprintf(stderr, "%s: Cannot merge ipset %s into %s\n", PROG, next->filename, ips->filename);
+            exit(exit_failure);
+        }
+    if(ips->next) ipset_set_filename(ips, name);
+}
+
 /* ----------------------------------------------------------------------------
  * usage()
  *
@@ -138,6 +148,34 @@ static void usage(const char *me) {
         "		Intersect all files to find their common IPs.\n"
         "		The resulting set is sorted.\n"
         "\n"
+        "	--coverage-at-least K\n"
+        "	--coverage-exactly K\n"
+        "	--coverage-at-most K\n"
+        "		> COVERAGE mode\n"
+        "		Find the IPs found in at least, exactly or at\n"
+        "		most K files (K >= 1), in a single pass over\n"
+        "		all of them.\n"
+        "		The resulting set is sorted.\n"
+        "\n"
+        "	--membership\n"
+        "		> MEMBERSHIP mode\n"
+        "		Split the IPs of all files into disjoint ranges,\n"
+        "		in a single pass over all of them, and print\n"
+        "		each range with the files it is found in, as\n"
+        "		CSV: first_ip,last_ip,membership, where\n"
+        "		membership is a hex bitmask of the files (the\n"
+        "		lowest bit is the first file).\n"
+        "		With --print-binary the table is printed in\n"
+        "		the membership binary format.\n"
+        "		It is not supported in IPv6 mode.\n"
+        "\n"
+        "	--exclusive-first\n"
+        "		> EXCLUSIVE FIRST mode\n"
+        "		Find the IPs of the first file that none of the\n"
+        "		other files has, in a single pass over all\n"
+        "		of them.\n"
+        "		The resulting set is sorted.\n"
+        "\n"
         "	--except\n"
         "	--exclude-next\n"
         "		> EXCEPT mode\n"
@@ -220,6 +258,34 @@ static void usage(const char *me) {
         "		Print counts for each file.\n"
         "		Add --header to get the CSV header too.\n"
         "\n"
+        "	--count-exclusive\n"
+        "		> COUNT EXCLUSIVE mode\n"
+        "		Print counts for each file, with the number\n"
+        "		of its IPs that none of the other files has,\n"
+        "		in a single pass over all of them.\n"
+        "		Add --header to get the CSV header too.\n"
+        "\n"
+        "\n"
+        "Predicate modes:\n"
+        "	--intersects\n"
+        "	--intersects-next\n"
+        "		> INTERSECTS mode\n"
+        "	--subset-of\n"
+        "	--subset-of-next\n"
+        "		> SUBSET mode\n"
+        "	--equals\n"
+        "	--equals-next\n"
+        "		> EQUALS mode\n"
+        "		Here is how they work:\n"
+        "		(1) merge all files before this parameter (ipset A);\n"
+        "		(2) merge all files after this parameter (ipset B);\n"
+        "		(3) exit with 0 when A has IPs in common with B,\n"
+        "		all the IPs of A are in B, or A and B have the\n"
+        "		same IPs, respectively, with 1 otherwise,\n"
+        "		and with 2 on errors.\n"
+        "		Nothing is printed; they stop at the first range\n"
+        "		that gives the answer, which is printed with -v.\n"
+        "\n"
         "\n"
         "Controlling input:\n"
         "	--dont-fix-network\n"
@@ -274,6 +340,22 @@ static void usage(const char *me) {
         "		The result can be read by iprange on the same\n"
         "		architecture (no conversion of endianness).\n"
         "\n"
+        "	--print-ipset-restore NAME\n"
+        "		Print a script for ipset restore, that creates\n"
+        "		the hash:net set NAME-tmp, adds the CIDRs to it,\n"
+        "		swaps it with NAME and destroys it, so that NAME\n"
+        "		changes at once. NAME is created if it is missing.\n"
+        "		The hashsize of NAME-tmp is given for the number\n"
+        "		of CIDRs; the maxelem of both sets is %u, so\n"
+        "		NAME must have it too if it exists.\n"
+        "		NAME can be up to %d characters.\n"
+        "		It cannot be used with --print-prefix and\n"
+        "		--print-suffix, and not in IPv6 mode.\n"
+        "\n"
+        "	--print-ipset-restore-ips NAME\n"
+        "		Like --print-ipset-restore, with a hash:ip set\n"
+        "		of the single IPs.\n"
+        "\n"
         "	--print-prefix STRING\n"
         "		Print STRING before each IP, range or CIDR.\n"
         "		This sets both --print-prefix-ips and\n"
@@ -315,6 +397,28 @@ static void usage(const char *me) {
         "		(the default is to not print the header line).\n"
         "\n"
         "\n"
+        "Controlling parallel processing:\n"
+        "	--threads NUMBER\n"
+        "		The number of threads to use for loading the\n"
+        "		files of @filename and @directory inputs, for\n"
+        "		parsing large text files, for optimizing\n"
+        "		large ipsets, for set operations on them and\n"
+        "		for comparing the pairs of --compare-next and\n"
+        "		--compare-first, and for formatting the text\n"
+        "		output of large IPv4 ipsets.\n"
+        "		It applies to the inputs given after it\n"
+        "		(the default is 1).\n"
+        "\n"
+        "\n"
+        "Controlling set operations:\n"
+        "	--bitmap\n"
+        "		Use a 512 MiB bitmap of the whole IPv4 space\n"
+        "		for merging, finding the common IPs, excluding\n"
+        "		and diffing ipsets, instead of sorting them.\n"
+        "		This is done anyway when the ipsets have 64M\n"
+        "		entries or more.\n"
+        "\n"
+        "\n"
         "Controlling DNS resolution:\n"
         "	--dns-threads NUMBER\n"
         "		The number of parallel DNS queries to execute\n"
@@ -397,7 +501,7 @@ static void usage(const char *me) {
         "\n"
         "		Any number of files can be given.\n"
         "\n"
-        , me, dns_threads_max);
+        , me, (unsigned int)IPSET_RESTORE_MAXELEM, IPSET_RESTORE_NAME_MAX, dns_threads_max);
     exit(0);
 }
 
@@ -446,7 +550,7 @@ static int compare_pathnames(const void *left, const void *right)
 static void invalid_option_value(const char *option, const char *value, const char *expected)
 {
     fprintf(stderr, "%s: Invalid value '%s' for %s. %s\n", PROG, value, option, expected);
-    exit(1);
+    exit(exit_failure);
 }
 
 static long parse_long_option_or_die(const char *option, const char *value, long min, long max, const char *expected)
@@ -478,6 +582,16 @@ static size_t parse_size_option_or_die(const char *option, const char *value, si
     return (size_t)parsed;
 }
 
+static int is_predicate_option(const char *arg)
+{
+    return !strcmp(arg, "--intersects")
+        || !strcmp(arg, "--intersects-next")
+        || !strcmp(arg, "--subset-of")
+        || !strcmp(arg, "--subset-of-next")
+        || !strcmp(arg, "--equals")
+        || !strcmp(arg, "--equals-next");
+}
+
 static void free_pathnames(char **files, size_t entries)
 {
     size_t i;
@@ -488,6 +602,42 @@ static void free_pathnames(char **files, size_t entries)
     free(files);
 }
 
+/* ----------------------------------------------------------------------------
+ * ipset_load_files()
+ *
+ * loads the given files into slots[], keeping their order
+ * with --threads the files are loaded in parallel, otherwise loading stops at
+ * the first file that fails. A file that failed to load leaves its slot NULL.
+ *
+ */
+
+typedef struct load_files_job {
+    char **files;
+    ipset **slots;
+} LOAD_FILES_JOB;
+
+static void ipset_load_files_job(size_t job, void *data)
+{
+    LOAD_FILES_JOB *lf = data;
+
+    lf->slots[job] = ipset_load(lf->files[job]);
+}
+
+static void ipset_load_files(char **files, ipset **slots, size_t entries)
+{
+    size_t j;
+
+    if(parallel_threads > 1 && entries > 1) {
+        LOAD_FILES_JOB lf = { files, slots };
+        parallel_run("load", entries, ipset_load_files_job, &lf);
+        return;
+    }
+
+    for(j = 0; j < entries; j++)
+        if(!(slots[j] = ipset_load(files[j])))
+            break;
+}
+
 /*#define MODE_HISTOGRAM 11 */
 
 int main(int argc, char **argv) {
@@ -497,6 +647,8 @@ int main(int argc, char **argv) {
 
     size_t ipset_reduce_factor = 120;
     size_t ipset_reduce_min_accepted = 16384;
+    size_t coverage_depth = 0;
+    int coverage_op = 0;
     int ret = 0, quiet = 0;
     int inputs = 0;
 
@@ -511,6 +663,10 @@ int main(int argc, char **argv) {
     else
         PROG = argv[0];
 
+    /* the predicates exit with 1 for no, so their errors, even those found before their option, exit with 2 */
+    for(i = 1; i < argc ; i++)
+        if(is_predicate_option(argv[i])) exit_failure = 2;
+
     for(i = 1; i < argc ; i++) {
         if(i+1 < argc && !strcmp(argv[i], "as")) {
             if(!read_second) {
@@ -544,7 +700,7 @@ int main(int argc, char **argv) {
                 j = (int)strtol(s, &e, 10);
                 if(j <= 0 || j > 32) {
                     fprintf(stderr, "%s: Only prefixes from 1 to 32 can be set (32 is always enabled). %d is invalid.\n", PROG, j);
-                    exit(1);
+                    exit(exit_failure);
                 }
                 if(debug) fprintf(stderr, "Enabling prefix %d\n", j);
                 prefix_enabled[j] = 1;
@@ -553,7 +709,7 @@ int main(int argc, char **argv) {
 
             if(e && *e) {
                 fprintf(stderr, "%s: Invalid prefix '%s'\n", PROG, e);
-                exit(1);
+                exit(exit_failure);
             }
         }
         else if(i+1 < argc && (
@@ -574,6 +730,19 @@ int main(int argc, char **argv) {
             ipset_reduce_factor = 100 + parse_size_option_or_die(option, value, 0, SIZE_MAX - 100, "It must be a non-negative integer percentage.");
             mode = MODE_REDUCE;
         }
+        else if(i+1 < argc && (
+               !strcmp(argv[i], "--coverage-at-least")
+            || !strcmp(argv[i], "--coverage-exactly")
+            || !strcmp(argv[i], "--coverage-at-most")
+            )) {
+            const char *option = argv[i];
+            const char *value = argv[++i];
+            coverage_depth = parse_size_option_or_die(option, value, 1, SIZE_MAX, "It must be a positive integer.");
+            if(!strcmp(option, "--coverage-at-least")) coverage_op = IPSET_COVERAGE_AT_LEAST;
+            else if(!strcmp(option, "--coverage-exactly")) coverage_op = IPSET_COVERAGE_EXACTLY;
+            else coverage_op = IPSET_COVERAGE_AT_MOST;
+            mode = MODE_COVERAGE;
+        }
         else if(i+1 < argc && (
                !strcmp(argv[i], "--ipset-reduce-entries")
             || !strcmp(argv[i], "--reduce-entries")
@@ -613,7 +782,7 @@ int main(int argc, char **argv) {
             read_second = 1;
             if(active_family != 6 && !root) {
                 fprintf(stderr, "%s: An ipset is needed before --except\n", PROG);
-                exit(1);
+                exit(exit_failure);
             }
         }
         else if(!strcmp(argv[i], "--diff")
@@ -622,9 +791,28 @@ int main(int argc, char **argv) {
             read_second = 1;
             if(active_family != 6 && !root) {
                 fprintf(stderr, "%s: An ipset is needed before --diff\n", PROG);
-                exit(1);
+                exit(exit_failure);
+            }
+        }
+        else if(is_predicate_option(argv[i])) {
+            if(!strncmp(argv[i], "--intersects", 12)) mode = MODE_INTERSECTS;
+            else if(!strncmp(argv[i], "--subset-of", 11)) mode = MODE_SUBSET;
+            else mode = MODE_EQUALS;
+            read_second = 1;
+            if(active_family != 6 && !root) {
+                fprintf(stderr, "%s: An ipset is needed before %s\n", PROG, argv[i]);
+                exit(exit_failure);
             }
         }
+        else if(!strcmp(argv[i], "--membership")) {
+            mode = MODE_MEMBERSHIP;
+        }
+        else if(!strcmp(argv[i], "--exclusive-first")) {
+            mode = MODE_EXCLUSIVE_FIRST;
+        }
+        else if(!strcmp(argv[i], "--count-exclusive")) {
+            mode = MODE_COUNT_EXCLUSIVE;
+        }
         else if(!strcmp(argv[i], "--compare")) {
             mode = MODE_COMPARE;
         }
@@ -636,7 +824,7 @@ int main(int argc, char **argv) {
             read_second = 1;
             if(active_family != 6 && !root) {
                 fprintf(stderr, "%s: An ipset is needed before --compare-next\n", PROG);
-                exit(1);
+                exit(exit_failure);
             }
         }
         else if(!strcmp(argv[i], "--count-unique")
@@ -667,6 +855,22 @@ int main(int argc, char **argv) {
             || !strcmp(argv[i], "-1")) {
             print = PRINT_SINGLE_IPS;
         }
+        else if(i+1 < argc && (
+               !strcmp(argv[i], "--print-ipset-restore")
+            || !strcmp(argv[i], "--print-ipset-restore-ips")
+            )) {
+            const char *option = argv[i];
+            const char *value = argv[++i];
+            size_t len = strlen(value);
+
+            if(!len || len > IPSET_RESTORE_NAME_MAX || strpbrk(value, " \t\r\n")) {
+                fprintf(stderr, "%s: Invalid value '%s' for %s. It must be an ipset name of up to %d characters, without spaces.\n", PROG, value, option, IPSET_RESTORE_NAME_MAX);
+                exit(exit_failure);
+            }
+
+            print = strcmp(option, "--print-ipset-restore") ? PRINT_IPSET_RESTORE_IP : PRINT_IPSET_RESTORE_NET;
+            print_ipset_restore = argv[i];
+        }
         else if(i+1 < argc && !strcmp(argv[i], "--print-prefix")) {
             print_prefix_ips  = argv[++i];
             print_prefix_nets = print_prefix_ips;
@@ -699,6 +903,12 @@ int main(int argc, char **argv) {
         else if(i+1 < argc && !strcmp(argv[i], "--dns-threads")) {
             dns_threads_max = (int)parse_long_option_or_die("--dns-threads", argv[++i], 1, INT_MAX, "It must be an integer greater than or equal to 1.");
         }
+        else if(i+1 < argc && !strcmp(argv[i], "--threads")) {
+            parallel_threads = (int)parse_long_option_or_die("--threads", argv[++i], 1, 1024, "It must be an integer between 1 and 1024.");
+        }
+        else if(!strcmp(argv[i], "--bitmap")) {
+            ipset_bitmap_forced = 1;
+        }
         else if(!strcmp(argv[i], "--dns-silent")) {
             dns_silent = 1;
         }
@@ -736,7 +946,7 @@ int main(int argc, char **argv) {
                 inputs++;
                 if(!(ips = ipset_load(NULL))) {
                     fprintf(stderr, "%s: Cannot load ipset from stdin\n", PROG);
-                    exit(1);
+                    exit(exit_failure);
                 }
 
                 if(read_second)
@@ -756,6 +966,7 @@ int main(int argc, char **argv) {
                 if(dir) {
                     struct dirent *entry;
                     char **files = NULL;
+                    ipset **slots;
                     size_t files_allocated = 0, files_collected = 0, j;
 
                     if(unlikely(debug)) 
@@ -783,7 +994,7 @@ int main(int argc, char **argv) {
                                 closedir(dir);
                                 free_pathnames(files, files_collected);
                                 fprintf(stderr, "%s: Cannot allocate memory for directory listing %s\n", PROG, listname);
-                                exit(1);
+                                exit(exit_failure);
                             }
 
                             files = tmp;
@@ -795,7 +1006,7 @@ int main(int argc, char **argv) {
                             closedir(dir);
                             free_pathnames(files, files_collected);
                             fprintf(stderr, "%s: Cannot allocate memory for directory entry %s\n", PROG, filepath);
-                            exit(1);
+                            exit(exit_failure);
                         }
 
                         files_collected++;
@@ -811,20 +1022,30 @@ int main(int argc, char **argv) {
                         
                         /* Report an error for empty directory */
                         fprintf(stderr, "%s: No valid files found in directory: %s\n", PROG, listname);
-                        exit(1);
+                        exit(exit_failure);
                     }
 
                     qsort(files, files_collected, sizeof(*files), compare_pathnames);
 
-                    for(j = 0; j < files_collected; j++) {
-                        if(unlikely(debug))
+                    slots = calloc(files_collected, sizeof(*slots));
+                    if(!slots) {
+                        free_pathnames(files, files_collected);
+                        fprintf(stderr, "%s: Cannot allocate memory for directory listing %s\n", PROG, listname);
+                        exit(exit_failure);
+                    }
+
+                    if(unlikely(debug))
+                        for(j = 0; j < files_collected; j++)
                             fprintf(stderr, "%s: Loading file %s from directory %s\n", PROG, files[j], listname);
 
-                        if(!(ips = ipset_load(files[j]))) {
+                    ipset_load_files(files, slots, files_collected);
+
+                    for(j = 0; j < files_collected; j++) {
+                        if(!(ips = slots[j])) {
                             fprintf(stderr, "%s: Cannot load file %s from directory %s\n",
                                     PROG, files[j], listname);
                             free_pathnames(files, files_collected);
-                            exit(1);
+                            exit(exit_failure);
                         }
 
                         if(read_second)
@@ -835,17 +1056,22 @@ int main(int argc, char **argv) {
                         }
                     }
 
+                    free(slots);
                     free_pathnames(files, files_collected);
                 }
                 else if(errno != ENOTDIR) {
                     fprintf(stderr, "%s: Cannot access %s: %s\n", PROG, listname, strerror(errno));
-                    exit(1);
+                    exit(exit_failure);
                 }
                 else {
                     /* Handle as a file list */
                     FILE *fp;
                     char line[MAX_LINE + 1];
                     int lineid = 0;
+                    char **files = NULL;
+                    int *lineids = NULL;
+                    ipset **slots;
+                    size_t files_allocated = 0, files_collected = 0, j;
                     
                     if(unlikely(debug)) 
                         fprintf(stderr, "%s: Loading files from list %s\n", PROG, listname);
@@ -853,13 +1079,10 @@ int main(int argc, char **argv) {
                     fp = iprange_fopen_read(listname);
                     if(!fp) {
                         fprintf(stderr, "%s: Cannot open file list: %s - %s\n", PROG, listname, strerror(errno));
-                        exit(1);
+                        exit(exit_failure);
                     }
                     
-                    /* Flag to track if we loaded any files */
-                    int files_loaded = 0;
-
-                    /* Read each line and load the corresponding file */
+                    /* Read each line and collect the corresponding file */
                     while(fgets(line, MAX_LINE, fp)) {
                         lineid++;
                         
@@ -870,46 +1093,91 @@ int main(int argc, char **argv) {
                             continue;
                             
                         iprange_trim_trailing_whitespace(s);
-                            
-                        if(unlikely(debug)) 
-                            fprintf(stderr, "%s: Loading file %s from list (line %d)\n", PROG, s, lineid);
-                        
-                        /* Load the file as an independent ipset */
-                        if(!(ips = ipset_load(s))) {
-                            fprintf(stderr, "%s: Cannot load file %s from list %s (line %d)\n", 
-                                    PROG, s, listname, lineid);
-                            exit(1);
+
+                        if(files_collected == files_allocated) {
+                            size_t next_allocated = (files_allocated)?files_allocated * 2:16;
+                            char **tmp = realloc(files, next_allocated * sizeof(*files));
+                            int *tmp_lineids = (tmp)?realloc(lineids, next_allocated * sizeof(*lineids)):NULL;
+
+                            if(tmp) files = tmp;
+                            if(tmp_lineids) lineids = tmp_lineids;
+                            if(!tmp || !tmp_lineids) {
+                                fclose(fp);
+                                free(lineids);
+                                free_pathnames(files, files_collected);
+                                fprintf(stderr, "%s: Cannot allocate memory for file list %s\n", PROG, listname);
+                                exit(exit_failure);
+                            }
+
+                            files_allocated = next_allocated;
                         }
-                        
-                        files_loaded = 1;
-                        
-                        /* Add the ipset to the appropriate chain */
-                        if(read_second)
-                            ipset_chain_append(&second, &second_last, ips);
-                        else {
-                            if(!first) first = ips;
-                            ipset_chain_append(&root, &root_last, ips);
+
+                        files[files_collected] = strdup(s);
+                        if(!files[files_collected]) {
+                            fclose(fp);
+                            free(lineids);
+                            free_pathnames(files, files_collected);
+                            fprintf(stderr, "%s: Cannot allocate memory for file list entry %s\n", PROG, s);
+                            exit(exit_failure);
                         }
+
+                        lineids[files_collected] = lineid;
+                        files_collected++;
                     }
                     
                     fclose(fp);
                     
                     /* Handle empty file list case */
-                    if(!files_loaded) {
+                    if(!files_collected) {
                         if(unlikely(debug))
                             fprintf(stderr, "%s: File list %s is empty or contains no valid entries\n", PROG, listname);
                         
                         /* Report an error for empty file list */
                         fprintf(stderr, "%s: No valid files found in file list: %s\n", PROG, listname);
-                        exit(1);
+                        exit(exit_failure);
+                    }
+
+                    slots = calloc(files_collected, sizeof(*slots));
+                    if(!slots) {
+                        free(lineids);
+                        free_pathnames(files, files_collected);
+                        fprintf(stderr, "%s: Cannot allocate memory for file list %s\n", PROG, listname);
+                        exit(exit_failure);
+                    }
+
+                    if(unlikely(debug))
+                        for(j = 0; j < files_collected; j++)
+                            fprintf(stderr, "%s: Loading file %s from list (line %d)\n", PROG, files[j], lineids[j]);
+
+                    /* Load each file as an independent ipset */
+                    ipset_load_files(files, slots, files_collected);
+
+                    for(j = 0; j < files_collected; j++) {
+                        if(!(ips = slots[j])) {
+                            fprintf(stderr, "%s: Cannot load file %s from list %s (line %d)\n",
+                                    PROG, files[j], listname, lineids[j]);
+                            exit(exit_failure);
+                        }
+
+                        /* Add the ipset to the appropriate chain */
+                        if(read_second)
+                            ipset_chain_append(&second, &second_last, ips);
+                        else {
+                            if(!first) first = ips;
+                            ipset_chain_append(&root, &root_last, ips);
+                        }
                     }
+
+                    free(slots);
+                    free(lineids);
+                    free_pathnames(files, files_collected);
                 }
             }
             else {
                 inputs++;
                 if(!(ips = ipset_load(argv[i]))) {
                     fprintf(stderr, "%s: Cannot load ipset: %s\n", PROG, argv[i]);
-                    exit(1);
+                    exit(exit_failure);
                 }
                 
                 if(read_second)
@@ -922,11 +1190,19 @@ int main(int argc, char **argv) {
         }
     }
 
+    /* the add command is the prefix of the lines of ipset restore scripts */
+    if((print == PRINT_IPSET_RESTORE_NET || print == PRINT_IPSET_RESTORE_IP)
+       && (*print_prefix_ips || *print_prefix_nets || *print_suffix_ips || *print_suffix_nets)) {
+        fprintf(stderr, "%s: --print-prefix and --print-suffix cannot be used with --print-ipset-restore\n", PROG);
+        exit(exit_failure);
+    }
+
     /* IPv6 mode: delegate to the IPv6 execution path */
     if(active_family == 6) {
         gettimeofday(&load_dt, NULL);
         ret = iprange6_run(argc, argv, mode, print, header, quiet,
-                           ipset_reduce_factor, ipset_reduce_min_accepted);
+                           ipset_reduce_factor, ipset_reduce_min_accepted,
+                           coverage_op, coverage_depth);
         exit(ret);
     }
 
@@ -941,7 +1217,7 @@ int main(int argc, char **argv) {
 
         if(!(first = root = ipset_load(NULL))) {
             fprintf(stderr, "%s: Cannot load ipset from stdin\n", PROG);
-            exit(1);
+            exit(exit_failure);
         }
         root_last = root;
     }
@@ -949,21 +1225,36 @@ int main(int argc, char **argv) {
     if(!root) {
         // impossible situation since we fail if no ipset is loaded
         fprintf(stderr, "%s: No valid ipsets to merge from the provided inputs.\n", PROG);
-        exit(1);
+        exit(exit_failure);
     }
 
     gettimeofday(&load_dt, NULL);
 
         if(mode == MODE_COMBINE || mode == MODE_REDUCE || mode == MODE_COUNT_UNIQUE_MERGED) {
-        /* for debug mode to show something meaningful */
-        ipset_set_filename(root, "combined ipset");
-
-        for(ips = root->next; ips ;ips = ips->next)
-            if(unlikely(ipset_merge(root, ips))) {
-                fprintf(stderr, "%s: Cannot merge ipset %s into %s\n", PROG, ips->filename, root->filename);
-                exit(1);
+        if(root->next || ipset_bitmap_forced) {
+            ipset *combined;
+
+            /* either set the bits of all the ipsets, or optimize each ipset and stream them in order into one */
+            if(ipset_bitmap_wanted(root, NULL))
+                combined = ipset_bitmap_union(root, "combined ipset");
+            else if(ipset_shard_wanted(root, NULL))
+                combined = ipset_shard_union(root, "combined ipset");
+            else
+                combined = ipset_kmerge_all(root, "combined ipset");
+
+            if(unlikely(!combined)) {
+                fprintf(stderr, "%s: Cannot merge ipsets into combined ipset\n", PROG);
+                exit(exit_failure);
             }
 
+            ipset_free_all(root);
+            root = combined;
+        }
+        else {
+            /* for debug mode to show something meaningful */
+            ipset_set_filename(root, "combined ipset");
+        }
+
         /* ipset_optimize(root); */
         if(mode == MODE_REDUCE) ipset_reduce(root, ipset_reduce_factor, ipset_reduce_min_accepted);
 
@@ -981,46 +1272,109 @@ int main(int argc, char **argv) {
         }
     }
     else if(mode == MODE_COMMON) {
-        ipset *common = NULL, *ips2 = NULL;
+        ipset *common = NULL;
 
         if(!root->next) {
             fprintf(stderr, "%s: two ipsets at least are needed to be compared to find their common IPs.\n", PROG);
-            exit(1);
+            exit(exit_failure);
         }
 
         /* ipset_optimize_all(root); */
 
-        common = ipset_common(root, root->next);
-        for(ips = root->next->next; ips ;ips = ips->next) {
-            ips2 = ipset_common(common, ips);
-            ipset_free(common);
-            common = ips2;
+        if(ipset_bitmap_wanted(root, NULL)) {
+            if(!(common = ipset_bitmap_common(root))) {
+                fprintf(stderr, "%s: Cannot find the common IPs of the ipsets\n", PROG);
+                exit(exit_failure);
+            }
+        }
+        else if(ipset_shard_wanted(root, NULL)) {
+            if(!(common = ipset_shard_common(root))) {
+                fprintf(stderr, "%s: Cannot find the common IPs of the ipsets\n", PROG);
+                exit(exit_failure);
+            }
+        }
+        else if(!(common = ipset_common_all(root))) {
+            fprintf(stderr, "%s: Cannot find the common IPs of the ipsets\n", PROG);
+            exit(exit_failure);
         }
 
         gettimeofday(&print_dt, NULL);
         ipset_print(common, print);
     }
+    else if(mode == MODE_COVERAGE) {
+        ipset *coverage;
+
+        if(!(coverage = ipset_coverage(root, coverage_op, coverage_depth))) {
+            fprintf(stderr, "%s: Cannot find the coverage of the ipsets\n", PROG);
+            exit(exit_failure);
+        }
+
+        gettimeofday(&print_dt, NULL);
+        ipset_print(coverage, print);
+    }
+    else if(mode == MODE_MEMBERSHIP) {
+        IPSET_MEMBERSHIP *membership;
+
+        if(!(membership = ipset_membership(root))) {
+            fprintf(stderr, "%s: Cannot find the membership of the ipsets\n", PROG);
+            exit(exit_failure);
+        }
+
+        gettimeofday(&print_dt, NULL);
+        ipset_membership_print(membership, print, header);
+        ipset_membership_free(membership);
+    }
+    else if(mode == MODE_EXCLUSIVE_FIRST) {
+        ipset *exclusive;
+        size_t id;
+
+        for(ips = root, id = 0; ips && ips != first; ips = ips->next) id++;
+
+        if(!(exclusive = ipset_exclusive(root, id))) {
+            fprintf(stderr, "%s: Cannot find the exclusive IPs of the first ipset\n", PROG);
+            exit(exit_failure);
+        }
+
+        gettimeofday(&print_dt, NULL);
+        ipset_print(exclusive, print);
+    }
     else if(mode == MODE_DIFF) {
         if(!root || !second) {
             fprintf(stderr, "%s: two ipsets at least are needed to be diffed.\n", PROG);
-            exit(1);
+            exit(exit_failure);
         }
 
-        for(ips = root->next; ips ;ips = ips->next)
-            if(unlikely(ipset_merge(root, ips))) {
-                fprintf(stderr, "%s: Cannot merge ipset %s into %s\n", PROG, ips->filename, root->filename);
-                exit(1);
+        if(ipset_bitmap_wanted(root, second)) {
+            if(!(ips = ipset_bitmap_diff(root, second))) {
+                fprintf(stderr, "%s: Cannot find the differences of the ipsets\n", PROG);
+                exit(exit_failure);
             }
-        if(root->next) ipset_set_filename(root, "ipset A");
+        }
+        else {
+            for(ips = root->next; ips ;ips = ips->next)
+                if(unlikely(ipset_merge(root, ips))) {
+                    fprintf(stderr, "%s: Cannot merge ipset %s into %s\n", PROG, ips->filename, root->filename);
+                    exit(exit_failure);
+                }
+            if(root->next) ipset_set_filename(root, "ipset A");
 
-        for(ips = second->next; ips ;ips = ips->next)
-            if(unlikely(ipset_merge(second, ips))) {
-                fprintf(stderr, "%s: Cannot merge ipset %s into %s\n", PROG, ips->filename, second->filename);
-                exit(1);
-            }
-        if(second->next) ipset_set_filename(second, "ipset B");
+            for(ips = second->next; ips ;ips = ips->next)
+                if(unlikely(ipset_merge(second, ips))) {
+                    fprintf(stderr, "%s: Cannot merge ipset %s into %s\n", PROG, ips->filename, second->filename);
+                    exit(exit_failure);
+                }
+            if(second->next) ipset_set_filename(second, "ipset B");
+
+            if(ipset_shard_wanted(root, second))
+                ips = ipset_shard_diff(root, second);
+            else
+                ips = ipset_diff(root, second);
 
-        ips = ipset_diff(root, second);
+            if(!ips) {
+                fprintf(stderr, "%s: Cannot find the differences of the ipsets\n", PROG);
+                exit(exit_failure);
+            }
+        }
 
         gettimeofday(&print_dt, NULL);
         if(!quiet) ipset_print(ips, print);
@@ -1029,58 +1383,80 @@ int main(int argc, char **argv) {
         if(ips->unique_ips) ret = 1;
         else ret = 0;
     }
+    else if(mode == MODE_INTERSECTS || mode == MODE_SUBSET || mode == MODE_EQUALS) {
+        network_addr_t witness;
+        int answer;
+
+        if(!root || !second) {
+            fprintf(stderr, "%s: two ipsets at least are needed to be tested.\n", PROG);
+            exit(exit_failure);
+        }
+
+        ipset_merge_side(root, "ipset A");
+        ipset_merge_side(second, "ipset B");
+
+        if(mode == MODE_INTERSECTS)
+            answer = ipset_intersects(root, second, debug ? &witness : NULL);
+        else if(mode == MODE_SUBSET)
+            answer = ipset_is_subset(root, second, debug ? &witness : NULL);
+        else
+            answer = ipset_equals(root, second, debug ? &witness : NULL);
+
+        if(unlikely(debug)) {
+            char buf1[IP2STR_MAX_LEN + 1], buf2[IP2STR_MAX_LEN + 1];
+            int decided = (mode == MODE_INTERSECTS) ? answer : !answer;
+
+            if(decided)
+                fprintf(stderr, "%s: witness range %s-%s\n", PROG, ip2str_r(buf1, witness.addr), ip2str_r(buf2, witness.broadcast));
+            else
+                fprintf(stderr, "%s: no witness range found\n", PROG);
+        }
+
+        gettimeofday(&print_dt, NULL);
+        ret = answer ? 0 : 1;
+    }
     else if(mode == MODE_COMPARE) {
         ipset *ips2;
+        uint64_t *common;
+        size_t n, i, j;
 
         if(!root->next) {
             fprintf(stderr, "%s: two ipsets at least are needed to be compared.\n", PROG);
-            exit(1);
+            exit(exit_failure);
         }
 
         if(unlikely(header)) fputs("name1,name2,entries1,entries2,ips1,ips2,combined_ips,common_ips\n", stdout);
 
         ipset_optimize_all(root);
 
-        for(ips = root; ips ;ips = ips->next) {
-            for(ips2 = ips; ips2 ;ips2 = ips2->next) {
-                ipset *comips;
+        /* the common IPs of all the pairs, in a single sweep */
+        if(!(common = ipset_compare_all(root, &n))) {
+            fprintf(stderr, "%s: Cannot compare the ipsets\n", PROG);
+            exit(exit_failure);
+        }
+
+        for(ips = root, i = 0; ips ;ips = ips->next, i++) {
+            for(ips2 = ips->next, j = i + 1; ips2 ;ips2 = ips2->next, j++) {
                 size_t entries1, entries2;
                 uint64_t unique1 = ipset_report_unique_ips(ips, &entries1);
                 uint64_t unique2 = ipset_report_unique_ips(ips2, &entries2);
+                uint64_t common_ips = common[ipset_compare_pair(n, i, j)];
 
-                if(ips == ips2) continue;
-
-#ifdef COMPARE_WITH_COMMON
-                comips = ipset_common(ips, ips2);
-                if(!comips) {
-                    fprintf(stderr, "%s: Cannot find the common IPs of ipset %s and %s\n", PROG, ips->filename, ips2->filename);
-                    exit(1);
-                }
-                iprange_csv_write_compare_row(ips->filename, ips2->filename, entries1, entries2,
-                                              unique1, unique2, unique1 + unique2 - comips->unique_ips, comips->unique_ips);
-                ipset_free(comips);
-#else
-                comips = ipset_combine(ips, ips2);
-                if(!comips) {
-                    fprintf(stderr, "%s: Cannot merge ipset %s and %s\n", PROG, ips->filename, ips2->filename);
-                    exit(1);
-                }
-
-                ipset_optimize(comips);
                 iprange_csv_write_compare_row(ips->filename, ips2->filename, entries1, entries2,
-                                              unique1, unique2, comips->unique_ips, unique1 + unique2 - comips->unique_ips);
-                ipset_free(comips);
-#endif
+                                              unique1, unique2, unique1 + unique2 - common_ips, common_ips);
             }
         }
+        free(common);
         gettimeofday(&print_dt, NULL);
     }
     else if(mode == MODE_COMPARE_NEXT) {
         ipset *ips2;
+        uint64_t *common;
+        size_t n1, n2, i, j;
 
         if(!second) {
             fprintf(stderr, "%s: no files given after the --compare-next parameter.\n", PROG);
-            exit(1);
+            exit(exit_failure);
         }
 
         if(unlikely(header)) fputs("name1,name2,entries1,entries2,ips1,ips2,combined_ips,common_ips\n", stdout);
@@ -1088,105 +1464,126 @@ int main(int argc, char **argv) {
         ipset_optimize_all(root);
         ipset_optimize_all(second);
 
-        for(ips = root; ips ;ips = ips->next) {
-            for(ips2 = second; ips2 ;ips2 = ips2->next) {
+        for(ips = root, n1 = 0; ips ;ips = ips->next) n1++;
+        for(ips2 = second, n2 = 0; ips2 ;ips2 = ips2->next) n2++;
+
+        /* count all the pairs on parallel threads, then print them in order */
+        if(!(common = ipset_count_pairs(root, n1, second, n2, ipset_count_common))) {
+            fprintf(stderr, "%s: Cannot compare the ipsets\n", PROG);
+            exit(exit_failure);
+        }
+
+        for(ips = root, i = 0; ips ;ips = ips->next, i++) {
+            for(ips2 = second, j = 0; ips2 ;ips2 = ips2->next, j++) {
                 size_t entries1, entries2;
                 uint64_t unique1 = ipset_report_unique_ips(ips, &entries1);
                 uint64_t unique2 = ipset_report_unique_ips(ips2, &entries2);
-#ifdef COMPARE_WITH_COMMON
-                ipset *common = ipset_common(ips, ips2);
-                if(!common) {
-                    fprintf(stderr, "%s: Cannot find the common IPs of ipset %s and %s\n", PROG, ips->filename, ips2->filename);
-                    exit(1);
-                }
-                iprange_csv_write_compare_row(ips->filename, ips2->filename, entries1, entries2,
-                                              unique1, unique2, unique1 + unique2 - common->unique_ips, common->unique_ips);
-                ipset_free(common);
-#else
-                ipset *combined = ipset_combine(ips, ips2);
-                if(!combined) {
-                    fprintf(stderr, "%s: Cannot merge ipset %s and %s\n", PROG, ips->filename, ips2->filename);
-                    exit(1);
-                }
+                uint64_t common_ips = common[i * n2 + j];
 
-                ipset_optimize(combined);
                 iprange_csv_write_compare_row(ips->filename, ips2->filename, entries1, entries2,
-                                              unique1, unique2, combined->unique_ips, unique1 + unique2 - combined->unique_ips);
-                ipset_free(combined);
-#endif
+                                              unique1, unique2, unique1 + unique2 - common_ips, common_ips);
             }
         }
+        free(common);
         gettimeofday(&print_dt, NULL);
     }
     else if(mode == MODE_COMPARE_FIRST) {
+        uint64_t *common;
+        size_t n, i;
+
         if(!root->next) {
             fprintf(stderr, "%s: two ipsets at least are needed to be compared.\n", PROG);
-            exit(1);
+            exit(exit_failure);
         }
 
         if(unlikely(header)) fputs("name,entries,unique_ips,common_ips\n", stdout);
 
         ipset_optimize_all(root);
 
-        for(ips = root; ips ;ips = ips->next) {
-            ipset *comips;
+        for(ips = root, n = 0; ips ;ips = ips->next) n++;
+
+        if(!(common = ipset_count_pairs(root, n, first, 1, ipset_count_common))) {
+            fprintf(stderr, "%s: Cannot compare the ipsets\n", PROG);
+            exit(exit_failure);
+        }
+
+        for(ips = root, i = 0; ips ;ips = ips->next, i++) {
             size_t entries;
             uint64_t unique_ips = ipset_report_unique_ips(ips, &entries);
 
             if(ips == first) continue;
 
-#ifdef COMPARE_WITH_COMMON
-            comips = ipset_common(ips, first);
-            if(!comips) {
-                fprintf(stderr, "%s: Cannot find the comips IPs of ipset %s and %s\n", PROG, ips->filename, first->filename);
-                exit(1);
-            }
-            iprange_csv_write_count_row(ips->filename, entries, unique_ips, comips->unique_ips);
-            ipset_free(comips);
-#else
-            comips = ipset_combine(ips, first);
-            if(!comips) {
-                fprintf(stderr, "%s: Cannot merge ipset %s and %s\n", PROG, ips->filename, first->filename);
-                exit(1);
-            }
+            iprange_csv_write_count_row(ips->filename, entries, unique_ips, common[i]);
+        }
+        free(common);
+        gettimeofday(&print_dt, NULL);
+    }
+    else if(mode == MODE_COUNT_EXCLUSIVE) {
+        uint64_t *exclusive;
+        size_t i;
 
-            ipset_optimize(comips);
-            iprange_csv_write_count_row(ips->filename, entries, unique_ips, unique_ips + first->unique_ips - comips->unique_ips);
-            ipset_free(comips);
-#endif
+        if(unlikely(header)) fputs("name,entries,unique_ips,exclusive_ips\n", stdout);
+
+        if(!(exclusive = ipset_exclusive_ips(root))) {
+            fprintf(stderr, "%s: Cannot count the exclusive IPs of the ipsets\n", PROG);
+            exit(exit_failure);
         }
+
+        for(ips = root, i = 0; ips ;ips = ips->next, i++) {
+            size_t entries;
+            uint64_t unique_ips = ipset_report_unique_ips(ips, &entries);
+
+            iprange_csv_write_count_row(ips->filename, entries, unique_ips, exclusive[i]);
+        }
+        free(exclusive);
         gettimeofday(&print_dt, NULL);
     }
     else if(mode == MODE_EXCLUDE_NEXT) {
-        ipset *excluded;
+        ipset *excluded, *tmp;
 
         if(!second) {
             fprintf(stderr, "%s: no files given after the --exclude-next parameter.\n", PROG);
-            exit(1);
+            exit(exit_failure);
         }
 
-        /* merge them */
-        for(ips = root->next; ips ;ips = ips->next)
-            if(unlikely(ipset_merge(root, ips))) {
-                fprintf(stderr, "%s: Cannot merge ipset %s into %s\n", PROG, ips->filename, root->filename);
-                exit(1);
+        if(ipset_bitmap_wanted(root, second)) {
+            if(!(excluded = ipset_bitmap_exclude(root, second))) {
+                fprintf(stderr, "%s: Cannot exclude the IPs of the ipsets from %s\n", PROG, root->filename);
+                exit(exit_failure);
             }
+        }
+        else {
+            /* merge them */
+            for(ips = root->next; ips ;ips = ips->next)
+                if(unlikely(ipset_merge(root, ips))) {
+                    fprintf(stderr, "%s: Cannot merge ipset %s into %s\n", PROG, ips->filename, root->filename);
+                    exit(exit_failure);
+                }
 
-        /* ipset_optimize(root); */
-        /* ipset_optimize_all(second); */
+            /* ipset_optimize(root); */
+            /* ipset_optimize_all(second); */
+
+            /* exclude the union of all of them, in a single pass */
+            excluded = root;
+            root = root->next;
+
+            /* the ipsets after it have been merged into it */
+            excluded->next = NULL;
+
+            if(ipset_shard_wanted(excluded, second))
+                tmp = ipset_shard_exclude_all(excluded, second);
+            else
+                tmp = ipset_exclude_all(excluded, second);
 
-        excluded = root;
-        root = root->next;
-        for(ips = second; ips ;ips = ips->next) {
-            ipset *tmp = ipset_exclude(excluded, ips);
             if(!tmp) {
-                fprintf(stderr, "%s: Cannot exclude the IPs of ipset %s from %s\n", PROG, ips->filename, excluded->filename);
-                exit(1);
+                fprintf(stderr, "%s: Cannot exclude the IPs of the ipsets from %s\n", PROG, excluded->filename);
+                exit(exit_failure);
             }
 
             ipset_free(excluded);
             excluded = tmp;
         }
+
         gettimeofday(&print_dt, NULL);
         ipset_print(excluded, print);
     }
@@ -1209,7 +1606,7 @@ int main(int argc, char **argv) {
 */
     else {
         fprintf(stderr, "%s: Unknown mode.\n", PROG);
-        exit(1);
+        exit(exit_failure);
     }
 
     gettimeofday(&stop_dt, NULL);
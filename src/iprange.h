@@ -23,6 +23,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 
 extern int cidr_use_network;
 extern int default_prefix;
@@ -235,6 +236,79 @@ static inline network_addr_t str2netaddr(char *ipstr, int *err) {
 
 }
 
+/*-----------------------------------------------------------------*/
+/* parse a canonical A.B.C.D or A.B.C.D/N token in a single pass,  */
+/* validating and converting it at the same time                   */
+/*                                                                 */
+/* only plain decimal octets without leading zeros and a decimal   */
+/* prefix are accepted; anything else (octal, hex, short forms,    */
+/* netmasks) returns NULL, so that the caller can fall back to     */
+/* str2netaddr() which handles every form inet_aton() accepts      */
+/*                                                                 */
+/* on success it returns a pointer to the first character after    */
+/* the token                                                       */
+/*-----------------------------------------------------------------*/
+static inline const char *ipv4_fast_parse(const char *s, network_addr_t *netaddr) {
+    in_addr_t addr = 0;
+    unsigned int octet, digit;
+    int i, prefix = default_prefix;
+
+    for(i = 0; i < 4; i++) {
+        if(i) {
+            if(unlikely(*s != '.')) return NULL;
+            s++;
+        }
+
+        octet = (unsigned int)(unsigned char)*s - '0';
+        if(unlikely(octet > 9)) return NULL;
+        s++;
+
+        if(likely(octet)) {
+            digit = (unsigned int)(unsigned char)*s - '0';
+            if(digit <= 9) {
+                octet = octet * 10 + digit;
+                s++;
+
+                digit = (unsigned int)(unsigned char)*s - '0';
+                if(digit <= 9) {
+                    octet = octet * 10 + digit;
+                    s++;
+                    if(unlikely(octet > 255)) return NULL;
+                }
+            }
+        }
+
+        addr = (addr << 8) | octet;
+    }
+
+    if(*s == '/') {
+        s++;
+
+        prefix = (int)((unsigned int)(unsigned char)*s - '0');
+        if(unlikely((unsigned int)prefix > 9)) return NULL;
+        s++;
+
+        digit = (unsigned int)(unsigned char)*s - '0';
+        if(prefix && digit <= 9) {
+            prefix = prefix * 10 + (int)digit;
+            s++;
+            if(unlikely(prefix > 32)) return NULL;
+        }
+    }
+
+    /* the token must end here, otherwise it is not canonical */
+    if(unlikely((*s >= '0' && *s <= '9') || *s == '.' || *s == '/')) return NULL;
+
+    if(likely(cidr_use_network))
+        netaddr->addr = network(addr, prefix);
+    else
+        netaddr->addr = addr;
+
+    netaddr->broadcast = broadcast(netaddr->addr, prefix);
+
+    return s;
+}
+
 // ----------------------------------------------------------------------------
 // Print out a 32-bit address in A.B.C.D/M format
 //
@@ -276,17 +350,29 @@ static inline char *ip2str_r(char *buf, in_addr_t IP) {
 
 #include "ipset.h"
 #include "ipset_binary.h"
+#include "ipset_bitmap.h"
 #include "ipset_combine.h"
 #include "ipset_common.h"
+#include "ipset_compare.h"
 #include "ipset_copy.h"
+#include "ipset_count.h"
+#include "ipset_coverage.h"
 #include "ipset_diff.h"
 #include "ipset_exclude.h"
+#include "ipset_heap.h"
 #include "ipset_dns.h"
+#include "ipset_kmerge.h"
 #include "ipset_load.h"
 #include "ipset_merge.h"
 #include "ipset_optimize.h"
+#include "ipset_output.h"
+#include "ipset_parallel.h"
+#include "ipset_predicate.h"
 #include "ipset_print.h"
+#include "ipset_membership.h"
 #include "ipset_reduce.h"
+#include "ipset_shard.h"
+#include "ipset_sort.h"
 
 /* operation modes — shared between iprange.c and iprange6_main.c */
 #define MODE_COMBINE 1
@@ -299,5 +385,12 @@ static inline char *ip2str_r(char *buf, in_addr_t IP) {
 #define MODE_COMMON 8
 #define MODE_EXCLUDE_NEXT 9
 #define MODE_DIFF 10
+#define MODE_COVERAGE 11
+#define MODE_MEMBERSHIP 12
+#define MODE_COUNT_EXCLUSIVE 13
+#define MODE_EXCLUSIVE_FIRST 14
+#define MODE_INTERSECTS 15
+#define MODE_SUBSET 16
+#define MODE_EQUALS 17
 
 #endif //IPRANGE_IPRANGE_H
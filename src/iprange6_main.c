@@ -14,7 +14,6 @@
 #include <dirent.h>
 
 extern int active_family;
-extern unsigned long ipv6_dropped_in_ipv4_mode;
 
 static void ipset6_chain_append_local(ipset6 **head, ipset6 **tail, ipset6 *ips)
 {
@@ -42,6 +41,39 @@ static void free_pathnames6(char **files, size_t entries)
     free(files);
 }
 
+/*
+ * loads the given files into slots[], keeping their order
+ * with --threads the files are loaded in parallel, otherwise loading stops at
+ * the first file that fails. A file that failed to load leaves its slot NULL.
+ */
+
+typedef struct load6_files_job {
+    char **files;
+    ipset6 **slots;
+} LOAD6_FILES_JOB;
+
+static void ipset6_load_files_job(size_t job, void *data)
+{
+    LOAD6_FILES_JOB *lf = data;
+
+    lf->slots[job] = ipset6_load(lf->files[job]);
+}
+
+static void ipset6_load_files(char **files, ipset6 **slots, size_t entries)
+{
+    size_t j;
+
+    if(parallel_threads > 1 && entries > 1) {
+        LOAD6_FILES_JOB lf = { files, slots };
+        parallel_run("load", entries, ipset6_load_files_job, &lf);
+        return;
+    }
+
+    for(j = 0; j < entries; j++)
+        if(!(slots[j] = ipset6_load(files[j])))
+            break;
+}
+
 static uint128_t ipset6_report_unique_ips(ipset6 *ips, size_t *entries)
 {
     uint128_t unique_ips = ipset6_unique_ips(ips);
@@ -90,6 +122,18 @@ static void iprange6_csv_write_unique_row(const char *name, size_t entries, uint
     fputc('\n', stdout);
 }
 
+/* merges all the ipsets linked to 'next' from ips into it, naming it name */
+static void ipset6_merge_side(ipset6 *ips, const char *name) {
+    ipset6 *next;
+
+    for(next = ips->next; next; next = next->next)
+        if(unlikely(ipset6_merge(ips, next))) {
+            fprintf(stderr, "%s: Cannot merge ipset %s\n", PROG, next->filename);
+            exit(exit_failure);
+        }
+    if(ips->next) ipset6_set_filename(ips, name);
+}
+
 /*
  * iprange6_run() - execute IPv6 mode
  *
@@ -98,13 +142,19 @@ static void iprange6_csv_write_unique_row(const char *name, size_t entries, uint
  */
 int iprange6_run(int argc, char **argv, int mode, IPSET_PRINT_CMD print,
                  int header, int quiet, size_t ipset_reduce_factor,
-                 size_t ipset_reduce_min_accepted)
+                 size_t ipset_reduce_min_accepted, int coverage_op,
+                 size_t coverage_depth)
 {
     ipset6 *root = NULL, *root_last = NULL, *ips6 = NULL;
     ipset6 *first = NULL, *second = NULL, *second_last = NULL;
     int i, read_second = 0, inputs = 0, ret = 0;
     char u128buf[40];
 
+    if(print == PRINT_IPSET_RESTORE_NET || print == PRINT_IPSET_RESTORE_IP) {
+        fprintf(stderr, "%s: --print-ipset-restore is not supported in IPv6 mode\n", PROG);
+        exit(exit_failure);
+    }
+
     /* re-scan argv for file arguments, positional operators, and IPv6-relevant options */
     for(i = 1; i < argc; i++) {
         /* handle --min-prefix for IPv6 (0..128) */
@@ -116,7 +166,7 @@ int iprange6_run(int argc, char **argv, int mode, IPSET_PRINT_CMD print,
             val = strtol(argv[++i], &end, 10);
             if(errno || !end || end == argv[i] || *end != '\0' || val < 1 || val > 128) {
                 fprintf(stderr, "%s: Invalid value '%s' for --min-prefix. It must be between 1 and 128.\n", PROG, argv[i]);
-                exit(1);
+                exit(exit_failure);
             }
             for(j = 0; j < (int)val; j++)
                 prefix6_enabled[j] = 0;
@@ -136,14 +186,14 @@ int iprange6_run(int argc, char **argv, int mode, IPSET_PRINT_CMD print,
                 j = (int)strtol(s, &e, 10);
                 if(j <= 0 || j > 128) {
                     fprintf(stderr, "%s: Only prefixes from 1 to 128 can be set. %d is invalid.\n", PROG, j);
-                    exit(1);
+                    exit(exit_failure);
                 }
                 prefix6_enabled[j] = 1;
                 if(*e == ',' || *e == ' ') e++;
             }
             if(e && *e) {
                 fprintf(stderr, "%s: Invalid prefix '%s'\n", PROG, e);
-                exit(1);
+                exit(exit_failure);
             }
             continue;
         }
@@ -160,6 +210,8 @@ int iprange6_run(int argc, char **argv, int mode, IPSET_PRINT_CMD print,
         if(i+1 < argc && (!strcmp(argv[i], "as")
             || !strcmp(argv[i], "--ipset-reduce") || !strcmp(argv[i], "--reduce-factor")
             || !strcmp(argv[i], "--ipset-reduce-entries") || !strcmp(argv[i], "--reduce-entries")
+            || !strcmp(argv[i], "--print-ipset-restore")
+            || !strcmp(argv[i], "--print-ipset-restore-ips")
             || !strcmp(argv[i], "--print-prefix")
             || !strcmp(argv[i], "--print-prefix-ips")
             || !strcmp(argv[i], "--print-prefix-nets")
@@ -167,6 +219,10 @@ int iprange6_run(int argc, char **argv, int mode, IPSET_PRINT_CMD print,
             || !strcmp(argv[i], "--print-suffix-ips")
             || !strcmp(argv[i], "--print-suffix-nets")
             || !strcmp(argv[i], "--dns-threads")
+            || !strcmp(argv[i], "--threads")
+            || !strcmp(argv[i], "--coverage-at-least")
+            || !strcmp(argv[i], "--coverage-exactly")
+            || !strcmp(argv[i], "--coverage-at-most")
             )) {
             i++; /* skip value */
             continue;
@@ -188,6 +244,12 @@ int iprange6_run(int argc, char **argv, int mode, IPSET_PRINT_CMD print,
                 read_second = 1;
                 continue;
             }
+            if(!strcmp(argv[i], "--intersects") || !strcmp(argv[i], "--intersects-next")
+               || !strcmp(argv[i], "--subset-of") || !strcmp(argv[i], "--subset-of-next")
+               || !strcmp(argv[i], "--equals") || !strcmp(argv[i], "--equals-next")) {
+                read_second = 1;
+                continue;
+            }
             /* all other flags: skip */
             continue;
         }
@@ -198,7 +260,7 @@ int iprange6_run(int argc, char **argv, int mode, IPSET_PRINT_CMD print,
         if(!strcmp(argv[i], "-")) {
             if(!(ips6 = ipset6_load(NULL))) {
                 fprintf(stderr, "%s: Cannot load ipset from stdin\n", PROG);
-                exit(1);
+                exit(exit_failure);
             }
         }
         else if(argv[i][0] == '@') {
@@ -208,6 +270,7 @@ int iprange6_run(int argc, char **argv, int mode, IPSET_PRINT_CMD print,
             if(dir) {
                 struct dirent *entry;
                 char **files = NULL;
+                ipset6 **slots;
                 size_t files_allocated = 0, files_collected = 0, j;
 
                 while((entry = readdir(dir))) {
@@ -227,7 +290,7 @@ int iprange6_run(int argc, char **argv, int mode, IPSET_PRINT_CMD print,
                             closedir(dir);
                             free_pathnames6(files, files_collected);
                             fprintf(stderr, "%s: Cannot allocate memory\n", PROG);
-                            exit(1);
+                            exit(exit_failure);
                         }
                         files = tmp;
                         files_allocated = next_allocated;
@@ -238,7 +301,7 @@ int iprange6_run(int argc, char **argv, int mode, IPSET_PRINT_CMD print,
                         closedir(dir);
                         free_pathnames6(files, files_collected);
                         fprintf(stderr, "%s: Cannot allocate memory\n", PROG);
-                        exit(1);
+                        exit(exit_failure);
                     }
                     files_collected++;
                 }
@@ -247,16 +310,25 @@ int iprange6_run(int argc, char **argv, int mode, IPSET_PRINT_CMD print,
                 if(!files_collected) {
                     free(files);
                     fprintf(stderr, "%s: No valid files found in directory: %s\n", PROG, listname);
-                    exit(1);
+                    exit(exit_failure);
                 }
 
                 qsort(files, files_collected, sizeof(*files), compare_pathnames6);
 
+                slots = calloc(files_collected, sizeof(*slots));
+                if(!slots) {
+                    free_pathnames6(files, files_collected);
+                    fprintf(stderr, "%s: Cannot allocate memory\n", PROG);
+                    exit(exit_failure);
+                }
+
+                ipset6_load_files(files, slots, files_collected);
+
                 for(j = 0; j < files_collected; j++) {
-                    if(!(ips6 = ipset6_load(files[j]))) {
+                    if(!(ips6 = slots[j])) {
                         fprintf(stderr, "%s: Cannot load file %s\n", PROG, files[j]);
                         free_pathnames6(files, files_collected);
-                        exit(1);
+                        exit(exit_failure);
                     }
 
                     if(read_second)
@@ -266,22 +338,27 @@ int iprange6_run(int argc, char **argv, int mode, IPSET_PRINT_CMD print,
                         ipset6_chain_append_local(&root, &root_last, ips6);
                     }
                 }
+                free(slots);
                 free_pathnames6(files, files_collected);
                 continue;
             }
             else if(errno != ENOTDIR) {
                 fprintf(stderr, "%s: Cannot access %s: %s\n", PROG, listname, strerror(errno));
-                exit(1);
+                exit(exit_failure);
             }
             else {
                 /* file list */
                 FILE *fp = iprange_fopen_read(listname);
                 char line[MAX_LINE + 1];
-                int lineid = 0, files_loaded = 0;
+                int lineid = 0;
+                char **files = NULL;
+                int *lineids = NULL;
+                ipset6 **slots;
+                size_t files_allocated = 0, files_collected = 0, j;
 
                 if(!fp) {
                     fprintf(stderr, "%s: Cannot open file list: %s - %s\n", PROG, listname, strerror(errno));
-                    exit(1);
+                    exit(exit_failure);
                 }
 
                 while(fgets(line, MAX_LINE, fp)) {
@@ -292,12 +369,55 @@ int iprange6_run(int argc, char **argv, int mode, IPSET_PRINT_CMD print,
                         continue;
                     iprange_trim_trailing_whitespace(s);
 
-                    if(!(ips6 = ipset6_load(s))) {
-                        fprintf(stderr, "%s: Cannot load file %s from list %s (line %d)\n", PROG, s, listname, lineid);
+                    if(files_collected == files_allocated) {
+                        size_t next_allocated = files_allocated ? files_allocated * 2 : 16;
+                        char **tmp = realloc(files, next_allocated * sizeof(*files));
+                        int *tmp_lineids = tmp ? realloc(lineids, next_allocated * sizeof(*lineids)) : NULL;
+                        if(tmp) files = tmp;
+                        if(tmp_lineids) lineids = tmp_lineids;
+                        if(!tmp || !tmp_lineids) {
+                            fclose(fp);
+                            free(lineids);
+                            free_pathnames6(files, files_collected);
+                            fprintf(stderr, "%s: Cannot allocate memory\n", PROG);
+                            exit(exit_failure);
+                        }
+                        files_allocated = next_allocated;
+                    }
+
+                    files[files_collected] = strdup(s);
+                    if(!files[files_collected]) {
                         fclose(fp);
-                        exit(1);
+                        free(lineids);
+                        free_pathnames6(files, files_collected);
+                        fprintf(stderr, "%s: Cannot allocate memory\n", PROG);
+                        exit(exit_failure);
+                    }
+                    lineids[files_collected] = lineid;
+                    files_collected++;
+                }
+                fclose(fp);
+
+                if(!files_collected) {
+                    fprintf(stderr, "%s: No valid files found in file list: %s\n", PROG, listname);
+                    exit(exit_failure);
+                }
+
+                slots = calloc(files_collected, sizeof(*slots));
+                if(!slots) {
+                    free(lineids);
+                    free_pathnames6(files, files_collected);
+                    fprintf(stderr, "%s: Cannot allocate memory\n", PROG);
+                    exit(exit_failure);
+                }
+
+                ipset6_load_files(files, slots, files_collected);
+
+                for(j = 0; j < files_collected; j++) {
+                    if(!(ips6 = slots[j])) {
+                        fprintf(stderr, "%s: Cannot load file %s from list %s (line %d)\n", PROG, files[j], listname, lineids[j]);
+                        exit(exit_failure);
                     }
-                    files_loaded = 1;
 
                     if(read_second)
                         ipset6_chain_append_local(&second, &second_last, ips6);
@@ -306,19 +426,16 @@ int iprange6_run(int argc, char **argv, int mode, IPSET_PRINT_CMD print,
                         ipset6_chain_append_local(&root, &root_last, ips6);
                     }
                 }
-                fclose(fp);
-
-                if(!files_loaded) {
-                    fprintf(stderr, "%s: No valid files found in file list: %s\n", PROG, listname);
-                    exit(1);
-                }
+                free(slots);
+                free(lineids);
+                free_pathnames6(files, files_collected);
                 continue;
             }
         }
         else {
             if(!(ips6 = ipset6_load(argv[i]))) {
                 fprintf(stderr, "%s: Cannot load ipset: %s\n", PROG, argv[i]);
-                exit(1);
+                exit(exit_failure);
             }
         }
 
@@ -340,30 +457,42 @@ int iprange6_run(int argc, char **argv, int mode, IPSET_PRINT_CMD print,
     if(!inputs) {
         if(!(first = root = ipset6_load(NULL))) {
             fprintf(stderr, "%s: Cannot load ipset from stdin\n", PROG);
-            exit(1);
+            exit(exit_failure);
         }
         root_last = root;
     }
 
     if(!root) {
         fprintf(stderr, "%s: No valid ipsets to process.\n", PROG);
-        exit(1);
+        exit(exit_failure);
     }
 
     /* --- mode execution (mirrors the IPv4 logic in main()) --- */
 
     if(mode == MODE_COMBINE || mode == MODE_REDUCE || mode == MODE_COUNT_UNIQUE_MERGED) {
-        ipset6_set_filename(root, "combined ipset");
-
-        for(ips6 = root->next; ips6; ips6 = ips6->next)
-            if(unlikely(ipset6_merge(root, ips6))) {
-                fprintf(stderr, "%s: Cannot merge ipset %s\n", PROG, ips6->filename);
-                exit(1);
+        if(root->next && ipset6_shard_wanted(root, NULL)) {
+            ipset6 *combined = ipset6_shard_union(root, "combined ipset");
+            if(unlikely(!combined)) {
+                fprintf(stderr, "%s: Cannot merge ipsets into combined ipset\n", PROG);
+                exit(exit_failure);
             }
 
+            ipset6_free_all(root);
+            root = combined;
+        }
+        else {
+            ipset6_set_filename(root, "combined ipset");
+
+            for(ips6 = root->next; ips6; ips6 = ips6->next)
+                if(unlikely(ipset6_merge(root, ips6))) {
+                    fprintf(stderr, "%s: Cannot merge ipset %s\n", PROG, ips6->filename);
+                    exit(exit_failure);
+                }
+        }
+
         if(mode == MODE_REDUCE) {
             fprintf(stderr, "%s: --ipset-reduce is not supported in IPv6 mode\n", PROG);
-            exit(1);
+            exit(exit_failure);
         }
 
         if(mode == MODE_COMBINE)
@@ -379,49 +508,124 @@ int iprange6_run(int argc, char **argv, int mode, IPSET_PRINT_CMD print,
 
         if(!root->next) {
             fprintf(stderr, "%s: two ipsets at least are needed to find common IPs.\n", PROG);
-            exit(1);
+            exit(exit_failure);
         }
 
-        common = ipset6_common(root, root->next);
-        for(ips6 = root->next->next; ips6; ips6 = ips6->next) {
-            ips2 = ipset6_common(common, ips6);
-            ipset6_free(common);
-            common = ips2;
+        if(ipset6_shard_wanted(root, NULL)) {
+            if(!(common = ipset6_shard_common(root))) {
+                fprintf(stderr, "%s: Cannot find the common IPs of the ipsets\n", PROG);
+                exit(exit_failure);
+            }
+        }
+        else {
+            common = ipset6_common(root, root->next);
+            for(ips6 = root->next->next; ips6; ips6 = ips6->next) {
+                ips2 = ipset6_common(common, ips6);
+                ipset6_free(common);
+                common = ips2;
+            }
         }
         ipset6_print(common, print);
     }
     else if(mode == MODE_DIFF) {
         if(!second) {
             fprintf(stderr, "%s: two ipsets at least are needed to be diffed.\n", PROG);
-            exit(1);
+            exit(exit_failure);
         }
 
         for(ips6 = root->next; ips6; ips6 = ips6->next)
             if(unlikely(ipset6_merge(root, ips6))) {
                 fprintf(stderr, "%s: Cannot merge ipset %s\n", PROG, ips6->filename);
-                exit(1);
+                exit(exit_failure);
             }
         if(root->next) ipset6_set_filename(root, "ipset A");
 
         for(ips6 = second->next; ips6; ips6 = ips6->next)
             if(unlikely(ipset6_merge(second, ips6))) {
                 fprintf(stderr, "%s: Cannot merge ipset %s\n", PROG, ips6->filename);
-                exit(1);
+                exit(exit_failure);
             }
         if(second->next) ipset6_set_filename(second, "ipset B");
 
-        ips6 = ipset6_diff(root, second);
+        if(ipset6_shard_wanted(root, second))
+            ips6 = ipset6_shard_diff(root, second);
+        else
+            ips6 = ipset6_diff(root, second);
+
+        if(!ips6) {
+            fprintf(stderr, "%s: Cannot find the differences of the ipsets\n", PROG);
+            exit(exit_failure);
+        }
+
         if(!quiet) ipset6_print(ips6, print);
 
         if(!u128_is_zero(ips6->unique_ips)) ret = 1;
         else ret = 0;
     }
+    else if(mode == MODE_INTERSECTS || mode == MODE_SUBSET || mode == MODE_EQUALS) {
+        network_addr6_t witness;
+        int answer;
+
+        if(!second) {
+            fprintf(stderr, "%s: two ipsets at least are needed to be tested.\n", PROG);
+            exit(exit_failure);
+        }
+
+        ipset6_merge_side(root, "ipset A");
+        ipset6_merge_side(second, "ipset B");
+
+        if(mode == MODE_INTERSECTS)
+            answer = ipset6_intersects(root, second, debug ? &witness : NULL);
+        else if(mode == MODE_SUBSET)
+            answer = ipset6_is_subset(root, second, debug ? &witness : NULL);
+        else
+            answer = ipset6_equals(root, second, debug ? &witness : NULL);
+
+        if(unlikely(debug)) {
+            char buf1[IP6STR_MAX_LEN], buf2[IP6STR_MAX_LEN];
+            int decided = (mode == MODE_INTERSECTS) ? answer : !answer;
+
+            if(decided)
+                fprintf(stderr, "%s: witness range %s-%s\n", PROG, ip6str_r(buf1, witness.addr), ip6str_r(buf2, witness.broadcast));
+            else
+                fprintf(stderr, "%s: no witness range found\n", PROG);
+        }
+
+        ret = answer ? 0 : 1;
+    }
+    else if(mode == MODE_MEMBERSHIP) {
+        fprintf(stderr, "%s: --membership is not supported in IPv6 mode\n", PROG);
+        exit(exit_failure);
+    }
+    else if(mode == MODE_COVERAGE) {
+        ipset6 *coverage;
+
+        if(!(coverage = ipset6_coverage(root, coverage_op, coverage_depth))) {
+            fprintf(stderr, "%s: Cannot find the coverage of the ipsets\n", PROG);
+            exit(exit_failure);
+        }
+
+        ipset6_print(coverage, print);
+    }
+    else if(mode == MODE_EXCLUSIVE_FIRST) {
+        ipset6 *exclusive;
+        size_t id;
+
+        for(ips6 = root, id = 0; ips6 && ips6 != first; ips6 = ips6->next) id++;
+
+        if(!(exclusive = ipset6_exclusive(root, id))) {
+            fprintf(stderr, "%s: Cannot find the exclusive IPs of the first ipset\n", PROG);
+            exit(exit_failure);
+        }
+
+        ipset6_print(exclusive, print);
+    }
     else if(mode == MODE_COMPARE) {
         ipset6 *ips2;
 
         if(!root->next) {
             fprintf(stderr, "%s: two ipsets at least are needed to be compared.\n", PROG);
-            exit(1);
+            exit(exit_failure);
         }
 
         if(unlikely(header)) printf("name1,name2,entries1,entries2,ips1,ips2,combined_ips,common_ips\n");
@@ -430,33 +634,28 @@ int iprange6_run(int argc, char **argv, int mode, IPSET_PRINT_CMD print,
 
         for(ips6 = root; ips6; ips6 = ips6->next) {
             for(ips2 = ips6; ips2; ips2 = ips2->next) {
-                ipset6 *comips;
                 size_t entries1, entries2;
                 uint128_t unique1 = ipset6_report_unique_ips(ips6, &entries1);
                 uint128_t unique2 = ipset6_report_unique_ips(ips2, &entries2);
 
                 if(ips6 == ips2) continue;
 
-                comips = ipset6_combine(ips6, ips2);
-                if(!comips) {
-                    fprintf(stderr, "%s: Cannot merge ipsets\n", PROG);
-                    exit(1);
-                }
+                uint128_t combined_ips = ipset6_count_union(ips6, ips2);
 
-                ipset6_optimize(comips);
                 iprange6_csv_write_compare_row(ips6->filename, ips2->filename, entries1, entries2,
-                                               unique1, unique2, comips->unique_ips,
-                                               u128_sub(u128_add(unique1, unique2), comips->unique_ips));
-                ipset6_free(comips);
+                                               unique1, unique2, combined_ips,
+                                               u128_sub(u128_add(unique1, unique2), combined_ips));
             }
         }
     }
     else if(mode == MODE_COMPARE_NEXT) {
         ipset6 *ips2;
+        uint128_t *combined;
+        size_t n1, n2, i, j;
 
         if(!second) {
             fprintf(stderr, "%s: no files given after the --compare-next parameter.\n", PROG);
-            exit(1);
+            exit(exit_failure);
         }
 
         if(unlikely(header)) printf("name1,name2,entries1,entries2,ips1,ips2,combined_ips,common_ips\n");
@@ -464,77 +663,105 @@ int iprange6_run(int argc, char **argv, int mode, IPSET_PRINT_CMD print,
         ipset6_optimize_all(root);
         ipset6_optimize_all(second);
 
-        for(ips6 = root; ips6; ips6 = ips6->next) {
-            for(ips2 = second; ips2; ips2 = ips2->next) {
+        for(ips6 = root, n1 = 0; ips6; ips6 = ips6->next) n1++;
+        for(ips2 = second, n2 = 0; ips2; ips2 = ips2->next) n2++;
+
+        /* count all the pairs on parallel threads, then print them in order */
+        if(!(combined = ipset6_count_pairs(root, n1, second, n2, ipset6_count_union))) {
+            fprintf(stderr, "%s: Cannot compare the ipsets\n", PROG);
+            exit(exit_failure);
+        }
+
+        for(ips6 = root, i = 0; ips6; ips6 = ips6->next, i++) {
+            for(ips2 = second, j = 0; ips2; ips2 = ips2->next, j++) {
                 size_t entries1, entries2;
                 uint128_t unique1 = ipset6_report_unique_ips(ips6, &entries1);
                 uint128_t unique2 = ipset6_report_unique_ips(ips2, &entries2);
 
-                ipset6 *combined = ipset6_combine(ips6, ips2);
-                if(!combined) {
-                    fprintf(stderr, "%s: Cannot merge ipsets\n", PROG);
-                    exit(1);
-                }
+                uint128_t combined_ips = combined[i * n2 + j];
 
-                ipset6_optimize(combined);
                 iprange6_csv_write_compare_row(ips6->filename, ips2->filename, entries1, entries2,
-                                               unique1, unique2, combined->unique_ips,
-                                               u128_sub(u128_add(unique1, unique2), combined->unique_ips));
-                ipset6_free(combined);
+                                               unique1, unique2, combined_ips,
+                                               u128_sub(u128_add(unique1, unique2), combined_ips));
             }
         }
+        free(combined);
     }
     else if(mode == MODE_COMPARE_FIRST) {
+        uint128_t *common;
+        size_t n, i;
+
         if(!root->next) {
             fprintf(stderr, "%s: two ipsets at least are needed to be compared.\n", PROG);
-            exit(1);
+            exit(exit_failure);
         }
 
         if(unlikely(header)) printf("name,entries,unique_ips,common_ips\n");
 
         ipset6_optimize_all(root);
 
-        for(ips6 = root; ips6; ips6 = ips6->next) {
+        for(ips6 = root, n = 0; ips6; ips6 = ips6->next) n++;
+
+        if(!(common = ipset6_count_pairs(root, n, first, 1, ipset6_count_common))) {
+            fprintf(stderr, "%s: Cannot compare the ipsets\n", PROG);
+            exit(exit_failure);
+        }
+
+        for(ips6 = root, i = 0; ips6; ips6 = ips6->next, i++) {
             size_t entries;
             uint128_t unique_ips = ipset6_report_unique_ips(ips6, &entries);
 
             if(ips6 == first) continue;
 
-            ipset6 *comips = ipset6_combine(ips6, first);
-            if(!comips) {
-                fprintf(stderr, "%s: Cannot merge ipsets\n", PROG);
-                exit(1);
-            }
+            iprange6_csv_write_count_row(ips6->filename, entries, unique_ips, common[i]);
+        }
+        free(common);
+    }
+    else if(mode == MODE_COUNT_EXCLUSIVE) {
+        uint128_t *exclusive;
+        size_t i;
+
+        if(unlikely(header)) printf("name,entries,unique_ips,exclusive_ips\n");
+
+        if(!(exclusive = ipset6_exclusive_ips(root))) {
+            fprintf(stderr, "%s: Cannot count the exclusive IPs of the ipsets\n", PROG);
+            exit(exit_failure);
+        }
+
+        for(ips6 = root, i = 0; ips6; ips6 = ips6->next, i++) {
+            size_t entries;
+            uint128_t unique_ips = ipset6_report_unique_ips(ips6, &entries);
 
-            ipset6_optimize(comips);
-            iprange6_csv_write_count_row(ips6->filename, entries, unique_ips,
-                                         u128_sub(u128_add(unique_ips, first->unique_ips), comips->unique_ips));
-            ipset6_free(comips);
+            iprange6_csv_write_count_row(ips6->filename, entries, unique_ips, exclusive[i]);
         }
+        free(exclusive);
     }
     else if(mode == MODE_EXCLUDE_NEXT) {
         ipset6 *excluded;
 
         if(!second) {
             fprintf(stderr, "%s: no files given after the --exclude-next parameter.\n", PROG);
-            exit(1);
+            exit(exit_failure);
         }
 
         for(ips6 = root->next; ips6; ips6 = ips6->next)
             if(unlikely(ipset6_merge(root, ips6))) {
                 fprintf(stderr, "%s: Cannot merge ipset %s\n", PROG, ips6->filename);
-                exit(1);
+                exit(exit_failure);
             }
 
-        excluded = root;
-        for(ips6 = second; ips6; ips6 = ips6->next) {
-            ipset6 *tmp = ipset6_exclude(excluded, ips6);
-            if(!tmp) {
-                fprintf(stderr, "%s: Cannot exclude IPs\n", PROG);
-                exit(1);
-            }
-            if(excluded != root) ipset6_free(excluded);
-            excluded = tmp;
+        /* the ipsets after root have been merged into it */
+        root->next = NULL;
+
+        /* exclude the union of all of them, in a single pass */
+        if(ipset6_shard_wanted(root, second))
+            excluded = ipset6_shard_exclude_all(root, second);
+        else
+            excluded = ipset6_exclude_all(root, second);
+
+        if(!excluded) {
+            fprintf(stderr, "%s: Cannot exclude IPs\n", PROG);
+            exit(exit_failure);
         }
         ipset6_print(excluded, print);
     }
@@ -549,7 +776,7 @@ int iprange6_run(int argc, char **argv, int mode, IPSET_PRINT_CMD print,
     }
     else {
         fprintf(stderr, "%s: Unknown mode.\n", PROG);
-        exit(1);
+        exit(exit_failure);
     }
 
     (void)ipset_reduce_factor;
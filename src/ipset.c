@@ -2,6 +2,19 @@
 
 #define IPSET_ENTRIES_INCREASE_STEP 1024
 
+/*
+ * set operations on 2 ipsets gallop over the larger one with ipset_seek(),
+ * instead of walking it entry by entry, when it has at least this many
+ * times the entries of the smaller one; 0 disables galloping
+ */
+size_t ipset_gallop_ratio = 32;
+
+/*
+ * the exit status of errors; the predicate modes make it 2, since their
+ * exit status 1 is the answer no, like cmp, diff and grep do
+ */
+int exit_failure = 1;
+
 /* ----------------------------------------------------------------------------
  * ipset_create()
  *
@@ -90,7 +103,7 @@ void ipset_grow_internal(ipset *ips, size_t free_entries_needed) {
     increase = (free_entries_needed < IPSET_ENTRIES_INCREASE_STEP)?IPSET_ENTRIES_INCREASE_STEP:free_entries_needed;
     if(unlikely(ipset_size_add_overflows(ips->entries_max, increase, &new_entries_max) || ipset_entries_allocation_overflows(new_entries_max))) {
         fprintf(stderr, "%s: Cannot grow ipset %s safely beyond %zu entries\n", PROG, ips->filename, ips->entries_max);
-        exit(1);
+        exit(exit_failure);
     }
 
     ips->entries_max = new_entries_max;
@@ -98,7 +111,7 @@ void ipset_grow_internal(ipset *ips, size_t free_entries_needed) {
     ips->netaddrs = realloc(ips->netaddrs, ips->entries_max * sizeof(network_addr_t));
     if(unlikely(!ips->netaddrs)) {
         fprintf(stderr, "%s: Cannot re-allocate memory (%zu bytes)\n", PROG, ips->entries_max * sizeof(network_addr_t));
-        exit(1);
+        exit(exit_failure);
     }
 }
 
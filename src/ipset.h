@@ -45,6 +45,10 @@ extern size_t prefix_counters[33];
 
 extern uint64_t ipset_unique_ips(ipset *ips);
 
+extern size_t ipset_gallop_ratio;
+
+extern int exit_failure;
+
 static inline int ipset_entries_allocation_overflows(size_t entries) {
     return (entries > (SIZE_MAX / sizeof(network_addr_t)));
 }
@@ -56,6 +60,45 @@ static inline int ipset_size_add_overflows(size_t left, size_t right, size_t *su
 }
 
 
+/* ----------------------------------------------------------------------------
+ * ipset_seek()
+ *
+ * returns the first entry from at on, with a broadcast at or after addr, or
+ * end when there is none; the entries must be optimized
+ *
+ * it gallops from at and then searches binary, so that skipping k entries
+ * costs O(log k) comparisons instead of k
+ *
+ */
+
+static inline const network_addr_t *ipset_seek(const network_addr_t *at, const network_addr_t *end, uint64_t addr) {
+    size_t step = 1, left = (size_t)(end - at);
+    const network_addr_t *hi;
+
+    if(likely(at == end || at->broadcast >= addr)) return at;
+    if(likely(left > 1 && at[1].broadcast >= addr)) return at + 1;
+
+    /* at is before addr */
+    while(step < left && at[step].broadcast < addr) {
+        at += step;
+        left -= step;
+        step <<= 1;
+    }
+
+    hi = (step < left) ? at + step : end;
+    at++;
+
+    while(at < hi) {
+        const network_addr_t *mid = at + (hi - at) / 2;
+
+        if(mid->broadcast < addr) at = mid + 1;
+        else hi = mid;
+    }
+
+    return at;
+}
+
+
 /* ----------------------------------------------------------------------------
  * ipset_grow()
  *
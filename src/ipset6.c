@@ -67,7 +67,7 @@ void ipset6_grow_internal(ipset6 *ips, size_t free_entries_needed) {
     increase = (free_entries_needed < IPSET6_ENTRIES_INCREASE_STEP)?IPSET6_ENTRIES_INCREASE_STEP:free_entries_needed;
     if(unlikely(ipset6_size_add_overflows(ips->entries_max, increase, &new_entries_max) || ipset6_entries_allocation_overflows(new_entries_max))) {
         fprintf(stderr, "%s: Cannot grow ipset %s safely beyond %zu entries\n", PROG, ips->filename, ips->entries_max);
-        exit(1);
+        exit(exit_failure);
     }
 
     ips->entries_max = new_entries_max;
@@ -75,7 +75,7 @@ void ipset6_grow_internal(ipset6 *ips, size_t free_entries_needed) {
     ips->netaddrs = realloc(ips->netaddrs, ips->entries_max * sizeof(network_addr6_t));
     if(unlikely(!ips->netaddrs)) {
         fprintf(stderr, "%s: Cannot re-allocate memory (%zu bytes)\n", PROG, ips->entries_max * sizeof(network_addr6_t));
-        exit(1);
+        exit(exit_failure);
     }
 }
 
@@ -133,8 +133,34 @@ extern void ipset6_optimize_all(ipset6 *root);
 extern int ipset6_merge(ipset6 *to, ipset6 *add);
 extern ipset6 *ipset6_common(ipset6 *ips1, ipset6 *ips2);
 extern ipset6 *ipset6_exclude(ipset6 *ips1, ipset6 *ips2);
+extern ipset6 *ipset6_exclude_all(ipset6 *ips1, ipset6 *root);
+extern ipset6 *ipset6_coverage(ipset6 *root, int op, size_t wanted);
+extern uint128_t *ipset6_exclusive_ips(ipset6 *root);
+extern ipset6 *ipset6_exclusive(ipset6 *root, size_t id);
 extern ipset6 *ipset6_diff(ipset6 *ips1, ipset6 *ips2);
 extern ipset6 *ipset6_combine(ipset6 *ips1, ipset6 *ips2);
 extern ipset6 *ipset6_copy(ipset6 *ips1);
 
+extern uint128_t ipset6_count_common(ipset6 *ips1, ipset6 *ips2);
+extern uint128_t ipset6_count_union(ipset6 *ips1, ipset6 *ips2);
+extern uint128_t ipset6_count_diff(ipset6 *ips1, ipset6 *ips2);
+extern uint128_t ipset6_count_exclude(ipset6 *ips1, ipset6 *ips2);
+
+typedef uint128_t (*IPSET6_COUNT_OP)(ipset6 *ips1, ipset6 *ips2);
+
+extern uint128_t *ipset6_count_pairs(ipset6 *first1, size_t n1, ipset6 *first2, size_t n2, IPSET6_COUNT_OP op);
+
+extern int ipset6_intersects(ipset6 *ips1, ipset6 *ips2, network_addr6_t *witness);
+extern int ipset6_is_subset(ipset6 *ips1, ipset6 *ips2, network_addr6_t *witness);
+extern int ipset6_equals(ipset6 *ips1, ipset6 *ips2, network_addr6_t *witness);
+
+typedef ipset6 *(*IPSET6_SHARD_OP)(ipset6 *root);
+
+extern int ipset6_shard_wanted(ipset6 *first, ipset6 *second);
+extern ipset6 *ipset6_shard(ipset6 **inputs, size_t n, const char *filename, IPSET6_SHARD_OP op, int coalesced);
+extern ipset6 *ipset6_shard_union(ipset6 *root, const char *filename);
+extern ipset6 *ipset6_shard_common(ipset6 *root);
+extern ipset6 *ipset6_shard_diff(ipset6 *ips1, ipset6 *ips2);
+extern ipset6 *ipset6_shard_exclude_all(ipset6 *ips1, ipset6 *root);
+
 #endif /* IPRANGE_IPSET6_H */
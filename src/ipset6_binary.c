@@ -7,7 +7,7 @@ static uint32_t endianness6 = 0x1A2B3C4D;
 
 static void binary6_write_failed(void) {
     fprintf(stderr, "%s: cannot write binary output: %s\n", PROG, strerror(errno));
-    exit(1);
+    exit(exit_failure);
 }
 
 static int binary6_validate_payload(ipset6 *ips, int header_optimized, size_t entries, uint128_t expected_unique_ips, int *payload_is_optimized)
@@ -0,0 +1,131 @@
+#include "iprange.h"
+#include "iprange6.h"
+#include "ipset6.h"
+
+/*
+ * the IPv6 counterparts of ipset_count.c: they walk 2 optimized ipsets and
+ * count IPs, without allocating memory; the counts saturate at the largest
+ * 128-bit number, like unique_ips
+ */
+
+static inline uint128_t ipset6_count_add(uint128_t a, uint128_t b) {
+    if(u128_gt(b, u128_sub(IPV6_ADDR_MAX, a))) return IPV6_ADDR_MAX;
+    return u128_add(a, b);
+}
+
+uint128_t ipset6_count_common(ipset6 *ips1, ipset6 *ips2) {
+    const network_addr6_t *a, *aend, *b, *bend;
+    uint128_t count = U128_ZERO;
+
+    if(unlikely(!(ips1->flags & IPSET_FLAG_OPTIMIZED)))
+        ipset6_optimize(ips1);
+
+    if(unlikely(!(ips2->flags & IPSET_FLAG_OPTIMIZED)))
+        ipset6_optimize(ips2);
+
+    a = ips1->netaddrs;
+    aend = a + ips1->entries;
+    b = ips2->netaddrs;
+    bend = b + ips2->entries;
+
+    while(a < aend && b < bend) {
+        ipv6_addr_t lo = u128_gt(a->addr, b->addr) ? a->addr : b->addr;
+        ipv6_addr_t hi = u128_lt(a->broadcast, b->broadcast) ? a->broadcast : b->broadcast;
+
+        if(u128_le(lo, hi)) {
+            /* the whole address space does not fit, saturate */
+            if(u128_is_zero(lo) && u128_eq(hi, IPV6_ADDR_MAX))
+                count = IPV6_ADDR_MAX;
+            else
+                count = ipset6_count_add(count, u128_add(u128_sub(hi, lo), U128_ONE));
+        }
+
+        /* the one that ends first cannot overlap anything else */
+        if(u128_lt(a->broadcast, b->broadcast)) a++;
+        else if(u128_lt(b->broadcast, a->broadcast)) b++;
+        else {
+            a++;
+            b++;
+        }
+    }
+
+    return count;
+}
+
+uint128_t ipset6_count_union(ipset6 *ips1, ipset6 *ips2) {
+    uint128_t common = ipset6_count_common(ips1, ips2);
+    return ipset6_count_add(ips1->unique_ips, u128_sub(ips2->unique_ips, common));
+}
+
+uint128_t ipset6_count_diff(ipset6 *ips1, ipset6 *ips2) {
+    uint128_t common = ipset6_count_common(ips1, ips2);
+    return ipset6_count_add(u128_sub(ips1->unique_ips, common), u128_sub(ips2->unique_ips, common));
+}
+
+uint128_t ipset6_count_exclude(ipset6 *ips1, ipset6 *ips2) {
+    uint128_t common = ipset6_count_common(ips1, ips2);
+    return u128_sub(ips1->unique_ips, common);
+}
+
+/* the IPv6 counterpart of ipset_count_pairs() */
+
+#define COUNT6_JOBS_PER_THREAD 8
+
+typedef struct count6_pairs_job {
+    ipset6 **ipsets1;
+    ipset6 **ipsets2;
+    size_t n2;
+    size_t pairs;
+    size_t per_job;
+    IPSET6_COUNT_OP op;
+    uint128_t *counts;
+} COUNT6_PAIRS_JOB;
+
+static void count6_pairs_job(size_t job, void *data) {
+    COUNT6_PAIRS_JOB *cj = data;
+    size_t p = job * cj->per_job, end = p + cj->per_job;
+
+    if(end > cj->pairs) end = cj->pairs;
+
+    for(; p < end; p++)
+        cj->counts[p] = cj->op(cj->ipsets1[p / cj->n2], cj->ipsets2[p % cj->n2]);
+}
+
+uint128_t *ipset6_count_pairs(ipset6 *first1, size_t n1, ipset6 *first2, size_t n2, IPSET6_COUNT_OP op) {
+    COUNT6_PAIRS_JOB cj;
+    ipset6 *ips;
+    size_t i;
+
+    if(unlikely(n2 && n1 > SIZE_MAX / sizeof(uint128_t) / n2)) {
+        fprintf(stderr, "%s: Cannot compare %zu x %zu ipsets: too many pairs\n", PROG, n1, n2);
+        return NULL;
+    }
+
+    cj.n2 = n2;
+    cj.pairs = n1 * n2;
+    cj.op = op;
+    cj.per_job = cj.pairs / ((size_t)((parallel_threads > 1) ? parallel_threads : 1) * COUNT6_JOBS_PER_THREAD);
+    if(!cj.per_job) cj.per_job = 1;
+    cj.ipsets1 = malloc((n1 ? n1 : 1) * sizeof(ipset6 *));
+    cj.ipsets2 = malloc((n2 ? n2 : 1) * sizeof(ipset6 *));
+    cj.counts = malloc((cj.pairs ? cj.pairs : 1) * sizeof(uint128_t));
+
+    if(unlikely(!cj.ipsets1 || !cj.ipsets2 || !cj.counts)) {
+        fprintf(stderr, "%s: Cannot allocate memory for comparing %zu x %zu ipsets\n", PROG, n1, n2);
+        free(cj.ipsets1);
+        free(cj.ipsets2);
+        free(cj.counts);
+        return NULL;
+    }
+
+    for(ips = first1, i = 0; ips && i < n1; ips = ips->next, i++) cj.ipsets1[i] = ips;
+    for(ips = first2, i = 0; ips && i < n2; ips = ips->next, i++) cj.ipsets2[i] = ips;
+
+    if(unlikely(debug)) fprintf(stderr, "%s: Counting %zu pairs of ipsets (IPv6)\n", PROG, cj.pairs);
+
+    parallel_run("compare", (cj.pairs + cj.per_job - 1) / cj.per_job, count6_pairs_job, &cj);
+
+    free(cj.ipsets1);
+    free(cj.ipsets2);
+    return cj.counts;
+}
@@ -0,0 +1,276 @@
+#include "iprange.h"
+#include "iprange6.h"
+#include "ipset6.h"
+
+/*
+ * the IPv6 counterpart of ipset_coverage.c: the ipsets are swept once, with
+ * a min-heap of the next range of every ipset and one of the last IPs of the
+ * ranges the sweep is in
+ *
+ * the sweep keeps the first IP of the part it is in and whether it is past
+ * the last IP, since the one after the whole address space does not fit in
+ * 128 bits
+ */
+
+typedef struct coverage6_cursor {
+    const network_addr6_t *next;
+    const network_addr6_t *end;
+} COVERAGE6_CURSOR;
+
+/* gets every part of the address space that is in depth ipsets (depth > 0);
+ * when depth is 1, id is the position of the ipset in the list */
+typedef void (*COVERAGE6_PART)(ipv6_addr_t lo, ipv6_addr_t hi, size_t depth, size_t id, void *data);
+
+/* starts has the ipsets by the first IP of their next range, and lasts the
+ * ones in the sweep by the last IP of their range in it */
+typedef struct coverage6_sweep {
+    COVERAGE6_CURSOR *cursors;
+    size_t *starts;
+    size_t starts_n;
+    size_t *lasts;
+    size_t depth;
+    size_t id_sum;
+} COVERAGE6_SWEEP;
+
+static int coverage6_starts_less(size_t a, size_t b, const void *data) {
+    const COVERAGE6_CURSOR *c = data;
+
+    return u128_lt(c[a].next->addr, c[b].next->addr);
+}
+
+/* the last IP of the range of an ipset in the sweep, the one before its next;
+ * an optimized ipset has one range in the sweep at most */
+static inline ipv6_addr_t coverage6_last(const COVERAGE6_CURSOR *c, size_t id) {
+    return c[id].next[-1].broadcast;
+}
+
+static int coverage6_lasts_less(size_t a, size_t b, const void *data) {
+    return u128_lt(coverage6_last(data, a), coverage6_last(data, b));
+}
+
+/* the ranges that start at pos enter the sweep */
+static inline void coverage6_enter(COVERAGE6_SWEEP *sw, ipv6_addr_t pos) {
+    while(sw->starts_n && u128_eq(sw->cursors[sw->starts[0]].next->addr, pos)) {
+        COVERAGE6_CURSOR *c = &sw->cursors[sw->starts[0]];
+
+        sw->lasts[sw->depth] = sw->starts[0];
+        sw->id_sum += sw->starts[0];
+        if(++c->next == c->end) sw->starts[0] = sw->starts[--sw->starts_n];
+        if(sw->starts_n) heap_sift_down(sw->starts, sw->starts_n, 0, coverage6_starts_less, sw->cursors);
+
+        heap_sift_up(sw->lasts, sw->depth++, coverage6_lasts_less, sw->cursors);
+    }
+}
+
+/* sweeps all the ipsets linked to 'next' from root; -1 if memory cannot be allocated */
+static int coverage6_sweep(ipset6 *root, COVERAGE6_PART part, void *data) {
+    COVERAGE6_SWEEP sw;
+    ipset6 *ips;
+    size_t ids = 0, i;
+    ipv6_addr_t pos = U128_ZERO;
+
+    for(ips = root; ips; ips = ips->next) {
+        ipset6_optimize(ips);
+        ids++;
+    }
+
+    sw.cursors = malloc((ids ? ids : 1) * sizeof(COVERAGE6_CURSOR));
+    sw.starts = malloc((ids ? ids : 1) * sizeof(size_t));
+    sw.lasts = malloc((ids ? ids : 1) * sizeof(size_t));
+    sw.starts_n = 0;
+    sw.depth = 0;
+    sw.id_sum = 0;
+
+    if(unlikely(!sw.cursors || !sw.starts || !sw.lasts)) {
+        fprintf(stderr, "%s: Cannot allocate memory for the coverage of %zu ipsets\n", PROG, ids);
+        free(sw.cursors);
+        free(sw.starts);
+        free(sw.lasts);
+        return -1;
+    }
+
+    for(ips = root, i = 0; ips; ips = ips->next, i++) {
+        sw.cursors[i].next = ips->netaddrs;
+        sw.cursors[i].end = ips->netaddrs + ips->entries;
+        if(ips->entries) sw.starts[sw.starts_n++] = i;
+    }
+
+    heap_make(sw.starts, sw.starts_n, coverage6_starts_less, sw.cursors);
+
+    while(sw.starts_n || sw.depth) {
+        ipv6_addr_t last;
+
+        if(!sw.depth) {
+            /* jump to the next range */
+            pos = sw.cursors[sw.starts[0]].next->addr;
+            coverage6_enter(&sw, pos);
+            continue;
+        }
+
+        /* every IP from pos up to last is in depth ipsets; when it is 1,
+         * the sum of the ids of the ipsets is the id of that one */
+        if(sw.starts_n && u128_le(sw.cursors[sw.starts[0]].next->addr, coverage6_last(sw.cursors, sw.lasts[0]))) {
+            last = u128_dec(sw.cursors[sw.starts[0]].next->addr);
+            part(pos, last, sw.depth, sw.id_sum, data);
+            pos = u128_inc(last);
+        }
+        else {
+            last = coverage6_last(sw.cursors, sw.lasts[0]);
+            part(pos, last, sw.depth, sw.id_sum, data);
+
+            /* the ranges that end here leave the sweep */
+            while(sw.depth && u128_eq(coverage6_last(sw.cursors, sw.lasts[0]), last)) {
+                sw.id_sum -= sw.lasts[0];
+                sw.lasts[0] = sw.lasts[--sw.depth];
+                if(sw.depth) heap_sift_down(sw.lasts, sw.depth, 0, coverage6_lasts_less, sw.cursors);
+            }
+
+            if(u128_eq(last, IPV6_ADDR_MAX)) break;
+            pos = u128_inc(last);
+        }
+
+        coverage6_enter(&sw, pos);
+    }
+
+    free(sw.cursors);
+    free(sw.starts);
+    free(sw.lasts);
+    return 0;
+}
+
+static size_t coverage6_lines(ipset6 *root, const char *what) {
+    ipset6 *ips;
+    size_t lines = 0;
+
+    for(ips = root; ips; ips = ips->next)
+        if(unlikely(ipset6_size_add_overflows(lines, ips->lines, &lines))) {
+            fprintf(stderr, "%s: Cannot find the %s of ipset %s safely: too many input lines\n", PROG, what, ips->filename);
+            return SIZE_MAX;
+        }
+
+    return lines;
+}
+
+typedef struct coverage6_match {
+    ipset6 *ips;
+    int op;
+    size_t wanted;
+} COVERAGE6_MATCH;
+
+static void coverage6_match_part(ipv6_addr_t lo, ipv6_addr_t hi, size_t depth, size_t id, void *data) {
+    COVERAGE6_MATCH *cm = data;
+    (void)id;
+
+    if(ipset_coverage_match(cm->op, depth, cm->wanted))
+        ipset6_add_ip_range(cm->ips, lo, hi);
+}
+
+/* the IPv6 counterpart of ipset_coverage() */
+ipset6 *ipset6_coverage(ipset6 *root, int op, size_t wanted) {
+    COVERAGE6_MATCH cm;
+    size_t lines = coverage6_lines(root, "coverage");
+
+    if(unlikely(lines == SIZE_MAX)) return NULL;
+
+    if(unlikely(debug)) fprintf(stderr, "%s: Finding the coverage depth of the ipsets (IPv6)\n", PROG);
+
+    cm.op = op;
+    cm.wanted = wanted;
+    cm.ips = ipset6_create("coverage", 0);
+    if(unlikely(!cm.ips)) return NULL;
+
+    /* added in order, so adjacent ranges are joined */
+    cm.ips->flags |= IPSET_FLAG_OPTIMIZED;
+
+    if(unlikely(coverage6_sweep(root, coverage6_match_part, &cm))) {
+        ipset6_free(cm.ips);
+        return NULL;
+    }
+
+    cm.ips->lines = lines;
+    return cm.ips;
+}
+
+static void exclusive6_ips_part(ipv6_addr_t lo, ipv6_addr_t hi, size_t depth, size_t id, void *data) {
+    uint128_t *exclusive = data;
+
+    if(depth != 1) return;
+
+    /* the whole address space does not fit, saturate */
+    if(u128_is_zero(lo) && u128_eq(hi, IPV6_ADDR_MAX))
+        exclusive[id] = IPV6_ADDR_MAX;
+    else {
+        uint128_t size = u128_add(u128_sub(hi, lo), U128_ONE);
+
+        if(u128_gt(size, u128_sub(IPV6_ADDR_MAX, exclusive[id])))
+            exclusive[id] = IPV6_ADDR_MAX;
+        else
+            exclusive[id] = u128_add(exclusive[id], size);
+    }
+}
+
+/* the IPv6 counterpart of ipset_exclusive_ips(); the counts saturate like unique_ips */
+uint128_t *ipset6_exclusive_ips(ipset6 *root) {
+    ipset6 *ips;
+    uint128_t *exclusive;
+    size_t ids = 0, i;
+
+    for(ips = root; ips; ips = ips->next) ids++;
+
+    if(unlikely(debug)) fprintf(stderr, "%s: Counting the exclusive IPs of %zu ipsets (IPv6)\n", PROG, ids);
+
+    exclusive = malloc((ids ? ids : 1) * sizeof(uint128_t));
+    if(unlikely(!exclusive)) {
+        fprintf(stderr, "%s: Cannot allocate memory for the exclusive IPs of %zu ipsets\n", PROG, ids);
+        return NULL;
+    }
+
+    for(i = 0; i < ids; i++) exclusive[i] = U128_ZERO;
+
+    if(unlikely(coverage6_sweep(root, exclusive6_ips_part, exclusive))) {
+        free(exclusive);
+        return NULL;
+    }
+
+    return exclusive;
+}
+
+typedef struct exclusive6_ranges {
+    ipset6 *ips;
+    size_t id;
+} EXCLUSIVE6_RANGES;
+
+static void exclusive6_ranges_part(ipv6_addr_t lo, ipv6_addr_t hi, size_t depth, size_t id, void *data) {
+    EXCLUSIVE6_RANGES *er = data;
+
+    if(depth == 1 && id == er->id)
+        ipset6_add_ip_range(er->ips, lo, hi);
+}
+
+/* the IPv6 counterpart of ipset_exclusive() */
+ipset6 *ipset6_exclusive(ipset6 *root, size_t id) {
+    EXCLUSIVE6_RANGES er;
+    ipset6 *ips;
+    size_t i, lines = coverage6_lines(root, "exclusive IPs");
+
+    if(unlikely(lines == SIZE_MAX)) return NULL;
+
+    for(ips = root, i = 0; ips && i < id; ips = ips->next, i++) ;
+
+    er.id = id;
+    er.ips = ipset6_create(ips ? ips->filename : "exclusive", 0);
+    if(unlikely(!er.ips)) return NULL;
+
+    if(unlikely(debug)) fprintf(stderr, "%s: Finding the exclusive IPs of %s (IPv6)\n", PROG, er.ips->filename);
+
+    /* added in order, so adjacent ranges are joined */
+    er.ips->flags |= IPSET_FLAG_OPTIMIZED;
+
+    if(unlikely(coverage6_sweep(root, exclusive6_ranges_part, &er))) {
+        ipset6_free(er.ips);
+        return NULL;
+    }
+
+    er.ips->lines = lines;
+    return er.ips;
+}
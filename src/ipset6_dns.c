@@ -38,6 +38,33 @@ static pthread_cond_t dns6_cond = PTHREAD_COND_INITIALIZER;
 static pthread_mutex_t dns6_requests_mut = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t dns6_replies_mut = PTHREAD_MUTEX_INITIALIZER;
 
+/*
+ * the request and reply queues are global, so only one load at a time
+ * can be resolving hostnames; the others wait for it to finish
+ */
+static pthread_mutex_t dns6_session_mut = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t dns6_session_cond = PTHREAD_COND_INITIALIZER;
+static const void *dns6_session_owner;
+
+void dns6_session_acquire(const void *owner)
+{
+    pthread_mutex_lock(&dns6_session_mut);
+    while(dns6_session_owner && dns6_session_owner != owner)
+        pthread_cond_wait(&dns6_session_cond, &dns6_session_mut);
+    dns6_session_owner = owner;
+    pthread_mutex_unlock(&dns6_session_mut);
+}
+
+void dns6_session_release(const void *owner)
+{
+    pthread_mutex_lock(&dns6_session_mut);
+    if(dns6_session_owner == owner) {
+        dns6_session_owner = NULL;
+        pthread_cond_broadcast(&dns6_session_cond);
+    }
+    pthread_mutex_unlock(&dns6_session_mut);
+}
+
 void dns6_reset_stats(void)
 {
     pthread_mutex_lock(&dns6_requests_mut);
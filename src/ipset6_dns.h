@@ -4,5 +4,7 @@
 extern int dns6_request(ipset6 *ips, const char *hostname);
 extern int dns6_done(ipset6 *ips);
 extern void dns6_reset_stats(void);
+extern void dns6_session_acquire(const void *owner);
+extern void dns6_session_release(const void *owner);
 
 #endif //IPRANGE_IPSET6_DNS_H
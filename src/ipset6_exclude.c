@@ -120,3 +120,137 @@ inline ipset6 *ipset6_exclude(ipset6 *ips1, ipset6 *ips2) {
     ips->flags |= IPSET_FLAG_OPTIMIZED;
     return ips;
 }
+
+/*
+ * the union of the excluded ipsets for ipset6_exclude_all(), streamed in
+ * order from a min-heap of cursors keyed on the address of their next range
+ */
+
+typedef struct exclude6_cursor {
+    const network_addr6_t *next;
+    const network_addr6_t *end;
+} EXCLUDE6_CURSOR;
+
+typedef struct exclude6_stream {
+    EXCLUDE6_CURSOR *cursors;
+    size_t *heap;
+    size_t heap_n;
+} EXCLUDE6_STREAM;
+
+static int exclude6_starts_less(size_t a, size_t b, const void *data) {
+    const EXCLUDE6_CURSOR *c = data;
+
+    return u128_lt(c[a].next->addr, c[b].next->addr);
+}
+
+/* moves the cursor at the top of the heap to its next range */
+static inline void exclude6_advance(EXCLUDE6_STREAM *st) {
+    EXCLUDE6_CURSOR *c = &st->cursors[st->heap[0]];
+
+    if(++c->next == c->end) st->heap[0] = st->heap[--st->heap_n];
+    if(st->heap_n) heap_sift_down(st->heap, st->heap_n, 0, exclude6_starts_less, st->cursors);
+}
+
+/* the next range of the union, joining overlapping and adjacent ranges */
+static int exclude6_next(EXCLUDE6_STREAM *st, ipv6_addr_t *lo, ipv6_addr_t *hi) {
+    ipv6_addr_t h;
+
+    if(unlikely(!st->heap_n)) return 0;
+
+    *lo = st->cursors[st->heap[0]].next->addr;
+    h = st->cursors[st->heap[0]].next->broadcast;
+    exclude6_advance(st);
+
+    while(st->heap_n) {
+        const network_addr6_t *n = st->cursors[st->heap[0]].next;
+
+        /* when h is the last IP, nothing can be after it */
+        if(!u128_eq(h, IPV6_ADDR_MAX) && u128_gt(n->addr, u128_inc(h)))
+            break;
+
+        if(u128_gt(n->broadcast, h)) h = n->broadcast;
+        exclude6_advance(st);
+    }
+
+    *hi = h;
+    return 1;
+}
+
+/* the IPv6 counterpart of ipset_exclude_all() */
+ipset6 *ipset6_exclude_all(ipset6 *ips1, ipset6 *root) {
+    EXCLUDE6_STREAM st;
+    ipset6 *ips, *r;
+    size_t i, i1, n = 0, lines;
+    ipv6_addr_t lo2 = U128_ZERO, hi2 = U128_ZERO;
+    int more;
+
+    if(unlikely(!(ips1->flags & IPSET_FLAG_OPTIMIZED)))
+        ipset6_optimize(ips1);
+
+    if(unlikely(debug)) fprintf(stderr, "%s: Removing IPs in all the excluded ipsets from %s (IPv6)\n", PROG, ips1->filename);
+
+    lines = ips1->lines;
+    for(r = root; r; r = r->next) {
+        if(unlikely(ipset6_size_add_overflows(lines, r->lines, &lines))) {
+            fprintf(stderr, "%s: Cannot exclude ipset %s from %s safely: too many input lines\n", PROG, r->filename, ips1->filename);
+            return NULL;
+        }
+        n++;
+    }
+
+    st.cursors = malloc((n ? n : 1) * sizeof(EXCLUDE6_CURSOR));
+    st.heap = malloc((n ? n : 1) * sizeof(size_t));
+    st.heap_n = 0;
+    ips = ipset6_create(ips1->filename, ips1->entries);
+    if(unlikely(!st.cursors || !st.heap || !ips)) {
+        fprintf(stderr, "%s: Cannot allocate memory for excluding %zu ipsets from %s\n", PROG, n, ips1->filename);
+        free(st.cursors);
+        free(st.heap);
+        if(ips) ipset6_free(ips);
+        return NULL;
+    }
+
+    for(r = root, i = 0; r; r = r->next, i++) {
+        ipset6_optimize(r);
+        st.cursors[i].next = r->netaddrs;
+        st.cursors[i].end = r->netaddrs + r->entries;
+        if(r->entries) st.heap[st.heap_n++] = i;
+    }
+
+    heap_make(st.heap, st.heap_n, exclude6_starts_less, st.cursors);
+
+    more = exclude6_next(&st, &lo2, &hi2);
+
+    for(i1 = 0; i1 < ips1->entries; i1++) {
+        ipv6_addr_t lo = ips1->netaddrs[i1].addr, hi = ips1->netaddrs[i1].broadcast;
+        int left = 1;
+
+        /* skip the excluded ranges before this one */
+        while(more && u128_lt(hi2, lo))
+            more = exclude6_next(&st, &lo2, &hi2);
+
+        while(more && u128_le(lo2, hi)) {
+            if(u128_gt(lo2, lo))
+                ipset6_add_ip_range(ips, lo, u128_dec(lo2));
+
+            /* it may also overlap the next range of ips1, so keep it */
+            if(u128_ge(hi2, hi)) {
+                left = 0;
+                break;
+            }
+
+            lo = u128_inc(hi2);
+            more = exclude6_next(&st, &lo2, &hi2);
+        }
+
+        if(left)
+            ipset6_add_ip_range(ips, lo, hi);
+    }
+
+    free(st.cursors);
+    free(st.heap);
+
+    ips->lines = lines;
+    ips->flags |= IPSET_FLAG_OPTIMIZED;
+    return ips;
+}
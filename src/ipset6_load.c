@@ -7,7 +7,6 @@
 
 /* address family for the current invocation */
 extern int active_family;
-extern unsigned long ipv6_dropped_in_ipv4_mode;
 
 /*
  * Classify a token as IPv6, IPv4, or hostname.
@@ -191,6 +190,7 @@ ipset6 *ipset6_load(const char *filename) {
     FILE *fp = NULL;
     int lineid = 0;
     int parse_errors = 0;
+    int dns_session = 0;
     char line[MAX_LINE + 1], ipstr[MAX_INPUT_ELEMENT6 + 1], ipstr2[MAX_INPUT_ELEMENT6 + 1];
     ipset6 *ips = ipset6_create((filename && *filename)?filename:"stdin", 0);
 
@@ -299,9 +299,16 @@ ipset6 *ipset6_load(const char *filename) {
                 if(unlikely(debug))
                     fprintf(stderr, "%s: DNS resolution for hostname '%s' from line %d of file %s (IPv6 mode).\n", PROG, ipstr, lineid, ips->filename);
 
+                /* the DNS queues are global: own them until dns6_done() */
+                if(unlikely(!dns_session)) {
+                    dns6_session_acquire(&dns_session);
+                    dns_session = 1;
+                }
+
                 if(unlikely(dns6_request(ips, ipstr))) {
                     if(likely(fp != stdin)) fclose(fp);
                     dns6_reset_stats();
+                    dns6_session_release(&dns_session);
                     ipset6_free(ips);
                     return NULL;
                 }
@@ -309,16 +316,21 @@ ipset6 *ipset6_load(const char *filename) {
 
             default:
                 fprintf(stderr, "%s: Cannot understand result code. This is an internal error.\n", PROG);
-                exit(1);
+                exit(exit_failure);
                 break;
         }
     } while(likely(ips && fgets(line, MAX_LINE, fp)));
 
     if(likely(fp != stdin)) fclose(fp);
 
-    if(unlikely(dns6_done(ips))) {
-        ipset6_free(ips);
-        return NULL;
+    if(unlikely(dns_session)) {
+        int failed = dns6_done(ips);
+
+        dns6_session_release(&dns_session);
+        if(unlikely(failed)) {
+            ipset6_free(ips);
+            return NULL;
+        }
     }
 
     if(unlikely(!ips)) return NULL;
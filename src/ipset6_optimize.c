@@ -13,58 +13,89 @@ static int compar_netaddr6(const void *p1, const void *p2) {
     return 0;
 }
 
-inline void ipset6_optimize(ipset6 *ips) {
-    network_addr6_t *naddrs;
-    size_t i, n = ips->entries, lines = ips->lines;
-    network_addr6_t *oaddrs = ips->netaddrs;
-    ipv6_addr_t lo, hi;
-
-    if(unlikely(ips->flags & IPSET_FLAG_OPTIMIZED)) return;
+/* merges overlapping and adjacent entries of a sorted array in place */
+static size_t ipset6_coalesce(network_addr6_t *addrs, size_t n) {
+    size_t i, w = 0;
 
-    if(unlikely(debug)) fprintf(stderr, "%s: Optimizing %s (IPv6)\n", PROG, ips->filename);
+    if(unlikely(!n)) return 0;
 
-    if(unlikely(n == 0)) {
-        ips->flags |= IPSET_FLAG_OPTIMIZED;
-        ips->unique_ips = U128_ZERO;
-        return;
-    }
+    for(i = 1; i < n; i++) {
+        if(u128_le(addrs[i].broadcast, addrs[w].broadcast))
+            continue;
 
-    qsort((void *)ips->netaddrs, ips->entries, sizeof(network_addr6_t), compar_netaddr6);
+        /* overflow-safe adjacency check: hi + 1 would overflow if hi == max */
+        if(u128_le(addrs[i].addr, addrs[w].broadcast) || (!u128_eq(addrs[w].broadcast, IPV6_ADDR_MAX) && u128_eq(addrs[i].addr, u128_inc(addrs[w].broadcast)))) {
+            addrs[w].broadcast = addrs[i].broadcast;
+            continue;
+        }
 
-    naddrs = malloc(ips->entries * sizeof(network_addr6_t));
-    if(unlikely(!naddrs)) {
-        fprintf(stderr, "%s: Cannot allocate memory (%zu bytes)\n", PROG, n * sizeof(network_addr6_t));
-        exit(1);
+        addrs[++w] = addrs[i];
     }
 
-    ips->netaddrs = naddrs;
-    ips->entries = 0;
-    ips->unique_ips = U128_ZERO;
-    ips->lines = 0;
+    return w + 1;
+}
 
-    lo = oaddrs[0].addr;
-    hi = oaddrs[0].broadcast;
-    for(i = 1; i < n; i++) {
-        if(u128_le(oaddrs[i].broadcast, hi))
-            continue;
+/* ----------------------------------------------------------------------------
+ * ipset6_optimize_finish()
+ *
+ * after the entries have been coalesced in place, it recalculates the unique
+ * IPs, saturating at IPV6_ADDR_MAX since 2^128 does not fit, gives back the
+ * memory of the entries that are no longer used and flags the ipset as
+ * optimized
+ * the number of lines is not changed: it is the number of lines loaded
+ *
+ */
+
+static void ipset6_optimize_finish(ipset6 *ips) {
+    network_addr6_t *naddrs;
+    uint128_t unique_ips = U128_ZERO, size;
+    size_t i;
 
-        /* overflow-safe adjacency check: hi + 1 would overflow if hi == max */
-        if(u128_le(oaddrs[i].addr, hi) || (!u128_eq(hi, IPV6_ADDR_MAX) && u128_eq(oaddrs[i].addr, u128_inc(hi)))) {
-            hi = oaddrs[i].broadcast;
-            continue;
+    for(i = 0; i < ips->entries; i++) {
+        if(u128_is_zero(ips->netaddrs[i].addr) && u128_eq(ips->netaddrs[i].broadcast, IPV6_ADDR_MAX)) {
+            unique_ips = IPV6_ADDR_MAX;
+            break;
         }
 
-        ipset6_add_ip_range(ips, lo, hi);
+        size = u128_add(u128_sub(ips->netaddrs[i].broadcast, ips->netaddrs[i].addr), U128_ONE);
+        if(u128_gt(unique_ips, u128_sub(IPV6_ADDR_MAX, size))) {
+            unique_ips = IPV6_ADDR_MAX;
+            break;
+        }
 
-        lo = oaddrs[i].addr;
-        hi = oaddrs[i].broadcast;
+        unique_ips = u128_add(unique_ips, size);
     }
-    ipset6_add_ip_range(ips, lo, hi);
-    ips->lines = lines;
 
+    ips->unique_ips = unique_ips;
     ips->flags |= IPSET_FLAG_OPTIMIZED;
 
-    free(oaddrs);
+    if(ips->entries < ips->entries_max) {
+        /* if shrinking fails, the bigger allocation is still valid */
+        naddrs = realloc(ips->netaddrs, ips->entries * sizeof(network_addr6_t));
+        if(likely(naddrs)) {
+            ips->netaddrs = naddrs;
+            ips->entries_max = ips->entries;
+        }
+    }
+}
+
+inline void ipset6_optimize(ipset6 *ips) {
+    size_t n = ips->entries;
+
+    if(unlikely(ips->flags & IPSET_FLAG_OPTIMIZED)) return;
+
+    if(unlikely(debug)) fprintf(stderr, "%s: Optimizing %s (IPv6)\n", PROG, ips->filename);
+
+    if(unlikely(n == 0)) {
+        ips->flags |= IPSET_FLAG_OPTIMIZED;
+        ips->unique_ips = U128_ZERO;
+        return;
+    }
+
+    qsort((void *)ips->netaddrs, ips->entries, sizeof(network_addr6_t), compar_netaddr6);
+
+    ips->entries = ipset6_coalesce(ips->netaddrs, n);
+    ipset6_optimize_finish(ips);
 }
 
 inline void ipset6_optimize_all(ipset6 *root) {
@@ -0,0 +1,100 @@
+#include "iprange.h"
+#include "iprange6.h"
+#include "ipset6.h"
+
+/*
+ * the IPv6 counterparts of ipset_predicate.c: they walk 2 optimized ipsets
+ * and stop at the first range that answers them, setting witness to it when
+ * it is not NULL
+ */
+
+static inline void predicate6_optimize(ipset6 *ips1, ipset6 *ips2) {
+    if(unlikely(!(ips1->flags & IPSET_FLAG_OPTIMIZED)))
+        ipset6_optimize(ips1);
+
+    if(unlikely(!(ips2->flags & IPSET_FLAG_OPTIMIZED)))
+        ipset6_optimize(ips2);
+}
+
+static inline int predicate6_witness(network_addr6_t *witness, ipv6_addr_t lo, ipv6_addr_t hi) {
+    if(witness) {
+        witness->addr = lo;
+        witness->broadcast = hi;
+    }
+
+    return 1;
+}
+
+int ipset6_intersects(ipset6 *ips1, ipset6 *ips2, network_addr6_t *witness) {
+    const network_addr6_t *a, *aend, *b, *bend;
+
+    predicate6_optimize(ips1, ips2);
+
+    a = ips1->netaddrs;
+    aend = a + ips1->entries;
+    b = ips2->netaddrs;
+    bend = b + ips2->entries;
+
+    while(a < aend && b < bend) {
+        ipv6_addr_t lo = u128_gt(a->addr, b->addr) ? a->addr : b->addr;
+        ipv6_addr_t hi = u128_lt(a->broadcast, b->broadcast) ? a->broadcast : b->broadcast;
+
+        if(u128_le(lo, hi))
+            return predicate6_witness(witness, lo, hi);
+
+        /* the one that ends first cannot overlap anything else */
+        if(u128_lt(a->broadcast, b->broadcast)) a++;
+        else b++;
+    }
+
+    return 0;
+}
+
+/* every range of ips1 must be inside a single range of the optimized ips2 */
+int ipset6_is_subset(ipset6 *ips1, ipset6 *ips2, network_addr6_t *witness) {
+    const network_addr6_t *a, *aend, *b, *bend;
+
+    predicate6_optimize(ips1, ips2);
+
+    /* a subset cannot have more IPs */
+    if(!witness && u128_gt(ips1->unique_ips, ips2->unique_ips))
+        return 0;
+
+    a = ips1->netaddrs;
+    aend = a + ips1->entries;
+    b = ips2->netaddrs;
+    bend = b + ips2->entries;
+
+    for(; a < aend; a++) {
+        while(b < bend && u128_lt(b->broadcast, a->addr)) b++;
+
+        if(unlikely(b == bend))
+            return !predicate6_witness(witness, a->addr, a->broadcast);
+
+        /* the start of a is not in b */
+        if(u128_gt(b->addr, a->addr)) {
+            ipv6_addr_t hi = u128_dec(b->addr);
+            return !predicate6_witness(witness, a->addr, u128_lt(hi, a->broadcast) ? hi : a->broadcast);
+        }
+
+        /* b ends before a, and the next range of ips2 starts after a gap */
+        if(u128_lt(b->broadcast, a->broadcast)) {
+            ipv6_addr_t hi = a->broadcast;
+
+            if(b + 1 < bend && u128_lt(u128_dec(b[1].addr), hi)) hi = u128_dec(b[1].addr);
+            return !predicate6_witness(witness, u128_inc(b->broadcast), hi);
+        }
+    }
+
+    return 1;
+}
+
+/* optimized ipsets with the same IPs have the same entries */
+int ipset6_equals(ipset6 *ips1, ipset6 *ips2, network_addr6_t *witness) {
+    predicate6_optimize(ips1, ips2);
+
+    if(!witness && (ips1->entries != ips2->entries || !u128_eq(ips1->unique_ips, ips2->unique_ips)))
+        return 0;
+
+    return ipset6_is_subset(ips1, ips2, witness) && ipset6_is_subset(ips2, ips1, witness);
+}
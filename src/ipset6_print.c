@@ -27,21 +27,39 @@ inline void prefix6_update_counters(ipv6_addr_t addr, int prefix) {
         prefix6_counters[prefix]++;
 }
 
+/* the text ip6str_r() gives, formatted in place in the output buffer */
+static inline char *ipset6_output_ip(char *p, ipv6_addr_t addr) {
+    ip6str_r(p, addr);
+    return p + strlen(p);
+}
+
 inline void print_addr6(ipv6_addr_t addr, int prefix) {
+    char *p = ipset_output_pos;
+
     prefix6_update_counters(addr, prefix);
 
-    char buf[IP6STR_MAX_LEN + 1];
+    if(prefix < 128) {
+        p = ipset_output_string(p, &ipset_output_prefix_nets);
+        p = ipset6_output_ip(p, addr);
+        *p++ = '/';
+        p = ipset_output_octet(p, (unsigned int)prefix);
+        p = ipset_output_string(p, &ipset_output_suffix_nets);
+    }
+    else {
+        p = ipset_output_string(p, &ipset_output_prefix_ips);
+        p = ipset6_output_ip(p, addr);
+        p = ipset_output_string(p, &ipset_output_suffix_ips);
+    }
+    *p++ = '\n';
 
-    if(prefix < 128)
-        printf("%s%s/%d%s\n", print_prefix_nets, ip6str_r(buf, addr), prefix, print_suffix_nets);
-    else
-        printf("%s%s%s\n", print_prefix_ips, ip6str_r(buf, addr), print_suffix_ips);
+    ipset_output_commit(p);
 }
 
 inline void print_addr6_range(ipv6_addr_t lo, ipv6_addr_t hi) {
-    char buf[IP6STR_MAX_LEN + 1];
+    char *p = ipset_output_pos;
 
     if(unlikely(u128_gt(lo, hi))) {
+        char buf[IP6STR_MAX_LEN + 1];
         ipv6_addr_t t = hi;
         fprintf(stderr, "%s: WARNING: invalid range reversed start=%s", PROG, ip6str_r(buf, lo));
         fprintf(stderr, " end=%s\n", ip6str_r(buf, hi));
@@ -50,28 +68,105 @@ inline void print_addr6_range(ipv6_addr_t lo, ipv6_addr_t hi) {
     }
 
     if(u128_eq(lo, hi)) {
-        printf("%s%s-", print_prefix_ips, ip6str_r(buf, lo));
-        printf("%s%s\n", ip6str_r(buf, hi), print_suffix_ips);
+        p = ipset_output_string(p, &ipset_output_prefix_ips);
+        p = ipset6_output_ip(p, lo);
+        *p++ = '-';
+        p = ipset6_output_ip(p, hi);
+        p = ipset_output_string(p, &ipset_output_suffix_ips);
     }
     else {
-        printf("%s%s-", print_prefix_nets, ip6str_r(buf, lo));
-        printf("%s%s\n", ip6str_r(buf, hi), print_suffix_nets);
+        p = ipset_output_string(p, &ipset_output_prefix_nets);
+        p = ipset6_output_ip(p, lo);
+        *p++ = '-';
+        p = ipset6_output_ip(p, hi);
+        p = ipset_output_string(p, &ipset_output_suffix_nets);
     }
+    *p++ = '\n';
+
+    ipset_output_commit(p);
 }
 
 inline void print_addr6_single(ipv6_addr_t x) {
-    char buf[IP6STR_MAX_LEN + 1];
-    printf("%s%s%s\n", print_prefix_ips, ip6str_r(buf, x), print_suffix_ips);
+    char *p = ipset_output_pos;
+
+    p = ipset_output_string(p, &ipset_output_prefix_ips);
+    p = ipset6_output_ip(p, x);
+    p = ipset_output_string(p, &ipset_output_suffix_ips);
+    *p++ = '\n';
+
+    ipset_output_commit(p);
+}
+
+/* the text of a 16-bit group, in lowercase hex without leading zeros */
+static inline char *ipset6_output_group(char *p, unsigned int v) {
+    static const char digits[] = "0123456789abcdef";
+
+    if(v >= 0x1000U) *p++ = digits[(v >> 12) & 0xfU];
+    if(v >= 0x100U) *p++ = digits[(v >> 8) & 0xfU];
+    if(v >= 0x10U) *p++ = digits[(v >> 4) & 0xfU];
+    *p++ = digits[v & 0xfU];
+    return p;
+}
+
+/*
+ * prints the IPs from x to last, which are in the same /112, and returns
+ * how many they are
+ *
+ * like an odometer, only the last group turns: while it is not zero, the
+ * zeros of the other groups are compressed the same way, so the text before
+ * it is formatted once and copied to every line. ::/80 is printed one IP at
+ * a time, since ip6str_r() may give its addresses with an IPv4 tail.
+ */
+static size_t print_addr6_single_run(ipv6_addr_t x, ipv6_addr_t last) {
+    unsigned int v = (unsigned int)(u128_lo64(x) & 0xffffU), to = (unsigned int)(u128_lo64(last) & 0xffffU);
+    char head[IP6STR_MAX_LEN + 1], group[4];
+    size_t n = to - v + 1, head_len, group_len;
+
+    if(!u128_hi64(x) && !(u128_lo64(x) >> 48)) {
+        for(; v <= to; v++, x = u128_inc(x))
+            print_addr6_single(x);
+        return n;
+    }
+
+    if(!v) {
+        print_addr6_single(x);
+        if(!to) return n;
+        x = u128_inc(x);
+        v++;
+    }
+
+    /* the text of x without its last group */
+    ip6str_r(head, x);
+    group_len = (size_t)(ipset6_output_group(group, v) - group);
+    head_len = strlen(head) - group_len;
+    if(unlikely(head[head_len - 1] != ':' || memcmp(&head[head_len], group, group_len))) {
+        for(; v <= to; v++, x = u128_inc(x))
+            print_addr6_single(x);
+        return n;
+    }
+
+    for(; v <= to; v++) {
+        char *p = ipset_output_string(ipset_output_pos, &ipset_output_prefix_ips);
+        memcpy(p, head, head_len);
+        p = ipset6_output_group(p + head_len, v);
+        p = ipset_output_string(p, &ipset_output_suffix_ips);
+        *p++ = '\n';
+        ipset_output_commit(p);
+    }
+
+    return n;
 }
 
-/*------------------------------------------------------------*/
-/* Recursively compute network addresses to cover range lo-hi */
-/* for IPv6 (0..128 prefix space)                             */
-/* Maximum recursion depth is 128.                            */
-/*------------------------------------------------------------*/
-inline int split_range6(ipv6_addr_t addr, int prefix, ipv6_addr_t lo, ipv6_addr_t hi, void (*print)(ipv6_addr_t, int)) {
-    ipv6_addr_t bc, lower_half, upper_half;
+/* ----------------------------------------------------------------------------
+ * split_range6_start(), split_range6_cidrs()
+ *
+ * the IPv6 counterparts of split_range_start() and split_range_cidrs(); the
+ * cursor is done when the last block has been produced, since the range may
+ * end at the last IPv6 address
+ *
+ */
 
+void split_range6_start(SPLIT_RANGE6_CURSOR *c, ipv6_addr_t lo, ipv6_addr_t hi) {
     if(unlikely(u128_gt(lo, hi))) {
         ipv6_addr_t t = hi;
         char buf[IP6STR_MAX_LEN + 1];
@@ -81,46 +176,57 @@ inline int split_range6(ipv6_addr_t addr, int prefix, ipv6_addr_t lo, ipv6_addr_
         lo = t;
     }
 
-    if(unlikely(prefix < 0 || prefix > 128)) {
+    c->next = lo;
+    c->last = hi;
+    c->done = 0;
+}
+
+/* the prefix of the largest block that starts at next and ends at or before last */
+static inline int split_range6_block(ipv6_addr_t next, ipv6_addr_t last) {
+    ipv6_addr_t left = u128_sub(last, next);
+    int bits = u128_is_zero(next) ? 128 : u128_ctz(next);
+    int fit = u128_eq(left, U128_MAX) ? 128 : 127 - u128_clz(u128_inc(left));
+
+    return 128 - ((fit < bits) ? fit : bits);
+}
+
+/* the prefix the blocks of the given prefix are printed with */
+static inline int split_range6_enabled(int prefix) {
+    while(prefix <= 128 && !prefix6_enabled[prefix])
+        prefix++;
+
+    if(unlikely(prefix > 128))
         fprintf(stderr, "%s: Invalid IPv6 prefix %d!\n", PROG, prefix);
-        return 0;
-    }
 
-    bc = broadcast6(addr, prefix);
+    return prefix;
+}
 
-    if(unlikely(u128_lt(lo, addr) || u128_gt(hi, bc))) {
-        char buf[IP6STR_MAX_LEN + 1];
-        fprintf(stderr, "%s: Out of range limits for IPv6 network %s/%d\n", PROG, ip6str_r(buf, addr), prefix);
-        return 0;
-    }
+size_t split_range6_cidrs(SPLIT_RANGE6_CURSOR *c, IPSET6_CIDR *cidrs, size_t max) {
+    size_t n = 0;
 
-    if(u128_eq(lo, addr) && u128_eq(hi, bc) && prefix6_enabled[prefix]) {
-        print(addr, prefix);
-        return 1;
-    }
+    while(n < max && !c->done) {
+        int prefix = split_range6_block(c->next, c->last);
+        int enabled = split_range6_enabled(prefix);
+        ipv6_addr_t end = broadcast6(c->next, prefix), bc;
 
-    prefix++;
-    lower_half = addr;
-    upper_half = set_bit6(addr, prefix, 1);
+        if(unlikely(enabled > 128)) {
+            if(u128_eq(end, c->last)) c->done = 1;
+            else c->next = u128_inc(end);
+            continue;
+        }
 
-    if(u128_lt(hi, upper_half)) {
-        /* cppcheck-suppress misra-c2012-17.2 -- CIDR splitting is bounded to 128 levels. */
-        return split_range6(lower_half, prefix, lo, hi, print);
-    }
-    else if(u128_ge(lo, upper_half)) {
-        /* cppcheck-suppress misra-c2012-17.2 -- CIDR splitting is bounded to 128 levels. */
-        return split_range6(upper_half, prefix, lo, hi, print);
-    }
-    else {
-        /* cppcheck-suppress misra-c2012-17.2 -- CIDR splitting is bounded to 128 levels. */
-        int lower = split_range6(lower_half, prefix, lo, broadcast6(lower_half, prefix), print);
-        /* cppcheck-suppress misra-c2012-17.2 -- CIDR splitting is bounded to 128 levels. */
-        int upper = split_range6(upper_half, prefix, upper_half, hi, print);
-        return (
-            lower +
-            upper
-        );
+        do {
+            bc = broadcast6(c->next, enabled);
+            cidrs[n].addr = c->next;
+            cidrs[n].prefix = enabled;
+            n++;
+
+            if(u128_eq(bc, c->last)) c->done = 1;
+            else c->next = u128_inc(bc);
+        } while(n < max && !c->done && u128_le(c->next, end));
     }
+
+    return n;
 }
 
 void ipset6_print(ipset6 *ips, IPSET_PRINT_CMD print) {
@@ -138,14 +244,26 @@ void ipset6_print(ipset6 *ips, IPSET_PRINT_CMD print) {
     if(unlikely(debug)) fprintf(stderr, "%s: Printing %s (IPv6) with %zu ranges, %s unique IPs\n",
         PROG, ips->filename, ips->entries, u128_to_dec(u128buf, sizeof(u128buf), ips->unique_ips));
 
+    ipset_output_begin();
+
     switch(print) {
         case PRINT_CIDR:
             for(i = 0; i <= 128; i++)
                 prefix6_counters[i] = 0;
 
             n = ips->entries;
-            for(i = 0; i < n; i++)
-                total += split_range6(U128_ZERO, 0, ips->netaddrs[i].addr, ips->netaddrs[i].broadcast, print_addr6);
+            for(i = 0; i < n; i++) {
+                SPLIT_RANGE6_CURSOR c;
+                IPSET6_CIDR cidrs[SPLIT_RANGE_BATCH];
+                size_t j, k;
+
+                split_range6_start(&c, ips->netaddrs[i].addr, ips->netaddrs[i].broadcast);
+                while((k = split_range6_cidrs(&c, cidrs, SPLIT_RANGE_BATCH))) {
+                    for(j = 0; j < k; j++)
+                        print_addr6(cidrs[j].addr, cidrs[j].prefix);
+                    total += k;
+                }
+            }
             break;
 
         case PRINT_SINGLE_IPS:
@@ -153,7 +271,7 @@ void ipset6_print(ipset6 *ips, IPSET_PRINT_CMD print) {
             for(i = 0; i < n; i++) {
                 ipv6_addr_t start = ips->netaddrs[i].addr;
                 ipv6_addr_t end = ips->netaddrs[i].broadcast;
-                ipv6_addr_t x;
+                ipv6_addr_t x, last;
 
                 if(unlikely(u128_gt(start, end))) {
                     char buf[IP6STR_MAX_LEN + 1];
@@ -169,9 +287,12 @@ void ipset6_print(ipset6 *ips, IPSET_PRINT_CMD print) {
                     fprintf(stderr, " end=%s\n", ip6str_r(buf, end));
                     continue;
                 }
-                for(x = start; u128_ge(x, start) && u128_le(x, end); x = u128_inc(x)) {
-                    print_addr6_single(x);
-                    total++;
+                for(x = start; ; x = u128_inc(last)) {
+                    last = u128_or(x, u128_from_u32(0xffffU));
+                    if(u128_gt(last, end)) last = end;
+
+                    total += print_addr6_single_run(x, last);
+                    if(u128_eq(last, end)) break;
                 }
             }
             break;
@@ -185,6 +306,8 @@ void ipset6_print(ipset6 *ips, IPSET_PRINT_CMD print) {
             break;
     }
 
+    ipset_output_finish();
+
     if(unlikely(debug)) {
         int prefixes = 0;
 
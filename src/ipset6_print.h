@@ -12,6 +12,19 @@ extern void print_addr6(ipv6_addr_t addr, int prefix);
 extern void print_addr6_range(ipv6_addr_t lo, ipv6_addr_t hi);
 extern void print_addr6_single(ipv6_addr_t x);
 
-extern int split_range6(ipv6_addr_t addr, int prefix, ipv6_addr_t lo, ipv6_addr_t hi, void (*print)(ipv6_addr_t, int));
+/* the IPv6 counterparts of IPSET_CIDR and SPLIT_RANGE_CURSOR */
+typedef struct ipset6_cidr {
+    ipv6_addr_t addr;
+    int prefix;
+} IPSET6_CIDR;
+
+typedef struct split_range6_cursor {
+    ipv6_addr_t next;
+    ipv6_addr_t last;
+    int done;
+} SPLIT_RANGE6_CURSOR;
+
+extern void split_range6_start(SPLIT_RANGE6_CURSOR *c, ipv6_addr_t lo, ipv6_addr_t hi);
+extern size_t split_range6_cidrs(SPLIT_RANGE6_CURSOR *c, IPSET6_CIDR *cidrs, size_t max);
 
 #endif /* IPRANGE_IPSET6_PRINT_H */
@@ -0,0 +1,352 @@
+#include "iprange.h"
+#include "iprange6.h"
+#include "ipset6.h"
+
+/*
+ * the IPv6 counterpart of ipset_shard.c: the 128-bit address space is split
+ * into shards with about the same number of entries, the kernel runs on the
+ * entries of each shard on parallel threads, and the results are clipped to
+ * their shards and concatenated.
+ *
+ * the last IP of each shard is kept (not the one after it), since the one
+ * after the whole address space does not fit in 128 bits.
+ */
+
+typedef struct shard6 {
+    int used;                   /* the shard has a part of the address space */
+    ipv6_addr_t from;           /* the first IP of the shard */
+    ipv6_addr_t to;             /* the last IP of the shard */
+    ipset6 *result;             /* the result of the kernel, clipped to the shard */
+    size_t skip;                /* its first entry is glued to the previous shard */
+    size_t offset;              /* where its entries go in the final result */
+    int clipped_first;          /* its first entry started before the shard */
+    int clipped_last;           /* its last entry ended after the shard */
+} SHARD6;
+
+typedef struct shard6_job {
+    ipset6 **inputs;
+    size_t n;
+    SHARD6 *shards;
+    IPSET6_SHARD_OP op;
+    ipset6 *out;
+    int failed;
+} SHARD6_JOB;
+
+int ipset6_shard_wanted(ipset6 *first, ipset6 *second) {
+    ipset6 *ips;
+    size_t entries = 0;
+
+    if(parallel_threads <= 1) return 0;
+
+    for(ips = first; ips; ips = ips->next)
+        entries += ips->entries;
+
+    for(ips = second; ips; ips = ips->next)
+        entries += ips->entries;
+
+    return entries >= ipset_shard_min;
+}
+
+/* the number of entries of an optimized ipset that start before addr */
+static size_t shard6_rank_below(const ipset6 *ips, ipv6_addr_t addr) {
+    size_t lo = 0, hi = ips->entries;
+
+    while(lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if(u128_lt(ips->netaddrs[mid].addr, addr)) lo = mid + 1;
+        else hi = mid;
+    }
+
+    return lo;
+}
+
+/* the number of entries of an optimized ipset that start at or before addr */
+static size_t shard6_rank_upto(const ipset6 *ips, ipv6_addr_t addr) {
+    size_t lo = 0, hi = ips->entries;
+
+    while(lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if(u128_le(ips->netaddrs[mid].addr, addr)) lo = mid + 1;
+        else hi = mid;
+    }
+
+    return lo;
+}
+
+/* the smallest IP up to which there are at least rank entries, in all the inputs */
+static ipv6_addr_t shard6_split(ipset6 **inputs, size_t n, size_t rank) {
+    ipv6_addr_t lo = U128_ZERO, hi = IPV6_ADDR_MAX;
+
+    while(u128_lt(lo, hi)) {
+        ipv6_addr_t mid = u128_add(lo, u128_shr(u128_sub(hi, lo), 1));
+        size_t i, upto = 0;
+
+        for(i = 0; i < n; i++)
+            upto += shard6_rank_upto(inputs[i], mid);
+
+        if(upto < rank) lo = u128_inc(mid);
+        else hi = mid;
+    }
+
+    return lo;
+}
+
+static void shard6_op_job(size_t s, void *data) {
+    SHARD6_JOB *sj = data;
+    SHARD6 *sh = &sj->shards[s];
+    ipset6 *views, *r;
+    size_t i, first, last;
+
+    if(!sh->used) return;
+
+    views = calloc(sj->n, sizeof(ipset6));
+    if(unlikely(!views)) {
+        sj->failed = 1;
+        return;
+    }
+
+    /* the entries of each input that overlap the shard, in place */
+    for(i = 0; i < sj->n; i++) {
+        ipset6 *in = sj->inputs[i];
+        size_t from = shard6_rank_below(in, sh->from);
+        size_t to = shard6_rank_upto(in, sh->to);
+
+        /* the one before may end inside the shard */
+        if(from > 0 && u128_ge(in->netaddrs[from - 1].broadcast, sh->from)) from--;
+
+        ipset6_set_filename(&views[i], in->filename);
+        views[i].netaddrs = &in->netaddrs[from];
+        views[i].entries = views[i].entries_max = to - from;
+        views[i].flags = IPSET_FLAG_OPTIMIZED;
+        if(i) {
+            views[i].prev = &views[i - 1];
+            views[i - 1].next = &views[i];
+        }
+    }
+
+    r = sj->op(views);
+    free(views);
+
+    if(unlikely(!r)) {
+        sj->failed = 1;
+        return;
+    }
+
+    /* clip the result to the shard */
+    for(first = 0; first < r->entries && u128_lt(r->netaddrs[first].broadcast, sh->from); first++) ;
+    for(last = first; last < r->entries && u128_le(r->netaddrs[last].addr, sh->to); last++) ;
+
+    if(first < last) {
+        if(u128_lt(r->netaddrs[first].addr, sh->from)) {
+            r->netaddrs[first].addr = sh->from;
+            sh->clipped_first = 1;
+        }
+
+        if(u128_gt(r->netaddrs[last - 1].broadcast, sh->to)) {
+            r->netaddrs[last - 1].broadcast = sh->to;
+            sh->clipped_last = 1;
+        }
+    }
+
+    if(first) memmove(r->netaddrs, &r->netaddrs[first], (last - first) * sizeof(network_addr6_t));
+
+    /* re-add the entries to recalculate unique_ips */
+    r->entries = 0;
+    r->unique_ips = U128_ZERO;
+    r->flags &= ~IPSET_FLAG_OPTIMIZED;
+    for(i = first; i < last; i++)
+        ipset6_added_entry(r);
+
+    sh->result = r;
+}
+
+static void shard6_copy_job(size_t s, void *data) {
+    SHARD6_JOB *sj = data;
+    SHARD6 *sh = &sj->shards[s];
+
+    if(!sh->result) return;
+
+    ipset6_copy_entries(&sj->out->netaddrs[sh->offset], &sh->result->netaddrs[sh->skip], sh->result->entries - sh->skip);
+}
+
+ipset6 *ipset6_shard(ipset6 **inputs, size_t n, const char *filename, IPSET6_SHARD_OP op, int coalesced) {
+    SHARD6_JOB sj;
+    size_t i, s, shards, total = 0, lines = 0, entries = 0;
+    uint128_t unique_ips = U128_ZERO;
+    ipv6_addr_t from = U128_ZERO;
+    SHARD6 *prev = NULL;
+    int used = 1;
+
+    if(unlikely(debug)) fprintf(stderr, "%s: Sharding the set operation of %zu ipsets to %s (IPv6)\n", PROG, n, filename);
+
+    for(i = 0; i < n; i++) {
+        ipset6_optimize(inputs[i]);
+        total += inputs[i]->entries;
+        lines += inputs[i]->lines;
+    }
+
+    shards = (size_t)((parallel_threads > 1) ? parallel_threads : 1) * 4;
+
+    sj.inputs = inputs;
+    sj.n = n;
+    sj.op = op;
+    sj.failed = 0;
+    sj.shards = calloc(shards, sizeof(SHARD6));
+    sj.out = NULL;
+    if(unlikely(!sj.shards)) {
+        fprintf(stderr, "%s: Cannot allocate memory for %zu shards of %s\n", PROG, shards, filename);
+        return NULL;
+    }
+
+    /* each shard starts after the previous; once one reaches the last IP, the rest are not used */
+    for(s = 0; s < shards && used; s++) {
+        SHARD6 *sh = &sj.shards[s];
+
+        sh->used = 1;
+        sh->from = from;
+        sh->to = (s == shards - 1) ? IPV6_ADDR_MAX : shard6_split(inputs, n, total * (s + 1) / shards);
+
+        if(u128_lt(sh->to, sh->from)) sh->used = 0;
+        else if(u128_eq(sh->to, IPV6_ADDR_MAX)) used = 0;
+        else from = u128_inc(sh->to);
+    }
+
+    parallel_run("shard", shards, shard6_op_job, &sj);
+
+    /* find where the entries of each shard go, gluing them to the previous */
+    for(s = 0; !sj.failed && s < shards; s++) {
+        SHARD6 *sh = &sj.shards[s];
+        ipv6_addr_t last;
+
+        if(!sh->result || !sh->result->entries) continue;
+
+        if(prev) {
+            last = prev->result->netaddrs[prev->result->entries - 1].broadcast;
+            if(!u128_eq(last, IPV6_ADDR_MAX) && u128_eq(u128_inc(last), sh->result->netaddrs[0].addr)
+               && (coalesced || (prev->clipped_last && sh->clipped_first)))
+                sh->skip = 1;
+        }
+
+        sh->offset = entries;
+        entries += sh->result->entries - sh->skip;
+        unique_ips = u128_gt(sh->result->unique_ips, u128_sub(IPV6_ADDR_MAX, unique_ips)) ? IPV6_ADDR_MAX : u128_add(unique_ips, sh->result->unique_ips);
+        prev = sh;
+    }
+
+    if(likely(!sj.failed)) {
+        sj.out = ipset6_create(filename, entries);
+        if(unlikely(!sj.out)) sj.failed = 1;
+    }
+
+    if(likely(!sj.failed)) {
+        parallel_run("shard copy", shards, shard6_copy_job, &sj);
+
+        /* the first entry of a glued shard extends the last one before it */
+        for(s = 0; s < shards; s++) {
+            SHARD6 *sh = &sj.shards[s];
+            if(sh->skip) sj.out->netaddrs[sh->offset - 1].broadcast = sh->result->netaddrs[0].broadcast;
+        }
+
+        sj.out->entries = entries;
+        sj.out->unique_ips = unique_ips;
+        sj.out->lines = lines;
+        sj.out->flags |= IPSET_FLAG_OPTIMIZED;
+    }
+    else
+        fprintf(stderr, "%s: Cannot allocate memory for the shards of %s\n", PROG, filename);
+
+    for(s = 0; s < shards; s++)
+        if(sj.shards[s].result) ipset6_free(sj.shards[s].result);
+
+    free(sj.shards);
+    return sj.failed ? NULL : sj.out;
+}
+
+static ipset6 *shard6_union_op(ipset6 *root) {
+    ipset6 *ips, *merged = ipset6_create("union", 0);
+
+    if(unlikely(!merged)) return NULL;
+
+    for(ips = root; ips; ips = ips->next)
+        if(unlikely(ipset6_merge(merged, ips))) {
+            ipset6_free(merged);
+            return NULL;
+        }
+
+    ipset6_optimize(merged);
+    return merged;
+}
+
+static ipset6 *shard6_common_op(ipset6 *root) {
+    ipset6 *ips, *common, *tmp;
+
+    common = ipset6_common(root, root->next);
+    for(ips = root->next->next; common && ips; ips = ips->next) {
+        tmp = ipset6_common(common, ips);
+        ipset6_free(common);
+        common = tmp;
+    }
+
+    return common;
+}
+
+static ipset6 *shard6_diff_op(ipset6 *root) {
+    return ipset6_diff(root, root->next);
+}
+
+static ipset6 *shard6_exclude_all_op(ipset6 *root) {
+    return ipset6_exclude_all(root, root->next);
+}
+
+/* runs op on all the ipsets linked to 'next' from root */
+static ipset6 *shard6_all(ipset6 *root, const char *filename, IPSET6_SHARD_OP op, int coalesced) {
+    ipset6 **inputs, *ips, *ret;
+    size_t n = 0;
+
+    for(ips = root; ips; ips = ips->next) n++;
+
+    inputs = malloc(n * sizeof(ipset6 *));
+    if(unlikely(!inputs)) {
+        fprintf(stderr, "%s: Cannot allocate memory for sharding %zu ipsets\n", PROG, n);
+        return NULL;
+    }
+
+    for(ips = root, n = 0; ips; ips = ips->next) inputs[n++] = ips;
+
+    ret = ipset6_shard(inputs, n, filename, op, coalesced);
+    free(inputs);
+    return ret;
+}
+
+ipset6 *ipset6_shard_union(ipset6 *root, const char *filename) {
+    return shard6_all(root, filename, shard6_union_op, 1);
+}
+
+ipset6 *ipset6_shard_common(ipset6 *root) {
+    return shard6_all(root, "common", shard6_common_op, 1);
+}
+
+ipset6 *ipset6_shard_diff(ipset6 *ips1, ipset6 *ips2) {
+    ipset6 *inputs[2] = { ips1, ips2 };
+    return ipset6_shard(inputs, 2, "diff", shard6_diff_op, 0);
+}
+
+ipset6 *ipset6_shard_exclude_all(ipset6 *ips1, ipset6 *root) {
+    ipset6 **inputs, *ips, *ret;
+    size_t n = 1;
+
+    for(ips = root; ips; ips = ips->next) n++;
+
+    inputs = malloc(n * sizeof(ipset6 *));
+    if(unlikely(!inputs)) {
+        fprintf(stderr, "%s: Cannot allocate memory for sharding %zu ipsets\n", PROG, n);
+        return NULL;
+    }
+
+    inputs[0] = ips1;
+    for(ips = root, n = 1; ips; ips = ips->next) inputs[n++] = ips;
+
+    ret = ipset6_shard(inputs, n, ips1->filename, shard6_exclude_all_op, 1);
+    free(inputs);
+    return ret;
+}
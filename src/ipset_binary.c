@@ -9,7 +9,7 @@ static uint32_t endianness = 0x1A2B3C4D;
 
 static void binary_write_failed(void) {
     fprintf(stderr, "%s: cannot write binary output: %s\n", PROG, strerror(errno));
-    exit(1);
+    exit(exit_failure);
 }
 
 static int compare_network_addr_binary(const void *p1, const void *p2)
@@ -0,0 +1,449 @@
+#include "iprange.h"
+
+/*
+ * the bitmap engine keeps an IPv4 ipset as one bit per address. It costs a
+ * fixed 512 MiB, which is the size of 64M entries in the sorted array, but
+ * loading is just setting bits (no sorting) and set operations are plain
+ * word-wise loops that the compiler vectorizes.
+ *
+ * ipsets and set operations with at least ipset_bitmap_min entries use it;
+ * --bitmap forces it for the set operations, whatever their size.
+ */
+size_t ipset_bitmap_min = 64 * 1024 * 1024;
+int ipset_bitmap_forced = 0;
+
+/* ----------------------------------------------------------------------------
+ * ipset_bitmap_wanted()
+ *
+ * returns non-zero when a set operation on the ipsets linked from first and
+ * second (it may be NULL) should use the bitmap engine
+ *
+ */
+
+int ipset_bitmap_wanted(ipset *first, ipset *second) {
+    ipset *ips;
+    size_t entries = 0;
+
+    if(ipset_bitmap_forced) return 1;
+
+    for(ips = first; ips; ips = ips->next)
+        entries += ips->entries;
+
+    for(ips = second; ips; ips = ips->next)
+        entries += ips->entries;
+
+    return entries >= ipset_bitmap_min;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_bitmap_create()
+ *
+ * returns an empty bitmap, or NULL if it cannot be allocated
+ *
+ * the memory is mapped anonymously, so it is zeroed by the kernel and
+ * untouched areas of the address space do not use any physical memory.
+ * Setting bits of random IPs touches pages all over it, so huge pages are
+ * requested to save most of the TLB misses.
+ *
+ */
+
+IPSET_BITMAP *ipset_bitmap_create(void) {
+    IPSET_BITMAP *bm = malloc(sizeof(IPSET_BITMAP));
+    void *words;
+
+    if(unlikely(!bm)) return NULL;
+
+    words = mmap(NULL, (size_t)(IPSET_BITMAP_WORDS * sizeof(uint64_t)), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(unlikely(words == MAP_FAILED)) {
+        free(bm);
+        return NULL;
+    }
+
+#ifdef MADV_HUGEPAGE
+    (void)madvise(words, (size_t)(IPSET_BITMAP_WORDS * sizeof(uint64_t)), MADV_HUGEPAGE);
+#endif
+
+    bm->words = words;
+    return bm;
+}
+
+void ipset_bitmap_free(IPSET_BITMAP *bm) {
+    if(!bm) return;
+
+    munmap(bm->words, (size_t)(IPSET_BITMAP_WORDS * sizeof(uint64_t)));
+    free(bm);
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_bitmap_set_range() and ipset_bitmap_clear_range()
+ *
+ * the bit of an IP is bit (IP % 64) of word (IP / 64); the words fully
+ * inside a range are filled at once
+ *
+ */
+
+void ipset_bitmap_set_range(IPSET_BITMAP *bm, in_addr_t lo, in_addr_t hi) {
+    size_t first = lo >> 6, last = hi >> 6;
+    uint64_t first_mask = ~UINT64_C(0) << (lo & 63);
+    uint64_t last_mask = ~UINT64_C(0) >> (63 - (hi & 63));
+
+    if(first == last) {
+        bm->words[first] |= first_mask & last_mask;
+        return;
+    }
+
+    bm->words[first] |= first_mask;
+    if(last > first + 1)
+        memset(&bm->words[first + 1], 0xff, (last - first - 1) * sizeof(uint64_t));
+    bm->words[last] |= last_mask;
+}
+
+void ipset_bitmap_clear_range(IPSET_BITMAP *bm, in_addr_t lo, in_addr_t hi) {
+    size_t first = lo >> 6, last = hi >> 6;
+    uint64_t first_mask = ~UINT64_C(0) << (lo & 63);
+    uint64_t last_mask = ~UINT64_C(0) >> (63 - (hi & 63));
+
+    if(first == last) {
+        bm->words[first] &= ~(first_mask & last_mask);
+        return;
+    }
+
+    bm->words[first] &= ~first_mask;
+    if(last > first + 1)
+        memset(&bm->words[first + 1], 0, (last - first - 1) * sizeof(uint64_t));
+    bm->words[last] &= ~last_mask;
+}
+
+/*
+ * the entries of the ipset do not need to be sorted; when they are not, every
+ * entry is a cache miss, so the words of the next entries are prefetched
+ */
+#define IPSET_BITMAP_PREFETCH 16
+
+void ipset_bitmap_add_ipset(IPSET_BITMAP *bm, ipset *ips) {
+    size_t i;
+
+    for(i = 0; i < ips->entries; i++) {
+        if(likely(i + IPSET_BITMAP_PREFETCH < ips->entries))
+            __builtin_prefetch(&bm->words[ips->netaddrs[i + IPSET_BITMAP_PREFETCH].addr >> 6], 1);
+
+        ipset_bitmap_set_range(bm, ips->netaddrs[i].addr, ips->netaddrs[i].broadcast);
+    }
+}
+
+void ipset_bitmap_del_ipset(IPSET_BITMAP *bm, ipset *ips) {
+    size_t i;
+
+    for(i = 0; i < ips->entries; i++)
+        ipset_bitmap_clear_range(bm, ips->netaddrs[i].addr, ips->netaddrs[i].broadcast);
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_bitmap_and() and ipset_bitmap_diff_sides()
+ *
+ * word-wise set operations; union and exclusion do not need them: they are
+ * done by setting and clearing the ranges of the ipsets directly
+ *
+ */
+
+void ipset_bitmap_and(IPSET_BITMAP *dst, const IPSET_BITMAP *src) {
+    uint64_t *restrict d = dst->words;
+    const uint64_t *restrict s = src->words;
+    size_t i;
+
+    for(i = 0; i < IPSET_BITMAP_WORDS; i++)
+        d[i] &= s[i];
+}
+
+/* leaves in each bitmap only the IPs that are not in the other */
+void ipset_bitmap_diff_sides(IPSET_BITMAP *bm1, IPSET_BITMAP *bm2) {
+    uint64_t *restrict w1 = bm1->words;
+    uint64_t *restrict w2 = bm2->words;
+    size_t i;
+
+    for(i = 0; i < IPSET_BITMAP_WORDS; i++) {
+        uint64_t x = w1[i], y = w2[i];
+
+        w1[i] = x & ~y;
+        w2[i] = y & ~x;
+    }
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_bitmap_to_ipset()
+ *
+ * returns a new optimized ipset with the runs of set bits of the bitmap
+ * the runs are counted first, to allocate the ipset at its final size;
+ * words that are all zeros outside a run, or all ones inside a run, are
+ * skipped without looking at their bits
+ *
+ * returns NULL if memory cannot be allocated
+ *
+ */
+
+/* the number of runs is the number of bits set, that follow a bit not set */
+static size_t ipset_bitmap_runs(const IPSET_BITMAP *bm) {
+    const uint64_t *words = bm->words;
+    uint64_t w, carry = 0;
+    size_t runs = 0;
+
+    for(w = 0; w < IPSET_BITMAP_WORDS; w++) {
+        uint64_t word = words[w];
+
+        runs += (size_t)__builtin_popcountll(word & ~((word << 1) | carry));
+        carry = word >> 63;
+    }
+
+    return runs;
+}
+
+/* appends a run to an ipset that has been allocated for all of them */
+static inline void ipset_bitmap_emit(ipset *ips, uint64_t lo, uint64_t hi) {
+    ips->netaddrs[ips->entries].addr = (in_addr_t)lo;
+    ips->netaddrs[ips->entries].broadcast = (in_addr_t)hi;
+    ips->unique_ips += hi - lo + 1;
+    ips->entries++;
+}
+
+ipset *ipset_bitmap_to_ipset(const IPSET_BITMAP *bm, const char *filename, size_t lines) {
+    ipset *ips = ipset_create(filename, ipset_bitmap_runs(bm));
+    const uint64_t *words = bm->words;
+    uint64_t lo = 0, w;
+    int in_run = 0;
+
+    if(unlikely(!ips)) return NULL;
+
+    for(w = 0; w < IPSET_BITMAP_WORDS; w++) {
+        uint64_t word = words[w], base = w << 6;
+
+        /* a run started in a previous word: find its end */
+        if(in_run) {
+            unsigned int end;
+
+            if(word == ~UINT64_C(0)) continue;
+
+            end = (unsigned int)__builtin_ctzll(~word);
+            ipset_bitmap_emit(ips, lo, base + end - 1);
+            in_run = 0;
+            word &= ~UINT64_C(0) << end;
+        }
+
+        /* the runs that start in this word */
+        while(word) {
+            unsigned int start = (unsigned int)__builtin_ctzll(word);
+            uint64_t after = ~word & (~UINT64_C(0) << start);
+            unsigned int end;
+
+            if(!after) {
+                /* it continues to the next word */
+                lo = base + start;
+                in_run = 1;
+                break;
+            }
+
+            end = (unsigned int)__builtin_ctzll(after);
+            ipset_bitmap_emit(ips, base + start, base + end - 1);
+            word &= ~UINT64_C(0) << end;
+        }
+    }
+
+    if(in_run)
+        ipset_bitmap_emit(ips, lo, UINT32_MAX);
+
+    ips->lines = lines;
+    ips->flags |= IPSET_FLAG_OPTIMIZED;
+    return ips;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_bitmap_optimize()
+ *
+ * sorts and merges the entries of the ipset through a bitmap, replacing its
+ * entries with the ones of the bitmap; the number of lines is kept
+ *
+ * returns 0 on success, -1 if memory cannot be allocated, in which case the
+ * ipset is left untouched
+ *
+ */
+
+int ipset_bitmap_optimize(ipset *ips) {
+    IPSET_BITMAP *bm = ipset_bitmap_create();
+    ipset *tmp;
+
+    if(unlikely(!bm)) return -1;
+
+    ipset_bitmap_add_ipset(bm, ips);
+    tmp = ipset_bitmap_to_ipset(bm, ips->filename, ips->lines);
+    ipset_bitmap_free(bm);
+
+    if(unlikely(!tmp)) return -1;
+
+    free(ips->netaddrs);
+    ips->netaddrs = tmp->netaddrs;
+    ips->entries = tmp->entries;
+    ips->entries_max = tmp->entries_max;
+    ips->unique_ips = tmp->unique_ips;
+
+    tmp->netaddrs = NULL;
+    ipset_free(tmp);
+    return 0;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * set operations on the bitmap engine
+ *
+ * they give exactly the same result as the sorted array functions, with the
+ * lines of the result being the sum of the lines of all the ipsets involved
+ * they return NULL if memory cannot be allocated
+ *
+ */
+
+static size_t ipset_bitmap_lines(ipset *first, ipset *second) {
+    ipset *ips;
+    size_t lines = 0;
+
+    for(ips = first; ips; ips = ips->next)
+        lines += ips->lines;
+
+    for(ips = second; ips; ips = ips->next)
+        lines += ips->lines;
+
+    return lines;
+}
+
+static IPSET_BITMAP *ipset_bitmap_alloc(void) {
+    IPSET_BITMAP *bm = ipset_bitmap_create();
+
+    if(unlikely(!bm))
+        fprintf(stderr, "%s: Cannot allocate memory for a bitmap (%zu bytes)\n", PROG, (size_t)(IPSET_BITMAP_WORDS * sizeof(uint64_t)));
+
+    return bm;
+}
+
+static IPSET_BITMAP *ipset_bitmap_of_all(ipset *root) {
+    IPSET_BITMAP *bm = ipset_bitmap_alloc();
+    ipset *ips;
+
+    if(unlikely(!bm)) return NULL;
+
+    for(ips = root; ips; ips = ips->next)
+        ipset_bitmap_add_ipset(bm, ips);
+
+    return bm;
+}
+
+/* the union of all the ipsets linked from root */
+ipset *ipset_bitmap_union(ipset *root, const char *filename) {
+    IPSET_BITMAP *bm;
+    ipset *ips;
+
+    if(unlikely(debug)) fprintf(stderr, "%s: Merging all ipsets to %s with a bitmap\n", PROG, filename);
+
+    if(unlikely(!(bm = ipset_bitmap_of_all(root)))) return NULL;
+
+    ips = ipset_bitmap_to_ipset(bm, filename, ipset_bitmap_lines(root, NULL));
+    ipset_bitmap_free(bm);
+    return ips;
+}
+
+/* the IPs found in all the ipsets linked from root */
+ipset *ipset_bitmap_common(ipset *root) {
+    IPSET_BITMAP *bm, *tmp;
+    ipset *ips;
+
+    if(unlikely(debug)) fprintf(stderr, "%s: Finding the common IPs of all ipsets with a bitmap\n", PROG);
+
+    if(unlikely(!(bm = ipset_bitmap_alloc()))) return NULL;
+    if(unlikely(!(tmp = ipset_bitmap_alloc()))) {
+        ipset_bitmap_free(bm);
+        return NULL;
+    }
+
+    /* the bitmap has the first ipset, and the rest are anded to it */
+    ipset_bitmap_add_ipset(bm, root);
+
+    for(ips = root->next; ips; ips = ips->next) {
+        ipset_bitmap_add_ipset(tmp, ips);
+        ipset_bitmap_and(bm, tmp);
+
+        /* clearing its ranges is cheaper than clearing the whole bitmap */
+        ipset_bitmap_del_ipset(tmp, ips);
+    }
+
+    ipset_bitmap_free(tmp);
+
+    ips = ipset_bitmap_to_ipset(bm, "common", ipset_bitmap_lines(root, NULL));
+    ipset_bitmap_free(bm);
+    return ips;
+}
+
+/* the IPs of the ipsets linked from root, that are not in the ones linked from second */
+ipset *ipset_bitmap_exclude(ipset *root, ipset *second) {
+    IPSET_BITMAP *bm;
+    ipset *ips;
+
+    if(unlikely(debug)) fprintf(stderr, "%s: Excluding IPs from %s with a bitmap\n", PROG, root->filename);
+
+    if(unlikely(!(bm = ipset_bitmap_of_all(root)))) return NULL;
+
+    for(ips = second; ips; ips = ips->next)
+        ipset_bitmap_del_ipset(bm, ips);
+
+    ips = ipset_bitmap_to_ipset(bm, root->filename, ipset_bitmap_lines(root, second));
+    ipset_bitmap_free(bm);
+    return ips;
+}
+
+/*
+ * the IPs that are in either the ipsets linked from root or from second, but
+ * not in both; like ipset_diff(), the ranges found only in the first and the
+ * ones found only in the second are not joined, even when they are adjacent
+ */
+ipset *ipset_bitmap_diff(ipset *root, ipset *second) {
+    IPSET_BITMAP *bm1, *bm2;
+    ipset *ips, *only1, *only2;
+    size_t i1 = 0, i2 = 0;
+
+    if(unlikely(debug)) fprintf(stderr, "%s: Finding the differences with a bitmap\n", PROG);
+
+    if(unlikely(!(bm1 = ipset_bitmap_of_all(root)))) return NULL;
+    if(unlikely(!(bm2 = ipset_bitmap_of_all(second)))) {
+        ipset_bitmap_free(bm1);
+        return NULL;
+    }
+
+    ipset_bitmap_diff_sides(bm1, bm2);
+    only1 = ipset_bitmap_to_ipset(bm1, "diff", 0);
+    ipset_bitmap_free(bm1);
+    only2 = ipset_bitmap_to_ipset(bm2, "diff", 0);
+    ipset_bitmap_free(bm2);
+
+    ips = (only1 && only2) ? ipset_create("diff", only1->entries + only2->entries) : NULL;
+    if(unlikely(!ips)) {
+        if(only1) ipset_free(only1);
+        if(only2) ipset_free(only2);
+        return NULL;
+    }
+
+    /* the ranges of the two sides never overlap */
+    while(i1 < only1->entries || i2 < only2->entries) {
+        if(i2 == only2->entries || (i1 < only1->entries && only1->netaddrs[i1].addr < only2->netaddrs[i2].addr))
+            ips->netaddrs[ips->entries++] = only1->netaddrs[i1++];
+        else
+            ips->netaddrs[ips->entries++] = only2->netaddrs[i2++];
+    }
+
+    ips->unique_ips = only1->unique_ips + only2->unique_ips;
+    ips->lines = ipset_bitmap_lines(root, second);
+    ips->flags |= IPSET_FLAG_OPTIMIZED;
+
+    ipset_free(only1);
+    ipset_free(only2);
+    return ips;
+}
@@ -0,0 +1,35 @@
+#ifndef IPRANGE_IPSET_BITMAP_H
+#define IPRANGE_IPSET_BITMAP_H
+
+/* one bit for every IPv4 address: 2^26 words of 64 bits, 512 MiB */
+#define IPSET_BITMAP_WORDS (UINT64_C(1) << 26)
+
+typedef struct ipset_bitmap {
+    uint64_t *words;
+} IPSET_BITMAP;
+
+extern size_t ipset_bitmap_min;
+extern int ipset_bitmap_forced;
+
+extern int ipset_bitmap_wanted(ipset *first, ipset *second);
+
+extern IPSET_BITMAP *ipset_bitmap_create(void);
+extern void ipset_bitmap_free(IPSET_BITMAP *bm);
+
+extern void ipset_bitmap_set_range(IPSET_BITMAP *bm, in_addr_t lo, in_addr_t hi);
+extern void ipset_bitmap_clear_range(IPSET_BITMAP *bm, in_addr_t lo, in_addr_t hi);
+extern void ipset_bitmap_add_ipset(IPSET_BITMAP *bm, ipset *ips);
+extern void ipset_bitmap_del_ipset(IPSET_BITMAP *bm, ipset *ips);
+
+extern void ipset_bitmap_and(IPSET_BITMAP *dst, const IPSET_BITMAP *src);
+extern void ipset_bitmap_diff_sides(IPSET_BITMAP *bm1, IPSET_BITMAP *bm2);
+
+extern ipset *ipset_bitmap_to_ipset(const IPSET_BITMAP *bm, const char *filename, size_t lines);
+extern int ipset_bitmap_optimize(ipset *ips);
+
+extern ipset *ipset_bitmap_union(ipset *root, const char *filename);
+extern ipset *ipset_bitmap_common(ipset *root);
+extern ipset *ipset_bitmap_exclude(ipset *root, ipset *second);
+extern ipset *ipset_bitmap_diff(ipset *root, ipset *second);
+
+#endif //IPRANGE_IPSET_BITMAP_H
@@ -1,5 +1,37 @@
 #include "iprange.h"
 
+/* ----------------------------------------------------------------------------
+ * ipset_common_gallop()
+ *
+ * adds to ips the IPs common to small and large, by seeking in large the
+ * first range that may overlap each range of small, so that it costs
+ * O(m log(n/m)) instead of O(m + n)
+ *
+ */
+
+static void ipset_common_gallop(ipset *ips, ipset *small, ipset *large) {
+    const network_addr_t *s = small->netaddrs, *send = small->netaddrs + small->entries;
+    const network_addr_t *at = large->netaddrs, *end = large->netaddrs + large->entries;
+
+    for(; s < send; s++) {
+        const network_addr_t *p;
+
+        at = ipset_seek(at, end, s->addr);
+        if(unlikely(at == end)) break;
+
+        for(p = at; p < end && p->addr <= s->broadcast; p++) {
+            in_addr_t lo = (p->addr > s->addr) ? p->addr : s->addr;
+            in_addr_t hi = (p->broadcast < s->broadcast) ? p->broadcast : s->broadcast;
+
+            ipset_add_ip_range(ips, lo, hi);
+        }
+
+        /* the last one overlapping may also overlap the next range of small */
+        if(p > at) at = p - 1;
+    }
+}
+
+
 /* ----------------------------------------------------------------------------
  * ipset_common()
  *
@@ -34,6 +66,15 @@ inline ipset *ipset_common(ipset *ips1, ipset *ips2) {
         return ips;
     }
 
+    if(ipset_gallop_ratio && (n1 / n2 >= ipset_gallop_ratio || n2 / n1 >= ipset_gallop_ratio)) {
+        if(n1 < n2) ipset_common_gallop(ips, ips1, ips2);
+        else ipset_common_gallop(ips, ips2, ips1);
+
+        ips->lines = ips1->lines + ips2->lines;
+        ips->flags |= IPSET_FLAG_OPTIMIZED;
+        return ips;
+    }
+
     lo1 = ips1->netaddrs[0].addr;
     lo2 = ips2->netaddrs[0].addr;
     hi1 = ips1->netaddrs[0].broadcast;
@@ -89,3 +130,152 @@ inline ipset *ipset_common(ipset *ips1, ipset *ips2) {
     return ips;
 }
 
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_common_sweep()
+ *
+ * adds to common the IPs common to the n ipsets of cursors, found in a
+ * single pass over all of them, without intermediate ipsets
+ *
+ * every ipset has a cursor; each one in turn is moved to the first range
+ * that ends at or after the candidate IP. When that range starts after the
+ * candidate, it becomes the new candidate; otherwise it covers it. Once all
+ * the cursors in a row cover the candidate, the range up to the first end
+ * of their ranges is common, and the next candidate is the IP after it.
+ *
+ * it stops as soon as one of the cursors runs out of ranges, since nothing
+ * after that can be common to all the ipsets
+ *
+ */
+
+typedef struct ipset_common_cursor {
+    const network_addr_t *at;
+    const network_addr_t *end;
+} IPSET_COMMON_CURSOR;
+
+static void ipset_common_sweep(ipset *common, IPSET_COMMON_CURSOR *cursors, size_t n) {
+    size_t i, covered = 0;
+    uint64_t candidate = 0;
+    in_addr_t hi = UINT32_MAX;      /* the first end of the ranges covering the candidate */
+
+    for(i = 0; n ;) {
+        IPSET_COMMON_CURSOR *c = &cursors[i];
+
+        c->at = ipset_seek(c->at, c->end, candidate);
+        if(c->at == c->end)
+            break;
+
+        if(c->at->addr > candidate) {
+            candidate = c->at->addr;
+            hi = c->at->broadcast;
+            covered = 1;
+        }
+        else {
+            if(c->at->broadcast < hi)
+                hi = c->at->broadcast;
+            covered++;
+        }
+
+        if(covered == n) {
+            ipset_add_ip_range(common, (in_addr_t)candidate, hi);
+
+            if(hi == UINT32_MAX)
+                break;
+
+            candidate = (uint64_t)hi + 1;
+            hi = UINT32_MAX;
+            covered = 0;
+        }
+
+        if(++i == n) i = 0;
+    }
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_common_all()
+ *
+ * it takes all the ipsets linked to 'next' from root
+ * it returns 1 new ipset having the IPs common to all of them
+ *
+ * the first two ipsets are intersected with ipset_common(). While the IPs
+ * common so far are ipset_gallop_ratio times fewer ranges than the next
+ * ipset, it goes on pairwise, galloping through it; that is what sparse
+ * inputs do, where little is common. Otherwise, the IPs common so far and
+ * the ipsets left are intersected by ipset_common_sweep() in one pass.
+ *
+ * the result is optimized
+ */
+
+ipset *ipset_common_all(ipset *root) {
+    ipset *ips, *pairwise = NULL, *common, *tmp;
+    IPSET_COMMON_CURSOR *cursors;
+    size_t n = 0, i = 0, lines = 0;
+
+    if(unlikely(debug)) fprintf(stderr, "%s: Finding common IPs in all ipsets\n", PROG);
+
+    for(ips = root; ips; ips = ips->next) {
+        ipset_optimize(ips);
+        lines += ips->lines;
+    }
+
+    ips = root;
+    if(root && root->next) {
+        pairwise = ipset_common(root, root->next);
+
+        for(ips = root->next->next; pairwise && pairwise->entries && ips ;ips = ips->next) {
+            if(!ipset_gallop_ratio || ips->entries / pairwise->entries < ipset_gallop_ratio)
+                break;
+
+            tmp = ipset_common(pairwise, ips);
+            ipset_free(pairwise);
+            pairwise = tmp;
+        }
+
+        if(unlikely(!pairwise))
+            return NULL;
+
+        if(!ips || !pairwise->entries) {
+            pairwise->lines = lines;
+            return pairwise;
+        }
+
+        n++;
+    }
+
+    for(tmp = ips; tmp; tmp = tmp->next)
+        n++;
+
+    if(unlikely(debug)) fprintf(stderr, "%s: Sweeping %zu ipsets for their common IPs\n", PROG, n);
+
+    common = ipset_create("common", 0);
+    cursors = malloc((n ? n : 1) * sizeof(IPSET_COMMON_CURSOR));
+    if(unlikely(!common || !cursors)) {
+        fprintf(stderr, "%s: Cannot allocate memory for finding the common IPs of %zu ipsets\n", PROG, n);
+        if(common) ipset_free(common);
+        if(pairwise) ipset_free(pairwise);
+        free(cursors);
+        return NULL;
+    }
+
+    if(pairwise) {
+        cursors[i].at = pairwise->netaddrs;
+        cursors[i].end = pairwise->netaddrs + pairwise->entries;
+        i++;
+    }
+
+    for(; ips; ips = ips->next, i++) {
+        cursors[i].at = ips->netaddrs;
+        cursors[i].end = ips->netaddrs + ips->entries;
+    }
+
+    ipset_common_sweep(common, cursors, n);
+
+    free(cursors);
+    if(pairwise) ipset_free(pairwise);
+
+    common->lines = lines;
+    common->flags |= IPSET_FLAG_OPTIMIZED;
+    return common;
+}
@@ -2,5 +2,6 @@
 #define IPRANGE_IPSET_COMMON_H
 
 extern ipset *ipset_common(ipset *ips1, ipset *ips2);
+extern ipset *ipset_common_all(ipset *root);
 
 #endif //IPRANGE_IPSET_COMMON_H
@@ -0,0 +1,145 @@
+#include "iprange.h"
+
+/* ----------------------------------------------------------------------------
+ * the start heap: the cursors of the ipsets, ordered by the first IP of their
+ * next range
+ *
+ */
+
+typedef struct compare_cursor {
+    const network_addr_t *next;
+    const network_addr_t *end;
+    size_t id;                      /* the position of the ipset in the list */
+} COMPARE_CURSOR;
+
+static int compare_starts_less(size_t a, size_t b, const void *data) {
+    const COMPARE_CURSOR *c = data;
+
+    return c[a].next->addr < c[b].next->addr;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_compare_all()
+ *
+ * it takes all the ipsets linked to 'next' from root, which must be
+ * optimized, and returns the number of IPs every pair of them has in common,
+ * in an array indexed with ipset_compare_pair(); *n is set to the number
+ * of ipsets
+ *
+ * it sweeps the address space once, from the start or end of one range to
+ * the next start or end of any range, keeping the ipsets that cover the
+ * current part sorted by their position in the list. Every pair of them
+ * has this part in common.
+ *
+ * returns NULL if memory cannot be allocated
+ *
+ */
+
+uint64_t *ipset_compare_all(ipset *root, size_t *n) {
+    COMPARE_CURSOR *cursors;
+    ipset *ips;
+    uint64_t *common, *active_end, pos = 0;
+    size_t *heap, *active_id, ids = 0, heap_n = 0, active = 0, i, pairs;
+
+    for(ips = root; ips; ips = ips->next) ids++;
+    *n = ids;
+
+    if(unlikely(debug)) fprintf(stderr, "%s: Comparing %zu ipsets in a single sweep\n", PROG, ids);
+
+    if(unlikely(ids > 1 && ids - 1 > SIZE_MAX / ids)) {
+        fprintf(stderr, "%s: Cannot compare %zu ipsets: too many pairs\n", PROG, ids);
+        return NULL;
+    }
+
+    pairs = (ids > 1) ? ids * (ids - 1) / 2 : 1;
+    common = calloc(pairs, sizeof(uint64_t));
+    cursors = malloc((ids ? ids : 1) * sizeof(COMPARE_CURSOR));
+    heap = malloc((ids ? ids : 1) * sizeof(size_t));
+    active_id = malloc((ids ? ids : 1) * sizeof(size_t));
+    active_end = malloc((ids ? ids : 1) * sizeof(uint64_t));
+
+    if(unlikely(!common || !cursors || !heap || !active_id || !active_end)) {
+        fprintf(stderr, "%s: Cannot allocate memory for comparing %zu ipsets\n", PROG, ids);
+        free(common);
+        free(cursors);
+        free(heap);
+        free(active_id);
+        free(active_end);
+        return NULL;
+    }
+
+    for(ips = root, i = 0; ips; ips = ips->next, i++) {
+        cursors[i].next = ips->netaddrs;
+        cursors[i].end = ips->netaddrs + ips->entries;
+        cursors[i].id = i;
+        if(ips->entries) heap[heap_n++] = i;
+    }
+
+    heap_make(heap, heap_n, compare_starts_less, cursors);
+
+    for(;;) {
+        uint64_t next = UINT64_MAX;
+
+        if(heap_n) next = cursors[heap[0]].next->addr;
+        for(i = 0; i < active; i++)
+            if(active_end[i] < next) next = active_end[i];
+
+        if(next == UINT64_MAX) break;
+
+        /* every pair of the active ipsets has [pos, next) in common */
+        if(active > 1 && next > pos) {
+            uint64_t len = next - pos;
+            size_t a, b;
+
+            for(a = 0; a + 1 < active; a++) {
+                /* wraps around when negative, but adding j brings it back */
+                size_t row = ipset_compare_pair(ids, active_id[a], active_id[a] + 1) - (active_id[a] + 1);
+
+                for(b = a + 1; b < active; b++)
+                    common[row + active_id[b]] += len;
+            }
+        }
+
+        pos = next;
+
+        /* remove the ranges that end here, keeping the rest in order */
+        for(i = 0; i < active && active_end[i] != pos; i++) ;
+        if(i < active) {
+            size_t w = i;
+
+            for(; i < active; i++) {
+                if(active_end[i] == pos) continue;
+                active_id[w] = active_id[i];
+                active_end[w] = active_end[i];
+                w++;
+            }
+            active = w;
+        }
+
+        /* add the ranges that start here */
+        while(heap_n && cursors[heap[0]].next->addr == pos) {
+            COMPARE_CURSOR *c = &cursors[heap[0]];
+            size_t at = active;
+
+            while(at > 0 && active_id[at - 1] > c->id) {
+                active_id[at] = active_id[at - 1];
+                active_end[at] = active_end[at - 1];
+                at--;
+            }
+
+            active_id[at] = c->id;
+            active_end[at] = (uint64_t)c->next->broadcast + 1;
+            active++;
+
+            if(++c->next == c->end) heap[0] = heap[--heap_n];
+            if(heap_n) heap_sift_down(heap, heap_n, 0, compare_starts_less, cursors);
+        }
+    }
+
+    free(cursors);
+    free(heap);
+    free(active_id);
+    free(active_end);
+    return common;
+}
@@ -0,0 +1,11 @@
+#ifndef IPRANGE_IPSET_COMPARE_H
+#define IPRANGE_IPSET_COMPARE_H
+
+/* the position of the pair of ipsets i < j, of n, in the array of ipset_compare_all() */
+static inline size_t ipset_compare_pair(size_t n, size_t i, size_t j) {
+    return i * (2 * n - i - 1) / 2 + (j - i - 1);
+}
+
+extern uint64_t *ipset_compare_all(ipset *root, size_t *n);
+
+#endif //IPRANGE_IPSET_COMPARE_H
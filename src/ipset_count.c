@@ -0,0 +1,193 @@
+#include "iprange.h"
+
+/*
+ * the cardinality of the set operations on 2 ipsets, without building the
+ * resulting ipset: they walk the 2 optimized ipsets and only count IPs, so
+ * they do not allocate any memory
+ *
+ * every count is derived from the IPs in common:
+ *
+ *   union   = ips1 + ips2 - common
+ *   diff    = ips1 + ips2 - 2 * common
+ *   exclude = ips1 - common
+ *
+ */
+
+/* counts the IPs common to the ranges of small and large, seeking in large */
+static uint64_t ipset_count_common_gallop(const ipset *small, const ipset *large) {
+    const network_addr_t *s = small->netaddrs, *send = small->netaddrs + small->entries;
+    const network_addr_t *at = large->netaddrs, *end = large->netaddrs + large->entries;
+    uint64_t count = 0;
+
+    for(; s < send; s++) {
+        const network_addr_t *p;
+
+        at = ipset_seek(at, end, s->addr);
+        if(unlikely(at == end)) break;
+
+        for(p = at; p < end && p->addr <= s->broadcast; p++) {
+            in_addr_t lo = (p->addr > s->addr) ? p->addr : s->addr;
+            in_addr_t hi = (p->broadcast < s->broadcast) ? p->broadcast : s->broadcast;
+
+            count += (uint64_t)hi - (uint64_t)lo + UINT64_C(1);
+        }
+
+        /* the last one overlapping may also overlap the next range of small */
+        if(p > at) at = p - 1;
+    }
+
+    return count;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_count_common()
+ *
+ * returns the number of IPs common to both ipsets given
+ *
+ */
+
+uint64_t ipset_count_common(ipset *ips1, ipset *ips2) {
+    const network_addr_t *a, *aend, *b, *bend;
+    uint64_t count = 0;
+    size_t n1, n2;
+
+    if(unlikely(!(ips1->flags & IPSET_FLAG_OPTIMIZED)))
+        ipset_optimize(ips1);
+
+    if(unlikely(!(ips2->flags & IPSET_FLAG_OPTIMIZED)))
+        ipset_optimize(ips2);
+
+    n1 = ips1->entries;
+    n2 = ips2->entries;
+
+    if(unlikely(n1 == 0 || n2 == 0))
+        return 0;
+
+    if(ipset_gallop_ratio && (n1 / n2 >= ipset_gallop_ratio || n2 / n1 >= ipset_gallop_ratio))
+        return (n1 < n2) ? ipset_count_common_gallop(ips1, ips2) : ipset_count_common_gallop(ips2, ips1);
+
+    a = ips1->netaddrs;
+    aend = a + n1;
+    b = ips2->netaddrs;
+    bend = b + n2;
+
+    while(a < aend && b < bend) {
+        in_addr_t ha = a->broadcast, hb = b->broadcast;
+        in_addr_t lo = (a->addr > b->addr) ? a->addr : b->addr;
+        in_addr_t hi = (ha < hb) ? ha : hb;
+
+        /* without branches, since whether they overlap is unpredictable */
+        count += (lo <= hi) ? (uint64_t)hi - (uint64_t)lo + UINT64_C(1) : 0;
+
+        /* the one that ends first cannot overlap anything else */
+        a += (ha <= hb);
+        b += (hb <= ha);
+    }
+
+    return count;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_count_union()
+ * ipset_count_diff()
+ * ipset_count_exclude()
+ *
+ * return the number of IPs that ipset_combine() (optimized), ipset_diff()
+ * and ipset_exclude() would have
+ *
+ */
+
+uint64_t ipset_count_union(ipset *ips1, ipset *ips2) {
+    uint64_t common = ipset_count_common(ips1, ips2);
+    return ips1->unique_ips + ips2->unique_ips - common;
+}
+
+uint64_t ipset_count_diff(ipset *ips1, ipset *ips2) {
+    uint64_t common = ipset_count_common(ips1, ips2);
+    return ips1->unique_ips + ips2->unique_ips - 2 * common;
+}
+
+uint64_t ipset_count_exclude(ipset *ips1, ipset *ips2) {
+    uint64_t common = ipset_count_common(ips1, ips2);
+    return ips1->unique_ips - common;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_count_pairs()
+ *
+ * runs the count op on every pair of the n1 ipsets linked to 'next' from
+ * first1 and the n2 ipsets linked from first2, which must be optimized, on
+ * the threads given with --threads; the threads take the next pairs to count
+ * as soon as they finish the previous, so they stay busy even when the
+ * ipsets have very different sizes
+ *
+ * returns an array of n1 x n2 counts, the one of the pair (i, j) at
+ * i * n2 + j, so that the caller can print them in order; NULL if memory
+ * cannot be allocated
+ *
+ */
+
+/* the pairs are split into this many jobs per thread */
+#define COUNT_JOBS_PER_THREAD 8
+
+typedef struct count_pairs_job {
+    ipset **ipsets1;
+    ipset **ipsets2;
+    size_t n2;
+    size_t pairs;
+    size_t per_job;
+    IPSET_COUNT_OP op;
+    uint64_t *counts;
+} COUNT_PAIRS_JOB;
+
+static void count_pairs_job(size_t job, void *data) {
+    COUNT_PAIRS_JOB *cj = data;
+    size_t p = job * cj->per_job, end = p + cj->per_job;
+
+    if(end > cj->pairs) end = cj->pairs;
+
+    for(; p < end; p++)
+        cj->counts[p] = cj->op(cj->ipsets1[p / cj->n2], cj->ipsets2[p % cj->n2]);
+}
+
+uint64_t *ipset_count_pairs(ipset *first1, size_t n1, ipset *first2, size_t n2, IPSET_COUNT_OP op) {
+    COUNT_PAIRS_JOB cj;
+    ipset *ips;
+    size_t i;
+
+    if(unlikely(n2 && n1 > SIZE_MAX / sizeof(uint64_t) / n2)) {
+        fprintf(stderr, "%s: Cannot compare %zu x %zu ipsets: too many pairs\n", PROG, n1, n2);
+        return NULL;
+    }
+
+    cj.n2 = n2;
+    cj.pairs = n1 * n2;
+    cj.op = op;
+    cj.per_job = cj.pairs / ((size_t)((parallel_threads > 1) ? parallel_threads : 1) * COUNT_JOBS_PER_THREAD);
+    if(!cj.per_job) cj.per_job = 1;
+    cj.ipsets1 = malloc((n1 ? n1 : 1) * sizeof(ipset *));
+    cj.ipsets2 = malloc((n2 ? n2 : 1) * sizeof(ipset *));
+    cj.counts = malloc((cj.pairs ? cj.pairs : 1) * sizeof(uint64_t));
+
+    if(unlikely(!cj.ipsets1 || !cj.ipsets2 || !cj.counts)) {
+        fprintf(stderr, "%s: Cannot allocate memory for comparing %zu x %zu ipsets\n", PROG, n1, n2);
+        free(cj.ipsets1);
+        free(cj.ipsets2);
+        free(cj.counts);
+        return NULL;
+    }
+
+    for(ips = first1, i = 0; ips && i < n1; ips = ips->next, i++) cj.ipsets1[i] = ips;
+    for(ips = first2, i = 0; ips && i < n2; ips = ips->next, i++) cj.ipsets2[i] = ips;
+
+    if(unlikely(debug)) fprintf(stderr, "%s: Counting %zu pairs of ipsets\n", PROG, cj.pairs);
+
+    parallel_run("compare", (cj.pairs + cj.per_job - 1) / cj.per_job, count_pairs_job, &cj);
+
+    free(cj.ipsets1);
+    free(cj.ipsets2);
+    return cj.counts;
+}
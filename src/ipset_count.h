@@ -0,0 +1,13 @@
+#ifndef IPRANGE_IPSET_COUNT_H
+#define IPRANGE_IPSET_COUNT_H
+
+extern uint64_t ipset_count_common(ipset *ips1, ipset *ips2);
+extern uint64_t ipset_count_union(ipset *ips1, ipset *ips2);
+extern uint64_t ipset_count_diff(ipset *ips1, ipset *ips2);
+extern uint64_t ipset_count_exclude(ipset *ips1, ipset *ips2);
+
+typedef uint64_t (*IPSET_COUNT_OP)(ipset *ips1, ipset *ips2);
+
+extern uint64_t *ipset_count_pairs(ipset *first1, size_t n1, ipset *first2, size_t n2, IPSET_COUNT_OP op);
+
+#endif //IPRANGE_IPSET_COUNT_H
@@ -0,0 +1,280 @@
+#include "iprange.h"
+
+/*
+ * the coverage depth of an IP is the number of ipsets it is in
+ *
+ * the ipsets are swept once, in address order: a min-heap has the next range
+ * of every ipset, ordered by its first IP, and another has the ends of the
+ * ranges the sweep is in. Every range enters and leaves the sweep once, so it
+ * is O(N log k) for N ranges in k ipsets.
+ *
+ * the exclusive IPs of an ipset are the ones none of the others has, so they
+ * are the ones the sweep finds in that one alone.
+ */
+
+typedef struct coverage_cursor {
+    const network_addr_t *next;
+    const network_addr_t *end;
+} COVERAGE_CURSOR;
+
+/* the starts heap has the ipsets by the first IP of their next range */
+static int coverage_starts_less(size_t a, size_t b, const void *data) {
+    const COVERAGE_CURSOR *c = data;
+
+    return c[a].next->addr < c[b].next->addr;
+}
+
+/* the IP after the range of an ipset in the sweep, the one before its next;
+ * an optimized ipset has one range in the sweep at most */
+static inline uint64_t coverage_end(const COVERAGE_CURSOR *c, size_t id) {
+    return (uint64_t)c[id].next[-1].broadcast + 1;
+}
+
+/* the ends heap has the ipsets in the sweep by the end of their range */
+static int coverage_ends_less(size_t a, size_t b, const void *data) {
+    return coverage_end(data, a) < coverage_end(data, b);
+}
+
+/* ----------------------------------------------------------------------------
+ * ipset_coverage_sweep()
+ *
+ * sweeps all the ipsets linked to 'next' from root, optimizing them, and
+ * calls part() for every part of the address space that is in some of them
+ *
+ * enter() and leave(), when given, get the position of an ipset whose range
+ * enters or leaves the sweep, after the part before it, so that the caller
+ * can keep its own state of the ipsets in the sweep
+ *
+ * returns -1 if memory cannot be allocated
+ *
+ */
+
+int ipset_coverage_sweep(ipset *root, COVERAGE_PART part, COVERAGE_MOVE enter, COVERAGE_MOVE leave, void *data) {
+    COVERAGE_CURSOR *cursors;
+    ipset *ips;
+    size_t *starts, *ends, ids = 0, starts_n = 0, depth = 0, id_sum = 0, i;
+    uint64_t pos = 0;
+
+    for(ips = root; ips; ips = ips->next) {
+        ipset_optimize(ips);
+        ids++;
+    }
+
+    cursors = malloc((ids ? ids : 1) * sizeof(COVERAGE_CURSOR));
+    starts = malloc((ids ? ids : 1) * sizeof(size_t));
+    ends = malloc((ids ? ids : 1) * sizeof(size_t));
+
+    if(unlikely(!cursors || !starts || !ends)) {
+        fprintf(stderr, "%s: Cannot allocate memory for sweeping %zu ipsets\n", PROG, ids);
+        free(cursors);
+        free(starts);
+        free(ends);
+        return -1;
+    }
+
+    for(ips = root, i = 0; ips; ips = ips->next, i++) {
+        cursors[i].next = ips->netaddrs;
+        cursors[i].end = ips->netaddrs + ips->entries;
+        if(ips->entries) starts[starts_n++] = i;
+    }
+
+    heap_make(starts, starts_n, coverage_starts_less, cursors);
+
+    for(;;) {
+        uint64_t next = UINT64_MAX;
+
+        /* every IP from pos up to next is in depth ipsets; when it is 1,
+         * the sum of the ids of the ipsets is the id of that one */
+        if(starts_n) next = cursors[starts[0]].next->addr;
+        if(depth && coverage_end(cursors, ends[0]) < next) next = coverage_end(cursors, ends[0]);
+        if(next == UINT64_MAX) break;
+
+        if(depth && next > pos)
+            part((in_addr_t)pos, (in_addr_t)(next - 1), depth, id_sum, data);
+
+        pos = next;
+
+        /* the ranges that end here leave the sweep */
+        while(depth && coverage_end(cursors, ends[0]) == pos) {
+            id_sum -= ends[0];
+            if(leave) leave(ends[0], data);
+            ends[0] = ends[--depth];
+            if(depth) heap_sift_down(ends, depth, 0, coverage_ends_less, cursors);
+        }
+
+        /* the ranges that start here enter it */
+        while(starts_n && cursors[starts[0]].next->addr == pos) {
+            COVERAGE_CURSOR *c = &cursors[starts[0]];
+
+            ends[depth] = starts[0];
+            id_sum += starts[0];
+            if(enter) enter(starts[0], data);
+            if(++c->next == c->end) starts[0] = starts[--starts_n];
+            if(starts_n) heap_sift_down(starts, starts_n, 0, coverage_starts_less, cursors);
+
+            heap_sift_up(ends, depth++, coverage_ends_less, cursors);
+        }
+    }
+
+    free(cursors);
+    free(starts);
+    free(ends);
+    return 0;
+}
+
+static size_t coverage_lines(ipset *root, const char *what) {
+    ipset *ips;
+    size_t lines = 0;
+
+    for(ips = root; ips; ips = ips->next)
+        if(unlikely(ipset_size_add_overflows(lines, ips->lines, &lines))) {
+            fprintf(stderr, "%s: Cannot find the %s of ipset %s safely: too many input lines\n", PROG, what, ips->filename);
+            return SIZE_MAX;
+        }
+
+    return lines;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_coverage()
+ *
+ * it takes all the ipsets linked to 'next' from root
+ * it returns 1 new ipset having the IPs whose coverage depth matches op and
+ * wanted (IPSET_COVERAGE_AT_LEAST, IPSET_COVERAGE_EXACTLY or
+ * IPSET_COVERAGE_AT_MOST wanted ipsets); its lines are the sum of the lines
+ * of all of them
+ *
+ * the result is optimized; it returns NULL if memory cannot be allocated
+ */
+
+typedef struct coverage_match {
+    ipset *ips;
+    int op;
+    size_t wanted;
+} COVERAGE_MATCH;
+
+static void coverage_match_part(in_addr_t lo, in_addr_t hi, size_t depth, size_t id, void *data) {
+    COVERAGE_MATCH *cm = data;
+    (void)id;
+
+    if(ipset_coverage_match(cm->op, depth, cm->wanted))
+        ipset_add_ip_range(cm->ips, lo, hi);
+}
+
+ipset *ipset_coverage(ipset *root, int op, size_t wanted) {
+    COVERAGE_MATCH cm;
+    size_t lines = coverage_lines(root, "coverage");
+
+    if(unlikely(lines == SIZE_MAX)) return NULL;
+
+    if(unlikely(debug)) fprintf(stderr, "%s: Finding the coverage depth of the ipsets\n", PROG);
+
+    cm.op = op;
+    cm.wanted = wanted;
+    cm.ips = ipset_create("coverage", 0);
+    if(unlikely(!cm.ips)) return NULL;
+
+    /* added in order, so adjacent ranges are joined */
+    cm.ips->flags |= IPSET_FLAG_OPTIMIZED;
+
+    if(unlikely(ipset_coverage_sweep(root, coverage_match_part, NULL, NULL, &cm))) {
+        ipset_free(cm.ips);
+        return NULL;
+    }
+
+    cm.ips->lines = lines;
+    return cm.ips;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_exclusive_ips()
+ *
+ * it takes all the ipsets linked to 'next' from root
+ * it returns an array with the number of IPs of each of them, in the order
+ * of the list, that none of the others has
+ *
+ * it returns NULL if memory cannot be allocated
+ */
+
+static void exclusive_ips_part(in_addr_t lo, in_addr_t hi, size_t depth, size_t id, void *data) {
+    uint64_t *exclusive = data;
+
+    if(depth == 1)
+        exclusive[id] += (uint64_t)hi - (uint64_t)lo + UINT64_C(1);
+}
+
+uint64_t *ipset_exclusive_ips(ipset *root) {
+    ipset *ips;
+    uint64_t *exclusive;
+    size_t ids = 0;
+
+    for(ips = root; ips; ips = ips->next) ids++;
+
+    if(unlikely(debug)) fprintf(stderr, "%s: Counting the exclusive IPs of %zu ipsets\n", PROG, ids);
+
+    exclusive = calloc(ids ? ids : 1, sizeof(uint64_t));
+    if(unlikely(!exclusive)) {
+        fprintf(stderr, "%s: Cannot allocate memory for the exclusive IPs of %zu ipsets\n", PROG, ids);
+        return NULL;
+    }
+
+    if(unlikely(ipset_coverage_sweep(root, exclusive_ips_part, NULL, NULL, exclusive))) {
+        free(exclusive);
+        return NULL;
+    }
+
+    return exclusive;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_exclusive()
+ *
+ * it takes all the ipsets linked to 'next' from root
+ * it returns 1 new ipset having the IPs of the one at position id in the
+ * list that none of the others has; its lines are the sum of the lines
+ * of all of them
+ *
+ * the result is optimized; it returns NULL if memory cannot be allocated
+ */
+
+typedef struct exclusive_ranges {
+    ipset *ips;
+    size_t id;
+} EXCLUSIVE_RANGES;
+
+static void exclusive_ranges_part(in_addr_t lo, in_addr_t hi, size_t depth, size_t id, void *data) {
+    EXCLUSIVE_RANGES *er = data;
+
+    if(depth == 1 && id == er->id)
+        ipset_add_ip_range(er->ips, lo, hi);
+}
+
+ipset *ipset_exclusive(ipset *root, size_t id) {
+    EXCLUSIVE_RANGES er;
+    ipset *ips;
+    size_t i, lines = coverage_lines(root, "exclusive IPs");
+
+    if(unlikely(lines == SIZE_MAX)) return NULL;
+
+    for(ips = root, i = 0; ips && i < id; ips = ips->next, i++) ;
+
+    er.id = id;
+    er.ips = ipset_create(ips ? ips->filename : "exclusive", 0);
+    if(unlikely(!er.ips)) return NULL;
+
+    if(unlikely(debug)) fprintf(stderr, "%s: Finding the exclusive IPs of %s\n", PROG, er.ips->filename);
+
+    /* added in order, so adjacent ranges are joined */
+    er.ips->flags |= IPSET_FLAG_OPTIMIZED;
+
+    if(unlikely(ipset_coverage_sweep(root, exclusive_ranges_part, NULL, NULL, &er))) {
+        ipset_free(er.ips);
+        return NULL;
+    }
+
+    er.ips->lines = lines;
+    return er.ips;
+}
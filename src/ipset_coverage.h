@@ -0,0 +1,32 @@
+#ifndef IPRANGE_IPSET_COVERAGE_H
+#define IPRANGE_IPSET_COVERAGE_H
+
+/* how the coverage depth of an IP is compared to the depth given */
+#define IPSET_COVERAGE_AT_LEAST 1
+#define IPSET_COVERAGE_EXACTLY 2
+#define IPSET_COVERAGE_AT_MOST 3
+
+/* non-zero when an IP in depth ipsets is wanted; IPs in none are never wanted */
+static inline int ipset_coverage_match(int op, size_t depth, size_t wanted) {
+    if(!depth) return 0;
+
+    switch(op) {
+        case IPSET_COVERAGE_AT_LEAST: return depth >= wanted;
+        case IPSET_COVERAGE_EXACTLY: return depth == wanted;
+        default: return depth <= wanted;
+    }
+}
+
+/* gets every part of the address space that is in depth ipsets (depth > 0);
+ * when depth is 1, id is the position of the ipset in the list */
+typedef void (*COVERAGE_PART)(in_addr_t lo, in_addr_t hi, size_t depth, size_t id, void *data);
+
+/* gets the position in the list of an ipset whose range enters or leaves the sweep */
+typedef void (*COVERAGE_MOVE)(size_t id, void *data);
+
+extern int ipset_coverage_sweep(ipset *root, COVERAGE_PART part, COVERAGE_MOVE enter, COVERAGE_MOVE leave, void *data);
+extern ipset *ipset_coverage(ipset *root, int op, size_t wanted);
+extern uint64_t *ipset_exclusive_ips(ipset *root);
+extern ipset *ipset_exclusive(ipset *root, size_t id);
+
+#endif //IPRANGE_IPSET_COVERAGE_H
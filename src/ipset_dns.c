@@ -34,6 +34,14 @@ static pthread_cond_t dns_cond = PTHREAD_COND_INITIALIZER;
 static pthread_mutex_t dns_requests_mut = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t dns_replies_mut = PTHREAD_MUTEX_INITIALIZER;
 
+/*
+ * the request and reply queues are global, so only one load at a time
+ * can be resolving hostnames; the others wait for it to finish
+ */
+static pthread_mutex_t dns_session_mut = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t dns_session_cond = PTHREAD_COND_INITIALIZER;
+static const void *dns_session_owner;
+
 static void dns_lock_requests(void)   { pthread_mutex_lock(&dns_requests_mut); }
 static void dns_unlock_requests(void) { pthread_mutex_unlock(&dns_requests_mut); }
 static void dns_lock_replies(void)    { pthread_mutex_lock(&dns_replies_mut); }
@@ -56,6 +64,33 @@ void dns_reset_stats(void)
     dns_unlock_replies();
 }
 
+/* ----------------------------------------------------------------------------
+ * dns_session_acquire() / dns_session_release()
+ *
+ * a load has to own the DNS session before its first dns_request() and keep
+ * it until its dns_done(). Acquiring a session already owned by the same
+ * owner returns immediately.
+ */
+
+void dns_session_acquire(const void *owner)
+{
+    pthread_mutex_lock(&dns_session_mut);
+    while(dns_session_owner && dns_session_owner != owner)
+        pthread_cond_wait(&dns_session_cond, &dns_session_mut);
+    dns_session_owner = owner;
+    pthread_mutex_unlock(&dns_session_mut);
+}
+
+void dns_session_release(const void *owner)
+{
+    pthread_mutex_lock(&dns_session_mut);
+    if(dns_session_owner == owner) {
+        dns_session_owner = NULL;
+        pthread_cond_broadcast(&dns_session_cond);
+    }
+    pthread_mutex_unlock(&dns_session_mut);
+}
+
 static void dns_thread_wait_for_requests(void) {
     dns_lock_requests();
     while(!dns_requests)
@@ -72,20 +107,20 @@ static void dns_signal_threads(void)
 
 static void *dns_thread_resolve(void *ptr);
 
+/*
+ * the chunks of a parallel load share the DNS session of their load, so
+ * requests can be added by several threads at once: the count of the DNS
+ * threads is checked and updated with the requests lock held
+ */
 static int dns_request_add(DNSREQ *d)
 {
-    unsigned long pending;
-
     dns_lock_requests();
     d->next = dns_requests;
     dns_requests = d;
     dns_requests_pending++;
     dns_requests_made++;
 
-    pending = dns_requests_pending;
-    dns_unlock_requests();
-
-    if(pending > (unsigned long)dns_threads && dns_threads < dns_threads_max) {
+    if(dns_requests_pending > (unsigned long)dns_threads && dns_threads < dns_threads_max) {
         pthread_t thread;
 
         if(unlikely(debug))
@@ -94,7 +129,6 @@ static int dns_request_add(DNSREQ *d)
         if(pthread_create(&thread, NULL, dns_thread_resolve, NULL)) {
             fprintf(stderr, "%s: Cannot create DNS thread.\n", PROG);
             if(dns_threads == 0) {
-                dns_lock_requests();
                 dns_requests = d->next;
                 dns_requests_pending--;
                 dns_requests_made--;
@@ -111,7 +145,8 @@ static int dns_request_add(DNSREQ *d)
         }
     }
 
-    dns_signal_threads();
+    pthread_cond_signal(&dns_cond);
+    dns_unlock_requests();
     return 0;
 }
 
@@ -363,8 +398,10 @@ int dns_done(ipset *ips)
     dns_process_replies(ips);
 
     unsigned long retries, replies_found, replies_failed;
+    int threads;
 
     dns_lock_requests();
+    threads = dns_threads;
     made = dns_requests_made;
     retries = dns_requests_retries;
     replies_found = dns_replies_found;
@@ -372,7 +409,7 @@ int dns_done(ipset *ips)
     dns_unlock_requests();
 
     if(unlikely(debug))
-        fprintf(stderr, "%s: DNS: made %lu DNS requests, failed %lu, retries: %lu, IPs got %lu, threads used %d of %d\n", PROG, made, replies_failed, retries, replies_found, dns_threads, dns_threads_max);
+        fprintf(stderr, "%s: DNS: made %lu DNS requests, failed %lu, retries: %lu, IPs got %lu, threads used %d of %d\n", PROG, made, replies_failed, retries, replies_found, threads, dns_threads_max);
     else if(dns_progress) {
         for(; shown <= dots; shown++) {
             if(!(shown % 10)) fprintf(stderr, "%lu%%", shown * 100 / dots);
@@ -8,5 +8,7 @@ extern int dns_progress;
 extern int dns_request(ipset *ips, const char *hostname);
 extern int dns_done(ipset *ips);
 extern void dns_reset_stats(void);
+extern void dns_session_acquire(const void *owner);
+extern void dns_session_release(const void *owner);
 
 #endif //IPRANGE_IPSET_DNS_H
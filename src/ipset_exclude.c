@@ -1,5 +1,44 @@
 #include "iprange.h"
 
+/* ----------------------------------------------------------------------------
+ * ipset_exclude_gallop()
+ *
+ * adds to ips the IPs of ips1 that are not in ips2, when ips2 is the larger
+ * one, by seeking in ips2 the first range that may overlap each range of
+ * ips1, so that it costs O(m log(n/m)) instead of O(m + n)
+ *
+ */
+
+static void ipset_exclude_gallop(ipset *ips, ipset *ips1, ipset *ips2) {
+    const network_addr_t *r = ips1->netaddrs, *rend = ips1->netaddrs + ips1->entries;
+    const network_addr_t *at = ips2->netaddrs, *end = ips2->netaddrs + ips2->entries;
+
+    for(; r < rend; r++) {
+        in_addr_t lo = r->addr, hi = r->broadcast;
+        int left = 1;
+
+        at = ipset_seek(at, end, lo);
+
+        while(at < end && at->addr <= hi) {
+            if(at->addr > lo)
+                ipset_add_ip_range(ips, lo, at->addr - 1);
+
+            /* it may also overlap the next range of ips1, so keep it */
+            if(at->broadcast >= hi) {
+                left = 0;
+                break;
+            }
+
+            lo = at->broadcast + 1;
+            at++;
+        }
+
+        if(left)
+            ipset_add_ip_range(ips, lo, hi);
+    }
+}
+
+
 /* ----------------------------------------------------------------------------
  * ipset_exclude()
  *
@@ -45,6 +84,14 @@ inline ipset *ipset_exclude(ipset *ips1, ipset *ips2) {
         return ips;
     }
 
+    if(ipset_gallop_ratio && n2 / n1 >= ipset_gallop_ratio) {
+        ipset_exclude_gallop(ips, ips1, ips2);
+
+        ips->lines = ips1->lines + ips2->lines;
+        ips->flags |= IPSET_FLAG_OPTIMIZED;
+        return ips;
+    }
+
     lo1 = ips1->netaddrs[0].addr;
     lo2 = ips2->netaddrs[0].addr;
     hi1 = ips1->netaddrs[0].broadcast;
@@ -123,3 +170,82 @@ inline ipset *ipset_exclude(ipset *ips1, ipset *ips2) {
     ips->flags |= IPSET_FLAG_OPTIMIZED;
     return ips;
 }
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_exclude_all()
+ *
+ * it takes an ipset (ips1) and all the ipsets linked to 'next' from root
+ * it returns 1 new ipset having all the IPs of ips1, excluding the IPs of
+ * all the others
+ *
+ * the union of the excluded ipsets is streamed by a k-way merge, without
+ * building it, and it is removed from ips1 in a single pass, so the ipsets
+ * are excluded without creating an intermediate ipset for each of them
+ *
+ * the result is optimized; it returns NULL if memory cannot be allocated
+ */
+
+ipset *ipset_exclude_all(ipset *ips1, ipset *root) {
+    IPSET_KMERGE km;
+    ipset *ips, *r;
+    size_t i1, n1, lines;
+    in_addr_t lo2 = 0, hi2 = 0;
+    int more;
+
+    if(unlikely(!(ips1->flags & IPSET_FLAG_OPTIMIZED)))
+        ipset_optimize(ips1);
+
+    if(unlikely(debug)) fprintf(stderr, "%s: Removing IPs in all the excluded ipsets from %s\n", PROG, ips1->filename);
+
+    lines = ips1->lines;
+    for(r = root; r; r = r->next)
+        if(unlikely(ipset_size_add_overflows(lines, r->lines, &lines))) {
+            fprintf(stderr, "%s: Cannot exclude ipset %s from %s safely: too many input lines\n", PROG, r->filename, ips1->filename);
+            return NULL;
+        }
+
+    if(unlikely(ipset_kmerge_init(&km, root)))
+        return NULL;
+
+    ips = ipset_create(ips1->filename, ips1->entries);
+    if(unlikely(!ips)) {
+        ipset_kmerge_free(&km);
+        return NULL;
+    }
+
+    n1 = ips1->entries;
+    more = ipset_kmerge_next(&km, &lo2, &hi2);
+
+    for(i1 = 0; i1 < n1; i1++) {
+        in_addr_t lo = ips1->netaddrs[i1].addr, hi = ips1->netaddrs[i1].broadcast;
+        int left = 1;
+
+        /* skip the excluded ranges before this one */
+        while(more && hi2 < lo)
+            more = ipset_kmerge_next(&km, &lo2, &hi2);
+
+        while(more && lo2 <= hi) {
+            if(lo2 > lo)
+                ipset_add_ip_range(ips, lo, lo2 - 1);
+
+            /* it may also overlap the next range of ips1, so keep it */
+            if(hi2 >= hi) {
+                left = 0;
+                break;
+            }
+
+            lo = hi2 + 1;
+            more = ipset_kmerge_next(&km, &lo2, &hi2);
+        }
+
+        if(left)
+            ipset_add_ip_range(ips, lo, hi);
+    }
+
+    ipset_kmerge_free(&km);
+
+    ips->lines = lines;
+    ips->flags |= IPSET_FLAG_OPTIMIZED;
+    return ips;
+}
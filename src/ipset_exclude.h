@@ -2,5 +2,6 @@
 #define IPRANGE_IPSET_EXCLUDE_H
 
 extern ipset *ipset_exclude(ipset *ips1, ipset *ips2);
+extern ipset *ipset_exclude_all(ipset *ips1, ipset *root);
 
 #endif //IPRANGE_IPSET_EXCLUDE_H
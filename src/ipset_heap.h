@@ -0,0 +1,53 @@
+#ifndef IPRANGE_IPSET_HEAP_H
+#define IPRANGE_IPSET_HEAP_H
+
+/*
+ * binary min-heaps of item numbers, such as the positions of the ipsets
+ * swept by ipset_compare_all() or ipset_coverage()
+ *
+ * less(a, b, data) is non-zero when item a has to come out of the heap
+ * before item b. The helpers are inline, so a static less given to them is
+ * inlined too.
+ */
+
+typedef int (*HEAP_LESS)(size_t a, size_t b, const void *data);
+
+/* moves the item at i down to its place among the n items of the heap */
+static inline void heap_sift_down(size_t *heap, size_t n, size_t i, HEAP_LESS less, const void *data) {
+    size_t top = heap[i];
+
+    for(;;) {
+        size_t child = 2 * i + 1;
+
+        if(child >= n) break;
+        if(child + 1 < n && less(heap[child + 1], heap[child], data)) child++;
+        if(!less(heap[child], top, data)) break;
+
+        heap[i] = heap[child];
+        i = child;
+    }
+
+    heap[i] = top;
+}
+
+/* moves the item at i up to its place, after it has been appended to the heap */
+static inline void heap_sift_up(size_t *heap, size_t i, HEAP_LESS less, const void *data) {
+    size_t item = heap[i];
+
+    while(i > 0 && less(item, heap[(i - 1) / 2], data)) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+
+    heap[i] = item;
+}
+
+/* orders the n items of heap */
+static inline void heap_make(size_t *heap, size_t n, HEAP_LESS less, const void *data) {
+    size_t i;
+
+    for(i = n / 2; i-- > 0 ;)
+        heap_sift_down(heap, n, i, less, data);
+}
+
+#endif //IPRANGE_IPSET_HEAP_H
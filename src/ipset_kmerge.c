@@ -0,0 +1,218 @@
+#include "iprange.h"
+
+/* ----------------------------------------------------------------------------
+ * k-way merge of optimized ipsets
+ *
+ * every ipset is an already sorted list of non-overlapping ranges, so their
+ * union can be streamed in order by a tournament (loser) tree with one leaf
+ * per ipset, keyed on the address of the next range of each. Every range
+ * costs log2(k) comparisons, all in the small keys array, so this is
+ * O(N log k) for N ranges in k ipsets, without sorting them again.
+ *
+ */
+
+/* the key of an exhausted cursor; it is bigger than any address */
+#define IPSET_KMERGE_DONE UINT64_MAX
+
+/* replays the matches from a leaf up to the root, after its key changed */
+static inline void ipset_kmerge_replay(IPSET_KMERGE *km, size_t leaf) {
+    size_t node, winner = leaf;
+    uint64_t key = km->keys[leaf];
+
+    for(node = (leaf + km->leaves) >> 1; node; node >>= 1) {
+        size_t loser = km->tree[node];
+        uint64_t loser_key = km->keys[loser];
+
+        /* branchless: the outcome of every match is unpredictable */
+        size_t swap = (size_t)(loser_key < key);
+        size_t mask = (size_t)0 - swap;
+
+        km->tree[node] = (loser & ~mask) | (winner & mask);
+        winner = (winner & ~mask) | (loser & mask);
+        key = swap ? loser_key : key;
+    }
+
+    km->tree[0] = winner;
+}
+
+/* moves the winning cursor to its next range */
+static inline void ipset_kmerge_advance(IPSET_KMERGE *km) {
+    size_t winner = km->tree[0];
+    IPSET_KMERGE_CURSOR *c = &km->cursors[winner];
+
+    c->next++;
+    km->keys[winner] = (likely(c->next != c->end)) ? c->next->addr : IPSET_KMERGE_DONE;
+    ipset_kmerge_replay(km, winner);
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_kmerge_init()
+ *
+ * prepares a k-way merge of all the ipsets linked to 'next' from root
+ * ipsets that are not optimized are optimized first
+ *
+ * returns 0 on success, -1 if memory cannot be allocated
+ *
+ */
+
+int ipset_kmerge_init(IPSET_KMERGE *km, ipset *root) {
+    ipset *ips;
+    size_t count = 0, i, node;
+    size_t *winners;
+
+    for(ips = root; ips; ips = ips->next)
+        count++;
+
+    for(km->leaves = 1; km->leaves < count; km->leaves <<= 1) ;
+
+    km->tree = malloc(km->leaves * sizeof(size_t));
+    km->keys = malloc(km->leaves * sizeof(uint64_t));
+    km->cursors = calloc(km->leaves, sizeof(IPSET_KMERGE_CURSOR));
+    winners = malloc(km->leaves * 2 * sizeof(size_t));
+    if(unlikely(!km->tree || !km->keys || !km->cursors || !winners)) {
+        fprintf(stderr, "%s: Cannot allocate memory for merging %zu ipsets\n", PROG, count);
+        free(winners);
+        ipset_kmerge_free(km);
+        return -1;
+    }
+
+    for(i = 0, ips = root; i < km->leaves; i++) {
+        km->keys[i] = IPSET_KMERGE_DONE;
+
+        if(ips) {
+            ipset_optimize(ips);
+            if(ips->entries) {
+                km->cursors[i].next = ips->netaddrs;
+                km->cursors[i].end = ips->netaddrs + ips->entries;
+                km->keys[i] = ips->netaddrs[0].addr;
+            }
+            ips = ips->next;
+        }
+    }
+
+    /* play the initial tournament bottom up */
+    for(i = 0; i < km->leaves; i++)
+        winners[km->leaves + i] = i;
+
+    for(node = km->leaves - 1; node > 0; node--) {
+        size_t l = winners[node * 2], r = winners[node * 2 + 1];
+
+        if(km->keys[r] < km->keys[l]) {
+            winners[node] = r;
+            km->tree[node] = l;
+        }
+        else {
+            winners[node] = l;
+            km->tree[node] = r;
+        }
+    }
+
+    km->tree[0] = (km->leaves > 1) ? winners[1] : 0;
+    free(winners);
+
+    return 0;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_kmerge_next()
+ *
+ * returns the next range of the union in lo and hi; overlapping and adjacent
+ * ranges are joined, so the ranges returned are optimized
+ *
+ * returns 1 when a range is returned, 0 at the end of the merge
+ *
+ */
+
+int ipset_kmerge_next(IPSET_KMERGE *km, in_addr_t *lo, in_addr_t *hi) {
+    in_addr_t h;
+
+    if(unlikely(km->keys[km->tree[0]] == IPSET_KMERGE_DONE)) return 0;
+
+    *lo = km->cursors[km->tree[0]].next->addr;
+    h = km->cursors[km->tree[0]].next->broadcast;
+    ipset_kmerge_advance(km);
+
+    for(;;) {
+        uint64_t key = km->keys[km->tree[0]];
+
+        /* when h is the last IP, nothing can be after it */
+        if(key > h && key != (uint64_t)h + 1)
+            break;
+
+        if(km->cursors[km->tree[0]].next->broadcast > h)
+            h = km->cursors[km->tree[0]].next->broadcast;
+
+        ipset_kmerge_advance(km);
+    }
+
+    *hi = h;
+    return 1;
+}
+
+void ipset_kmerge_free(IPSET_KMERGE *km) {
+    free(km->tree);
+    free(km->keys);
+    free(km->cursors);
+    km->tree = NULL;
+    km->keys = NULL;
+    km->cursors = NULL;
+    km->leaves = 0;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_kmerge_all()
+ *
+ * returns a new optimized ipset with the union of all the ipsets linked to
+ * 'next' from root; its lines are the sum of the lines of all of them
+ *
+ * returns NULL if memory cannot be allocated
+ *
+ */
+
+ipset *ipset_kmerge_all(ipset *root, const char *filename) {
+    IPSET_KMERGE km;
+    ipset *ips, *merged;
+    size_t largest = 0, lines = 0;
+    in_addr_t lo, hi;
+
+    if(unlikely(debug)) fprintf(stderr, "%s: Merging all ipsets to %s\n", PROG, filename);
+
+    if(unlikely(ipset_kmerge_init(&km, root)))
+        return NULL;
+
+    for(ips = root; ips; ips = ips->next) {
+        if(ips->entries > largest) largest = ips->entries;
+        if(unlikely(ipset_size_add_overflows(lines, ips->lines, &lines))) {
+            fprintf(stderr, "%s: Cannot merge ipset %s to %s safely: too many input lines\n", PROG, ips->filename, filename);
+            ipset_kmerge_free(&km);
+            return NULL;
+        }
+    }
+
+    /* the union has at least as many entries as the largest ipset */
+    merged = ipset_create(filename, largest);
+    if(unlikely(!merged)) {
+        fprintf(stderr, "%s: Cannot allocate memory for ipset %s\n", PROG, filename);
+        ipset_kmerge_free(&km);
+        return NULL;
+    }
+
+    while(ipset_kmerge_next(&km, &lo, &hi)) {
+        if(unlikely(merged->entries == merged->entries_max))
+            ipset_grow(merged, merged->entries);
+
+        merged->netaddrs[merged->entries].addr = lo;
+        merged->netaddrs[merged->entries].broadcast = hi;
+        merged->entries++;
+        merged->unique_ips += (uint64_t)hi - (uint64_t)lo + UINT64_C(1);
+    }
+
+    ipset_kmerge_free(&km);
+
+    merged->lines = lines;
+    merged->flags |= IPSET_FLAG_OPTIMIZED;
+    return merged;
+}
@@ -0,0 +1,21 @@
+#ifndef IPRANGE_IPSET_KMERGE_H
+#define IPRANGE_IPSET_KMERGE_H
+
+typedef struct ipset_kmerge_cursor {
+    const network_addr_t *next;
+    const network_addr_t *end;
+} IPSET_KMERGE_CURSOR;
+
+typedef struct ipset_kmerge {
+    size_t leaves;                  /* a power of 2, at least the inputs */
+    size_t *tree;                   /* the loser of each match, tree[0] is the winner */
+    uint64_t *keys;                 /* the address of each cursor, or IPSET_KMERGE_DONE */
+    IPSET_KMERGE_CURSOR *cursors;
+} IPSET_KMERGE;
+
+extern int ipset_kmerge_init(IPSET_KMERGE *km, ipset *root);
+extern int ipset_kmerge_next(IPSET_KMERGE *km, in_addr_t *lo, in_addr_t *hi);
+extern void ipset_kmerge_free(IPSET_KMERGE *km);
+extern ipset *ipset_kmerge_all(ipset *root, const char *filename);
+
+#endif //IPRANGE_IPSET_KMERGE_H
@@ -3,7 +3,6 @@
 #include "ipset6_binary.h"
 
 extern int active_family;
-extern unsigned long ipv6_dropped_in_ipv4_mode;
 
 /*
  * the maximum line element to read in input files
@@ -187,7 +186,8 @@ static inline IPSET_LINE_TYPE parse_line(char *line, int lineid, char *ipstr, ch
 
     /* the rest is comment */
     if(unlikely(*s == '#' || *s == ';')) {
-        fprintf(stderr, "%s: Ignoring text on line %d, expected an ip address after -, but found '%s'\n", PROG, lineid, s);
+        /* mapped lines end at their newline, not at a \0 */
+        fprintf(stderr, "%s: Ignoring text on line %d, expected an ip address after -, but found '%.*s'\n", PROG, lineid, (int)strcspn(s, "\r\n"), s);
         return LINE_HAS_1_IP;
     }
 
@@ -229,6 +229,430 @@ static inline IPSET_LINE_TYPE parse_line(char *line, int lineid, char *ipstr, ch
     return LINE_IS_INVALID;
 }
 
+/* ----------------------------------------------------------------------------
+ * ipset_load_line_fast()
+ *
+ * the common case: a line with a canonical IP, CIDR or range, optionally
+ * followed by a comment. The tokens are validated and converted while they
+ * are scanned, without copying them out of the line first.
+ *
+ * returns 1 when the line was loaded, 0 when it has to go through
+ * parse_line() and str2netaddr()
+ *
+ */
+
+static inline const char *skip_blanks(const char *s) {
+    while(*s == ' ' || *s == '\t') s++;
+    return s;
+}
+
+static inline int line_ends_here(const char *s) {
+    return (*s == '\n' || *s == '\0' || *s == '\r' || *s == '#' || *s == ';');
+}
+
+static inline int ipset_load_line_fast(ipset *ips, const char *line) {
+    network_addr_t netaddr1, netaddr2;
+    const char *s = skip_blanks(line);
+
+    s = ipv4_fast_parse(s, &netaddr1);
+    if(unlikely(!s)) return 0;
+
+    s = skip_blanks(s);
+    if(likely(line_ends_here(s))) {
+        ipset_add_ip_range(ips, netaddr1.addr, netaddr1.broadcast);
+        return 1;
+    }
+
+    if(unlikely(*s != '-')) return 0;
+
+    s = ipv4_fast_parse(skip_blanks(s + 1), &netaddr2);
+    if(unlikely(!s)) return 0;
+
+    if(unlikely(!line_ends_here(skip_blanks(s)))) return 0;
+
+    ipset_add_ip_range(ips,
+        (netaddr1.addr < netaddr2.addr)?netaddr1.addr:netaddr2.addr,
+        (netaddr1.broadcast > netaddr2.broadcast)?netaddr1.broadcast:netaddr2.broadcast);
+    return 1;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * the state of a text load in progress
+ */
+
+typedef struct ipset_load_state {
+    ipset *ips;
+    int parse_errors;
+    int dns_session;            /* set once this load owns the DNS session */
+    const void *dns_owner;      /* the load the DNS session is owned for */
+    unsigned long ipv6_dropped;
+} IPSET_LOAD_STATE;
+
+/* frees a failed load, giving up the DNS session if it owns it */
+static void ipset_load_abort(IPSET_LOAD_STATE *state) {
+    if(state->dns_session) {
+        dns_reset_stats();
+        dns_session_release(state->dns_owner);
+    }
+
+    ipset_free(state->ips);
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_load_line()
+ *
+ * parses a single line of input and adds whatever it finds to the ipset
+ * the line is terminated by \n or \0 and len is its length, including the \n
+ *
+ * returns 0 to continue loading, -1 when the whole load has to be aborted
+ *
+ */
+
+static int ipset_load_line(IPSET_LOAD_STATE *state, char *line, size_t len, int lineid) {
+    ipset *ips = state->ips;
+    char ipstr[MAX_INPUT_ELEMENT + 1], ipstr2[MAX_INPUT_ELEMENT + 1];
+
+    if(likely(ipset_load_line_fast(ips, line)))
+        return 0;
+
+    switch(parse_line(line, lineid, ipstr, ipstr2, MAX_INPUT_ELEMENT)) {
+        case LINE_IS_INVALID:
+        {
+            /* check if this is an IPv6 line in IPv4 mode:
+             * must have at least two colons (a:b or ::x) to be plausible IPv6 */
+            char *colon = memchr(line, ':', len);
+            char *colon2 = colon ? memchr(colon + 1, ':', len - (size_t)(colon + 1 - line)) : NULL;
+            if(colon2 && active_family != 6) {
+                /* try to extract IPv4 from mapped IPv6 (::ffff:x.x.x.x) */
+                char *s = line;
+                while(*s == ' ' || *s == '\t') s++;
+                if(s[0] == ':' && s[1] == ':' && (s[2] == 'f' || s[2] == 'F')
+                   && (s[3] == 'f' || s[3] == 'F') && (s[4] == 'f' || s[4] == 'F')
+                   && (s[5] == 'f' || s[5] == 'F') && s[6] == ':') {
+                    /* extract the IPv4 part after ::ffff: */
+                    char v4str[MAX_INPUT_ELEMENT + 1];
+                    int vi = 0;
+                    char *v4 = s + 7;
+                    while(vi < MAX_INPUT_ELEMENT && ((*v4 >= '0' && *v4 <= '9') || *v4 == '.' || *v4 == '/')) {
+                        v4str[vi] = *v4;
+                        vi++;
+                        v4++;
+                    }
+                    v4str[vi] = '\0';
+
+                    /* skip trailing whitespace/comment */
+                    while(*v4 == ' ' || *v4 == '\t') v4++;
+                    if(vi > 0 && (*v4 == '\0' || *v4 == '\n' || *v4 == '\r' || *v4 == '#' || *v4 == ';')) {
+                        if(ipset_add_ipstr(ips, v4str))
+                            break; /* successfully converted mapped IPv6 to IPv4 */
+                    }
+                }
+
+                /* non-mapped IPv6: drop gracefully with counter */
+                state->ipv6_dropped++;
+                break;
+            }
+
+            /* cannot read line */
+            fprintf(stderr, "%s: Cannot understand line No %d from %s: %.*s\n", PROG, lineid, ips->filename, (int)len, line);
+            state->parse_errors = 1;
+        }
+            break;
+
+        case LINE_IS_EMPTY:
+            /* nothing on this line */
+            break;
+
+        case LINE_HAS_1_IP:
+            /* 1 IP on this line */
+            if(unlikely(!ipset_add_ipstr(ips, ipstr))) {
+                fprintf(stderr, "%s: Cannot understand line No %d from %s: %.*s\n", PROG, lineid, ips->filename, (int)len, line);
+                state->parse_errors = 1;
+            }
+            break;
+
+        case LINE_HAS_2_IPS:
+            /* 2 IPs in range on this line */
+        {
+            int err = 0;
+            in_addr_t lo, hi;
+            network_addr_t netaddr1, netaddr2;
+            netaddr1 = str2netaddr(ipstr, &err);
+            if(likely(!err)) netaddr2 = str2netaddr(ipstr2, &err);
+            if(unlikely(err)) {
+                fprintf(stderr, "%s: Cannot understand line No %d from %s: %.*s\n", PROG, lineid, ips->filename, (int)len, line);
+                state->parse_errors = 1;
+                break;
+            }
+
+            lo = (netaddr1.addr < netaddr2.addr)?netaddr1.addr:netaddr2.addr;
+            hi = (netaddr1.broadcast > netaddr2.broadcast)?netaddr1.broadcast:netaddr2.broadcast;
+            ipset_add_ip_range(ips, lo, hi);
+        }
+            break;
+
+        case LINE_HAS_1_HOSTNAME:
+            if(unlikely(debug))
+                fprintf(stderr, "%s: DNS resolution for hostname '%s' from line %d of file %s.\n", PROG, ipstr, lineid, ips->filename);
+
+            if(unlikely(!state->dns_session)) {
+                dns_session_acquire(state->dns_owner);
+                state->dns_session = 1;
+            }
+
+            if(unlikely(dns_request(ips, ipstr)))
+                return -1;
+            break;
+
+        default:
+            fprintf(stderr, "%s: Cannot understand result code. This is an internal error.\n", PROG);
+            exit(exit_failure);
+            break;
+    }
+
+    return 0;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_load_mapped()
+ *
+ * parses a memory mapped text file in place
+ * lines are located with memchr() and handed to the parser without copying,
+ * so there is no limit on the length of a line
+ *
+ * lineid is the number of lines of the file before map
+ *
+ * returns 0 on success, -1 when the load has to be aborted
+ *
+ */
+
+static int ipset_load_mapped(IPSET_LOAD_STATE *state, char *map, size_t size, int lineid) {
+    char *s = map, *end = map + size;
+
+    while(s < end) {
+        char *nl = memchr(s, '\n', (size_t)(end - s));
+        size_t len;
+
+        lineid++;
+
+        if(likely(nl)) {
+            len = (size_t)(nl - s) + 1;
+            if(unlikely(ipset_load_line(state, s, len, lineid)))
+                return -1;
+        }
+        else {
+            /* the last line has no newline: terminate a copy of it */
+            int ret;
+            char *last;
+
+            len = (size_t)(end - s);
+            last = malloc(len + 1);
+            if(unlikely(!last)) {
+                fprintf(stderr, "%s: Cannot allocate memory (%zu bytes)\n", PROG, len + 1);
+                return -1;
+            }
+            memcpy(last, s, len);
+            last[len] = '\0';
+
+            ret = ipset_load_line(state, last, len, lineid);
+            free(last);
+            if(unlikely(ret))
+                return -1;
+        }
+
+        s += len;
+    }
+
+    return 0;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_load_mapped_parallel()
+ *
+ * parses a memory mapped text file on --threads threads
+ *
+ * the file is split into chunks at newlines. The newlines of each chunk are
+ * counted first, so that every chunk knows the line number it starts at and
+ * errors are reported at their exact line. Then each chunk is parsed into its
+ * own ipset and the chunks are appended to the result in file order.
+ *
+ * returns 0 on success, -1 when the load has to be aborted
+ *
+ */
+
+/* files smaller than this are parsed by the calling thread */
+#define IPSET_LOAD_PARALLEL_MIN_BYTES (1024 * 1024)
+
+/* the minimum size of a chunk */
+#define IPSET_LOAD_CHUNK_MIN_BYTES (256 * 1024)
+
+typedef struct ipset_load_chunk {
+    char *start;
+    size_t size;
+    int lineid;                 /* the lines before this chunk, then its own */
+    int ret;
+    IPSET_LOAD_STATE state;
+} IPSET_LOAD_CHUNK;
+
+static void ipset_load_chunk_count_lines(size_t job, void *data) {
+    IPSET_LOAD_CHUNK *c = &((IPSET_LOAD_CHUNK *)data)[job];
+    char *s = c->start, *end = c->start + c->size;
+    int lines = 0;
+
+    while(s < end && (s = memchr(s, '\n', (size_t)(end - s)))) {
+        lines++;
+        s++;
+    }
+
+    c->lineid = lines;
+}
+
+static void ipset_load_chunk_parse(size_t job, void *data) {
+    IPSET_LOAD_CHUNK *c = &((IPSET_LOAD_CHUNK *)data)[job];
+
+    c->ret = ipset_load_mapped(&c->state, c->start, c->size, c->lineid);
+}
+
+static int ipset_load_mapped_parallel(IPSET_LOAD_STATE *state, char *map, size_t size) {
+    IPSET_LOAD_CHUNK *chunks;
+    ipset *ips = state->ips;
+    size_t n, i, target, total = 0;
+    char *s, *end = map + size;
+    int lines, ret = 0;
+
+    n = (size_t)parallel_threads * 4;
+    if(n > size / IPSET_LOAD_CHUNK_MIN_BYTES) n = size / IPSET_LOAD_CHUNK_MIN_BYTES;
+    if(n < 2) return ipset_load_mapped(state, map, size, 0);
+
+    chunks = calloc(n, sizeof(IPSET_LOAD_CHUNK));
+    if(unlikely(!chunks)) return ipset_load_mapped(state, map, size, 0);
+
+    /* split the file right after the first newline following each target
+     * offset; a chunk is left empty when a long line crossed its target */
+    target = size / n;
+    for(i = 0, s = map; i < n; i++) {
+        char *e = end;
+
+        if(i < n - 1) {
+            char *t = map + target * (i + 1);
+
+            if(t >= s) {
+                e = memchr(t, '\n', (size_t)(end - t));
+                e = (e)?e + 1:end;
+            }
+            else
+                e = s;
+        }
+
+        chunks[i].start = s;
+        chunks[i].size = (size_t)(e - s);
+        s = e;
+    }
+
+    parallel_run("load count", n, ipset_load_chunk_count_lines, chunks);
+
+    for(i = 0, lines = 0; i < n; i++) {
+        int chunk_lines = chunks[i].lineid;
+
+        chunks[i].lineid = lines;
+        lines += chunk_lines;
+
+        chunks[i].state.dns_owner = state->dns_owner;
+        chunks[i].state.ips = ipset_create(ips->filename, 0);
+        if(unlikely(!chunks[i].state.ips)) ret = -1;
+        else chunks[i].state.ips->flags |= IPSET_FLAG_OPTIMIZED;
+    }
+
+    if(likely(!ret))
+        parallel_run("load parse", n, ipset_load_chunk_parse, chunks);
+
+    for(i = 0; i < n; i++) {
+        IPSET_LOAD_STATE *cs = &chunks[i].state;
+
+        if(chunks[i].ret) ret = -1;
+        if(cs->parse_errors) state->parse_errors = 1;
+        if(cs->dns_session) state->dns_session = 1;
+        state->ipv6_dropped += cs->ipv6_dropped;
+        if(cs->ips) total += cs->ips->entries;
+    }
+
+    if(likely(!ret))
+        ipset_grow(ips, total);
+
+    /* append the chunks in file order */
+    for(i = 0; i < n; i++) {
+        ipset *c = chunks[i].state.ips;
+        size_t first = 0, lines_before, entries;
+        uint64_t unique_before;
+
+        if(unlikely(!c)) continue;
+
+        if(likely(!ret && c->entries)) {
+            lines_before = ips->lines;
+            unique_before = ips->unique_ips;
+
+            /* the first entry may join or follow the last one appended */
+            if(ips->flags & IPSET_FLAG_OPTIMIZED) {
+                ipset_add_ip_range(ips, c->netaddrs[0].addr, c->netaddrs[0].broadcast);
+                first = 1;
+            }
+
+            if(!(c->flags & IPSET_FLAG_OPTIMIZED))
+                ips->flags &= ~IPSET_FLAG_OPTIMIZED;
+
+            entries = c->entries - first;
+            ipset_grow(ips, entries);
+            ipset_copy_entries(&ips->netaddrs[ips->entries], &c->netaddrs[first], entries);
+            ips->entries += entries;
+
+            ips->lines = lines_before + c->lines;
+            ips->unique_ips = unique_before + c->unique_ips;
+        }
+
+        ipset_free(c);
+    }
+
+    free(chunks);
+    return ret;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_map_file()
+ *
+ * memory maps a regular file for reading
+ * returns NULL when the file cannot (or should not) be mapped, in which case
+ * the caller should read it as a stream
+ *
+ */
+
+static char *ipset_map_file(FILE *fp, size_t *size) {
+    /* cppcheck-suppress y2038-unsafe-call -- only st_mode and st_size are read here. */
+    struct stat st;
+    void *map;
+    int fd = fileno(fp);
+
+    if(unlikely(fd < 0 || fstat(fd, &st) != 0)) return NULL;
+    if(!S_ISREG(st.st_mode) || st.st_size <= 0) return NULL;
+    if(unlikely((uintmax_t)st.st_size > (uintmax_t)SIZE_MAX)) return NULL;
+
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(unlikely(map == MAP_FAILED)) {
+        if(unlikely(debug))
+            fprintf(stderr, "%s: Cannot mmap() file, falling back to stream reading: %s\n", PROG, strerror(errno));
+        return NULL;
+    }
+
+    (void)posix_madvise(map, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+
+    *size = (size_t)st.st_size;
+    return map;
+}
+
 
 /* ----------------------------------------------------------------------------
  * ipset_load()
@@ -236,6 +660,9 @@ static inline IPSET_LINE_TYPE parse_line(char *line, int lineid, char *ipstr, ch
  * loads a file and stores all entries it finds to a new ipset it creates
  * if the filename is NULL, stdin is used
  *
+ * regular files are memory mapped and parsed in place, while stdin and pipes
+ * are read line by line
+ *
  * the result is not optimized. To optimize it call ipset_optimize().
  *
  */
@@ -243,12 +670,17 @@ static inline IPSET_LINE_TYPE parse_line(char *line, int lineid, char *ipstr, ch
 ipset *ipset_load(const char *filename) {
     FILE *fp = NULL;
     int lineid = 0;
-    int parse_errors = 0;
-    char line[MAX_LINE + 1], ipstr[MAX_INPUT_ELEMENT + 1], ipstr2[MAX_INPUT_ELEMENT + 1];
+    char line[MAX_LINE + 1];
+    char *map = NULL;
+    size_t map_size = 0;
+    IPSET_LOAD_STATE state = { NULL, 0, 0, NULL, 0 };
     ipset *ips = ipset_create((filename && *filename)?filename:"stdin", 0);
 
     if(unlikely(!ips)) return NULL;
 
+    state.ips = ips;
+    state.dns_owner = &state;
+
     if (likely(filename && *filename)) {
         fp = iprange_fopen_read(filename);
         if (unlikely(!fp)) {
@@ -298,122 +730,65 @@ ipset *ipset_load(const char *filename) {
         return NULL;
     }
 
-    do {
-        lineid++;
-
-        switch(parse_line(line, lineid, ipstr, ipstr2, MAX_INPUT_ELEMENT)) {
-            case LINE_IS_INVALID:
-            {
-                /* check if this is an IPv6 line in IPv4 mode:
-                 * must have at least two colons (a:b or ::x) to be plausible IPv6 */
-                char *colon = strchr(line, ':');
-                char *colon2 = colon ? strchr(colon + 1, ':') : NULL;
-                if(colon2 && active_family != 6) {
-                    /* try to extract IPv4 from mapped IPv6 (::ffff:x.x.x.x) */
-                    char *s = line;
-                    while(*s == ' ' || *s == '\t') s++;
-                    if(s[0] == ':' && s[1] == ':' && (s[2] == 'f' || s[2] == 'F')
-                       && (s[3] == 'f' || s[3] == 'F') && (s[4] == 'f' || s[4] == 'F')
-                       && (s[5] == 'f' || s[5] == 'F') && s[6] == ':') {
-                        /* extract the IPv4 part after ::ffff: */
-                        char v4str[MAX_INPUT_ELEMENT + 1];
-                        int vi = 0;
-                        char *v4 = s + 7;
-                        while(vi < MAX_INPUT_ELEMENT && ((*v4 >= '0' && *v4 <= '9') || *v4 == '.' || *v4 == '/')) {
-                            v4str[vi] = *v4;
-                            vi++;
-                            v4++;
-                        }
-                        v4str[vi] = '\0';
-
-                        /* skip trailing whitespace/comment */
-                        while(*v4 == ' ' || *v4 == '\t') v4++;
-                        if(vi > 0 && (*v4 == '\0' || *v4 == '\n' || *v4 == '\r' || *v4 == '#' || *v4 == ';')) {
-                            if(ipset_add_ipstr(ips, v4str))
-                                break; /* successfully converted mapped IPv6 to IPv4 */
-                        }
-                    }
+    if(likely(fp != stdin))
+        map = ipset_map_file(fp, &map_size);
 
-                    /* non-mapped IPv6: drop gracefully with counter */
-                    ipv6_dropped_in_ipv4_mode++;
-                    break;
-                }
+    if(map) {
+        struct timeval start_dt, stop_dt;
+        int ret;
 
-                /* cannot read line */
-                fprintf(stderr, "%s: Cannot understand line No %d from %s: %s\n", PROG, lineid, ips->filename, line);
-                parse_errors = 1;
-            }
-                break;
-
-            case LINE_IS_EMPTY:
-                /* nothing on this line */
-                break;
-
-            case LINE_HAS_1_IP:
-                /* 1 IP on this line */
-                if(unlikely(!ipset_add_ipstr(ips, ipstr))) {
-                    fprintf(stderr, "%s: Cannot understand line No %d from %s: %s\n", PROG, lineid, ips->filename, line);
-                    parse_errors = 1;
-                }
-                break;
+        gettimeofday(&start_dt, NULL);
 
-            case LINE_HAS_2_IPS:
-                /* 2 IPs in range on this line */
-            {
-                int err = 0;
-                in_addr_t lo, hi;
-                network_addr_t netaddr1, netaddr2;
-                netaddr1 = str2netaddr(ipstr, &err);
-                if(likely(!err)) netaddr2 = str2netaddr(ipstr2, &err);
-                if(unlikely(err)) {
-                    fprintf(stderr, "%s: Cannot understand line No %d from %s: %s\n", PROG, lineid, ips->filename, line);
-                    parse_errors = 1;
-                    continue;
-                }
+        /* the first line is parsed again, directly from the mapping */
+        /* files loaded by the jobs of a parallel load are parsed on their job's thread */
+        if(parallel_threads > 1 && !parallel_in_job() && map_size >= IPSET_LOAD_PARALLEL_MIN_BYTES)
+            ret = ipset_load_mapped_parallel(&state, map, map_size);
+        else
+            ret = ipset_load_mapped(&state, map, map_size, 0);
 
-                lo = (netaddr1.addr < netaddr2.addr)?netaddr1.addr:netaddr2.addr;
-                hi = (netaddr1.broadcast > netaddr2.broadcast)?netaddr1.broadcast:netaddr2.broadcast;
-                ipset_add_ip_range(ips, lo, hi);
-            }
-                break;
+        gettimeofday(&stop_dt, NULL);
+        munmap(map, map_size);
 
-            case LINE_HAS_1_HOSTNAME:
-                if(unlikely(debug))
-                    fprintf(stderr, "%s: DNS resolution for hostname '%s' from line %d of file %s.\n", PROG, ipstr, lineid, ips->filename);
+        if(unlikely(ret)) {
+            fclose(fp);
+            ipset_load_abort(&state);
+            return NULL;
+        }
 
-                if(unlikely(dns_request(ips, ipstr))) {
-                    if(likely(fp != stdin)) fclose(fp);
-                    dns_reset_stats();
-                    ipset_free(ips);
-                    return NULL;
-                }
-                break;
+        if(unlikely(debug)) {
+            double secs = ((double)(stop_dt.tv_sec  * 1000000 + stop_dt.tv_usec) - (double)(start_dt.tv_sec * 1000000 + start_dt.tv_usec)) / (double)1000000;
+            fprintf(stderr, "%s: Parsed %zu bytes of %s in %0.5f seconds (%0.3f GB/s)\n", PROG, map_size, ips->filename, secs, (secs > 0)?((double)map_size / secs / 1e9):0.0);
+        }
+    }
+    else do {
+        lineid++;
 
-            default:
-                fprintf(stderr, "%s: Cannot understand result code. This is an internal error.\n", PROG);
-                exit(1);
-                break;
+        if(unlikely(ipset_load_line(&state, line, strlen(line), lineid))) {
+            if(likely(fp != stdin)) fclose(fp);
+            ipset_load_abort(&state);
+            return NULL;
         }
-    } while(likely(ips && fgets(line, MAX_LINE, fp)));
+    } while(likely(fgets(line, MAX_LINE, fp)));
 
     if(likely(fp != stdin)) fclose(fp);
 
-    if(unlikely(dns_done(ips))) {
-        ipset_free(ips);
-        return NULL;
-    }
+    if(unlikely(state.dns_session)) {
+        int failed = dns_done(ips);
 
-    if(unlikely(!ips)) return NULL;
+        dns_session_release(state.dns_owner);
+        if(unlikely(failed)) {
+            ipset_free(ips);
+            return NULL;
+        }
+    }
 
-    if(unlikely(parse_errors)) {
+    if(unlikely(state.parse_errors)) {
         ipset_free(ips);
         return NULL;
     }
 
-    if(ipv6_dropped_in_ipv4_mode > 0) {
-        fprintf(stderr, "%s: %s: %lu IPv6 entries dropped (use -6 for IPv6 mode)\n", PROG, ips->filename, ipv6_dropped_in_ipv4_mode);
-        ipv6_dropped_in_ipv4_mode = 0;
-    }
+    if(state.ipv6_dropped > 0)
+        fprintf(stderr, "%s: %s: %lu IPv6 entries dropped (use -6 for IPv6 mode)\n", PROG, ips->filename, state.ipv6_dropped);
 
     if(unlikely(debug)) fprintf(stderr, "%s: Loaded %s %s\n", PROG, (ips->flags & IPSET_FLAG_OPTIMIZED)?"optimized":"non-optimized", ips->filename);
 
@@ -0,0 +1,293 @@
+#include "iprange.h"
+
+/*
+ * the membership table of some ipsets: the ranges where the set of ipsets
+ * that have an IP changes, each one with the set of ipsets it is in
+ *
+ * the ipsets are swept once with ipset_coverage_sweep(), keeping the bitmask
+ * of the ipsets of the ranges the sweep is in. The bitmasks of the ranges are
+ * interned, so each distinct one is kept once and the ranges only have its id.
+ */
+
+static uint32_t endianness = 0x1A2B3C4D;
+
+static inline uint64_t membership_hash(const uint64_t *mask, size_t words) {
+    uint64_t h = 0;
+    size_t i;
+
+    for(i = 0; i < words; i++) {
+        h ^= mask[i];
+        h *= UINT64_C(0x9E3779B97F4A7C15);
+        h ^= h >> 29;
+    }
+
+    return h;
+}
+
+/* doubles the index of the bitmasks and re-adds them */
+static int membership_grow_index(IPSET_MEMBERSHIP *m) {
+    size_t slots = m->slots ? m->slots * 2 : 64, id;
+    uint32_t *index = calloc(slots, sizeof(uint32_t));
+
+    if(unlikely(!index)) return -1;
+
+    for(id = 0; id < m->memberships; id++) {
+        size_t s = (size_t)membership_hash(&m->masks[id * m->words], m->words) & (slots - 1);
+
+        while(index[s]) s = (s + 1) & (slots - 1);
+        index[s] = (uint32_t)(id + 1);
+    }
+
+    free(m->index);
+    m->index = index;
+    m->slots = slots;
+    return 0;
+}
+
+/* the id of the bitmask given, adding it if it is new; -1 if memory cannot be allocated */
+static int64_t membership_intern(IPSET_MEMBERSHIP *m, const uint64_t *mask) {
+    size_t s;
+
+    if(unlikely((m->memberships + 1) * 2 > m->slots && membership_grow_index(m)))
+        return -1;
+
+    for(s = (size_t)membership_hash(mask, m->words) & (m->slots - 1); m->index[s]; s = (s + 1) & (m->slots - 1)) {
+        size_t id = m->index[s] - 1;
+
+        if(!memcmp(&m->masks[id * m->words], mask, m->words * sizeof(uint64_t)))
+            return (int64_t)id;
+    }
+
+    if(unlikely(m->memberships >= UINT32_MAX - 1)) {
+        fprintf(stderr, "%s: too many distinct memberships\n", PROG);
+        return -1;
+    }
+
+    if(m->memberships == m->memberships_max) {
+        size_t max = m->memberships_max ? m->memberships_max * 2 : 64;
+        uint64_t *masks = realloc(m->masks, max * m->words * sizeof(uint64_t));
+
+        if(unlikely(!masks)) return -1;
+        m->masks = masks;
+        m->memberships_max = max;
+    }
+
+    memcpy(&m->masks[m->memberships * m->words], mask, m->words * sizeof(uint64_t));
+    m->index[s] = (uint32_t)(m->memberships + 1);
+    return (int64_t)m->memberships++;
+}
+
+/* appends the range lo - hi with the bitmask given, joining it to the last one when possible */
+static int membership_add(IPSET_MEMBERSHIP *m, in_addr_t lo, in_addr_t hi, const uint64_t *mask) {
+    int64_t id = membership_intern(m, mask);
+
+    if(unlikely(id < 0)) return -1;
+
+    if(m->entries && m->records[m->entries - 1].id == (uint32_t)id
+       && (uint64_t)m->records[m->entries - 1].broadcast + 1 == lo) {
+        m->records[m->entries - 1].broadcast = hi;
+        return 0;
+    }
+
+    if(m->entries == m->entries_max) {
+        size_t max = m->entries_max ? m->entries_max * 2 : 1024;
+        membership_record_t *records = realloc(m->records, max * sizeof(membership_record_t));
+
+        if(unlikely(!records)) return -1;
+        m->records = records;
+        m->entries_max = max;
+    }
+
+    m->records[m->entries].addr = lo;
+    m->records[m->entries].broadcast = hi;
+    m->records[m->entries].id = (uint32_t)id;
+    m->entries++;
+    return 0;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_membership()
+ *
+ * it takes all the ipsets linked to 'next' from root
+ * it returns the membership table of their union: its disjoint ranges, in
+ * order, each one with the id of the set of ipsets that have all its IPs
+ *
+ * the table refers to the filenames of the ipsets, so it must be freed
+ * before them; it returns NULL if memory cannot be allocated
+ *
+ */
+
+typedef struct membership_sweep {
+    IPSET_MEMBERSHIP *m;
+    uint64_t *mask;                 /* the ipsets of the ranges in the sweep */
+    int failed;
+} MEMBERSHIP_SWEEP;
+
+static void membership_part(in_addr_t lo, in_addr_t hi, size_t depth, size_t id, void *data) {
+    MEMBERSHIP_SWEEP *ms = data;
+    (void)depth;
+    (void)id;
+
+    if(likely(!ms->failed) && unlikely(membership_add(ms->m, lo, hi, ms->mask)))
+        ms->failed = 1;
+}
+
+static void membership_enter(size_t id, void *data) {
+    MEMBERSHIP_SWEEP *ms = data;
+
+    ms->mask[id / 64] |= UINT64_C(1) << (id % 64);
+}
+
+static void membership_leave(size_t id, void *data) {
+    MEMBERSHIP_SWEEP *ms = data;
+
+    ms->mask[id / 64] &= ~(UINT64_C(1) << (id % 64));
+}
+
+IPSET_MEMBERSHIP *ipset_membership(ipset *root) {
+    MEMBERSHIP_SWEEP ms;
+    IPSET_MEMBERSHIP *m;
+    ipset *ips;
+    size_t ids = 0, i;
+
+    for(ips = root; ips; ips = ips->next) ids++;
+
+    if(unlikely(debug)) fprintf(stderr, "%s: Finding the membership of the ranges of %zu ipsets\n", PROG, ids);
+
+    m = calloc(1, sizeof(IPSET_MEMBERSHIP));
+    ms.mask = calloc((ids + 63) / 64 + 1, sizeof(uint64_t));
+
+    if(unlikely(!m || !ms.mask || !(m->names = malloc((ids ? ids : 1) * sizeof(char *))))) {
+        fprintf(stderr, "%s: Cannot allocate memory for the membership of %zu ipsets\n", PROG, ids);
+        free(ms.mask);
+        if(m) ipset_membership_free(m);
+        return NULL;
+    }
+
+    m->files = ids;
+    m->words = (ids + 63) / 64;
+
+    for(ips = root, i = 0; ips; ips = ips->next, i++)
+        m->names[i] = ips->filename;
+
+    ms.m = m;
+    ms.failed = 0;
+
+    if(unlikely(ipset_coverage_sweep(root, membership_part, membership_enter, membership_leave, &ms))) {
+        free(ms.mask);
+        ipset_membership_free(m);
+        return NULL;
+    }
+
+    free(ms.mask);
+
+    if(unlikely(ms.failed)) {
+        fprintf(stderr, "%s: Cannot allocate memory for the membership of %zu ipsets\n", PROG, ids);
+        ipset_membership_free(m);
+        return NULL;
+    }
+
+    if(unlikely(debug)) fprintf(stderr, "%s: %zu ranges with %zu distinct memberships\n", PROG, m->entries, m->memberships);
+
+    return m;
+}
+
+void ipset_membership_free(IPSET_MEMBERSHIP *m) {
+    free(m->names);
+    free(m->records);
+    free(m->masks);
+    free(m->index);
+    free(m);
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_membership_print()
+ *
+ * prints the table as CSV: the first and last IP of every range and the
+ * bitmask of its ipsets in hex, where the lowest bit is the first ipset
+ *
+ * with PRINT_BINARY it prints it in the membership binary format: a text
+ * header with the filenames, followed by the bitmasks of all the ids and the
+ * records (membership_record_t) of the ranges, in the native byte order
+ *
+ */
+
+static void membership_write_failed(void) {
+    fprintf(stderr, "%s: cannot write membership output: %s\n", PROG, strerror(errno));
+    exit(exit_failure);
+}
+
+static void membership_print_binary(IPSET_MEMBERSHIP *m) {
+    size_t i;
+
+    /* like binary ipsets, nothing is printed when it is empty */
+    if(!m->entries) return;
+
+    if(fputs(MEMBERSHIP_BINARY_HEADER_V10, stdout) == EOF) membership_write_failed();
+    if(fprintf(stdout, "files %zu\n", m->files) < 0) membership_write_failed();
+
+    for(i = 0; i < m->files; i++) {
+        const char *s;
+
+        /* a filename is a line of the header */
+        if(fputs("file ", stdout) == EOF) membership_write_failed();
+        for(s = m->names[i]; *s; s++)
+            if(putchar((*s == '\n' || *s == '\r') ? '?' : *s) == EOF) membership_write_failed();
+        if(putchar('\n') == EOF) membership_write_failed();
+    }
+
+    if(fprintf(stdout, "mask words %zu\n", m->words) < 0) membership_write_failed();
+    if(fprintf(stdout, "memberships %zu\n", m->memberships) < 0) membership_write_failed();
+    if(fprintf(stdout, "record size %zu\n", sizeof(membership_record_t)) < 0) membership_write_failed();
+    if(fprintf(stdout, "records %zu\n", m->entries) < 0) membership_write_failed();
+    if(fprintf(stdout, "bytes %zu\n", sizeof(uint32_t) + m->memberships * m->words * sizeof(uint64_t)
+               + m->entries * sizeof(membership_record_t)) < 0) membership_write_failed();
+    if(fwrite(&endianness, sizeof(uint32_t), 1, stdout) != 1) membership_write_failed();
+    if(fwrite(m->masks, sizeof(uint64_t) * m->words, m->memberships, stdout) != m->memberships) membership_write_failed();
+    if(fwrite(m->records, sizeof(membership_record_t), m->entries, stdout) != m->entries) membership_write_failed();
+    if(fflush(stdout) != 0) membership_write_failed();
+}
+
+void ipset_membership_print(IPSET_MEMBERSHIP *m, IPSET_PRINT_CMD print, int header) {
+    static const char hex[] = "0123456789abcdef";
+    size_t digits = m->files ? (m->files + 3) / 4 : 1, i, d;
+    char *text, buf[IP2STR_MAX_LEN + 1];
+
+    if(print == PRINT_BINARY) {
+        membership_print_binary(m);
+        return;
+    }
+
+    /* the bitmasks in hex, once for every id */
+    text = malloc((m->memberships ? m->memberships : 1) * (digits + 1));
+    if(unlikely(!text)) {
+        fprintf(stderr, "%s: Cannot allocate memory for printing %zu memberships\n", PROG, m->memberships);
+        exit(exit_failure);
+    }
+
+    for(i = 0; i < m->memberships; i++) {
+        const uint64_t *mask = &m->masks[i * m->words];
+        char *t = &text[i * (digits + 1)];
+
+        for(d = 0; d < digits; d++) {
+            size_t nibble = digits - 1 - d;
+            t[d] = hex[(mask[nibble / 16] >> ((nibble % 16) * 4)) & 0xf];
+        }
+        t[digits] = '\0';
+    }
+
+    if(unlikely(header)) fputs("first_ip,last_ip,membership\n", stdout);
+
+    for(i = 0; i < m->entries; i++) {
+        fputs(ip2str_r(buf, m->records[i].addr), stdout);
+        fputc(',', stdout);
+        fputs(ip2str_r(buf, m->records[i].broadcast), stdout);
+        fputc(',', stdout);
+        fputs(&text[m->records[i].id * (digits + 1)], stdout);
+        fputc('\n', stdout);
+    }
+
+    free(text);
+}
@@ -0,0 +1,39 @@
+#ifndef IPRANGE_IPSET_MEMBERSHIP_H
+#define IPRANGE_IPSET_MEMBERSHIP_H
+
+#define MEMBERSHIP_BINARY_HEADER_V10 "iprange membership binary format v1.0\n"
+
+/* a range of the table and the id of the files it is in */
+typedef struct membership_record {
+    in_addr_t addr;
+    in_addr_t broadcast;
+    uint32_t id;
+} membership_record_t;
+
+/*
+ * the disjoint ranges of the union of some ipsets, each one with the id of
+ * the set of ipsets it is in: the membership of id is the bitmask of words
+ * 64-bit words at masks + id * words, where bit i is the i-th ipset
+ */
+typedef struct ipset_membership {
+    size_t files;                   /* the number of ipsets */
+    const char **names;             /* their filenames */
+    size_t words;                   /* the 64-bit words of each bitmask */
+
+    size_t entries;
+    size_t entries_max;
+    membership_record_t *records;
+
+    size_t memberships;             /* the distinct bitmasks */
+    size_t memberships_max;
+    uint64_t *masks;
+
+    size_t slots;                   /* a power of 2, the size of the index */
+    uint32_t *index;                /* the ids of the bitmasks by hash, 0 is free */
+} IPSET_MEMBERSHIP;
+
+extern IPSET_MEMBERSHIP *ipset_membership(ipset *root);
+extern void ipset_membership_free(IPSET_MEMBERSHIP *m);
+extern void ipset_membership_print(IPSET_MEMBERSHIP *m, IPSET_PRINT_CMD print, int header);
+
+#endif //IPRANGE_IPSET_MEMBERSHIP_H
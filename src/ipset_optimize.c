@@ -22,6 +22,251 @@ int compar_netaddr(const void *p1, const void *p2) {
 
 }				/* compar_netaddr() */
 
+/* ----------------------------------------------------------------------------
+ * ipset_coalesce()
+ *
+ * merges overlapping and adjacent entries of a sorted array in place
+ * returns the number of entries left at the beginning of the array
+ *
+ */
+
+static size_t ipset_coalesce(network_addr_t *addrs, size_t n) {
+    size_t i, w = 0;
+
+    if(unlikely(!n)) return 0;
+
+    for(i = 1; i < n; i++) {
+        /* it fits entirely inside the current */
+        if(addrs[i].broadcast <= addrs[w].broadcast)
+            continue;
+
+        /* it overlaps or is adjacent to the current: extend the current */
+        if(addrs[i].addr <= addrs[w].broadcast || (addrs[w].broadcast != UINT32_MAX && addrs[i].addr == addrs[w].broadcast + 1)) {
+            addrs[w].broadcast = addrs[i].broadcast;
+            continue;
+        }
+
+        addrs[++w] = addrs[i];
+    }
+
+    return w + 1;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_optimize_parallel()
+ *
+ * sorts and coalesces a large ipset on --threads threads
+ *
+ * the entries are split into buckets of address ranges, using splitters
+ * picked from a sorted sample of the addresses. Each bucket is then sorted
+ * and coalesced on its own, and finally the buckets are stitched together
+ * with the same rules: a range of one bucket may contain, overlap or be
+ * adjacent to the first ranges of the next ones.
+ *
+ * it needs a scratch array as big as the ipset; returns -1 when this cannot
+ * be allocated (the ipset is left untouched), 0 on success
+ *
+ */
+
+/* ipsets with at least this many entries are optimized in parallel */
+size_t ipset_optimize_parallel_min = 1024 * 1024;
+
+#define OPTIMIZE_SAMPLES_PER_BUCKET 64
+
+typedef struct optimize_job {
+    network_addr_t *src;        /* the unsorted entries */
+    network_addr_t *dst;        /* the entries scattered to buckets */
+    size_t entries;
+    size_t slices;              /* the input is scattered in slices */
+    size_t buckets;
+    in_addr_t *splitters;       /* buckets - 1 splitters */
+    size_t *counts;             /* slices x buckets: counts, then offsets */
+    size_t *bucket_start;       /* buckets + 1 */
+    size_t *bucket_entries;     /* the entries of each bucket, once coalesced */
+} OPTIMIZE_JOB;
+
+static int compar_in_addr(const void *p1, const void *p2) {
+    in_addr_t a1 = *(const in_addr_t *)p1, a2 = *(const in_addr_t *)p2;
+
+    return (a1 > a2) - (a1 < a2);
+}
+
+static inline size_t optimize_bucket(OPTIMIZE_JOB *oj, in_addr_t addr) {
+    size_t lo = 0, hi = oj->buckets - 1;
+
+    /* the number of splitters <= addr */
+    while(lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if(oj->splitters[mid] <= addr) lo = mid + 1;
+        else hi = mid;
+    }
+
+    return lo;
+}
+
+static inline void optimize_slice(OPTIMIZE_JOB *oj, size_t slice, size_t *from, size_t *to) {
+    *from = oj->entries * slice / oj->slices;
+    *to = oj->entries * (slice + 1) / oj->slices;
+}
+
+static void optimize_count_job(size_t slice, void *data) {
+    OPTIMIZE_JOB *oj = data;
+    size_t *counts = &oj->counts[slice * oj->buckets];
+    size_t i, from, to;
+
+    optimize_slice(oj, slice, &from, &to);
+    for(i = from; i < to; i++)
+        counts[optimize_bucket(oj, oj->src[i].addr)]++;
+}
+
+static void optimize_scatter_job(size_t slice, void *data) {
+    OPTIMIZE_JOB *oj = data;
+    size_t *offsets = &oj->counts[slice * oj->buckets];
+    size_t i, from, to;
+
+    optimize_slice(oj, slice, &from, &to);
+    for(i = from; i < to; i++)
+        oj->dst[offsets[optimize_bucket(oj, oj->src[i].addr)]++] = oj->src[i];
+}
+
+static void optimize_bucket_job(size_t bucket, void *data) {
+    OPTIMIZE_JOB *oj = data;
+    size_t start = oj->bucket_start[bucket];
+    size_t n = oj->bucket_start[bucket + 1] - start;
+
+    /* the same range of the source array is free to be used as scratch */
+    ipset_sort_scratch(&oj->dst[start], n, &oj->src[start]);
+    oj->bucket_entries[bucket] = ipset_coalesce(&oj->dst[start], n);
+}
+
+static int ipset_optimize_parallel(ipset *ips) {
+    OPTIMIZE_JOB oj;
+    network_addr_t *out;
+    size_t i, b, samples, w = 0;
+    in_addr_t *sample;
+
+    oj.src = ips->netaddrs;
+    oj.entries = ips->entries;
+    oj.buckets = (size_t)parallel_threads * 4;
+    oj.slices = oj.buckets;
+    samples = oj.buckets * OPTIMIZE_SAMPLES_PER_BUCKET;
+
+    oj.dst = malloc(oj.entries * sizeof(network_addr_t));
+    oj.splitters = malloc(oj.buckets * sizeof(in_addr_t));
+    oj.counts = calloc(oj.slices * oj.buckets, sizeof(size_t));
+    oj.bucket_start = calloc(oj.buckets + 1, sizeof(size_t));
+    oj.bucket_entries = calloc(oj.buckets, sizeof(size_t));
+    sample = malloc(samples * sizeof(in_addr_t));
+
+    if(unlikely(!oj.dst || !oj.splitters || !oj.counts || !oj.bucket_start || !oj.bucket_entries || !sample)) {
+        free(oj.dst);
+        free(oj.splitters);
+        free(oj.counts);
+        free(oj.bucket_start);
+        free(oj.bucket_entries);
+        free(sample);
+        return -1;
+    }
+
+    /* pick the splitters from an evenly spaced sample of the addresses */
+    for(i = 0; i < samples; i++)
+        sample[i] = oj.src[(oj.entries - 1) * i / (samples - 1)].addr;
+
+    qsort(sample, samples, sizeof(in_addr_t), compar_in_addr);
+
+    for(b = 1; b < oj.buckets; b++)
+        oj.splitters[b - 1] = sample[b * samples / oj.buckets];
+
+    free(sample);
+
+    /* scatter the entries to the buckets */
+    parallel_run("optimize count", oj.slices, optimize_count_job, &oj);
+
+    for(b = 0, w = 0; b < oj.buckets; b++) {
+        oj.bucket_start[b] = w;
+        for(i = 0; i < oj.slices; i++) {
+            size_t count = oj.counts[i * oj.buckets + b];
+            oj.counts[i * oj.buckets + b] = w;
+            w += count;
+        }
+    }
+    oj.bucket_start[oj.buckets] = w;
+
+    parallel_run("optimize scatter", oj.slices, optimize_scatter_job, &oj);
+
+    /* sort and coalesce each bucket */
+    parallel_run("optimize sort", oj.buckets, optimize_bucket_job, &oj);
+
+    /* stitch the buckets back to the original array */
+    out = oj.src;
+    w = 0;
+    for(b = 0; b < oj.buckets; b++) {
+        network_addr_t *bucket = &oj.dst[oj.bucket_start[b]];
+        size_t n = oj.bucket_entries[b];
+
+        for(i = 0; i < n && w > 0; i++) {
+            network_addr_t *last = &out[w - 1];
+
+            if(bucket[i].broadcast <= last->broadcast)
+                continue;
+
+            if(bucket[i].addr <= last->broadcast || (last->broadcast != UINT32_MAX && bucket[i].addr == last->broadcast + 1)) {
+                last->broadcast = bucket[i].broadcast;
+                continue;
+            }
+
+            break;
+        }
+
+        /* the rest of the bucket is already coalesced and after the last */
+        ipset_copy_entries(&out[w], &bucket[i], n - i);
+        w += n - i;
+    }
+
+    ips->entries = w;
+
+    free(oj.dst);
+    free(oj.splitters);
+    free(oj.counts);
+    free(oj.bucket_start);
+    free(oj.bucket_entries);
+    return 0;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_optimize_finish()
+ *
+ * after the entries have been coalesced in place, it recalculates the unique
+ * IPs, gives back the memory of the entries that are no longer used and flags
+ * the ipset as optimized
+ * the number of lines is not changed: it is the number of lines loaded
+ *
+ */
+
+static void ipset_optimize_finish(ipset *ips) {
+    network_addr_t *naddrs;
+    uint64_t unique_ips = 0;
+    size_t i;
+
+    for(i = 0; i < ips->entries; i++)
+        unique_ips += (uint64_t)ips->netaddrs[i].broadcast - (uint64_t)ips->netaddrs[i].addr + UINT64_C(1);
+
+    ips->unique_ips = unique_ips;
+    ips->flags |= IPSET_FLAG_OPTIMIZED;
+
+    if(ips->entries < ips->entries_max) {
+        /* if shrinking fails, the bigger allocation is still valid */
+        naddrs = realloc(ips->netaddrs, ips->entries * sizeof(network_addr_t));
+        if(likely(naddrs)) {
+            ips->netaddrs = naddrs;
+            ips->entries_max = ips->entries;
+        }
+    }
+}
+
+
 /* ----------------------------------------------------------------------------
  * ipset_optimize()
  *
@@ -33,10 +278,7 @@ int compar_netaddr(const void *p1, const void *p2) {
  */
 
 inline void ipset_optimize(ipset *ips) {
-    network_addr_t *naddrs;
-    size_t i, n = ips->entries, lines = ips->lines;
-    network_addr_t *oaddrs = ips->netaddrs;
-    in_addr_t lo, hi;
+    size_t n = ips->entries;
 
     if(unlikely(ips->flags & IPSET_FLAG_OPTIMIZED)) {
         if(unlikely(debug))
@@ -52,59 +294,34 @@ inline void ipset_optimize(ipset *ips) {
         return;
     }
 
-    /* sort it */
-    qsort((void *)ips->netaddrs, ips->entries, sizeof(network_addr_t), compar_netaddr);
+    if(n >= ipset_bitmap_min) {
+        if(unlikely(debug)) fprintf(stderr, "%s: Optimizing %s with a bitmap\n", PROG, ips->filename);
+
+        if(likely(!ipset_bitmap_optimize(ips))) {
+            ipset_optimize_finish(ips);
+            return;
+        }
 
-    /* optimize it in a new space */
-    naddrs = malloc(ips->entries * sizeof(network_addr_t));
-    if(unlikely(!naddrs)) {
-        fprintf(stderr, "%s: Cannot allocate memory (%zu bytes)\n", PROG, n * sizeof(network_addr_t));
-        exit(1);
+        if(unlikely(debug)) fprintf(stderr, "%s: Cannot allocate memory for the bitmap of %s\n", PROG, ips->filename);
     }
 
-    ips->netaddrs = naddrs;
-    ips->entries = 0;
-    ips->unique_ips = 0;
-    ips->lines = 0;
-
-    lo = oaddrs[0].addr;
-    hi = oaddrs[0].broadcast;
-    for (i = 1; i < n; i++) {
-        /*
-         * if the broadcast of this
-         * is before the broadcast of the last
-         * then skip it = it fits entirely inside the current
-         */
-        if (oaddrs[i].broadcast <= hi)
-            continue;
+    if(parallel_threads > 1 && n >= ipset_optimize_parallel_min) {
+        if(unlikely(debug)) fprintf(stderr, "%s: Optimizing %s on %d threads\n", PROG, ips->filename, parallel_threads);
 
-        /*
-         * if the network addr of this
-         * overlaps or is adjustent to the last
-         * then merge it = extent the broadcast of the last
-         */
-        if (oaddrs[i].addr <= hi || (hi != UINT32_MAX && oaddrs[i].addr == hi + 1)) {
-            hi = oaddrs[i].broadcast;
-            continue;
+        if(likely(!ipset_optimize_parallel(ips))) {
+            ipset_optimize_finish(ips);
+            return;
         }
 
-        /*
-         * at this point we are sure the old lo, hi
-         * do not overlap and are not adjustent to the current
-         * so, add the last to the new set
-         */
-        ipset_add_ip_range(ips, lo, hi);
-
-        /* prepare for the next loop */
-        lo = oaddrs[i].addr;
-        hi = oaddrs[i].broadcast;
+        if(unlikely(debug)) fprintf(stderr, "%s: Cannot allocate memory for parallel optimization of %s\n", PROG, ips->filename);
     }
-    ipset_add_ip_range(ips, lo, hi);
-    ips->lines = lines;
 
-    ips->flags |= IPSET_FLAG_OPTIMIZED;
+    /* sort it */
+    ipset_sort(ips->netaddrs, ips->entries);
 
-    free(oaddrs);
+    /* optimize it in place */
+    ips->entries = ipset_coalesce(ips->netaddrs, n);
+    ipset_optimize_finish(ips);
 }
 
 /* ----------------------------------------------------------------------------
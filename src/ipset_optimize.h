@@ -1,6 +1,9 @@
 #ifndef IPRANGE_IPSET_OPTIMIZE_H
 #define IPRANGE_IPSET_OPTIMIZE_H
 
+extern size_t ipset_optimize_parallel_min;
+
+extern int compar_netaddr(const void *p1, const void *p2);
 extern void ipset_optimize(ipset *ips);
 extern void ipset_optimize_all(ipset *root);
 
@@ -0,0 +1,381 @@
+#include "iprange.h"
+
+char *ipset_output_pos = NULL;
+char *ipset_output_limit = NULL;
+
+IPSET_OUTPUT_STRING ipset_output_prefix_ips = { "", 0 };
+IPSET_OUTPUT_STRING ipset_output_prefix_nets = { "", 0 };
+IPSET_OUTPUT_STRING ipset_output_suffix_ips = { "", 0 };
+IPSET_OUTPUT_STRING ipset_output_suffix_nets = { "", 0 };
+
+char ipset_output_octets[256][4];
+
+static char *output_buffer = NULL;
+static size_t output_size = 0;
+
+/* the room a line may need past the limit of a buffer */
+static size_t output_line_max = 0;
+
+typedef struct output_chunk {
+    struct output_chunk *next;
+    size_t len;
+    char data[];
+} OUTPUT_CHUNK;
+
+typedef struct output_slice {
+    OUTPUT_CHUNK *first;        /* formatted, waiting to be written */
+    OUTPUT_CHUNK *last;
+    size_t lines;
+    int done;
+} OUTPUT_SLICE;
+
+typedef struct output_pipeline {
+    IPSET_OUTPUT_FORMAT format;
+    void *data;
+
+    OUTPUT_SLICE *slices;
+    size_t n;
+    size_t head;                /* the slice being written */
+
+    OUTPUT_CHUNK *free;
+    size_t free_count;
+
+    pthread_mutex_t mut;
+    pthread_cond_t cond;
+} OUTPUT_PIPELINE;
+
+typedef struct output_worker {
+    IPSET_OUTPUT_SINK sink;
+    OUTPUT_PIPELINE *pl;
+    size_t slice;
+    OUTPUT_CHUNK *chunk;
+} OUTPUT_WORKER;
+
+static void output_write_failed(void) {
+    fprintf(stderr, "%s: cannot write output: %s\n", PROG, strerror(errno));
+    exit(exit_failure);
+}
+
+static void output_write(const char *p, size_t len) {
+    const char *end = p + len;
+
+    while(p < end) {
+        ssize_t written = write(STDOUT_FILENO, p, (size_t)(end - p));
+
+        if(unlikely(written < 0)) {
+            if(errno == EINTR) continue;
+            output_write_failed();
+        }
+
+        p += written;
+    }
+}
+
+static void output_resolve(IPSET_OUTPUT_STRING *s, const char *text, size_t *longest) {
+    s->s = text ? text : "";
+    s->len = strlen(s->s);
+    if(s->len > *longest) *longest = s->len;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_output_begin(), ipset_output_begin_with()
+ *
+ * prepares the buffer for the lines of an ipset: the output already given
+ * to stdio is written first, so that it stays before them, and the prefix
+ * and suffix strings are resolved once: --print-prefix-ips and the rest,
+ * or the ones given to ipset_output_begin_with()
+ *
+ */
+
+void ipset_output_begin(void) {
+    ipset_output_begin_with(print_prefix_ips, print_prefix_nets, print_suffix_ips, print_suffix_nets);
+}
+
+void ipset_output_begin_with(const char *prefix_ips, const char *prefix_nets, const char *suffix_ips, const char *suffix_nets) {
+    size_t longest = 0, size;
+    unsigned int i;
+
+    if(fflush(stdout) != 0) output_write_failed();
+
+    output_resolve(&ipset_output_prefix_ips, prefix_ips, &longest);
+    output_resolve(&ipset_output_prefix_nets, prefix_nets, &longest);
+    output_resolve(&ipset_output_suffix_ips, suffix_ips, &longest);
+    output_resolve(&ipset_output_suffix_nets, suffix_nets, &longest);
+
+    /* the longest line: a prefix, 2 addresses, a suffix and the newline */
+    output_line_max = 2 * longest + 2 * IPSET_OUTPUT_ADDR_MAX + 2;
+    size = IPSET_OUTPUT_BUFFER + output_line_max;
+
+    if(size > output_size) {
+        char *buffer = realloc(output_buffer, size);
+
+        if(unlikely(!buffer)) {
+            fprintf(stderr, "%s: Cannot allocate %zu bytes for the output\n", PROG, size);
+            exit(exit_failure);
+        }
+
+        output_buffer = buffer;
+        output_size = size;
+    }
+
+    if(!ipset_output_octets[255][3]) {
+        for(i = 0; i < 256; i++) {
+            char *p = ipset_output_octets[i];
+
+            if(i >= 100) *p++ = (char)('0' + i / 100);
+            if(i >= 10) *p++ = (char)('0' + (i / 10) % 10);
+            *p++ = (char)('0' + i % 10);
+            ipset_output_octets[i][3] = (char)(p - ipset_output_octets[i]);
+        }
+    }
+
+    ipset_output_pos = output_buffer;
+    ipset_output_limit = output_buffer + IPSET_OUTPUT_BUFFER;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_output_flush()
+ *
+ * writes the lines in the buffer to stdout
+ *
+ */
+
+void ipset_output_flush(void) {
+    output_write(output_buffer, (size_t)(ipset_output_pos - output_buffer));
+    ipset_output_pos = output_buffer;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_output_finish()
+ *
+ * writes the rest of the lines, after the last of an ipset
+ *
+ */
+
+void ipset_output_finish(void) {
+    ipset_output_flush();
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_output_sink_begin(), ipset_output_sink_end()
+ *
+ * a sink that writes to the output buffer, from ipset_output_pos; the lines
+ * formatted to it are in the buffer once ipset_output_sink_end() is called
+ *
+ */
+
+static void output_sink_flush(IPSET_OUTPUT_SINK *sink) {
+    ipset_output_pos = sink->pos;
+    ipset_output_flush();
+    sink->pos = ipset_output_pos;
+}
+
+void ipset_output_sink_begin(IPSET_OUTPUT_SINK *sink) {
+    sink->pos = ipset_output_pos;
+    sink->limit = ipset_output_limit;
+    sink->flush = output_sink_flush;
+    sink->data = NULL;
+}
+
+void ipset_output_sink_end(IPSET_OUTPUT_SINK *sink) {
+    ipset_output_pos = sink->pos;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * the pipeline of ipset_output_parallel()
+ *
+ * the chunks come from a fixed pool, so the memory does not depend on the
+ * size of the output. A slice that is not being written may only take a
+ * chunk when that leaves one free, so the slice being written can always
+ * get one and the pipeline cannot stall.
+ *
+ */
+
+static OUTPUT_CHUNK *output_chunk_get(OUTPUT_PIPELINE *pl, size_t slice) {
+    OUTPUT_CHUNK *chunk;
+
+    pthread_mutex_lock(&pl->mut);
+    while(pl->free_count <= ((slice == pl->head) ? 0U : 1U))
+        pthread_cond_wait(&pl->cond, &pl->mut);
+
+    chunk = pl->free;
+    pl->free = chunk->next;
+    pl->free_count--;
+    pthread_mutex_unlock(&pl->mut);
+
+    chunk->next = NULL;
+    chunk->len = 0;
+    return chunk;
+}
+
+/* gives the chunk to the writer, or back to the pool when it is empty */
+static void output_chunk_put(OUTPUT_PIPELINE *pl, size_t slice, OUTPUT_CHUNK *chunk, int done, size_t lines) {
+    OUTPUT_SLICE *sl = &pl->slices[slice];
+
+    pthread_mutex_lock(&pl->mut);
+    if(chunk->len) {
+        if(sl->last) sl->last->next = chunk;
+        else sl->first = chunk;
+        sl->last = chunk;
+    }
+    else {
+        chunk->next = pl->free;
+        pl->free = chunk;
+        pl->free_count++;
+    }
+
+    if(done) {
+        sl->done = 1;
+        sl->lines = lines;
+    }
+
+    pthread_cond_broadcast(&pl->cond);
+    pthread_mutex_unlock(&pl->mut);
+}
+
+static void output_worker_flush(IPSET_OUTPUT_SINK *sink) {
+    OUTPUT_WORKER *w = sink->data;
+
+    w->chunk->len = (size_t)(sink->pos - w->chunk->data);
+    output_chunk_put(w->pl, w->slice, w->chunk, 0, 0);
+
+    w->chunk = output_chunk_get(w->pl, w->slice);
+    sink->pos = w->chunk->data;
+    sink->limit = w->chunk->data + IPSET_OUTPUT_CHUNK;
+}
+
+static void output_format_job(size_t slice, void *data) {
+    OUTPUT_PIPELINE *pl = data;
+    OUTPUT_WORKER w;
+    size_t lines;
+
+    w.pl = pl;
+    w.slice = slice;
+    w.chunk = output_chunk_get(pl, slice);
+    w.sink.pos = w.chunk->data;
+    w.sink.limit = w.chunk->data + IPSET_OUTPUT_CHUNK;
+    w.sink.flush = output_worker_flush;
+    w.sink.data = &w;
+
+    lines = pl->format(slice, &w.sink, pl->data);
+
+    w.chunk->len = (size_t)(w.sink.pos - w.chunk->data);
+    output_chunk_put(pl, slice, w.chunk, 1, lines);
+}
+
+/* writes the chunks of the slices in order, as soon as they are formatted */
+static void *output_writer(void *ptr) {
+    OUTPUT_PIPELINE *pl = ptr;
+
+    pthread_mutex_lock(&pl->mut);
+    while(pl->head < pl->n) {
+        OUTPUT_SLICE *sl = &pl->slices[pl->head];
+
+        if(sl->first) {
+            OUTPUT_CHUNK *chunk = sl->first;
+
+            sl->first = chunk->next;
+            if(!sl->first) sl->last = NULL;
+            pthread_mutex_unlock(&pl->mut);
+
+            output_write(chunk->data, chunk->len);
+
+            pthread_mutex_lock(&pl->mut);
+            chunk->next = pl->free;
+            pl->free = chunk;
+            pl->free_count++;
+            pthread_cond_broadcast(&pl->cond);
+        }
+        else if(sl->done) {
+            pl->head++;
+            pthread_cond_broadcast(&pl->cond);
+        }
+        else
+            pthread_cond_wait(&pl->cond, &pl->mut);
+    }
+    pthread_mutex_unlock(&pl->mut);
+
+    return NULL;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_output_parallel()
+ *
+ * formats slices 0 to slices - 1 on parallel threads, by calling format()
+ * for each of them with a sink of its own, while a writer thread writes
+ * their lines to stdout in the order of the slices, so the output is the
+ * same as formatting them one after the other
+ *
+ * it must be called between ipset_output_begin() and ipset_output_finish(),
+ * with nothing left in the output buffer. The lines of all the slices are
+ * added to *lines.
+ *
+ * returns non-zero, without formatting anything, when the threads or their
+ * memory are not available; the caller should then format them itself
+ *
+ */
+
+int ipset_output_parallel(const char *what, size_t slices, IPSET_OUTPUT_FORMAT format, void *data, size_t *lines) {
+    OUTPUT_PIPELINE pl;
+    pthread_t writer;
+    size_t i, threads = (parallel_threads > 1) ? (size_t)parallel_threads : 1, chunks = threads * IPSET_OUTPUT_CHUNKS_PER_THREAD;
+    int ret = 0;
+
+    pl.format = format;
+    pl.data = data;
+    pl.n = slices;
+    pl.head = 0;
+    pl.free = NULL;
+    pl.free_count = 0;
+
+    pl.slices = calloc(slices, sizeof(OUTPUT_SLICE));
+    if(unlikely(!pl.slices)) return -1;
+
+    for(i = 0; i < chunks; i++) {
+        OUTPUT_CHUNK *chunk = malloc(sizeof(OUTPUT_CHUNK) + IPSET_OUTPUT_CHUNK + output_line_max);
+
+        if(unlikely(!chunk)) {
+            ret = -1;
+            break;
+        }
+
+        chunk->next = pl.free;
+        pl.free = chunk;
+        pl.free_count++;
+    }
+
+    pthread_mutex_init(&pl.mut, NULL);
+    pthread_cond_init(&pl.cond, NULL);
+
+    if(likely(!ret) && pthread_create(&writer, NULL, output_writer, &pl)) {
+        fprintf(stderr, "%s: %s: cannot create the writer thread, running on one.\n", PROG, what);
+        ret = -1;
+    }
+
+    if(likely(!ret)) {
+        if(unlikely(debug)) fprintf(stderr, "%s: %s: formatting %zu slices on %zu threads\n", PROG, what, slices, threads);
+
+        parallel_run(what, slices, output_format_job, &pl);
+        pthread_join(writer, NULL);
+
+        for(i = 0; i < slices; i++)
+            *lines += pl.slices[i].lines;
+    }
+
+    while(pl.free) {
+        OUTPUT_CHUNK *chunk = pl.free;
+        pl.free = chunk->next;
+        free(chunk);
+    }
+
+    pthread_cond_destroy(&pl.cond);
+    pthread_mutex_destroy(&pl.mut);
+    free(pl.slices);
+    return ret;
+}
@@ -0,0 +1,114 @@
+#ifndef IPRANGE_IPSET_OUTPUT_H
+#define IPRANGE_IPSET_OUTPUT_H
+
+/*
+ * the text output of the ipsets goes to a large buffer, written to stdout
+ * with write() when it fills up, instead of printf() per line
+ *
+ * the buffer has room for a whole line after its limit, so a line is
+ * formatted at ipset_output_pos without checking for room, and the buffer
+ * is written when the line ends past the limit
+ */
+
+#define IPSET_OUTPUT_BUFFER (1024 * 1024)
+
+/* the buffers of ipset_output_parallel(), and how many of them each thread gets */
+#define IPSET_OUTPUT_CHUNK (256 * 1024)
+#define IPSET_OUTPUT_CHUNKS_PER_THREAD 4
+
+/* the room for an address (IPv4 or IPv6) with its prefix */
+#define IPSET_OUTPUT_ADDR_MAX 64
+
+typedef struct ipset_output_string {
+    const char *s;
+    size_t len;
+} IPSET_OUTPUT_STRING;
+
+extern char *ipset_output_pos;
+extern char *ipset_output_limit;
+
+/* --print-prefix-ips, --print-prefix-nets, --print-suffix-ips, --print-suffix-nets */
+extern IPSET_OUTPUT_STRING ipset_output_prefix_ips;
+extern IPSET_OUTPUT_STRING ipset_output_prefix_nets;
+extern IPSET_OUTPUT_STRING ipset_output_suffix_ips;
+extern IPSET_OUTPUT_STRING ipset_output_suffix_nets;
+
+/* the text of 0 .. 255 in the first 3 bytes, and its length in the last */
+extern char ipset_output_octets[256][4];
+
+/*
+ * a sink is where a formatter writes its lines, without knowing if they go
+ * to the output buffer or to a buffer of ipset_output_parallel(): a line is
+ * formatted at pos, and flush() makes room when it ends past limit
+ */
+typedef struct ipset_output_sink {
+    char *pos;
+    char *limit;
+    void (*flush)(struct ipset_output_sink *sink);
+    void *data;
+} IPSET_OUTPUT_SINK;
+
+/* formats the lines of slice to sink, and returns how many they are */
+typedef size_t (*IPSET_OUTPUT_FORMAT)(size_t slice, IPSET_OUTPUT_SINK *sink, void *data);
+
+extern void ipset_output_begin(void);
+extern void ipset_output_begin_with(const char *prefix_ips, const char *prefix_nets, const char *suffix_ips, const char *suffix_nets);
+extern void ipset_output_flush(void);
+extern void ipset_output_finish(void);
+
+extern void ipset_output_sink_begin(IPSET_OUTPUT_SINK *sink);
+extern void ipset_output_sink_end(IPSET_OUTPUT_SINK *sink);
+
+extern int ipset_output_parallel(const char *what, size_t slices, IPSET_OUTPUT_FORMAT format, void *data, size_t *lines);
+
+/* the line formatted at ipset_output_pos ends at p */
+static inline void ipset_output_commit(char *p) {
+    ipset_output_pos = p;
+    if(unlikely(p >= ipset_output_limit)) ipset_output_flush();
+}
+
+/* the line formatted at sink->pos ends at p */
+static inline void ipset_output_sink_commit(IPSET_OUTPUT_SINK *sink, char *p) {
+    sink->pos = p;
+    if(unlikely(p >= sink->limit)) sink->flush(sink);
+}
+
+static inline char *ipset_output_string(char *p, const IPSET_OUTPUT_STRING *s) {
+    memcpy(p, s->s, s->len);
+    return p + s->len;
+}
+
+static inline char *ipset_output_text(char *p, const char *s) {
+    size_t len = strlen(s);
+    memcpy(p, s, len);
+    return p + len;
+}
+
+/* the text of a number, in decimal */
+static inline char *ipset_output_number(char *p, uint64_t n) {
+    char digits[20];
+    size_t i = 0;
+
+    do digits[i++] = (char)('0' + n % 10); while(n /= 10);
+    while(i) *p++ = digits[--i];
+    return p;
+}
+
+/* the text of a number from 0 to 255; it writes 4 bytes */
+static inline char *ipset_output_octet(char *p, unsigned int octet) {
+    memcpy(p, ipset_output_octets[octet], 4);
+    return p + ipset_output_octets[octet][3];
+}
+
+/* the text ip2str_r() gives; it writes up to 3 bytes after it */
+static inline char *ipset_output_ip(char *p, in_addr_t ip) {
+    p = ipset_output_octet(p, (ip >> 24) & 0xffU);
+    *p++ = '.';
+    p = ipset_output_octet(p, (ip >> 16) & 0xffU);
+    *p++ = '.';
+    p = ipset_output_octet(p, (ip >> 8) & 0xffU);
+    *p++ = '.';
+    return ipset_output_octet(p, ip & 0xffU);
+}
+
+#endif //IPRANGE_IPSET_OUTPUT_H
@@ -0,0 +1,142 @@
+#include "iprange.h"
+
+/* the number of threads to use for parallel work, set with --threads */
+int parallel_threads = 1;
+
+/* set on the threads while they run jobs, so that jobs do not start threads of their own */
+static __thread int parallel_running_job = 0;
+
+typedef struct parallel_pool {
+    const char *what;
+    size_t jobs;
+    size_t next;
+    PARALLEL_JOB run;
+    void *data;
+    pthread_mutex_t mut;
+} PARALLEL_POOL;
+
+typedef struct parallel_worker {
+    PARALLEL_POOL *pool;
+    pthread_t thread;
+    int id;
+} PARALLEL_WORKER;
+
+static int parallel_next_job(PARALLEL_POOL *pool, size_t *job) {
+    int ret = 0;
+
+    pthread_mutex_lock(&pool->mut);
+    if(pool->next < pool->jobs) {
+        *job = pool->next++;
+        ret = 1;
+    }
+    pthread_mutex_unlock(&pool->mut);
+
+    return ret;
+}
+
+static void *parallel_worker_run(void *ptr) {
+    PARALLEL_WORKER *w = ptr;
+    PARALLEL_POOL *pool = w->pool;
+    struct timeval start_dt, stop_dt;
+    size_t job, done = 0;
+
+    if(unlikely(debug)) gettimeofday(&start_dt, NULL);
+
+    parallel_running_job = 1;
+    while(parallel_next_job(pool, &job)) {
+        pool->run(job, pool->data);
+        done++;
+    }
+    parallel_running_job = 0;
+
+    if(unlikely(debug)) {
+        gettimeofday(&stop_dt, NULL);
+        fprintf(stderr, "%s: %s: thread %d ran %zu of %zu jobs in %0.5f seconds\n", PROG, pool->what, w->id, done, pool->jobs,
+            ((double)(stop_dt.tv_sec  * 1000000 + stop_dt.tv_usec) - (double)(start_dt.tv_sec * 1000000 + start_dt.tv_usec)) / (double)1000000);
+    }
+
+    return NULL;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * parallel_in_job()
+ *
+ * returns non-zero when called from a job of parallel_run()
+ *
+ */
+
+int parallel_in_job(void) {
+    return parallel_running_job;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * parallel_run()
+ *
+ * runs jobs 0 to jobs - 1 by calling run(job, data) for each of them
+ *
+ * up to parallel_threads threads are used, including the calling one, and
+ * every thread picks the next pending job as soon as it finishes one.
+ * It returns when all jobs have finished.
+ *
+ * if threads cannot be created, the remaining jobs are run by the threads
+ * that are available, so the jobs are always executed.
+ *
+ * called from a job, it runs the jobs on the calling thread, so nested
+ * parallel work never uses more than parallel_threads threads.
+ *
+ */
+
+void parallel_run(const char *what, size_t jobs, PARALLEL_JOB run, void *data) {
+    PARALLEL_POOL pool;
+    PARALLEL_WORKER *workers;
+    size_t threads = (parallel_threads > 1)?(size_t)parallel_threads:1;
+    size_t i, started = 0;
+
+    if(threads > jobs) threads = jobs;
+    if(parallel_running_job) threads = 1;
+
+    if(threads <= 1) {
+        for(i = 0; i < jobs; i++)
+            run(i, data);
+        return;
+    }
+
+    workers = calloc(threads, sizeof(PARALLEL_WORKER));
+    if(unlikely(!workers)) {
+        fprintf(stderr, "%s: %s: cannot allocate memory for %zu threads, running on one.\n", PROG, what, threads);
+        for(i = 0; i < jobs; i++)
+            run(i, data);
+        return;
+    }
+
+    pool.what = what;
+    pool.jobs = jobs;
+    pool.next = 0;
+    pool.run = run;
+    pool.data = data;
+    pthread_mutex_init(&pool.mut, NULL);
+
+    for(i = 0; i < threads; i++) {
+        workers[i].pool = &pool;
+        workers[i].id = (int)i;
+    }
+
+    /* worker 0 is the calling thread */
+    for(i = 1; i < threads; i++) {
+        if(pthread_create(&workers[i].thread, NULL, parallel_worker_run, &workers[i])) {
+            fprintf(stderr, "%s: %s: cannot create thread, continuing with %zu threads.\n", PROG, what, i);
+            break;
+        }
+        started++;
+    }
+
+    parallel_worker_run(&workers[0]);
+
+    for(i = 1; i <= started; i++)
+        pthread_join(workers[i].thread, NULL);
+
+    pthread_mutex_destroy(&pool.mut);
+    free(workers);
+}
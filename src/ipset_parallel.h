@@ -0,0 +1,11 @@
+#ifndef IPRANGE_IPSET_PARALLEL_H
+#define IPRANGE_IPSET_PARALLEL_H
+
+extern int parallel_threads;
+
+typedef void (*PARALLEL_JOB)(size_t job, void *data);
+
+extern int parallel_in_job(void);
+extern void parallel_run(const char *what, size_t jobs, PARALLEL_JOB run, void *data);
+
+#endif //IPRANGE_IPSET_PARALLEL_H
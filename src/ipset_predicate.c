@@ -0,0 +1,157 @@
+#include "iprange.h"
+
+/*
+ * yes/no questions about 2 ipsets: they walk the 2 optimized ipsets and stop
+ * at the first range that answers them (the witness), so they do not
+ * allocate any memory and often do not have to walk them to the end
+ *
+ * when witness is not NULL, it is set to that range:
+ *
+ *   ipset_intersects()  the first range common to both
+ *   ipset_is_subset()   the first range of ips1 that is not in ips2
+ *   ipset_equals()      a range that is in one of them only
+ *
+ */
+
+static inline void predicate_optimize(ipset *ips1, ipset *ips2) {
+    if(unlikely(!(ips1->flags & IPSET_FLAG_OPTIMIZED)))
+        ipset_optimize(ips1);
+
+    if(unlikely(!(ips2->flags & IPSET_FLAG_OPTIMIZED)))
+        ipset_optimize(ips2);
+}
+
+static inline int predicate_witness(network_addr_t *witness, in_addr_t lo, in_addr_t hi) {
+    if(witness) {
+        witness->addr = lo;
+        witness->broadcast = hi;
+    }
+
+    return 1;
+}
+
+/* finds the first range common to small and large, seeking in large */
+static int ipset_intersects_gallop(const ipset *small, const ipset *large, network_addr_t *witness) {
+    const network_addr_t *s = small->netaddrs, *send = small->netaddrs + small->entries;
+    const network_addr_t *at = large->netaddrs, *end = large->netaddrs + large->entries;
+
+    for(; s < send; s++) {
+        at = ipset_seek(at, end, s->addr);
+        if(unlikely(at == end)) break;
+
+        /* at ends at or after the start of s, so they overlap if it starts before its end */
+        if(at->addr <= s->broadcast)
+            return predicate_witness(witness, (at->addr > s->addr) ? at->addr : s->addr,
+                                     (at->broadcast < s->broadcast) ? at->broadcast : s->broadcast);
+    }
+
+    return 0;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_intersects()
+ *
+ * returns 1 when the 2 ipsets have at least 1 IP in common, 0 otherwise
+ *
+ */
+
+int ipset_intersects(ipset *ips1, ipset *ips2, network_addr_t *witness) {
+    const network_addr_t *a, *aend, *b, *bend;
+    size_t n1, n2;
+
+    predicate_optimize(ips1, ips2);
+
+    n1 = ips1->entries;
+    n2 = ips2->entries;
+
+    if(unlikely(n1 == 0 || n2 == 0))
+        return 0;
+
+    if(ipset_gallop_ratio && (n1 / n2 >= ipset_gallop_ratio || n2 / n1 >= ipset_gallop_ratio))
+        return (n1 < n2) ? ipset_intersects_gallop(ips1, ips2, witness) : ipset_intersects_gallop(ips2, ips1, witness);
+
+    a = ips1->netaddrs;
+    aend = a + n1;
+    b = ips2->netaddrs;
+    bend = b + n2;
+
+    while(a < aend && b < bend) {
+        in_addr_t lo = (a->addr > b->addr) ? a->addr : b->addr;
+        in_addr_t hi = (a->broadcast < b->broadcast) ? a->broadcast : b->broadcast;
+
+        if(lo <= hi)
+            return predicate_witness(witness, lo, hi);
+
+        /* the one that ends first cannot overlap anything else */
+        if(a->broadcast < b->broadcast) a++;
+        else b++;
+    }
+
+    return 0;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_is_subset()
+ *
+ * returns 1 when all the IPs of ips1 are in ips2, 0 otherwise
+ *
+ * since ips2 is optimized, its ranges are neither overlapping nor adjacent,
+ * so every range of ips1 must be inside a single range of ips2
+ *
+ */
+
+int ipset_is_subset(ipset *ips1, ipset *ips2, network_addr_t *witness) {
+    const network_addr_t *a, *aend, *b, *bend;
+
+    predicate_optimize(ips1, ips2);
+
+    /* a subset cannot have more IPs */
+    if(!witness && ips1->unique_ips > ips2->unique_ips)
+        return 0;
+
+    a = ips1->netaddrs;
+    aend = a + ips1->entries;
+    b = ips2->netaddrs;
+    bend = b + ips2->entries;
+
+    for(; a < aend; a++) {
+        b = ipset_seek(b, bend, a->addr);
+
+        if(unlikely(b == bend))
+            return !predicate_witness(witness, a->addr, a->broadcast);
+
+        /* the start of a is not in b */
+        if(b->addr > a->addr)
+            return !predicate_witness(witness, a->addr, (b->addr - 1 < a->broadcast) ? b->addr - 1 : a->broadcast);
+
+        /* b ends before a, and the next range of ips2 starts after a gap */
+        if(b->broadcast < a->broadcast)
+            return !predicate_witness(witness, b->broadcast + 1,
+                                      (b + 1 < bend && b[1].addr - 1 < a->broadcast) ? b[1].addr - 1 : a->broadcast);
+    }
+
+    return 1;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_equals()
+ *
+ * returns 1 when the 2 ipsets have the same IPs, 0 otherwise
+ *
+ * optimized ipsets with the same IPs have the same entries, so when they do
+ * not have the same counts there is no need to walk them, unless the
+ * witness is wanted
+ *
+ */
+
+int ipset_equals(ipset *ips1, ipset *ips2, network_addr_t *witness) {
+    predicate_optimize(ips1, ips2);
+
+    if(!witness && (ips1->entries != ips2->entries || ips1->unique_ips != ips2->unique_ips))
+        return 0;
+
+    return ipset_is_subset(ips1, ips2, witness) && ipset_is_subset(ips2, ips1, witness);
+}
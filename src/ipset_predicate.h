@@ -0,0 +1,8 @@
+#ifndef IPRANGE_IPSET_PREDICATE_H
+#define IPRANGE_IPSET_PREDICATE_H
+
+extern int ipset_intersects(ipset *ips1, ipset *ips2, network_addr_t *witness);
+extern int ipset_is_subset(ipset *ips1, ipset *ips2, network_addr_t *witness);
+extern int ipset_equals(ipset *ips1, ipset *ips2, network_addr_t *witness);
+
+#endif //IPRANGE_IPSET_PREDICATE_H
@@ -7,6 +7,17 @@ char *print_prefix_nets = "";
 char *print_suffix_ips = "";
 char *print_suffix_nets = "";
 
+char *print_ipset_restore = NULL;
+
+/* ipsets that print at least this many lines are formatted on --threads threads */
+size_t ipset_print_parallel_min = 64 * 1024;
+
+#define PRINT_SLICES_PER_THREAD 8
+
+/* the hashsize ipset gives to new sets, and the largest the kernel accepts */
+#define RESTORE_HASHSIZE_MIN 1024
+#define RESTORE_HASHSIZE_MAX (1ULL << 31)
+
 inline void prefix_update_counters(in_addr_t addr, int prefix) {
     (void)addr;
 
@@ -14,161 +25,217 @@ inline void prefix_update_counters(in_addr_t addr, int prefix) {
         prefix_counters[prefix]++;
 }
 
-inline void print_addr(in_addr_t addr, int prefix) {
-    prefix_update_counters(addr, prefix);
+/* ----------------------------------------------------------------------------
+ * the lines of the text output, formatted at p; they return where they end
+ *
+ */
 
-    char buf[IP2STR_MAX_LEN + 1];
+static inline char *format_addr(char *p, in_addr_t addr, int prefix) {
+    if (prefix < 32) {
+        p = ipset_output_string(p, &ipset_output_prefix_nets);
+        p = ipset_output_ip(p, addr);
+        *p++ = '/';
+        p = ipset_output_octet(p, (unsigned int)prefix);
+        p = ipset_output_string(p, &ipset_output_suffix_nets);
+    }
+    else {
+        p = ipset_output_string(p, &ipset_output_prefix_ips);
+        p = ipset_output_ip(p, addr);
+        p = ipset_output_string(p, &ipset_output_suffix_ips);
+    }
+    *p++ = '\n';
 
-    if (prefix < 32)
-        printf("%s%s/%d%s\n", print_prefix_nets, ip2str_r(buf, addr), prefix, print_suffix_nets);
-    else
-        printf("%s%s%s\n", print_prefix_ips, ip2str_r(buf, addr), print_suffix_ips);
+    return p;
+}
+
+static inline char *format_addr_range(char *p, in_addr_t lo, in_addr_t hi) {
+    if(lo == hi) {
+        p = ipset_output_string(p, &ipset_output_prefix_ips);
+        p = ipset_output_ip(p, lo);
+        *p++ = '-';
+        p = ipset_output_ip(p, hi);
+        p = ipset_output_string(p, &ipset_output_suffix_ips);
+    }
+    else {
+        p = ipset_output_string(p, &ipset_output_prefix_nets);
+        p = ipset_output_ip(p, lo);
+        *p++ = '-';
+        p = ipset_output_ip(p, hi);
+        p = ipset_output_string(p, &ipset_output_suffix_nets);
+    }
+    *p++ = '\n';
+
+    return p;
+}
+
+static inline char *format_addr_single(char *p, in_addr_t x) {
+    p = ipset_output_string(p, &ipset_output_prefix_ips);
+    p = ipset_output_ip(p, x);
+    p = ipset_output_string(p, &ipset_output_suffix_ips);
+    *p++ = '\n';
 
+    return p;
+}
+
+/* the warning for a range that ends before it starts; it should never happen */
+static void print_reversed_range(in_addr_t lo, in_addr_t hi) {
+    char buf[IP2STR_MAX_LEN + 1];
+    fprintf(stderr, "%s: WARNING: invalid range reversed start=%s", PROG, ip2str_r(buf, lo));
+    fprintf(stderr, " end=%s\n", ip2str_r(buf, hi));
+}
+
+inline void print_addr(in_addr_t addr, int prefix) {
+    prefix_update_counters(addr, prefix);
+    ipset_output_commit(format_addr(ipset_output_pos, addr, prefix));
 }				/* print_addr() */
 
 /*------------------------------------------------------*/
 /* Print out an address range in a.b.c.d-A.B.C.D format */
 /*------------------------------------------------------*/
 inline void print_addr_range(in_addr_t lo, in_addr_t hi) {
-    char buf[IP2STR_MAX_LEN + 1];
-
     if(unlikely(lo > hi)) {
-        /*
-         * it should never happen
-         * give a log for the user to see
-         */
         in_addr_t t = hi;
-        fprintf(stderr, "%s: WARNING: invalid range reversed start=%s", PROG, ip2str_r(buf, lo));
-        fprintf(stderr, " end=%s\n", ip2str_r(buf, hi));
+        print_reversed_range(lo, hi);
         hi = lo;
         lo = t;
     }
 
-    if(lo == hi) {
-        printf("%s%s-", print_prefix_ips, ip2str_r(buf, lo));
-        printf("%s%s\n", ip2str_r(buf, hi), print_suffix_ips);
-    }
-    else {
-        printf("%s%s-", print_prefix_nets, ip2str_r(buf, lo));
-        printf("%s%s\n", ip2str_r(buf, hi), print_suffix_nets);
-    }
-
+    ipset_output_commit(format_addr_range(ipset_output_pos, lo, hi));
 }
 
 inline void print_addr_single(in_addr_t x) {
-    char buf[IP2STR_MAX_LEN + 1];
-    printf("%s%s%s\n", print_prefix_ips, ip2str_r(buf, x), print_suffix_ips);
-
+    ipset_output_commit(format_addr_single(ipset_output_pos, x));
 }
 
-/*------------------------------------------------------------*/
-/* Recursively compute network addresses to cover range lo-hi */
-/*------------------------------------------------------------*/
-/* Note: Worst case scenario is when lo=0.0.0.1 and hi=255.255.255.254
- *       We then have 62 CIDR blocks to cover this interval, and 125
- *       calls to split_range();
- *       The maximum possible recursion depth is 32.
+/* ----------------------------------------------------------------------------
+ * split_range_start(), split_range_cidrs(), split_range_count()
+ *
+ * compute the CIDR blocks that cover the range lo-hi, using only the prefixes
+ * enabled in prefix_enabled[]
+ *
+ * the blocks are found in a loop, without recursion: the largest block that
+ * starts at an address is given by its trailing zero bits, limited by the
+ * leading zero bits of the number of IPs left. When its prefix is disabled, it
+ * is covered by the blocks of the next enabled prefix, exactly like splitting
+ * it in halves until an enabled prefix is found would do.
+ *
+ * split_range_cidrs() writes up to max of them to cidrs, in ascending order,
+ * and returns how many it wrote; 0 means the range is done. It continues from
+ * where the previous call stopped, so any number of blocks can be produced
+ * with a fixed batch.
+ *
+ * split_range_count() adds the number of blocks of every prefix to counters[],
+ * without producing them, and returns their total
+ *
  */
 
-inline int split_range(in_addr_t addr, int prefix, in_addr_t lo, in_addr_t hi, void (*print)(in_addr_t, int)) {
-    in_addr_t bc, lower_half, upper_half;
-
+void split_range_start(SPLIT_RANGE_CURSOR *c, in_addr_t lo, in_addr_t hi) {
     if(unlikely(lo > hi)) {
-        /*
-         * it should never happen
-         * give a log for the user to see
-         */
         in_addr_t t = hi;
-        char buf[IP2STR_MAX_LEN + 1];
-        fprintf(stderr, "%s: WARNING: invalid range reversed start=%s", PROG, ip2str_r(buf, lo));
-        fprintf(stderr, " end=%s\n", ip2str_r(buf, hi));
+        print_reversed_range(lo, hi);
         hi = lo;
         lo = t;
     }
 
-    if (unlikely((prefix < 0) || (prefix > 32))) {
+    c->next = lo;
+    c->last = hi;
+}
+
+/* the prefix of the largest block that starts at next and ends at or before last */
+static inline int split_range_block(uint64_t next, uint64_t last) {
+    int bits = next ? __builtin_ctzll(next) : 32;
+    int fit = 63 - __builtin_clzll(last - next + 1);
+
+    return 32 - ((fit < bits) ? fit : bits);
+}
+
+/* the prefix the blocks of the given prefix are printed with */
+static inline int split_range_enabled(int prefix) {
+    while(prefix <= 32 && !prefix_enabled[prefix])
+        prefix++;
+
+    if(unlikely(prefix > 32))
         fprintf(stderr, "%s: Invalid netmask %d!\n", PROG, prefix);
-        return 0;
-    }
 
-    bc = broadcast(addr, prefix);
+    return prefix;
+}
 
-    if (unlikely((lo < addr) || (hi > bc))) {
-        fprintf(stderr, "%s: Out of range limits: %x, %x for "
-                "network %x/%d, broadcast: %x!\n", PROG, lo, hi, addr, prefix, bc);
-        return 0;
-    }
+size_t split_range_cidrs(SPLIT_RANGE_CURSOR *c, IPSET_CIDR *cidrs, size_t max) {
+    size_t n = 0;
 
-    if ((lo == addr) && (hi == bc) && prefix_enabled[prefix]) {
-        print(addr, prefix);
-        return 1;
-    }
+    while(n < max && c->next <= c->last) {
+        int prefix = split_range_block(c->next, c->last);
+        int enabled = split_range_enabled(prefix);
+        uint64_t end = c->next + (UINT64_C(1) << (32 - prefix));
 
-    prefix++;
-    lower_half = addr;
-    upper_half = set_bit(addr, prefix, 1);
+        if(unlikely(enabled > 32)) {
+            c->next = end;
+            continue;
+        }
 
-    if (hi < upper_half) {
-        /* cppcheck-suppress misra-c2012-17.2 -- CIDR splitting is bounded to 32 levels. */
-        return split_range(lower_half, prefix, lo, hi, print);
-    }
-    else if (lo >= upper_half) {
-        /* cppcheck-suppress misra-c2012-17.2 -- CIDR splitting is bounded to 32 levels. */
-        return split_range(upper_half, prefix, lo, hi, print);
-    }
-    else {
-        /* cppcheck-suppress misra-c2012-17.2 -- CIDR splitting is bounded to 32 levels. */
-        int lower = split_range(lower_half, prefix, lo, broadcast(lower_half, prefix), print);
-        /* cppcheck-suppress misra-c2012-17.2 -- CIDR splitting is bounded to 32 levels. */
-        int upper = split_range(upper_half, prefix, upper_half, hi, print);
-        return (
-                lower +
-                upper
-        );
+        for(; n < max && c->next < end; c->next += UINT64_C(1) << (32 - enabled)) {
+            cidrs[n].addr = (in_addr_t)c->next;
+            cidrs[n].prefix = enabled;
+            n++;
+        }
     }
+
+    return n;
 }
 
+size_t split_range_count(in_addr_t lo, in_addr_t hi, size_t *counters) {
+    uint64_t next = lo, last = hi;
+    size_t total = 0;
+
+    while(next <= last) {
+        int prefix = split_range_block(next, last);
+        int enabled = split_range_enabled(prefix);
+
+        if(likely(enabled <= 32)) {
+            counters[enabled] += (size_t)1 << (enabled - prefix);
+            total += (size_t)1 << (enabled - prefix);
+        }
+
+        next += UINT64_C(1) << (32 - prefix);
+    }
+
+    return total;
+}
 
 /* ----------------------------------------------------------------------------
- * ipset_print()
+ * print_entries()
  *
- * print the ipset given to stdout
+ * formats the entries from to to - 1 of ips to sink, and returns the number
+ * of lines; the prefixes of the CIDRs are counted in counters[]
  *
  */
 
-void ipset_print(ipset *ips, IPSET_PRINT_CMD print) {
-    size_t i, n, total = 0;
-
-    if(unlikely(!(ips->flags & IPSET_FLAG_OPTIMIZED)))
-        ipset_optimize(ips);
-
-    if(print == PRINT_BINARY) {
-        ipset_save_binary_v10(ips);
-        return;
-    }
-
-    if(unlikely(debug)) fprintf(stderr, "%s: Printing %s with %zu ranges, %" PRIu64 " unique IPs\n", PROG, ips->filename, ips->entries, ips->unique_ips);
+static size_t print_entries(ipset *ips, IPSET_PRINT_CMD print, size_t from, size_t to, IPSET_OUTPUT_SINK *sink, size_t *counters) {
+    size_t i, total = 0;
 
     switch(print) {
         case PRINT_CIDR:
-            /* reset the prefix counters */
-            for(i = 0; i <= 32; i++)
-                prefix_counters[i] = 0;
-
-            n = ips->entries;
-            for(i = 0; i < n ;i++)
-                total += split_range(0, 0, ips->netaddrs[i].addr, ips->netaddrs[i].broadcast, print_addr);
-
+            for(i = from; i < to ;i++) {
+                SPLIT_RANGE_CURSOR c;
+                IPSET_CIDR cidrs[SPLIT_RANGE_BATCH];
+                size_t j, k;
+
+                split_range_start(&c, ips->netaddrs[i].addr, ips->netaddrs[i].broadcast);
+                while((k = split_range_cidrs(&c, cidrs, SPLIT_RANGE_BATCH))) {
+                    for(j = 0; j < k ;j++) {
+                        counters[cidrs[j].prefix]++;
+                        ipset_output_sink_commit(sink, format_addr(sink->pos, cidrs[j].addr, cidrs[j].prefix));
+                    }
+                    total += k;
+                }
+            }
             break;
 
         case PRINT_SINGLE_IPS:
-            n = ips->entries;
-            for(i = 0; i < n ;i++) {
+            for(i = from; i < to ;i++) {
                 in_addr_t x, start = ips->netaddrs[i].addr, end = ips->netaddrs[i].broadcast;
                 if(unlikely(start > end)) {
-                    char buf[IP2STR_MAX_LEN + 1];
-                    fprintf(stderr, "%s: WARNING: invalid range reversed start=%s", PROG, ip2str_r(buf, start));
-                    fprintf(stderr, " end=%s\n", ip2str_r(buf, end));
+                    print_reversed_range(start, end);
                     x = end;
                     end = start;
                     start = x;
@@ -180,26 +247,287 @@ void ipset_print(ipset *ips, IPSET_PRINT_CMD print) {
                     continue;
                 }
                 for( x = start ; x >= start && x <= end ; x++ ) {
-                    print_addr_single(x);
+                    ipset_output_sink_commit(sink, format_addr_single(sink->pos, x));
                     total++;
                 }
             }
             break;
 
         default:
-            n = ips->entries;
-            for(i = 0; i < n ;i++) {
-                print_addr_range(ips->netaddrs[i].addr, ips->netaddrs[i].broadcast);
+            for(i = from; i < to ;i++) {
+                in_addr_t lo = ips->netaddrs[i].addr, hi = ips->netaddrs[i].broadcast;
+                if(unlikely(lo > hi)) {
+                    print_reversed_range(lo, hi);
+                    lo = hi;
+                    hi = ips->netaddrs[i].addr;
+                }
+                ipset_output_sink_commit(sink, format_addr_range(sink->pos, lo, hi));
                 total++;
             }
             break;
     }
 
+    return total;
+}
+
+typedef struct print_slices {
+    ipset *ips;
+    IPSET_PRINT_CMD print;
+    size_t *from;               /* the first entry of each slice, and the end */
+    size_t (*counters)[33];     /* the CIDR prefixes of each slice */
+} PRINT_SLICES;
+
+static size_t print_slice(size_t slice, IPSET_OUTPUT_SINK *sink, void *data) {
+    PRINT_SLICES *ps = data;
+    return print_entries(ps->ips, ps->print, ps->from[slice], ps->from[slice + 1], sink, ps->counters[slice]);
+}
+
+/* about how many lines an entry prints, to give the slices the same work */
+static inline uint64_t print_weight(ipset *ips, IPSET_PRINT_CMD print, size_t i) {
+    in_addr_t lo = ips->netaddrs[i].addr, hi = ips->netaddrs[i].broadcast;
+
+    /* the ranges print_entries() eliminates print nothing */
+    if(print == PRINT_SINGLE_IPS && hi > lo && hi - lo <= (256 * 256 * 256))
+        return (uint64_t)hi - lo + 1;
+
+    return 1;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * print_parallel()
+ *
+ * with --threads, ipsets that print at least ipset_print_parallel_min lines
+ * are split into slices of contiguous entries that print about the same
+ * number of lines. The slices are formatted on parallel threads and written
+ * in order (see ipset_output_parallel()), and their prefix counters are added
+ * to prefix_counters[].
+ *
+ * returns non-zero when it printed the ipset, adding its lines to *total
+ *
+ */
+
+static int print_parallel(ipset *ips, IPSET_PRINT_CMD print, size_t *total) {
+    PRINT_SLICES ps;
+    size_t i, s, slices;
+    uint64_t weight = 0, target, w;
+    int ret = 0;
+
+    if(parallel_threads <= 1 || ips->entries < 2)
+        return 0;
+
+    for(i = 0; i < ips->entries; i++)
+        weight += print_weight(ips, print, i);
+
+    if(weight < ipset_print_parallel_min)
+        return 0;
+
+    slices = (size_t)parallel_threads * PRINT_SLICES_PER_THREAD;
+    if(slices > ips->entries) slices = ips->entries;
+
+    ps.ips = ips;
+    ps.print = print;
+    ps.from = malloc((slices + 1) * sizeof(size_t));
+    ps.counters = calloc(slices, sizeof(*ps.counters));
+    if(unlikely(!ps.from || !ps.counters)) {
+        free(ps.from);
+        free(ps.counters);
+        return 0;
+    }
+
+    /* slice s starts after the entry that reaches s times the weight of a slice */
+    target = weight / slices + 1;
+    ps.from[0] = 0;
+    for(i = 0, s = 1, w = 0; i < ips->entries && s < slices; i++) {
+        w += print_weight(ips, print, i);
+        while(s < slices && w >= target * s)
+            ps.from[s++] = i + 1;
+    }
+    while(s <= slices)
+        ps.from[s++] = ips->entries;
+
+    if(!ipset_output_parallel("print", slices, print_slice, &ps, total)) {
+        for(s = 0; s < slices; s++)
+            for(i = 0; i <= 32; i++)
+                prefix_counters[i] += ps.counters[s][i];
+        ret = 1;
+    }
+
+    free(ps.from);
+    free(ps.counters);
+    return ret;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * print_restore_begin(), print_restore_end()
+ *
+ * the ipset as a script for ipset restore, that fills the set NAME-tmp and
+ * swaps it with NAME (print_ipset_restore), so that NAME changes at once: a
+ * hash:net set of the CIDRs for PRINT_IPSET_RESTORE_NET, or a hash:ip set
+ * of the single IPs for PRINT_IPSET_RESTORE_IP. The add lines are formatted
+ * like the CIDRs and single IPs are, with the add command as their prefix.
+ *
+ * the kernel refuses the CIDR 0.0.0.0/0 in hash:net sets, so prefix 0 is
+ * disabled while the CIDRs are counted and printed, and the whole range is
+ * added as two /1 blocks.
+ *
+ * the entries are counted before they are printed, so that the hashsize of
+ * NAME-tmp gives about one entry per bucket, and the kernel does not resize
+ * the hash while the set is filled. The sets are created with -exist, which
+ * the kernel refuses for a set that exists with another maxelem; swap gives
+ * NAME the maxelem of NAME-tmp, so both always get IPSET_RESTORE_MAXELEM.
+ *
+ */
+
+static uint64_t restore_hashsize(uint64_t entries) {
+    uint64_t size = RESTORE_HASHSIZE_MIN;
+
+    while(size < entries && size < RESTORE_HASHSIZE_MAX)
+        size <<= 1;
+
+    return size;
+}
+
+/* the add lines ipset_print() prints for lines, counted without formatting them */
+static uint64_t restore_entries(ipset *ips, IPSET_PRINT_CMD lines) {
+    size_t counters[33], i;
+    uint64_t entries = 0;
+
+    memset(counters, 0, sizeof(counters));
+
+    for(i = 0; i < ips->entries; i++) {
+        if(lines == PRINT_CIDR)
+            entries += split_range_count(ips->netaddrs[i].addr, ips->netaddrs[i].broadcast, counters);
+        else
+            entries += print_weight(ips, lines, i);
+    }
+
+    return entries;
+}
+
+/* the create line of NAME, or of NAME-tmp with its hashsize; names are short enough for any line */
+static char *format_restore_create(char *p, const char *type, const char *tmp, uint64_t hashsize) {
+    p = ipset_output_text(p, "create ");
+    p = ipset_output_text(p, print_ipset_restore);
+    p = ipset_output_text(p, tmp);
+    *p++ = ' ';
+    p = ipset_output_text(p, type);
+    p = ipset_output_text(p, " family inet");
+    if(hashsize) {
+        p = ipset_output_text(p, " hashsize ");
+        p = ipset_output_number(p, hashsize);
+    }
+    p = ipset_output_text(p, " maxelem ");
+    p = ipset_output_number(p, IPSET_RESTORE_MAXELEM);
+    p = ipset_output_text(p, " -exist\n");
+    return p;
+}
+
+/* a command on NAME-tmp, and on NAME when and is given */
+static char *format_restore_command(char *p, const char *command, const char *and) {
+    p = ipset_output_text(p, command);
+    p = ipset_output_text(p, print_ipset_restore);
+    p = ipset_output_text(p, "-tmp");
+    if(and) {
+        *p++ = ' ';
+        p = ipset_output_text(p, and);
+    }
+    *p++ = '\n';
+    return p;
+}
+
+/* starts the output with the add command, of up to IPSET_RESTORE_NAME_MAX + 16 bytes, as the prefix */
+static void print_restore_begin(ipset *ips, IPSET_PRINT_CMD lines, char *add) {
+    const char *type = (lines == PRINT_CIDR) ? "hash:net" : "hash:ip";
+    uint64_t entries = restore_entries(ips, lines), hashsize = restore_hashsize(entries);
+    char *p;
+
+    if(unlikely(debug)) fprintf(stderr, "%s: ipset restore of %s, %s with %" PRIu64 " entries, hashsize %" PRIu64 "\n", PROG, print_ipset_restore, type, entries, hashsize);
+
+    p = ipset_output_text(add, "add ");
+    p = ipset_output_text(p, print_ipset_restore);
+    p = ipset_output_text(p, "-tmp ");
+    *p = '\0';
+
+    ipset_output_begin_with(add, add, "", "");
+    ipset_output_commit(format_restore_create(ipset_output_pos, type, "", 0));
+    ipset_output_commit(format_restore_create(ipset_output_pos, type, "-tmp", hashsize));
+    ipset_output_commit(format_restore_command(ipset_output_pos, "flush ", NULL));
+
+    /* print_parallel() needs an empty buffer */
+    ipset_output_flush();
+}
+
+static void print_restore_end(void) {
+    ipset_output_commit(format_restore_command(ipset_output_pos, "swap ", print_ipset_restore));
+    ipset_output_commit(format_restore_command(ipset_output_pos, "destroy ", NULL));
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_print()
+ *
+ * print the ipset given to stdout
+ *
+ * the lines are formatted into the output buffer (see ipset_output.h) and
+ * written with write(), so print_addr(), print_addr_range() and
+ * print_addr_single() may only be called between ipset_output_begin() and
+ * ipset_output_finish(); with --threads, large ipsets are formatted on
+ * parallel threads (see print_parallel()); PRINT_IPSET_RESTORE_NET and
+ * PRINT_IPSET_RESTORE_IP wrap the CIDRs or the single IPs in a script for
+ * ipset restore (see print_restore_begin())
+ *
+ */
+
+void ipset_print(ipset *ips, IPSET_PRINT_CMD print) {
+    IPSET_PRINT_CMD lines = print;
+    char add[IPSET_RESTORE_NAME_MAX + 16];
+    uint8_t prefix0_enabled = prefix_enabled[0];
+    size_t i, total = 0;
+
+    if(unlikely(!(ips->flags & IPSET_FLAG_OPTIMIZED)))
+        ipset_optimize(ips);
+
+    if(print == PRINT_BINARY) {
+        ipset_save_binary_v10(ips);
+        return;
+    }
+
+    if(unlikely(debug)) fprintf(stderr, "%s: Printing %s with %zu ranges, %" PRIu64 " unique IPs\n", PROG, ips->filename, ips->entries, ips->unique_ips);
+
+    if(print == PRINT_IPSET_RESTORE_NET || print == PRINT_IPSET_RESTORE_IP) {
+        lines = (print == PRINT_IPSET_RESTORE_IP) ? PRINT_SINGLE_IPS : PRINT_CIDR;
+        if(lines == PRINT_CIDR) prefix_enabled[0] = 0;
+        print_restore_begin(ips, lines, add);
+    }
+    else
+        ipset_output_begin();
+
+    /* reset the prefix counters */
+    for(i = 0; i <= 32; i++)
+        prefix_counters[i] = 0;
+
+    if(!print_parallel(ips, lines, &total)) {
+        IPSET_OUTPUT_SINK sink;
+
+        ipset_output_sink_begin(&sink);
+        total = print_entries(ips, lines, 0, ips->entries, &sink, prefix_counters);
+        ipset_output_sink_end(&sink);
+    }
+
+    if(lines != print) {
+        print_restore_end();
+        prefix_enabled[0] = prefix0_enabled;
+    }
+
+    ipset_output_finish();
+
     /* print prefix break down */
     if(unlikely(debug)) {
         int prefixes = 0;
 
-        if (print == PRINT_CIDR) {
+        if (lines == PRINT_CIDR) {
 
             fprintf(stderr, "\n%zu printed CIDRs, break down by prefix:\n", total);
 
@@ -212,12 +540,12 @@ void ipset_print(ipset *ips, IPSET_PRINT_CMD print) {
                 }
             }
         }
-        else if (print == PRINT_SINGLE_IPS) prefixes = 1;
+        else if (lines == PRINT_SINGLE_IPS) prefixes = 1;
 
         {
             char *units;
-            if (print == PRINT_CIDR) units = "CIDRs";
-            else if (print == PRINT_SINGLE_IPS) units = "IPs";
+            if (lines == PRINT_CIDR) units = "CIDRs";
+            else if (lines == PRINT_SINGLE_IPS) units = "IPs";
             else units = "ranges";
 
             fprintf(stderr, "\ntotals: %zu lines read, %zu distinct IP ranges found, %d CIDR prefixes, %zu %s printed, %" PRIu64 " unique IPs\n", ips->lines, ips->entries, prefixes, total, units, ips->unique_ips);
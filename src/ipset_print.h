@@ -5,16 +5,29 @@ typedef enum ipset_print_cmd {
     PRINT_RANGE = 1,
     PRINT_CIDR = 2,
     PRINT_SINGLE_IPS = 3,
-    PRINT_BINARY = 4
+    PRINT_BINARY = 4,
+    PRINT_IPSET_RESTORE_NET = 5,    /* a restore script of a hash:net set of the CIDRs */
+    PRINT_IPSET_RESTORE_IP = 6      /* a restore script of a hash:ip set of the single IPs */
 } IPSET_PRINT_CMD;
 
+/* ipset names are up to 31 characters, and the restore scripts add -tmp to it */
+#define IPSET_RESTORE_NAME_MAX 27
+
+/* the maxelem of the sets of the restore scripts: the largest, since it is only a cap */
+#define IPSET_RESTORE_MAXELEM UINT32_MAX
+
 extern uint8_t prefix_enabled[];
 
+extern size_t ipset_print_parallel_min;
+
 extern char *print_prefix_ips;
 extern char *print_prefix_nets;
 extern char *print_suffix_ips;
 extern char *print_suffix_nets;
 
+/* the set of PRINT_IPSET_RESTORE_NET and PRINT_IPSET_RESTORE_IP */
+extern char *print_ipset_restore;
+
 extern void ipset_print(ipset *ips, IPSET_PRINT_CMD print);
 
 extern void prefix_update_counters(in_addr_t addr, int prefix);
@@ -22,6 +35,23 @@ extern void print_addr(in_addr_t addr, int prefix);
 extern void print_addr_range(in_addr_t lo, in_addr_t hi);
 extern void print_addr_single(in_addr_t x);
 
-extern int split_range(in_addr_t addr, int prefix, in_addr_t lo, in_addr_t hi, void (*print)(in_addr_t, int));
+/* a CIDR block of a range, as produced by split_range_cidrs() */
+typedef struct ipset_cidr {
+    in_addr_t addr;
+    int prefix;
+} IPSET_CIDR;
+
+/* where split_range_cidrs() is in the range it splits; done when next > last */
+typedef struct split_range_cursor {
+    uint64_t next;
+    in_addr_t last;
+} SPLIT_RANGE_CURSOR;
+
+/* the CIDR blocks split_range_cidrs() is given room for by its callers */
+#define SPLIT_RANGE_BATCH 64
+
+extern void split_range_start(SPLIT_RANGE_CURSOR *c, in_addr_t lo, in_addr_t hi);
+extern size_t split_range_cidrs(SPLIT_RANGE_CURSOR *c, IPSET_CIDR *cidrs, size_t max);
+extern size_t split_range_count(in_addr_t lo, in_addr_t hi, size_t *counters);
 
 #endif //IPRANGE_IPSET_PRINT_H
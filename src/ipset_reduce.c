@@ -30,7 +30,7 @@ void ipset_reduce(ipset *ips, size_t acceptable_increase, size_t min_accepted) {
     /* find how many prefixes are there */
     if(unlikely(debug)) fprintf(stderr, "\nCounting prefixes in %s\n", ips->filename);
     for(i = 0; i < n ;i++)
-        split_range(0, 0, ips->netaddrs[i].addr, ips->netaddrs[i].broadcast, prefix_update_counters);
+        split_range_count(ips->netaddrs[i].addr, ips->netaddrs[i].broadcast, prefix_counters);
 
     /* count them */
     if(unlikely(debug)) fprintf(stderr, "Break down by prefix:\n");
@@ -0,0 +1,346 @@
+#include "iprange.h"
+
+/*
+ * set operations on very large ipsets can run on all the threads given with
+ * --threads, by splitting the IPv4 address space into shards that have about
+ * the same number of entries, and running the existing kernel on each shard.
+ *
+ * every shard sees the entries of the ipsets that overlap its part of the
+ * address space, in place (nothing is copied). Since the set operations work
+ * on each IP on its own, the result of a kernel clipped to the part of the
+ * shard is the part of the whole result. The results are then concatenated,
+ * gluing the ranges that were split at the shard boundaries.
+ */
+
+/* set operations on at least this many entries in total are sharded */
+size_t ipset_shard_min = 1024 * 1024;
+
+#define SHARDS_PER_THREAD 4
+
+typedef struct shard {
+    uint64_t from;              /* the first IP of the shard */
+    uint64_t end;               /* the IP after the last of the shard */
+    ipset *result;              /* the result of the kernel, clipped to the shard */
+    size_t skip;                /* its first entry is glued to the previous shard */
+    size_t offset;              /* where its entries go in the final result */
+    int clipped_first;          /* its first entry started before the shard */
+    int clipped_last;           /* its last entry ended after the shard */
+} SHARD;
+
+typedef struct shard_job {
+    ipset **inputs;
+    size_t n;
+    SHARD *shards;
+    IPSET_SHARD_OP op;
+    ipset *out;
+    int failed;
+} SHARD_JOB;
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_shard_wanted()
+ *
+ * returns non-zero when a set operation on the ipsets linked from first and
+ * second (it may be NULL) should be sharded on multiple threads
+ *
+ */
+
+int ipset_shard_wanted(ipset *first, ipset *second) {
+    ipset *ips;
+    size_t entries = 0;
+
+    if(parallel_threads <= 1) return 0;
+
+    for(ips = first; ips; ips = ips->next)
+        entries += ips->entries;
+
+    for(ips = second; ips; ips = ips->next)
+        entries += ips->entries;
+
+    return entries >= ipset_shard_min;
+}
+
+/* the number of entries of an optimized ipset that start before addr */
+static size_t shard_rank(const ipset *ips, uint64_t addr) {
+    size_t lo = 0, hi = ips->entries;
+
+    while(lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if(ips->netaddrs[mid].addr < addr) lo = mid + 1;
+        else hi = mid;
+    }
+
+    return lo;
+}
+
+/* the smallest IP before which there are at least rank entries, in all the inputs */
+static uint64_t shard_split(ipset **inputs, size_t n, size_t rank) {
+    uint64_t lo = 0, hi = (uint64_t)UINT32_MAX + 1;
+
+    while(lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        size_t i, below = 0;
+
+        for(i = 0; i < n; i++)
+            below += shard_rank(inputs[i], mid);
+
+        if(below < rank) lo = mid + 1;
+        else hi = mid;
+    }
+
+    return lo;
+}
+
+static void shard_op_job(size_t s, void *data) {
+    SHARD_JOB *sj = data;
+    SHARD *sh = &sj->shards[s];
+    ipset *views, *r;
+    size_t i, first, last;
+    uint64_t unique_ips = 0;
+
+    if(sh->from >= sh->end) return;
+
+    views = calloc(sj->n, sizeof(ipset));
+    if(unlikely(!views)) {
+        sj->failed = 1;
+        return;
+    }
+
+    /* the entries of each input that overlap the shard, in place */
+    for(i = 0; i < sj->n; i++) {
+        ipset *in = sj->inputs[i];
+        size_t from = (sh->from) ? shard_rank(in, sh->from) : 0;
+        size_t to = shard_rank(in, sh->end);
+
+        /* the one before may end inside the shard */
+        if(from > 0 && in->netaddrs[from - 1].broadcast >= sh->from) from--;
+
+        ipset_set_filename(&views[i], in->filename);
+        views[i].netaddrs = &in->netaddrs[from];
+        views[i].entries = views[i].entries_max = to - from;
+        views[i].flags = IPSET_FLAG_OPTIMIZED;
+        if(i) {
+            views[i].prev = &views[i - 1];
+            views[i - 1].next = &views[i];
+        }
+    }
+
+    r = sj->op(views);
+    free(views);
+
+    if(unlikely(!r)) {
+        sj->failed = 1;
+        return;
+    }
+
+    /* clip the result to the shard */
+    for(first = 0; first < r->entries && r->netaddrs[first].broadcast < sh->from; first++) ;
+    for(last = first; last < r->entries && r->netaddrs[last].addr < sh->end; last++) ;
+
+    if(first < last) {
+        if(r->netaddrs[first].addr < sh->from) {
+            r->netaddrs[first].addr = (in_addr_t)sh->from;
+            sh->clipped_first = 1;
+        }
+
+        if(r->netaddrs[last - 1].broadcast >= sh->end) {
+            r->netaddrs[last - 1].broadcast = (in_addr_t)(sh->end - 1);
+            sh->clipped_last = 1;
+        }
+    }
+
+    if(first) memmove(r->netaddrs, &r->netaddrs[first], (last - first) * sizeof(network_addr_t));
+    r->entries = last - first;
+
+    for(i = 0; i < r->entries; i++)
+        unique_ips += (uint64_t)r->netaddrs[i].broadcast - (uint64_t)r->netaddrs[i].addr + UINT64_C(1);
+    r->unique_ips = unique_ips;
+
+    sh->result = r;
+}
+
+static void shard_copy_job(size_t s, void *data) {
+    SHARD_JOB *sj = data;
+    SHARD *sh = &sj->shards[s];
+
+    if(!sh->result) return;
+
+    ipset_copy_entries(&sj->out->netaddrs[sh->offset], &sh->result->netaddrs[sh->skip], sh->result->entries - sh->skip);
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_shard()
+ *
+ * runs op on the n ipsets given, splitting the address space into shards
+ * that run on parallel threads, and returns its result as a new optimized
+ * ipset named filename; its lines are the sum of the lines of the inputs
+ *
+ * op gets the entries of each shard as ipsets linked to 'next', in the order
+ * of inputs, and must not modify them. When coalesced is non-zero, op joins
+ * adjacent ranges, so the results of adjacent shards are joined too;
+ * otherwise they are joined only when a range was split by the shards.
+ *
+ * returns NULL if memory cannot be allocated
+ *
+ */
+
+ipset *ipset_shard(ipset **inputs, size_t n, const char *filename, IPSET_SHARD_OP op, int coalesced) {
+    SHARD_JOB sj;
+    size_t i, s, shards, total = 0, lines = 0, entries = 0, glued = 0;
+    uint64_t unique_ips = 0, split;
+    SHARD *prev = NULL;
+
+    if(unlikely(debug)) fprintf(stderr, "%s: Sharding the set operation of %zu ipsets to %s\n", PROG, n, filename);
+
+    for(i = 0; i < n; i++) {
+        ipset_optimize(inputs[i]);
+        total += inputs[i]->entries;
+        lines += inputs[i]->lines;
+    }
+
+    shards = (size_t)((parallel_threads > 1) ? parallel_threads : 1) * SHARDS_PER_THREAD;
+
+    sj.inputs = inputs;
+    sj.n = n;
+    sj.op = op;
+    sj.failed = 0;
+    sj.shards = calloc(shards, sizeof(SHARD));
+    sj.out = NULL;
+    if(unlikely(!sj.shards)) {
+        fprintf(stderr, "%s: Cannot allocate memory for %zu shards of %s\n", PROG, shards, filename);
+        return NULL;
+    }
+
+    /* each shard starts where the previous ends; some may be empty */
+    for(s = 0, split = 0; s < shards; s++) {
+        sj.shards[s].from = split;
+        split = (s == shards - 1) ? (uint64_t)UINT32_MAX + 1 : shard_split(inputs, n, total * (s + 1) / shards);
+        sj.shards[s].end = split;
+    }
+
+    parallel_run("shard", shards, shard_op_job, &sj);
+
+    /* find where the entries of each shard go, gluing them to the previous */
+    for(s = 0; !sj.failed && s < shards; s++) {
+        SHARD *sh = &sj.shards[s];
+
+        if(!sh->result || !sh->result->entries) continue;
+
+        if(prev && (uint64_t)prev->result->netaddrs[prev->result->entries - 1].broadcast + 1 == sh->result->netaddrs[0].addr
+           && (coalesced || (prev->clipped_last && sh->clipped_first))) {
+            sh->skip = 1;
+            glued++;
+        }
+
+        sh->offset = entries;
+        entries += sh->result->entries - sh->skip;
+        unique_ips += sh->result->unique_ips;
+        prev = sh;
+    }
+
+    if(likely(!sj.failed)) {
+        sj.out = ipset_create(filename, entries);
+        if(unlikely(!sj.out)) sj.failed = 1;
+    }
+
+    if(likely(!sj.failed)) {
+        parallel_run("shard copy", shards, shard_copy_job, &sj);
+
+        /* the first entry of a glued shard extends the last one before it */
+        for(s = 0; s < shards; s++) {
+            SHARD *sh = &sj.shards[s];
+            if(sh->skip) sj.out->netaddrs[sh->offset - 1].broadcast = sh->result->netaddrs[0].broadcast;
+        }
+
+        sj.out->entries = entries;
+        sj.out->unique_ips = unique_ips;
+        sj.out->lines = lines;
+        sj.out->flags |= IPSET_FLAG_OPTIMIZED;
+
+        if(unlikely(debug)) fprintf(stderr, "%s: %s has %zu entries from %zu shards, %zu glued\n", PROG, filename, entries, shards, glued);
+    }
+    else
+        fprintf(stderr, "%s: Cannot allocate memory for the shards of %s\n", PROG, filename);
+
+    for(s = 0; s < shards; s++)
+        if(sj.shards[s].result) ipset_free(sj.shards[s].result);
+
+    free(sj.shards);
+    return sj.failed ? NULL : sj.out;
+}
+
+
+/* ----------------------------------------------------------------------------
+ * the set operations, sharded
+ *
+ */
+
+static ipset *shard_union_op(ipset *root) {
+    return ipset_kmerge_all(root, "union");
+}
+
+static ipset *shard_common_op(ipset *root) {
+    return ipset_common_all(root);
+}
+
+static ipset *shard_diff_op(ipset *root) {
+    return ipset_diff(root, root->next);
+}
+
+static ipset *shard_exclude_all_op(ipset *root) {
+    return ipset_exclude_all(root, root->next);
+}
+
+/* runs op on all the ipsets linked to 'next' from root */
+static ipset *shard_all(ipset *root, const char *filename, IPSET_SHARD_OP op, int coalesced) {
+    ipset **inputs, *ips, *ret;
+    size_t n = 0;
+
+    for(ips = root; ips; ips = ips->next) n++;
+
+    inputs = malloc(n * sizeof(ipset *));
+    if(unlikely(!inputs)) {
+        fprintf(stderr, "%s: Cannot allocate memory for sharding %zu ipsets\n", PROG, n);
+        return NULL;
+    }
+
+    for(ips = root, n = 0; ips; ips = ips->next) inputs[n++] = ips;
+
+    ret = ipset_shard(inputs, n, filename, op, coalesced);
+    free(inputs);
+    return ret;
+}
+
+ipset *ipset_shard_union(ipset *root, const char *filename) {
+    return shard_all(root, filename, shard_union_op, 1);
+}
+
+ipset *ipset_shard_common(ipset *root) {
+    return shard_all(root, "common", shard_common_op, 1);
+}
+
+ipset *ipset_shard_diff(ipset *ips1, ipset *ips2) {
+    ipset *inputs[2] = { ips1, ips2 };
+    return ipset_shard(inputs, 2, "diff", shard_diff_op, 0);
+}
+
+ipset *ipset_shard_exclude_all(ipset *ips1, ipset *root) {
+    ipset **inputs, *ips, *ret;
+    size_t n = 1;
+
+    for(ips = root; ips; ips = ips->next) n++;
+
+    inputs = malloc(n * sizeof(ipset *));
+    if(unlikely(!inputs)) {
+        fprintf(stderr, "%s: Cannot allocate memory for sharding %zu ipsets\n", PROG, n);
+        return NULL;
+    }
+
+    inputs[0] = ips1;
+    for(ips = root, n = 1; ips; ips = ips->next) inputs[n++] = ips;
+
+    ret = ipset_shard(inputs, n, ips1->filename, shard_exclude_all_op, 1);
+    free(inputs);
+    return ret;
+}
@@ -0,0 +1,16 @@
+#ifndef IPRANGE_IPSET_SHARD_H
+#define IPRANGE_IPSET_SHARD_H
+
+typedef ipset *(*IPSET_SHARD_OP)(ipset *root);
+
+extern size_t ipset_shard_min;
+
+extern int ipset_shard_wanted(ipset *first, ipset *second);
+extern ipset *ipset_shard(ipset **inputs, size_t n, const char *filename, IPSET_SHARD_OP op, int coalesced);
+
+extern ipset *ipset_shard_union(ipset *root, const char *filename);
+extern ipset *ipset_shard_common(ipset *root);
+extern ipset *ipset_shard_diff(ipset *ips1, ipset *ips2);
+extern ipset *ipset_shard_exclude_all(ipset *ips1, ipset *root);
+
+#endif //IPRANGE_IPSET_SHARD_H
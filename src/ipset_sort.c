@@ -0,0 +1,140 @@
+#include "iprange.h"
+
+/*
+ * arrays with at least this many entries are sorted with the radix sort,
+ * smaller ones with qsort(); 0 always selects the radix sort and SIZE_MAX
+ * always selects qsort()
+ */
+size_t ipset_sort_radix_min = 16384;
+
+/* ----------------------------------------------------------------------------
+ * ipset_sort_qsort()
+ *
+ * sorts the entries with qsort() and compar_netaddr()
+ *
+ */
+
+void ipset_sort_qsort(network_addr_t *addrs, size_t entries) {
+    qsort((void *)addrs, entries, sizeof(network_addr_t), compar_netaddr);
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_sort_radix()
+ *
+ * LSD radix sort of the entries on the 64-bit key (addr, ~broadcast), which
+ * gives the same order as compar_netaddr(): ascending by address, then
+ * descending by broadcast. Entries with equal keys are identical, so the
+ * result is exactly the one qsort() produces.
+ *
+ * the key is sorted in four 16-bit digits; digits that are the same for all
+ * entries (very common: e.g. all single IPs share the broadcast digits with
+ * their address) are skipped.
+ *
+ * scratch must have room for as many entries as the array; when it is NULL
+ * it is allocated here.
+ *
+ * returns 0 on success, -1 when the scratch space cannot be allocated, in
+ * which case the entries are left untouched.
+ *
+ */
+
+#define RADIX_BITS 16
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_DIGITS 4
+
+static inline uint64_t radix_key(const network_addr_t *na) {
+    return ((uint64_t)na->addr << 32) | (uint64_t)(uint32_t)~na->broadcast;
+}
+
+static inline size_t radix_digit(const network_addr_t *na, unsigned int shift) {
+    return (size_t)((radix_key(na) >> shift) & (RADIX_BUCKETS - 1));
+}
+
+static int ipset_sort_radix_scratch(network_addr_t *addrs, size_t entries, network_addr_t *scratch) {
+    network_addr_t *allocated = NULL, *src = addrs, *dst;
+    size_t *counts, i;
+    int d;
+
+    if(entries < 2) return 0;
+
+    counts = calloc((size_t)RADIX_DIGITS * RADIX_BUCKETS, sizeof(size_t));
+    if(unlikely(!counts)) return -1;
+
+    if(!scratch) {
+        scratch = allocated = malloc(entries * sizeof(network_addr_t));
+        if(unlikely(!scratch)) {
+            free(counts);
+            return -1;
+        }
+    }
+    dst = scratch;
+
+    /* one pass to build the histograms of all digits */
+    for(i = 0; i < entries; i++) {
+        uint64_t key = radix_key(&addrs[i]);
+        for(d = 0; d < RADIX_DIGITS; d++)
+            counts[(size_t)d * RADIX_BUCKETS + ((key >> (d * RADIX_BITS)) & (RADIX_BUCKETS - 1))]++;
+    }
+
+    for(d = 0; d < RADIX_DIGITS; d++) {
+        size_t *c = &counts[(size_t)d * RADIX_BUCKETS];
+        unsigned int shift = (unsigned int)(d * RADIX_BITS);
+        size_t sum = 0, b;
+        network_addr_t *t;
+
+        /* skip digits that are the same on all entries */
+        if(c[radix_digit(&src[0], shift)] == entries)
+            continue;
+
+        for(b = 0; b < RADIX_BUCKETS; b++) {
+            size_t count = c[b];
+            c[b] = sum;
+            sum += count;
+        }
+
+        for(i = 0; i < entries; i++)
+            dst[c[radix_digit(&src[i], shift)]++] = src[i];
+
+        t = src;
+        src = dst;
+        dst = t;
+    }
+
+    if(src != addrs)
+        ipset_copy_entries(addrs, src, entries);
+
+    free(allocated);
+    free(counts);
+    return 0;
+}
+
+int ipset_sort_radix(network_addr_t *addrs, size_t entries) {
+    return ipset_sort_radix_scratch(addrs, entries, NULL);
+}
+
+
+/* ----------------------------------------------------------------------------
+ * ipset_sort()
+ *
+ * sorts the entries in the order of compar_netaddr(), selecting the radix
+ * sort for large arrays (see ipset_sort_radix_min)
+ *
+ */
+
+void ipset_sort(network_addr_t *addrs, size_t entries) {
+    ipset_sort_scratch(addrs, entries, NULL);
+}
+
+/* the same, with a caller provided scratch array of the same size (or NULL) */
+void ipset_sort_scratch(network_addr_t *addrs, size_t entries, network_addr_t *scratch) {
+    if(entries >= ipset_sort_radix_min) {
+        if(likely(!ipset_sort_radix_scratch(addrs, entries, scratch)))
+            return;
+
+        if(unlikely(debug))
+            fprintf(stderr, "%s: Cannot allocate memory for radix sort of %zu entries, using qsort()\n", PROG, entries);
+    }
+
+    ipset_sort_qsort(addrs, entries);
+}
@@ -0,0 +1,11 @@
+#ifndef IPRANGE_IPSET_SORT_H
+#define IPRANGE_IPSET_SORT_H
+
+extern size_t ipset_sort_radix_min;
+
+extern void ipset_sort_qsort(network_addr_t *addrs, size_t entries);
+extern int ipset_sort_radix(network_addr_t *addrs, size_t entries);
+extern void ipset_sort(network_addr_t *addrs, size_t entries);
+extern void ipset_sort_scratch(network_addr_t *addrs, size_t entries, network_addr_t *scratch);
+
+#endif //IPRANGE_IPSET_SORT_H
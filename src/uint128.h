@@ -227,4 +227,15 @@ static inline int u128_mod10(uint128_t a) {
 
 #endif /* __SIZEOF_INT128__ */
 
+/* the number of trailing and leading zero bits of a non-zero value */
+static inline int u128_ctz(uint128_t a) {
+    uint64_t lo = u128_lo64(a);
+    return lo ? __builtin_ctzll(lo) : 64 + __builtin_ctzll(u128_hi64(a));
+}
+
+static inline int u128_clz(uint128_t a) {
+    uint64_t hi = u128_hi64(a);
+    return hi ? __builtin_clzll(hi) : 64 + __builtin_clzll(u128_lo64(a));
+}
+
 #endif /* IPRANGE_UINT128_H */
@@ -0,0 +1,60 @@
+#include "iprange.h"
+#include "tests.unit/test_random.h"
+
+char *PROG = "bench-bitmap-optimize";
+int debug = 0;
+int cidr_use_network = 1;
+int default_prefix = 32;
+int active_family = 0;
+
+/*
+ * compares optimizing a big ipset of random single IPs with the sorted
+ * array engine and with the bitmap engine
+ */
+
+#define BENCH_ENTRIES 50000000
+
+static double now_secs(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+int main(void) {
+    ipset *a = ipset_create("array", BENCH_ENTRIES), *b;
+    uint64_t state = 3;
+    double t, ta, tb;
+    size_t i;
+    int ret = 0;
+
+    if(!a) return 1;
+
+    for(i = 0; i < BENCH_ENTRIES; i++) {
+        in_addr_t addr = rnd(&state);
+        ipset_add_ip_range(a, addr, addr);
+    }
+
+    b = ipset_copy(a);
+    if(!b) return 1;
+
+    ipset_bitmap_min = SIZE_MAX;
+    t = now_secs();
+    ipset_optimize(a);
+    ta = now_secs() - t;
+
+    ipset_bitmap_min = 0;
+    t = now_secs();
+    ipset_optimize(b);
+    tb = now_secs() - t;
+
+    if(a->entries != b->entries || a->unique_ips != b->unique_ips || memcmp(a->netaddrs, b->netaddrs, a->entries * sizeof(network_addr_t))) {
+        fprintf(stderr, "%s: the optimized ipsets differ\n", PROG);
+        ret = 1;
+    }
+
+    printf("%d single IPs: sorted array %8.3f s, bitmap %8.3f s, speedup %6.2fx\n", BENCH_ENTRIES, ta, tb, (tb > 0)?ta / tb:0.0);
+
+    ipset_free(a);
+    ipset_free(b);
+    return ret;
+}
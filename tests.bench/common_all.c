@@ -0,0 +1,95 @@
+#include "iprange.h"
+#include "tests.unit/test_random.h"
+
+char *PROG = "bench-common-all";
+int debug = 0;
+int cidr_use_network = 1;
+int default_prefix = 32;
+int active_family = 0;
+
+/*
+ * compares finding the IPs common to many ipsets with chained ipset_common()
+ * calls (what --common used to do) and with ipset_common_all(), which goes
+ * on pairwise while little is common and sweeps the rest otherwise
+ *
+ * sparse: every ipset has 10.0.0.0/8 and random /24s, so little is common
+ * shared: every ipset has the same /24s and a few random ones, so most
+ * of them are common
+ */
+
+#define BENCH_INPUTS 500
+#define BENCH_INPUT_ENTRIES 20000
+
+static double now_secs(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+static ipset *create_inputs(int shared) {
+    ipset *root = NULL, *last = NULL, *ips;
+    uint64_t state = 1, base;
+    size_t f, i;
+
+    for(f = 0; f < BENCH_INPUTS; f++) {
+        ips = ipset_create("input", BENCH_INPUT_ENTRIES + 1);
+        if(!ips) exit(1);
+
+        if(!shared)
+            ipset_add_ip_range(ips, 0x0a000000U, 0x0affffffU);
+
+        for(i = 0, base = 2; i < BENCH_INPUT_ENTRIES; i++) {
+            in_addr_t addr = network(rnd(shared && i % 10 ? &base : &state), 24);
+            ipset_add_ip_range(ips, addr, broadcast(addr, 24));
+        }
+        ipset_optimize(ips);
+
+        if(last) { last->next = ips; ips->prev = last; }
+        else root = ips;
+        last = ips;
+    }
+
+    return root;
+}
+
+static int bench(const char *name, int shared) {
+    ipset *root = create_inputs(shared), *ips, *pairwise, *all, *tmp;
+    double t, tp, ta;
+    int ret = 0;
+
+    t = now_secs();
+    pairwise = ipset_common(root, root->next);
+    for(ips = root->next->next; pairwise && ips; ips = ips->next) {
+        tmp = ipset_common(pairwise, ips);
+        ipset_free(pairwise);
+        pairwise = tmp;
+    }
+    tp = now_secs() - t;
+
+    t = now_secs();
+    all = ipset_common_all(root);
+    ta = now_secs() - t;
+
+    if(!pairwise || !all || all->entries != pairwise->entries || all->unique_ips != pairwise->unique_ips
+       || memcmp(all->netaddrs, pairwise->netaddrs, all->entries * sizeof(network_addr_t))) {
+        fprintf(stderr, "%s: %s: the common IPs differ\n", PROG, name);
+        ret = 1;
+    }
+
+    printf("%-7s %d ipsets x %d entries (%zu common): pairwise %8.3f s, single pass %8.3f s, speedup %6.2fx\n",
+           name, BENCH_INPUTS, BENCH_INPUT_ENTRIES, all ? all->entries : 0, tp, ta, (ta > 0)?tp / ta:0.0);
+
+    if(pairwise) ipset_free(pairwise);
+    if(all) ipset_free(all);
+    ipset_free_all(root);
+    return ret;
+}
+
+int main(void) {
+    int ret = 0;
+
+    ret += bench("sparse", 0);
+    ret += bench("shared", 1);
+
+    return ret ? 1 : 0;
+}
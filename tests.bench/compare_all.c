@@ -0,0 +1,98 @@
+#include "iprange.h"
+#include "tests.unit/test_random.h"
+
+char *PROG = "bench-compare-all";
+int debug = 0;
+int cidr_use_network = 1;
+int default_prefix = 32;
+int active_family = 0;
+
+/*
+ * compares finding the common IPs of all the pairs of many ipsets with
+ * ipset_combine() and ipset_optimize() on every pair (what --compare used
+ * to do) and with a single sweep of ipset_compare_all()
+ */
+
+#define BENCH_INPUT_ENTRIES 5000
+
+static double now_secs(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+static ipset *create_inputs(size_t inputs) {
+    ipset *root = NULL, *last = NULL, *ips;
+    uint64_t state = 1, shared = 2;
+    size_t f, i;
+
+    for(f = 0; f < inputs; f++) {
+        ips = ipset_create("input", BENCH_INPUT_ENTRIES);
+        if(!ips) exit(1);
+
+        /* a third of the entries are shared by all the ipsets */
+        shared = 2;
+        for(i = 0; i < BENCH_INPUT_ENTRIES; i++) {
+            int prefix = 16 + (int)(rnd(&state) % 17);
+            in_addr_t addr = network(rnd(i % 3 ? &state : &shared), prefix);
+            ipset_add_ip_range(ips, addr, broadcast(addr, prefix));
+        }
+        ipset_optimize(ips);
+
+        if(last) { last->next = ips; ips->prev = last; }
+        else root = ips;
+        last = ips;
+    }
+
+    return root;
+}
+
+static int bench(size_t inputs) {
+    ipset *root = create_inputs(inputs), *ips, *ips2, *comips;
+    uint64_t *matrix, *pairwise;
+    size_t n, i, j;
+    double t, tp, ts;
+    int ret = 0;
+
+    pairwise = calloc(inputs * (inputs - 1) / 2, sizeof(uint64_t));
+    if(!pairwise) exit(1);
+
+    t = now_secs();
+    for(ips = root, i = 0; ips; ips = ips->next, i++) {
+        for(ips2 = ips->next, j = i + 1; ips2; ips2 = ips2->next, j++) {
+            comips = ipset_combine(ips, ips2);
+            if(!comips) exit(1);
+            ipset_optimize(comips);
+            pairwise[ipset_compare_pair(inputs, i, j)] = ips->unique_ips + ips2->unique_ips - comips->unique_ips;
+            ipset_free(comips);
+        }
+    }
+    tp = now_secs() - t;
+
+    t = now_secs();
+    matrix = ipset_compare_all(root, &n);
+    ts = now_secs() - t;
+
+    if(!matrix || memcmp(matrix, pairwise, inputs * (inputs - 1) / 2 * sizeof(uint64_t))) {
+        fprintf(stderr, "%s: %zu ipsets: the common IPs differ\n", PROG, inputs);
+        ret = 1;
+    }
+
+    printf("%5zu ipsets x %d entries (%zu pairs): combine and optimize %8.3f s, single sweep %8.3f s, speedup %7.2fx\n",
+           inputs, BENCH_INPUT_ENTRIES, inputs * (inputs - 1) / 2, tp, ts, (ts > 0)?tp / ts:0.0);
+
+    free(matrix);
+    free(pairwise);
+    ipset_free_all(root);
+    return ret;
+}
+
+int main(void) {
+    int ret = 0;
+
+    ret += bench(10);
+    ret += bench(100);
+    ret += bench(400);
+
+    return ret ? 1 : 0;
+}
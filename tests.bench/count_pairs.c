@@ -0,0 +1,84 @@
+#include "iprange.h"
+#include "tests.unit/test_random.h"
+
+char *PROG = "bench-count-pairs";
+int debug = 0;
+int cidr_use_network = 1;
+int default_prefix = 32;
+int active_family = 0;
+
+/*
+ * compares counting the common IPs of pairs of ipsets, as --compare-next and
+ * --compare-first do, by building an optimized ipset_combine() of each pair
+ * (what they used to do) and with ipset_count_common(), which does not
+ * allocate anything
+ */
+
+#define BENCH_INPUTS 20
+#define BENCH_INPUT_ENTRIES 100000
+
+static double now_secs(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+static ipset *create_inputs(uint64_t *state) {
+    ipset *root = NULL, *last = NULL, *ips;
+    size_t f, i;
+
+    for(f = 0; f < BENCH_INPUTS; f++) {
+        ips = ipset_create("input", BENCH_INPUT_ENTRIES);
+        if(!ips) exit(1);
+
+        for(i = 0; i < BENCH_INPUT_ENTRIES; i++) {
+            int prefix = 20 + (int)(rnd(state) % 13);
+            in_addr_t addr = network(rnd(state) & 0x3fffffffU, prefix);
+            ipset_add_ip_range(ips, addr, broadcast(addr, prefix));
+        }
+        ipset_optimize(ips);
+
+        if(last) { last->next = ips; ips->prev = last; }
+        else root = ips;
+        last = ips;
+    }
+
+    return root;
+}
+
+int main(void) {
+    uint64_t state = 1, sum1 = 0, sum2 = 0;
+    ipset *root = create_inputs(&state), *second = create_inputs(&state), *ips, *ips2, *combined;
+    double t, tc, tk;
+
+    t = now_secs();
+    for(ips = root; ips; ips = ips->next) {
+        for(ips2 = second; ips2; ips2 = ips2->next) {
+            combined = ipset_combine(ips, ips2);
+            if(!combined) exit(1);
+            ipset_optimize(combined);
+            sum1 += ips->unique_ips + ips2->unique_ips - combined->unique_ips;
+            ipset_free(combined);
+        }
+    }
+    tc = now_secs() - t;
+
+    t = now_secs();
+    for(ips = root; ips; ips = ips->next)
+        for(ips2 = second; ips2; ips2 = ips2->next)
+            sum2 += ipset_count_common(ips, ips2);
+    tk = now_secs() - t;
+
+    printf("%d x %d ipsets of %d entries: combine and optimize %8.3f s, count %8.3f s, speedup %7.2fx\n",
+           BENCH_INPUTS, BENCH_INPUTS, BENCH_INPUT_ENTRIES, tc, tk, (tk > 0)?tc / tk:0.0);
+
+    ipset_free_all(root);
+    ipset_free_all(second);
+
+    if(sum1 != sum2) {
+        fprintf(stderr, "%s: the common IPs differ\n", PROG);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include "iprange.h"
+#include "tests.unit/test_random.h"
+
+char *PROG = "bench-exclude-all";
+int debug = 0;
+int cidr_use_network = 1;
+int default_prefix = 32;
+int active_family = 0;
+
+/*
+ * compares excluding many ipsets from a large one with chained
+ * ipset_exclude() calls (what --exclude-next used to do) and with
+ * ipset_exclude_all()
+ */
+
+#define BENCH_BASE_ENTRIES 1000000
+#define BENCH_EXCLUDED 40
+#define BENCH_EXCLUDED_ENTRIES 20000
+
+static double now_secs(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+static ipset *create_ipset(uint64_t *state, size_t entries) {
+    ipset *ips = ipset_create("input", entries);
+    size_t i;
+
+    if(!ips) exit(1);
+
+    for(i = 0; i < entries; i++) {
+        in_addr_t addr = network(rnd(state), 28);
+        ipset_add_ip_range(ips, addr, broadcast(addr, 28));
+    }
+    ipset_optimize(ips);
+
+    return ips;
+}
+
+int main(void) {
+    ipset *base, *root = NULL, *last = NULL, *ips, *chained, *all, *tmp;
+    uint64_t state = 1;
+    double t, tc, ta;
+    size_t f;
+    int ret = 0;
+
+    base = create_ipset(&state, BENCH_BASE_ENTRIES);
+    for(f = 0; f < BENCH_EXCLUDED; f++) {
+        ips = create_ipset(&state, BENCH_EXCLUDED_ENTRIES);
+
+        if(last) { last->next = ips; ips->prev = last; }
+        else root = ips;
+        last = ips;
+    }
+
+    t = now_secs();
+    chained = ipset_exclude(base, root);
+    for(ips = root->next; chained && ips; ips = ips->next) {
+        tmp = ipset_exclude(chained, ips);
+        ipset_free(chained);
+        chained = tmp;
+    }
+    tc = now_secs() - t;
+
+    t = now_secs();
+    all = ipset_exclude_all(base, root);
+    ta = now_secs() - t;
+
+    if(!chained || !all || all->entries != chained->entries || all->unique_ips != chained->unique_ips
+       || memcmp(all->netaddrs, chained->netaddrs, all->entries * sizeof(network_addr_t))) {
+        fprintf(stderr, "%s: the results differ\n", PROG);
+        ret = 1;
+    }
+
+    printf("%d entries - %d ipsets x %d entries (%zu left): chained %8.3f s, single pass %8.3f s, speedup %6.2fx\n",
+           BENCH_BASE_ENTRIES, BENCH_EXCLUDED, BENCH_EXCLUDED_ENTRIES, all ? all->entries : 0, tc, ta, (ta > 0)?tc / ta:0.0);
+
+    if(chained) ipset_free(chained);
+    if(all) ipset_free(all);
+    ipset_free(base);
+    ipset_free_all(root);
+    return ret;
+}
@@ -0,0 +1,73 @@
+#include "iprange.h"
+#include "tests.unit/test_random.h"
+
+char *PROG = "bench-gallop-ratio";
+int debug = 0;
+int cidr_use_network = 1;
+int default_prefix = 32;
+int active_family = 0;
+
+/*
+ * compares the linear walk of ipset_common() and ipset_exclude() with
+ * galloping over the larger ipset, for a large ipset of random /32s and
+ * smaller ipsets of random /24s, sweeping the ratio of their sizes
+ */
+
+#define BENCH_LARGE_ENTRIES (4 * 1024 * 1024)
+#define BENCH_LOOPS 5
+
+static double now_secs(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+static double run(ipset *small, ipset *large, int exclude, size_t ratio, ipset **result) {
+    double t;
+    int i;
+
+    ipset_gallop_ratio = ratio;
+
+    t = now_secs();
+    for(i = 0; i < BENCH_LOOPS; i++) {
+        if(*result) ipset_free(*result);
+        *result = exclude ? ipset_exclude(small, large) : ipset_common(small, large);
+        if(!*result) exit(1);
+    }
+
+    return (now_secs() - t) / BENCH_LOOPS;
+}
+
+int main(void) {
+    uint64_t state = 1;
+    ipset *large = random_optimized_ipset(&state, BENCH_LARGE_ENTRIES, 32, 32);
+    size_t ratio;
+    int exclude, ret = 0;
+
+    for(ratio = 1; ratio <= 65536; ratio *= 4) {
+        ipset *small = random_optimized_ipset(&state, BENCH_LARGE_ENTRIES / ratio, 24, 24);
+
+        for(exclude = 0; exclude < 2; exclude++) {
+            ipset *linear = NULL, *gallop = NULL;
+            double tl = run(small, large, exclude, 0, &linear);
+            double tg = run(small, large, exclude, 1, &gallop);
+
+            if(linear->entries != gallop->entries || linear->unique_ips != gallop->unique_ips
+               || memcmp(linear->netaddrs, gallop->netaddrs, linear->entries * sizeof(network_addr_t))) {
+                fprintf(stderr, "%s: ratio %zu: galloping differs\n", PROG, ratio);
+                ret = 1;
+            }
+
+            printf("%-7s %8zu vs %zu entries (ratio %6zu): linear %8.4f s, galloping %8.4f s, speedup %7.2fx\n",
+                   exclude ? "exclude" : "common", small->entries, large->entries, large->entries / small->entries, tl, tg, (tg > 0)?tl / tg:0.0);
+
+            ipset_free(linear);
+            ipset_free(gallop);
+        }
+
+        ipset_free(small);
+    }
+
+    ipset_free(large);
+    return ret;
+}
@@ -0,0 +1,93 @@
+#include "iprange.h"
+#include "tests.unit/test_random.h"
+
+char *PROG = "bench-kmerge-feeds";
+int debug = 0;
+int cidr_use_network = 1;
+int default_prefix = 32;
+int active_family = 0;
+
+/*
+ * compares merging many optimized feeds by concatenating and optimizing
+ * them again (what --merge used to do, with qsort() and with the radix sort)
+ * with the k-way merge
+ */
+
+#define BENCH_FEEDS 2000
+#define BENCH_FEED_ENTRIES 2000
+
+static double now_secs(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+static ipset *concat_optimize(ipset *root) {
+    ipset *concat = ipset_create("concat", 0), *ips;
+
+    if(!concat) return NULL;
+
+    for(ips = root; ips; ips = ips->next)
+        if(ipset_merge(concat, ips)) {
+            ipset_free(concat);
+            return NULL;
+        }
+
+    ipset_optimize(concat);
+    return concat;
+}
+
+int main(void) {
+    ipset *root = NULL, *last = NULL, *ips, *concat, *merged;
+    uint64_t state = 1;
+    size_t f, i;
+    double t, tq, tc, tk;
+    int ret = 0;
+
+    for(f = 0; f < BENCH_FEEDS; f++) {
+        ips = ipset_create("feed", BENCH_FEED_ENTRIES);
+        if(!ips) return 1;
+
+        for(i = 0; i < BENCH_FEED_ENTRIES; i++) {
+            int prefix = 20 + (int)(rnd(&state) % 13);
+            in_addr_t addr = network(rnd(&state), prefix);
+            ipset_add_ip_range(ips, addr, broadcast(addr, prefix));
+        }
+        ipset_optimize(ips);
+
+        if(last) { last->next = ips; ips->prev = last; }
+        else root = ips;
+        last = ips;
+    }
+
+    ipset_sort_radix_min = SIZE_MAX;
+    t = now_secs();
+    concat = concat_optimize(root);
+    tq = now_secs() - t;
+    if(!concat) return 1;
+    ipset_free(concat);
+
+    ipset_sort_radix_min = 0;
+    t = now_secs();
+    concat = concat_optimize(root);
+    tc = now_secs() - t;
+    if(!concat) return 1;
+
+    t = now_secs();
+    merged = ipset_kmerge_all(root, "kmerge");
+    tk = now_secs() - t;
+
+    if(ret || !merged || merged->entries != concat->entries || merged->unique_ips != concat->unique_ips
+       || merged->lines != concat->lines || memcmp(merged->netaddrs, concat->netaddrs, merged->entries * sizeof(network_addr_t))) {
+        fprintf(stderr, "%s: the merged ipsets differ\n", PROG);
+        ret = 1;
+    }
+
+    printf("%d feeds x %d entries: concat+qsort() %8.3f s, concat+radix %8.3f s, k-way merge %8.3f s, speedup %6.2fx / %6.2fx\n",
+           BENCH_FEEDS, BENCH_FEED_ENTRIES, tq, tc, tk, (tk > 0)?tq / tk:0.0, (tk > 0)?tc / tk:0.0);
+
+    if(merged) ipset_free(merged);
+    ipset_free(concat);
+    ipset_free_all(root);
+    return ret;
+}
@@ -0,0 +1,72 @@
+#include "iprange.h"
+
+char *PROG = "bench-parse-ipv4";
+int debug = 0;
+int cidr_use_network = 1;
+int default_prefix = 32;
+int active_family = 0;
+
+/*
+ * compares the single pass IPv4 parser used by the loader, with the
+ * generic str2netaddr() (inet_aton() based) path it replaces
+ */
+
+#define BENCH_TOKENS 1000000
+#define BENCH_ROUNDS 5
+
+static double now_secs(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+int main(void) {
+    static char tokens[BENCH_TOKENS][IP2STR_MAX_LEN + 4];
+    char buf[IP2STR_MAX_LEN + 4];
+    unsigned int seed = 1;
+    in_addr_t check_slow = 0, check_fast = 0;
+    double t, slow = 0, fast = 0;
+    size_t i;
+    int r;
+
+    for(i = 0; i < BENCH_TOKENS; i++) {
+        seed = seed * 1103515245U + 12345U;
+        ip2str_r(tokens[i], (in_addr_t)seed ^ ((in_addr_t)seed << 13));
+        if(i % 4 == 0) strcat(tokens[i], "/24");
+    }
+
+    for(r = 0; r < BENCH_ROUNDS; r++) {
+        t = now_secs();
+        for(i = 0; i < BENCH_TOKENS; i++) {
+            int err = 0;
+            network_addr_t n;
+            memcpy(buf, tokens[i], sizeof(buf));
+            n = str2netaddr(buf, &err);
+            check_slow += n.addr ^ n.broadcast;
+        }
+        slow += now_secs() - t;
+
+        t = now_secs();
+        for(i = 0; i < BENCH_TOKENS; i++) {
+            network_addr_t n;
+            memcpy(buf, tokens[i], sizeof(buf));
+            if(unlikely(!ipv4_fast_parse(buf, &n))) {
+                fprintf(stderr, "%s: cannot parse %s\n", PROG, buf);
+                return 1;
+            }
+            check_fast += n.addr ^ n.broadcast;
+        }
+        fast += now_secs() - t;
+    }
+
+    if(check_slow != check_fast) {
+        fprintf(stderr, "%s: parsers disagree\n", PROG);
+        return 1;
+    }
+
+    printf("str2netaddr():      %7.2f ns/token\n", slow * 1e9 / (BENCH_TOKENS * BENCH_ROUNDS));
+    printf("ipv4_fast_parse():  %7.2f ns/token\n", fast * 1e9 / (BENCH_TOKENS * BENCH_ROUNDS));
+    printf("speedup:            %7.2fx\n", (fast > 0)?slow / fast:0.0);
+
+    return 0;
+}
@@ -0,0 +1,137 @@
+#include "iprange.h"
+#include "tests.unit/test_random.h"
+
+char *PROG = "bench-print-output";
+int debug = 0;
+int cidr_use_network = 1;
+int default_prefix = 32;
+int active_family = 0;
+
+/*
+ * compares printing ranges and single IPs with printf() per line (what
+ * ipset_print() used to do) and with the output buffer, writing both to
+ * temporary files, which must be the same
+ */
+
+#define BENCH_ENTRIES 1000000
+
+static double now_secs(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+static void printf_ranges(ipset *ips) {
+    char buf[IP2STR_MAX_LEN + 1];
+    size_t i;
+
+    for(i = 0; i < ips->entries; i++) {
+        in_addr_t lo = ips->netaddrs[i].addr, hi = ips->netaddrs[i].broadcast;
+
+        if(lo == hi) {
+            printf("%s%s-", print_prefix_ips, ip2str_r(buf, lo));
+            printf("%s%s\n", ip2str_r(buf, hi), print_suffix_ips);
+        }
+        else {
+            printf("%s%s-", print_prefix_nets, ip2str_r(buf, lo));
+            printf("%s%s\n", ip2str_r(buf, hi), print_suffix_nets);
+        }
+    }
+}
+
+static void printf_single_ips(ipset *ips) {
+    char buf[IP2STR_MAX_LEN + 1];
+    size_t i;
+
+    for(i = 0; i < ips->entries; i++) {
+        in_addr_t x, start = ips->netaddrs[i].addr, end = ips->netaddrs[i].broadcast;
+
+        for(x = start; x >= start && x <= end; x++)
+            printf("%s%s%s\n", print_prefix_ips, ip2str_r(buf, x), print_suffix_ips);
+    }
+}
+
+/* runs fn with stdout going to a new temporary file, and returns its fd */
+static int to_file(void (*printf_fn)(ipset *), IPSET_PRINT_CMD print, ipset *ips, double *secs) {
+    char path[] = "/tmp/bench-print-output-XXXXXX";
+    int fd = mkstemp(path), saved = dup(STDOUT_FILENO);
+    double t;
+
+    if(fd < 0 || saved < 0) exit(1);
+    unlink(path);
+
+    fflush(stdout);
+    dup2(fd, STDOUT_FILENO);
+
+    t = now_secs();
+    if(printf_fn) {
+        printf_fn(ips);
+        fflush(stdout);
+    }
+    else
+        ipset_print(ips, print);
+    *secs = now_secs() - t;
+
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    return fd;
+}
+
+static int same_files(int fd1, int fd2) {
+    off_t size1 = lseek(fd1, 0, SEEK_END), size2 = lseek(fd2, 0, SEEK_END);
+    int same = 0;
+
+    if(size1 == size2) {
+        char *m1 = mmap(NULL, (size_t)size1, PROT_READ, MAP_PRIVATE, fd1, 0);
+        char *m2 = mmap(NULL, (size_t)size2, PROT_READ, MAP_PRIVATE, fd2, 0);
+
+        same = (m1 != MAP_FAILED && m2 != MAP_FAILED && !memcmp(m1, m2, (size_t)size1));
+        if(m1 != MAP_FAILED) munmap(m1, (size_t)size1);
+        if(m2 != MAP_FAILED) munmap(m2, (size_t)size2);
+    }
+
+    close(fd1);
+    close(fd2);
+    return same;
+}
+
+static int bench(const char *name, void (*printf_fn)(ipset *), IPSET_PRINT_CMD print, ipset *ips) {
+    double tp, tb;
+    int fd1 = to_file(printf_fn, print, ips, &tp);
+    off_t bytes = lseek(fd1, 0, SEEK_END);
+    int fd2 = to_file(NULL, print, ips, &tb);
+
+    if(!same_files(fd1, fd2)) {
+        fprintf(stderr, "%s: the %s output differs\n", PROG, name);
+        return 1;
+    }
+
+    printf("%-10s %10.1f MB: printf() %8.3f s (%7.1f MB/s), buffered %8.3f s (%7.1f MB/s), speedup %6.2fx\n",
+           name, (double)bytes / 1e6, tp, (double)bytes / 1e6 / tp, tb, (double)bytes / 1e6 / tb, (tb > 0)?tp / tb:0.0);
+    return 0;
+}
+
+int main(void) {
+    ipset *ips = ipset_create("input", BENCH_ENTRIES);
+    uint64_t state = 1;
+    size_t i;
+    int ret = 0;
+
+    if(!ips) return 1;
+
+    for(i = 0; i < BENCH_ENTRIES; i++) {
+        in_addr_t addr = network(rnd(&state), 28 + (int)(rnd(&state) % 5));
+        ipset_add_ip_range(ips, addr, broadcast(addr, 28 + (int)(rnd(&state) % 5)));
+    }
+    ipset_optimize(ips);
+
+    ret += bench("ranges", printf_ranges, PRINT_RANGE, ips);
+    ret += bench("single IPs", printf_single_ips, PRINT_SINGLE_IPS, ips);
+
+    print_prefix_ips = print_prefix_nets = "add blocklist ";
+    print_suffix_ips = print_suffix_nets = " timeout 3600";
+    ret += bench("restore", printf_single_ips, PRINT_SINGLE_IPS, ips);
+
+    ipset_free(ips);
+    return ret;
+}
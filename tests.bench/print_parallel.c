@@ -0,0 +1,102 @@
+#include "iprange.h"
+#include "tests.unit/test_random.h"
+
+char *PROG = "bench-print-parallel";
+int debug = 0;
+int cidr_use_network = 1;
+int default_prefix = 32;
+int active_family = 0;
+
+/*
+ * compares printing a large ipset on one thread and on BENCH_THREADS
+ * threads, in CIDR, range and single IP format, writing both to temporary
+ * files, which must be the same
+ */
+
+#define BENCH_ENTRIES 2000000
+#define BENCH_THREADS 4
+
+static double now_secs(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+/* prints ips with stdout going to a new temporary file, and returns its fd */
+static int to_file(ipset *ips, IPSET_PRINT_CMD print, int threads, double *secs) {
+    char path[] = "/tmp/bench-print-parallel-XXXXXX";
+    int fd = mkstemp(path), saved = dup(STDOUT_FILENO);
+    double t;
+
+    if(fd < 0 || saved < 0) exit(1);
+    unlink(path);
+
+    fflush(stdout);
+    dup2(fd, STDOUT_FILENO);
+
+    parallel_threads = threads;
+    t = now_secs();
+    ipset_print(ips, print);
+    *secs = now_secs() - t;
+    parallel_threads = 1;
+
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    return fd;
+}
+
+static int same_files(int fd1, int fd2) {
+    off_t size1 = lseek(fd1, 0, SEEK_END), size2 = lseek(fd2, 0, SEEK_END);
+    int same = 0;
+
+    if(size1 == size2) {
+        char *m1 = mmap(NULL, (size_t)size1, PROT_READ, MAP_PRIVATE, fd1, 0);
+        char *m2 = mmap(NULL, (size_t)size2, PROT_READ, MAP_PRIVATE, fd2, 0);
+
+        same = (m1 != MAP_FAILED && m2 != MAP_FAILED && !memcmp(m1, m2, (size_t)size1));
+        if(m1 != MAP_FAILED) munmap(m1, (size_t)size1);
+        if(m2 != MAP_FAILED) munmap(m2, (size_t)size2);
+    }
+
+    close(fd1);
+    close(fd2);
+    return same;
+}
+
+static int bench(const char *name, IPSET_PRINT_CMD print, ipset *ips) {
+    double t1, tn;
+    int fd1 = to_file(ips, print, 1, &t1);
+    off_t bytes = lseek(fd1, 0, SEEK_END);
+    int fd2 = to_file(ips, print, BENCH_THREADS, &tn);
+
+    if(!same_files(fd1, fd2)) {
+        fprintf(stderr, "%s: the %s output differs\n", PROG, name);
+        return 1;
+    }
+
+    printf("%-10s %10.1f MB: 1 thread %8.3f s (%7.1f MB/s), %d threads %8.3f s (%7.1f MB/s), speedup %6.2fx\n",
+           name, (double)bytes / 1e6, t1, (double)bytes / 1e6 / t1, BENCH_THREADS, tn, (double)bytes / 1e6 / tn, (tn > 0)?t1 / tn:0.0);
+    return 0;
+}
+
+int main(void) {
+    ipset *ips = ipset_create("input", BENCH_ENTRIES);
+    uint64_t state = 1;
+    size_t i;
+    int ret = 0;
+
+    if(!ips) return 1;
+
+    for(i = 0; i < BENCH_ENTRIES; i++) {
+        in_addr_t addr = rnd(&state);
+        ipset_add_ip_range(ips, addr, addr + (rnd(&state) % 64));
+    }
+    ipset_optimize(ips);
+
+    ret += bench("cidr", PRINT_CIDR, ips);
+    ret += bench("ranges", PRINT_RANGE, ips);
+    ret += bench("single IPs", PRINT_SINGLE_IPS, ips);
+
+    ipset_free(ips);
+    return ret;
+}
@@ -0,0 +1,110 @@
+#include "iprange.h"
+#include "tests.unit/test_random.h"
+
+char *PROG = "bench-shard-ops";
+int debug = 0;
+int cidr_use_network = 1;
+int default_prefix = 32;
+int active_family = 0;
+
+/*
+ * compares the sequential set operations with the sharded ones, on two
+ * large ipsets of random ranges that mostly overlap, like the aggregates
+ * of two consecutive days
+ */
+
+#define BENCH_ENTRIES (8 * 1024 * 1024)
+#define BENCH_THREADS 4
+
+static double now_secs(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+static ipset *create_ipset(uint64_t seed, uint64_t other) {
+    ipset *ips = ipset_create("input", BENCH_ENTRIES);
+    uint64_t state = 1;
+    size_t i;
+
+    if(!ips) exit(1);
+
+    for(i = 0; i < BENCH_ENTRIES; i++) {
+        /* 1 in 20 entries differs between the two */
+        in_addr_t addr = rnd(i % 20 ? &state : &seed);
+        int prefix = 24 + (int)(rnd(&other) % 9);
+
+        addr = network(addr, prefix);
+        ipset_add_ip_range(ips, addr, broadcast(addr, prefix));
+    }
+
+    ipset_optimize(ips);
+    return ips;
+}
+
+static int bench(const char *name, ipset *sequential, ipset *(*sharded)(ipset *, ipset *), ipset *ips1, ipset *ips2, double ts) {
+    ipset *result;
+    double t;
+    int ret = 0;
+
+    parallel_threads = BENCH_THREADS;
+    t = now_secs();
+    result = sharded(ips1, ips2);
+    t = now_secs() - t;
+    parallel_threads = 1;
+
+    if(!result || !sequential || result->entries != sequential->entries || result->unique_ips != sequential->unique_ips
+       || memcmp(result->netaddrs, sequential->netaddrs, result->entries * sizeof(network_addr_t))) {
+        fprintf(stderr, "%s: %s: the sharded result differs\n", PROG, name);
+        ret = 1;
+    }
+
+    printf("%-8s %zu + %zu entries: sequential %8.3f s, %d threads %8.3f s, speedup %6.2fx\n",
+           name, ips1->entries, ips2->entries, ts, BENCH_THREADS, t, (t > 0)?ts / t:0.0);
+
+    if(result) ipset_free(result);
+    if(sequential) ipset_free(sequential);
+    return ret;
+}
+
+static ipset *union2(ipset *ips1, ipset *ips2) {
+    ipset *ret;
+
+    ips1->next = ips2;
+    ret = ipset_shard_union(ips1, "union");
+    ips1->next = NULL;
+    return ret;
+}
+
+static ipset *common2(ipset *ips1, ipset *ips2) {
+    ipset *ret;
+
+    ips1->next = ips2;
+    ret = ipset_shard_common(ips1);
+    ips1->next = NULL;
+    return ret;
+}
+
+int main(void) {
+    ipset *ips1 = create_ipset(2, 3), *ips2 = create_ipset(4, 3), *r;
+    double t;
+    int ret = 0;
+
+    t = now_secs(); r = ipset_diff(ips1, ips2); t = now_secs() - t;
+    ret += bench("diff", r, ipset_shard_diff, ips1, ips2, t);
+
+    t = now_secs(); r = ipset_exclude(ips1, ips2); t = now_secs() - t;
+    ret += bench("exclude", r, ipset_shard_exclude_all, ips1, ips2, t);
+
+    t = now_secs(); r = ipset_common(ips1, ips2); t = now_secs() - t;
+    ret += bench("common", r, common2, ips1, ips2, t);
+
+    ips1->next = ips2;
+    t = now_secs(); r = ipset_kmerge_all(ips1, "union"); t = now_secs() - t;
+    ips1->next = NULL;
+    ret += bench("union", r, union2, ips1, ips2, t);
+
+    ipset_free(ips1);
+    ipset_free(ips2);
+    return ret ? 1 : 0;
+}
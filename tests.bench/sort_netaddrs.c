@@ -0,0 +1,84 @@
+#include "iprange.h"
+#include "tests.unit/test_random.h"
+
+char *PROG = "bench-sort-netaddrs";
+int debug = 0;
+int cidr_use_network = 1;
+int default_prefix = 32;
+int active_family = 0;
+
+/*
+ * compares qsort() with the radix sort used by ipset_optimize(),
+ * on random entries and on clustered (mostly single IPs of a few /16) ones
+ */
+
+#define BENCH_ENTRIES 10000000
+
+static double now_secs(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+static void fill_random(network_addr_t *a, size_t n) {
+    uint64_t state = 1;
+    size_t i;
+
+    for(i = 0; i < n; i++)
+        random_cidr(&state, 16, 32, 0, UINT64_C(1) << 32, &a[i]);
+}
+
+static void fill_clustered(network_addr_t *a, size_t n) {
+    uint64_t state = 2;
+    size_t i;
+
+    for(i = 0; i < n; i++) {
+        a[i].addr = (in_addr_t)(0x0a000000U + ((rnd(&state) % 16) << 16) + (rnd(&state) & 0xffff));
+        a[i].broadcast = a[i].addr;
+    }
+}
+
+static int bench(const char *name, void (*fill)(network_addr_t *, size_t), size_t n) {
+    network_addr_t *a = malloc(n * sizeof(network_addr_t));
+    network_addr_t *b = malloc(n * sizeof(network_addr_t));
+    double t, tq, tr;
+    int ret = 0;
+
+    if(!a || !b) {
+        fprintf(stderr, "%s: cannot allocate memory\n", PROG);
+        free(a);
+        free(b);
+        return 1;
+    }
+
+    fill(a, n);
+    ipset_copy_entries(b, a, n);
+
+    t = now_secs();
+    ipset_sort_qsort(a, n);
+    tq = now_secs() - t;
+
+    t = now_secs();
+    if(ipset_sort_radix(b, n)) ret = 1;
+    tr = now_secs() - t;
+
+    if(ret || memcmp(a, b, n * sizeof(network_addr_t))) {
+        fprintf(stderr, "%s: %s: the sorted arrays differ\n", PROG, name);
+        ret = 1;
+    }
+
+    printf("%-10s %9zu entries: qsort() %8.3f s, radix %8.3f s, speedup %6.2fx\n", name, n, tq, tr, (tr > 0)?tq / tr:0.0);
+
+    free(a);
+    free(b);
+    return ret;
+}
+
+int main(void) {
+    int ret = 0;
+
+    ret += bench("random", fill_random, BENCH_ENTRIES);
+    ret += bench("clustered", fill_clustered, BENCH_ENTRIES);
+
+    return ret ? 1 : 0;
+}
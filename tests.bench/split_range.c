@@ -0,0 +1,125 @@
+#include "iprange.h"
+#include "tests.unit/test_random.h"
+
+char *PROG = "bench-split-range";
+int debug = 0;
+int cidr_use_network = 1;
+int default_prefix = 32;
+int active_family = 0;
+
+/*
+ * compares the recursive split_range() that -C output and ipset_reduce() used
+ * to call per CIDR block, with the iterative decomposition into a batch and
+ * with counting the blocks without producing them
+ */
+
+#define BENCH_RANGES 1000000
+#define BENCH_ROUNDS 5
+
+static uint64_t sink_addr;
+static size_t sink_blocks;
+
+static double now_secs(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+static void sink(in_addr_t addr, int prefix) {
+    sink_addr += addr + (uint64_t)prefix;
+    sink_blocks++;
+}
+
+/* the recursive split_range() the decomposition replaced */
+static int recursive(in_addr_t addr, int prefix, in_addr_t lo, in_addr_t hi, void (*print)(in_addr_t, int)) {
+    in_addr_t bc = broadcast(addr, prefix), upper_half;
+
+    if(lo == addr && hi == bc && prefix_enabled[prefix]) {
+        print(addr, prefix);
+        return 1;
+    }
+
+    prefix++;
+    upper_half = set_bit(addr, prefix, 1);
+
+    if(hi < upper_half)
+        return recursive(addr, prefix, lo, hi, print);
+    else if(lo >= upper_half)
+        return recursive(upper_half, prefix, lo, hi, print);
+    else
+        return recursive(addr, prefix, lo, broadcast(addr, prefix), print) + recursive(upper_half, prefix, upper_half, hi, print);
+}
+
+static int bench(const char *name, network_addr_t *ranges) {
+    size_t counters[33], i, r, blocks_recursive = 0, blocks_batch = 0, blocks_count = 0;
+    uint64_t addr_recursive, addr_batch;
+    double t, tr, tb, tc;
+
+    t = now_secs();
+    sink_addr = 0;
+    for(r = 0; r < BENCH_ROUNDS; r++)
+        for(i = 0; i < BENCH_RANGES; i++)
+            blocks_recursive += (size_t)recursive(0, 0, ranges[i].addr, ranges[i].broadcast, sink);
+    tr = now_secs() - t;
+    addr_recursive = sink_addr;
+
+    t = now_secs();
+    sink_addr = 0;
+    for(r = 0; r < BENCH_ROUNDS; r++)
+        for(i = 0; i < BENCH_RANGES; i++) {
+            SPLIT_RANGE_CURSOR c;
+            IPSET_CIDR cidrs[SPLIT_RANGE_BATCH];
+            size_t j, k;
+
+            split_range_start(&c, ranges[i].addr, ranges[i].broadcast);
+            while((k = split_range_cidrs(&c, cidrs, SPLIT_RANGE_BATCH))) {
+                for(j = 0; j < k; j++)
+                    sink_addr += cidrs[j].addr + (uint64_t)cidrs[j].prefix;
+                blocks_batch += k;
+            }
+        }
+    tb = now_secs() - t;
+    addr_batch = sink_addr;
+
+    t = now_secs();
+    memset(counters, 0, sizeof(counters));
+    for(r = 0; r < BENCH_ROUNDS; r++)
+        for(i = 0; i < BENCH_RANGES; i++)
+            blocks_count += split_range_count(ranges[i].addr, ranges[i].broadcast, counters);
+    tc = now_secs() - t;
+
+    if(blocks_recursive != blocks_batch || blocks_recursive != blocks_count || addr_recursive != addr_batch) {
+        fprintf(stderr, "%s: the %s blocks differ\n", PROG, name);
+        return 1;
+    }
+
+    printf("%-12s %10zu blocks: recursive %7.3f s, batch %7.3f s (%5.2fx), count %7.3f s (%6.2fx)\n",
+           name, blocks_recursive, tr, tb, (tb > 0)?tr / tb:0.0, tc, (tc > 0)?tr / tc:0.0);
+    return 0;
+}
+
+int main(void) {
+    network_addr_t *ranges = malloc(BENCH_RANGES * sizeof(network_addr_t));
+    uint64_t state = 1;
+    size_t i;
+    int ret = 0, p;
+
+    if(!ranges) return 1;
+
+    /* ranges of random sizes that start and end anywhere */
+    for(i = 0; i < BENCH_RANGES; i++) {
+        ranges[i].addr = rnd(&state);
+        ranges[i].broadcast = ranges[i].addr + (rnd(&state) >> (8 + rnd(&state) % 24));
+        if(ranges[i].broadcast < ranges[i].addr) ranges[i].broadcast = UINT32_MAX;
+    }
+
+    ret += bench("all prefixes", ranges);
+
+    /* blocks of disabled prefixes are split, as after --ipset-reduce */
+    for(p = 1; p < 32; p += 2)
+        prefix_enabled[p] = 0;
+    ret += bench("even prefixes", ranges);
+
+    free(ranges);
+    return ret;
+}
@@ -60,7 +60,7 @@ done
 mkdir -p "$tmpdir/build"
 if ! (
     cd "$tmpdir/build" &&
-    "$srcdir/configure" --disable-man --without-compare-with-common >"$log" 2>&1 &&
+    "$srcdir/configure" --disable-man >"$log" 2>&1 &&
     make -j1 >>"$log" 2>&1
 ); then
     cat "$log"
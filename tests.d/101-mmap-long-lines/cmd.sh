@@ -0,0 +1,19 @@
+#!/bin/bash
+# Regular files are parsed in place from a memory mapping:
+# lines longer than the stream buffer and a missing final newline must both work.
+
+tmpdir=$(mktemp -d)
+trap 'rm -rf "$tmpdir"' EXIT
+
+{
+    printf '10.0.0.1 # %s\n' "$(printf '%02000d' 0)"
+    printf '10.0.0.2\n'
+    printf '10.0.0.3 - 10.0.0.7\n'
+    printf '192.168.1.0/24'
+} > "$tmpdir/input"
+
+echo "# file"
+../../iprange "$tmpdir/input"
+
+echo "# stdin, no final newline"
+printf '10.0.0.1\n192.168.1.0/24' | ../../iprange
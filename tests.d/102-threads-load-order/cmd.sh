@@ -0,0 +1,36 @@
+#!/bin/bash
+# --threads loads @directory and @filelist inputs in parallel,
+# the ipsets must keep the order of sequential loading.
+
+tmpdir=$(mktemp -d)
+trap 'rm -rf "$tmpdir"' EXIT
+
+mkdir "$tmpdir/dir" "$tmpdir/dir6"
+for n in 9 3 7 1 5 2 8 4 6; do
+    seq 1 $((n * 50)) | awk -v n="$n" '{ printf("10.%d.%d.%d\n", n, int($1 / 200), $1 % 200) }' >"$tmpdir/dir/feed-$n"
+    printf '2001:db8:%x::/48\n' "$n" >"$tmpdir/dir6/feed-$n"
+done
+
+ls "$tmpdir/dir"/feed-* | sort -r >"$tmpdir/list"
+echo "$tmpdir/missing" >"$tmpdir/list-bad"
+
+../../iprange --header --count-unique-all "@$tmpdir/dir" >"$tmpdir/seq" 2>&1
+../../iprange --threads 4 --header --count-unique-all "@$tmpdir/dir" >"$tmpdir/par" 2>&1
+cmp -s "$tmpdir/seq" "$tmpdir/par" || { echo "# ERROR: @directory output differs with --threads"; diff "$tmpdir/seq" "$tmpdir/par"; }
+
+../../iprange --header --count-unique-all "@$tmpdir/list" >"$tmpdir/seq" 2>&1
+../../iprange --threads 3 --header --count-unique-all "@$tmpdir/list" >"$tmpdir/par" 2>&1
+cmp -s "$tmpdir/seq" "$tmpdir/par" || { echo "# ERROR: @filelist output differs with --threads"; diff "$tmpdir/seq" "$tmpdir/par"; }
+
+../../iprange -6 --header --count-unique-all "@$tmpdir/dir6" >"$tmpdir/seq6" 2>&1
+../../iprange -6 --threads 4 --header --count-unique-all "@$tmpdir/dir6" >"$tmpdir/par" 2>&1
+cmp -s "$tmpdir/seq6" "$tmpdir/par" || { echo "# ERROR: IPv6 @directory output differs with --threads"; diff "$tmpdir/seq6" "$tmpdir/par"; }
+
+echo "# filelist"
+sed "s#$tmpdir#TMP#g" "$tmpdir/seq"
+
+echo "# ipv6 directory"
+sed "s#$tmpdir#TMP#g" "$tmpdir/seq6"
+
+echo "# failure"
+../../iprange --threads 2 --count-unique-all "@$tmpdir/list-bad" 2>&1 | sed "s#$tmpdir#TMP#g"
@@ -0,0 +1,30 @@
+#!/bin/bash
+# --threads parses a large regular file in chunks;
+# the result and the line numbers of errors must match sequential parsing.
+
+tmpdir=$(mktemp -d)
+trap 'rm -rf "$tmpdir"' EXIT
+
+seq 1 200000 | awk '{
+    v = ($1 * 7919) % 200000
+    if($1 % 3 == 0) printf("10.%d.%d.%d/30 # comment\n", int(v / 65536), int(v / 256) % 256, v % 256)
+    else if($1 % 3 == 1) printf("172.%d.%d.%d\n", 16 + int(v / 65536), int(v / 256) % 256, v % 256)
+    else printf("192.168.%d.1 - 192.168.%d.9\n", v % 256, v % 256)
+}' >"$tmpdir/big"
+
+../../iprange --print-binary "$tmpdir/big" >"$tmpdir/seq"
+../../iprange --threads 7 --print-binary "$tmpdir/big" >"$tmpdir/par"
+cmp -s "$tmpdir/seq" "$tmpdir/par" || echo "# ERROR: --threads changed the loaded ipset"
+
+echo "# count"
+../../iprange --threads 7 -C "$tmpdir/big"
+
+{
+    sed -n '1,150000p' "$tmpdir/big"
+    echo "10.1.2.300"
+    sed -n '150001,$p' "$tmpdir/big"
+    printf '10.1.2.400'
+} >"$tmpdir/bad"
+
+echo "# errors"
+../../iprange --threads 7 "$tmpdir/bad" 2>&1 >/dev/null | sed "s#$tmpdir#TMP#g" | sort
@@ -0,0 +1,46 @@
+#!/bin/bash
+# --bitmap computes the set operations on a bitmap of the IPv4 space;
+# the results must match the sorted array engine exactly.
+
+tmpdir=$(mktemp -d)
+trap 'rm -rf "$tmpdir"' EXIT
+
+cat >"$tmpdir/a" <<EOF2
+0.0.0.0
+0.0.0.2/31
+10.0.0.0/8
+10.1.2.3
+192.168.1.63 - 192.168.1.129
+255.255.255.255
+EOF2
+
+cat >"$tmpdir/b" <<EOF2
+0.0.0.1
+10.255.255.255 - 11.0.0.64
+192.168.1.64/26
+255.255.255.128/25
+EOF2
+
+cat >"$tmpdir/c" <<EOF2
+0.0.0.0/0
+EOF2
+
+for op in "" "--common" "--except" "--diff"; do
+    for files in "a b" "b a" "a c" "c b"; do
+        set -- $files
+        ../../iprange "$tmpdir/$1" $op "$tmpdir/$2" >"$tmpdir/array"
+        ../../iprange --bitmap "$tmpdir/$1" $op "$tmpdir/$2" >"$tmpdir/bitmap"
+        cmp -s "$tmpdir/array" "$tmpdir/bitmap" || { echo "# ERROR: --bitmap $op $files differs"; diff "$tmpdir/array" "$tmpdir/bitmap"; }
+    done
+done
+
+echo "# merge"
+../../iprange --bitmap "$tmpdir/a" "$tmpdir/b"
+echo "# common"
+../../iprange --bitmap "$tmpdir/a" --common "$tmpdir/b"
+echo "# except"
+../../iprange --bitmap "$tmpdir/a" --except "$tmpdir/b"
+echo "# diff"
+../../iprange --bitmap "$tmpdir/a" --diff "$tmpdir/b"
+echo "# count"
+../../iprange --bitmap -C "$tmpdir/a" "$tmpdir/c"
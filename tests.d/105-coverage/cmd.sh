@@ -0,0 +1,5 @@
+#!/bin/bash
+# IPs found in at least, exactly and at most 2 of 3 files -> exercises ipset_coverage
+../../iprange input1 input2 input3 --coverage-at-least 2
+../../iprange input1 input2 input3 --coverage-exactly 2
+../../iprange input1 input2 input3 --coverage-at-most 2
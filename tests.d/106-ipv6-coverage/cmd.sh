@@ -0,0 +1,5 @@
+#!/bin/bash
+# IPs found in at least, exactly and at most 2 of 3 IPv6 sets -> exercises ipset6_coverage
+../../iprange -6 input1 input2 input3 --coverage-at-least 2
+../../iprange -6 input1 input2 input3 --coverage-exactly 2
+../../iprange -6 input1 input2 input3 --coverage-at-most 2
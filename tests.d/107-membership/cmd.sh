@@ -0,0 +1,3 @@
+#!/bin/bash
+# Disjoint ranges of 3 files with the bitmask of the files they are in -> exercises ipset_membership
+../../iprange --header input1 input2 input3 --membership
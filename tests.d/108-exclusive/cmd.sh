@@ -0,0 +1,5 @@
+#!/bin/bash
+# IPs that only one of 3 files has -> exercises ipset_exclusive_ips and ipset_exclusive
+../../iprange input1 input2 input3 --count-exclusive --header
+../../iprange input1 input2 input3 --exclusive-first
+../../iprange input2 --exclusive-first input3 input1
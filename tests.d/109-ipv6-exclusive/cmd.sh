@@ -0,0 +1,4 @@
+#!/bin/bash
+# IPv6 IPs that only one of 3 files has -> exercises ipset6_exclusive_ips and ipset6_exclusive
+../../iprange -6 input1 input2 input3 --count-exclusive --header
+../../iprange -6 input1 input2 input3 --exclusive-first
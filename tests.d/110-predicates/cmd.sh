@@ -0,0 +1,8 @@
+#!/bin/bash
+# yes/no answers as exit codes, with nothing printed -> exercises ipset_intersects, ipset_is_subset and ipset_equals
+for args in "input1 --intersects input2" "input3 --intersects input2" \
+            "input1 --subset-of input2" "input1 --subset-of input2 input3" "input1 input2 --subset-of input3" \
+            "input1 --equals input2 input3" "input2 input3 --equals input1 input2" "input1 --equals-next input3"; do
+    ../../iprange $args
+    echo "$args: $?"
+done
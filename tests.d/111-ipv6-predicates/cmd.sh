@@ -0,0 +1,8 @@
+#!/bin/bash
+# IPv6 yes/no answers as exit codes, with nothing printed -> exercises ipset6_intersects, ipset6_is_subset and ipset6_equals
+for args in "input1 --intersects input2" "input3 --intersects input2" \
+            "input1 --subset-of input2" "input1 --subset-of input2 input3" "input1 input2 --subset-of input3" \
+            "input1 --equals input2 input3" "input2 input3 --equals input1 input2" "input1 --equals-next input3"; do
+    ../../iprange -6 $args
+    echo "$args: $?"
+done
@@ -0,0 +1,45 @@
+#!/bin/bash
+# --threads formats large ipsets on parallel threads,
+# the output and the prefix counters must be the same as with one thread.
+
+tmpdir=$(mktemp -d)
+trap 'rm -rf "$tmpdir"' EXIT
+
+# 80000 ranges of different sizes, and a few /16 for single IPs
+awk 'BEGIN {
+    for(i = 0; i < 80000; i++) {
+        start = 167772160 + i * 32 + i % 7
+        end = start + i % 13
+        printf("%d.%d.%d.%d-%d.%d.%d.%d\n",
+            int(start / 16777216), int(start / 65536) % 256, int(start / 256) % 256, start % 256,
+            int(end / 16777216), int(end / 65536) % 256, int(end / 256) % 256, end % 256)
+    }
+    print "192.168.0.0/16"
+    print "172.16.0.0/15"
+}' >"$tmpdir/input"
+
+run() {
+    local name="$1"
+    shift
+
+    ../../iprange "$@" "$tmpdir/input" >"$tmpdir/seq" 2>&1
+    ../../iprange --threads 4 "$@" "$tmpdir/input" >"$tmpdir/par" 2>&1
+    cmp -s "$tmpdir/seq" "$tmpdir/par" || { echo "# ERROR: $name output differs with --threads"; diff "$tmpdir/seq" "$tmpdir/par" | head; }
+
+    echo "# $name: $(wc -l <"$tmpdir/seq") lines"
+    head -n 2 "$tmpdir/seq"
+    tail -n 1 "$tmpdir/seq"
+}
+
+run "cidr"
+run "ranges" -j
+run "single ips" -1
+run "min prefix" --min-prefix 24
+run "restore" -1 --print-prefix "add set " --print-suffix " timeout 0"
+
+# the prefix counters of the threads are added up
+../../iprange -v "$tmpdir/input" 2>&1 >/dev/null | sed -n '/printed CIDRs/,/^totals/p' >"$tmpdir/seq"
+../../iprange -v --threads 3 "$tmpdir/input" 2>&1 >/dev/null | sed -n '/printed CIDRs/,/^totals/p' >"$tmpdir/par"
+cmp -s "$tmpdir/seq" "$tmpdir/par" || { echo "# ERROR: prefix counters differ with --threads"; diff "$tmpdir/seq" "$tmpdir/par"; }
+echo "# prefix counters"
+cat "$tmpdir/seq"
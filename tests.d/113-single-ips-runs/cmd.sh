@@ -0,0 +1,16 @@
+#!/bin/bash
+# -1 prints the IPs of IPv6 ranges a /112 at a time; the output must be
+# the same across the /112 boundaries, where the address carries to the
+# groups before its last one, and so must the IPv4 output across /24s.
+
+echo "# ipv4"
+../../iprange -1 input4
+
+echo "# ipv4 with prefix and suffix"
+../../iprange -1 --print-prefix "add set " --print-suffix " timeout 0" input4 | head -n 4
+
+echo "# ipv6"
+../../iprange -6 -1 input6
+
+echo "# ipv6 with prefix and suffix"
+../../iprange -6 -1 --print-prefix "add set " --print-suffix " timeout 0" input6 | head -n 4
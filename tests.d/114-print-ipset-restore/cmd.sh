@@ -0,0 +1,38 @@
+#!/bin/bash
+# --print-ipset-restore prints a script for ipset restore, with the hash
+# of NAME-tmp sized for the entries printed, and the same maxelem on both
+# sets whatever their size; --print-ipset-restore-ips does the same with
+# a hash:ip set of the single IPs.
+
+echo "# hash:net"
+../../iprange --print-ipset-restore blocklist input1
+
+echo "# hash:ip"
+../../iprange --print-ipset-restore-ips blocklist input1
+
+echo "# prefix and suffix strings cannot be used with it"
+../../iprange --print-prefix "add x " --print-ipset-restore blocklist input1 2>&1
+echo "exit $?"
+../../iprange --print-ipset-restore blocklist --print-suffix-nets " timeout 0" input1 2>&1
+echo "exit $?"
+
+echo "# 65536 entries, split by --min-prefix"
+../../iprange --min-prefix 24 --print-ipset-restore blocklist input2 | grep -v '^add'
+
+echo "# 65537 entries"
+../../iprange --min-prefix 24 --print-ipset-restore blocklist input3 | grep -v '^add'
+
+echo "# 65536 entries on threads"
+../../iprange --threads 4 --min-prefix 24 --print-ipset-restore blocklist input2 | grep -c '^add blocklist-tmp 10\.[0-9]*\.[0-9]*\.0/24$'
+
+echo "# 262144 single IPs"
+../../iprange --print-ipset-restore-ips blocklist input4 | grep -v '^add'
+
+echo "# names"
+../../iprange --print-ipset-restore abcdefghijklmnopqrstuvwxyza input1 | head -n 1
+../../iprange --print-ipset-restore abcdefghijklmnopqrstuvwxyzab input1 2>&1
+echo "exit $?"
+../../iprange --print-ipset-restore "a b" input1 2>&1
+echo "exit $?"
+../../iprange -6 --print-ipset-restore blocklist input1 2>&1
+echo "exit $?"
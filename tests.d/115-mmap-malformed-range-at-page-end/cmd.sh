@@ -0,0 +1,35 @@
+#!/bin/bash
+# mapped lines end at their newline, not at a \0: the warnings about a
+# malformed range on the last line of a file that fills a whole page must
+# stop at the end of the line, and never read past the mapping.
+
+tmpdir=$(mktemp -d)
+trap 'rm -rf "$tmpdir"' EXIT
+
+# 4096 bytes: 10.0.0.1 lines, a comment padding them, and the last line
+page() {
+    local last="$1" file="$2"
+
+    awk -v last="$last" 'BEGIN {
+        size = 4096 - length(last) - 1
+        for(n = 0; n + 9 + 2 <= size - 9; n += 9) print "10.0.0.1"
+        pad = "#"
+        while(length(pad) < size - n - 1) pad = pad "#"
+        print pad
+        print last
+    }' >"$file"
+
+    echo "# $(wc -c <"$file") bytes, ending with '$last'"
+}
+
+page "1.2.3.4 - # junk" "$tmpdir/comment"
+../../iprange "$tmpdir/comment" 2>&1 | sed "s|$tmpdir/||"
+echo "exit ${PIPESTATUS[0]}"
+
+page "1.2.3.4 - junk" "$tmpdir/junk"
+../../iprange "$tmpdir/junk" 2>&1 | sed "s|$tmpdir/||"
+echo "exit ${PIPESTATUS[0]}"
+
+# the same line in the middle of a file
+printf '1.2.3.4 - # junk\n5.6.7.8\n' >"$tmpdir/middle"
+../../iprange "$tmpdir/middle" 2>&1
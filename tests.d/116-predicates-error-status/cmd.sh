@@ -0,0 +1,10 @@
+#!/bin/bash
+# errors of the predicates exit with 2, so that they are not taken for the answer no (1)
+for args in "input1 --intersects missing" "input1 --subset-of input1" "--bogus input1 --subset-of input1" \
+            "input1 --equals" "--equals input1" "-6 input1 --intersects missing"; do
+    ../../iprange $args
+    echo "$args: $?"
+done
+# other modes keep exiting with 1 on errors
+../../iprange input1 missing
+echo "exit $?"
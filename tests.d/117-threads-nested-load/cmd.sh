@@ -0,0 +1,18 @@
+#!/bin/bash
+# --threads loads the files of @dir in parallel; each large file is then
+# parsed on the thread of its job, instead of in chunks on threads of its own.
+
+tmpdir=$(mktemp -d)
+trap 'rm -rf "$tmpdir"' EXIT
+
+mkdir "$tmpdir/dir"
+for f in 1 2 3; do
+    seq 1 150000 | awk -v f=$f '{ v = ($1 * 7919 * f) % 200000; printf("10.%d.%d.%d/30 # file %d\n", int(v / 65536), int(v / 256) % 256, v % 256, f) }' >"$tmpdir/dir/$f"
+done
+
+../../iprange --print-binary @"$tmpdir/dir" >"$tmpdir/seq"
+../../iprange --threads 4 --print-binary @"$tmpdir/dir" >"$tmpdir/par"
+cmp -s "$tmpdir/seq" "$tmpdir/par" || echo "# ERROR: --threads changed the loaded ipsets"
+
+echo "# jobs of the load"
+../../iprange -v --threads 4 -C @"$tmpdir/dir" 2>&1 | grep -o 'load[a-z ]*: thread [0-9]* ran [0-9]* of [0-9]* jobs' | sed 's/thread [0-9]* ran [0-9]*/thread ran/' | sort | uniq -c
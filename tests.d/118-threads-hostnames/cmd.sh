@@ -0,0 +1,28 @@
+#!/bin/bash
+# --threads parses a large file with hostnames in all its chunks at once;
+# the chunks share one DNS session, which must not start more DNS threads
+# than --dns-threads and must resolve every hostname.
+
+tmpdir=$(mktemp -d)
+trap 'rm -rf "$tmpdir"' EXIT
+
+seq 1 200000 | awk '{
+    v = ($1 * 7919) % 200000
+    if($1 % 5000 == 0) print "localhost"
+    else printf("10.%d.%d.%d/30\n", int(v / 65536), int(v / 256) % 256, v % 256)
+}' >"$tmpdir/big"
+
+../../iprange --print-binary "$tmpdir/big" >"$tmpdir/seq"
+for run in 1 2 3 4 5; do
+    ../../iprange --threads 8 --dns-threads 2 --print-binary "$tmpdir/big" >"$tmpdir/par"
+    cmp -s "$tmpdir/seq" "$tmpdir/par" || echo "# ERROR: --threads changed the loaded ipset"
+done
+
+echo "# count"
+../../iprange --threads 8 --dns-threads 2 -C "$tmpdir/big"
+
+echo "# DNS threads"
+../../iprange -v --threads 8 --dns-threads 2 -C "$tmpdir/big" 2>&1 | grep -o 'made [0-9]* DNS requests.*threads used [0-9]* of [0-9]*' | awk '{
+    print $1, $2, $3, $4, $5, $6
+    if($(NF - 2) > $NF) print "# ERROR: more DNS threads than --dns-threads"
+}'
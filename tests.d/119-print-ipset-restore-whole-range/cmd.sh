@@ -0,0 +1,12 @@
+#!/bin/bash
+# hash:net sets refuse 0.0.0.0/0, so --print-ipset-restore adds the whole
+# IPv4 range as two /1 blocks; the other printing modes still print /0.
+
+echo "# hash:net"
+echo "0.0.0.0/0" | ../../iprange --print-ipset-restore blocklist
+
+echo "# merged from ranges, on threads"
+printf '0.0.0.0 - 127.255.255.255\n128.0.0.0/1\n' | ../../iprange --threads 4 --print-ipset-restore blocklist | grep '^add'
+
+echo "# CIDRs"
+echo "0.0.0.0/0" | ../../iprange
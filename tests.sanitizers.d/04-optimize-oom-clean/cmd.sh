@@ -30,9 +30,19 @@ int main(void) {
 
     if(!ips) return 2;
 
-    ipset_add_ip_range(ips, 0x0A000001U, 0x0A000001U);
+    /* the radix sort scratch array is the third allocation */
+    debug = 1;
+    ipset_sort_radix_min = 2;
+
     ipset_add_ip_range(ips, 0x0A000003U, 0x0A000003U);
+    ipset_add_ip_range(ips, 0x0A000001U, 0x0A000001U);
+    ipset_add_ip_range(ips, 0x0A000002U, 0x0A000002U);
     ipset_optimize(ips);
+
+    if(ips->entries != 1 || ips->unique_ips != 3)
+        return 1;
+
+    ipset_free(ips);
     return 0;
 }
 EOF
@@ -44,10 +54,14 @@ if ! "${CC:-clang}" \
     -I../../src \
     -fsanitize=address,undefined \
     -g -O1 -fno-omit-frame-pointer \
+    -pthread \
     -Dmalloc=test_malloc \
     "$tmpdir/oom.c" \
     ../../src/ipset.c \
+    ../../src/ipset_bitmap.c \
     ../../src/ipset_optimize.c \
+    ../../src/ipset_parallel.c \
+    ../../src/ipset_sort.c \
     -o "$tmpdir/oom"; then
     echo "# ERROR: failed to build optimize OOM harness"
     exit 1
@@ -56,8 +70,9 @@ fi
 "$tmpdir/oom" >/dev/null 2>"$stderr"
 rc=$?
 
-if [ $rc -eq 0 ]; then
-    echo "# ERROR: optimize OOM harness should fail"
+if [ $rc -ne 0 ]; then
+    echo "# ERROR: optimize OOM harness should fall back to qsort()"
+    cat "$stderr"
     exit 1
 fi
 
@@ -73,4 +88,4 @@ if ! grep -q "Cannot allocate memory" "$stderr"; then
     exit 1
 fi
 
-echo "# OK: optimize OOM path fails cleanly"
+echo "# OK: optimize OOM path falls back cleanly"
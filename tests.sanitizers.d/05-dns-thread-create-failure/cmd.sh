@@ -16,7 +16,6 @@ int debug;
 int cidr_use_network = 1;
 int default_prefix = 32;
 int active_family = 0;
-unsigned long ipv6_dropped_in_ipv4_mode = 0;
 
 int pthread_create(pthread_t *thread, const pthread_attr_t *attr, void *(*start_routine)(void *), void *arg) {
     (void)thread;
@@ -66,17 +65,28 @@ if ! "${CC:-clang}" \
     "$tmpdir/dns_create_fail.c" \
     ../../src/ipset.c \
     ../../src/ipset_binary.c \
+    ../../src/ipset_bitmap.c \
     ../../src/ipset_combine.c \
     ../../src/ipset_common.c \
+    ../../src/ipset_compare.c \
     ../../src/ipset_copy.c \
+    ../../src/ipset_count.c \
+    ../../src/ipset_coverage.c \
     ../../src/ipset_diff.c \
     ../../src/ipset_dns.c \
     ../../src/ipset_exclude.c \
+    ../../src/ipset_kmerge.c \
     ../../src/ipset_load.c \
+    ../../src/ipset_membership.c \
     ../../src/ipset_merge.c \
     ../../src/ipset_optimize.c \
+    ../../src/ipset_output.c \
+    ../../src/ipset_parallel.c \
+    ../../src/ipset_predicate.c \
     ../../src/ipset_print.c \
     ../../src/ipset_reduce.c \
+    ../../src/ipset_shard.c \
+    ../../src/ipset_sort.c \
     -o "$tmpdir/dns_create_fail"; then
     echo "# ERROR: failed to build DNS thread-create harness"
     exit 1
@@ -0,0 +1,27 @@
+#!/bin/bash
+
+tmpdir=$(mktemp -d)
+stderr="$tmpdir/stderr"
+trap 'rm -rf "$tmpdir"' EXIT
+
+python3 - <<'PY' > "$tmpdir/input.txt"
+for i in range(100000):
+    print("10.%d.%d.%d/31" % ((i >> 14) & 255, (i >> 6) & 255, (i & 63) * 4))
+PY
+
+TSAN_OPTIONS='halt_on_error=1 exitcode=66' ../../iprange --threads 4 -1 "$tmpdir/input.txt" >/dev/null 2>"$stderr"
+rc=$?
+
+if [ $rc -ne 0 ]; then
+    echo "# ERROR: TSAN parallel print run failed"
+    cat "$stderr"
+    exit 1
+fi
+
+if grep -q "ThreadSanitizer" "$stderr"; then
+    echo "# ERROR: TSAN reported a race in the parallel output"
+    cat "$stderr"
+    exit 1
+fi
+
+echo "# OK: parallel output is TSAN-clean"
@@ -0,0 +1,71 @@
+#include "iprange.h"
+#include <string.h>
+#include "tests.unit/test_random.h"
+
+char *PROG = "bitmap_optimize_matches";
+int debug = 0;
+int cidr_use_network = 1;
+int default_prefix = 32;
+int active_family = 0;
+
+/* optimizes two copies of the ipset, with the sorted array and with the bitmap */
+static int check(const char *name, ipset *ips) {
+    ipset *copy = ipset_copy(ips);
+    int failed = 0;
+
+    if(!copy) return 1;
+
+    ipset_bitmap_min = SIZE_MAX;
+    ipset_optimize(ips);
+
+    ipset_bitmap_min = 0;
+    ipset_optimize(copy);
+
+    if(ips->entries != copy->entries || ips->unique_ips != copy->unique_ips || ips->lines != copy->lines
+       || memcmp(ips->netaddrs, copy->netaddrs, ips->entries * sizeof(network_addr_t))) {
+        fprintf(stderr, "%s: bitmap optimize differs (%zu/%zu entries)\n", name, ips->entries, copy->entries);
+        failed = 1;
+    }
+
+    ipset_free(copy);
+    ipset_free(ips);
+    return failed;
+}
+
+int main(void) {
+    uint64_t state = 5;
+    size_t i;
+    int failed = 0;
+    ipset *ips;
+
+    /* random CIDRs of all sizes, overlapping and adjacent */
+    ips = ipset_create("random", 0);
+    if(!ips) return 1;
+    for(i = 0; i < 100000; i++) {
+        int prefix = 4 + (int)(rnd(&state) % 29);
+        in_addr_t addr = network(rnd(&state), prefix);
+        ipset_add_ip_range(ips, addr, broadcast(addr, prefix));
+    }
+    failed += check("random", ips);
+
+    /* ranges within a single word, across words and at the edges of the space */
+    ips = ipset_create("edges", 0);
+    if(!ips) return 1;
+    ipset_add_ip_range(ips, 0, 0);
+    ipset_add_ip_range(ips, 2, 62);
+    ipset_add_ip_range(ips, 63, 64);
+    ipset_add_ip_range(ips, 130, 1000);
+    ipset_add_ip_range(ips, 0x0a000040U, 0x0a00007fU);
+    ipset_add_ip_range(ips, UINT32_MAX - 64, UINT32_MAX - 1);
+    ipset_add_ip_range(ips, UINT32_MAX, UINT32_MAX);
+    failed += check("edges", ips);
+
+    /* everything */
+    ips = ipset_create("all", 0);
+    if(!ips) return 1;
+    ipset_add_ip_range(ips, 0, UINT32_MAX);
+    ipset_add_ip_range(ips, 5, 7);
+    failed += check("all", ips);
+
+    return failed ? 1 : 0;
+}
@@ -6,7 +6,6 @@ int debug = 0;
 int cidr_use_network = 1;
 int default_prefix = 32;
 int active_family = 0;
-unsigned long ipv6_dropped_in_ipv4_mode = 0;
 
 int main(void)
 {
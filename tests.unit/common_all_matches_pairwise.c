@@ -0,0 +1,102 @@
+#include "iprange.h"
+#include <string.h>
+#include "tests.unit/test_random.h"
+
+char *PROG = "common_all_matches_pairwise";
+int debug = 0;
+int cidr_use_network = 1;
+int default_prefix = 32;
+int active_family = 0;
+
+static ipset *link_new(ipset **root, ipset **last) {
+    ipset *ips = ipset_create("input", 0);
+    if(!ips) exit(1);
+
+    if(*last) { (*last)->next = ips; ips->prev = *last; }
+    else *root = ips;
+    *last = ips;
+    return ips;
+}
+
+/* the sweep must give exactly what chained ipset_common() calls give */
+static int check(const char *name, ipset *root) {
+    ipset *pairwise, *sweep, *ips, *tmp;
+    int failed = 0;
+
+    pairwise = ipset_common(root, root->next);
+    for(ips = root->next->next; ips; ips = ips->next) {
+        tmp = ipset_common(pairwise, ips);
+        ipset_free(pairwise);
+        pairwise = tmp;
+    }
+
+    sweep = ipset_common_all(root);
+    if(!pairwise || !sweep) return 1;
+
+    if(sweep->entries != pairwise->entries || sweep->unique_ips != pairwise->unique_ips || sweep->lines != pairwise->lines
+       || memcmp(sweep->netaddrs, pairwise->netaddrs, sweep->entries * sizeof(network_addr_t))) {
+        fprintf(stderr, "%s: the sweep differs (%zu/%zu entries)\n", name, sweep->entries, pairwise->entries);
+        failed = 1;
+    }
+
+    ipset_free(sweep);
+    ipset_free(pairwise);
+    ipset_free_all(root);
+    return failed;
+}
+
+int main(void) {
+    ipset *root, *last, *ips;
+    uint64_t state = 17;
+    size_t n, f, i;
+    int failed = 0;
+
+    /* a few big ranges each, so that there is something in common */
+    for(n = 2; n <= 20; n++) {
+        root = last = NULL;
+        for(f = 0; f < n; f++) {
+            ips = link_new(&root, &last);
+            for(i = 0; i < 200; i++) {
+                int prefix = 2 + (int)(rnd(&state) % 12);
+                in_addr_t addr = network(rnd(&state), prefix);
+                ipset_add_ip_range(ips, addr, broadcast(addr, prefix));
+            }
+        }
+        failed += check("random", root);
+    }
+
+    /* little in common: pairwise through the big ipsets, then a small one swept */
+    root = last = NULL;
+    for(f = 0; f < 8; f++) {
+        ips = link_new(&root, &last);
+        ipset_add_ip_range(ips, 0x0A000000U, 0x0AFFFFFFU);
+        for(i = 0; i < (f < 2 || f == 5 ? 10 : 2000); i++) {
+            in_addr_t addr = network(rnd(&state), 24);
+            ipset_add_ip_range(ips, addr, broadcast(addr, 24));
+        }
+    }
+    failed += check("sparse", root);
+
+    /* ranges of one ipset adjacent to ranges of the other, up to the last IP */
+    root = last = NULL;
+    ips = link_new(&root, &last);
+    ipset_add_ip_range(ips, 0, 9);
+    ipset_add_ip_range(ips, 20, UINT32_MAX);
+    ips = link_new(&root, &last);
+    ipset_add_ip_range(ips, 10, 19);
+    ipset_add_ip_range(ips, 100, UINT32_MAX);
+    ips = link_new(&root, &last);
+    ipset_add_ip_range(ips, 0, UINT32_MAX);
+    failed += check("adjacent", root);
+
+    /* an empty ipset */
+    root = last = NULL;
+    ips = link_new(&root, &last);
+    ipset_add_ip_range(ips, 0, UINT32_MAX);
+    link_new(&root, &last);
+    ips = link_new(&root, &last);
+    ipset_add_ip_range(ips, 5, 5);
+    failed += check("empty", root);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,88 @@
+#include "iprange.h"
+#include "tests.unit/test_random.h"
+
+char *PROG = "compare_all_matches_pairwise";
+int debug = 0;
+int cidr_use_network = 1;
+int default_prefix = 32;
+int active_family = 0;
+
+static ipset *link_new(ipset **root, ipset **last) {
+    ipset *ips = ipset_create("input", 0);
+    if(!ips) exit(1);
+
+    if(*last) { (*last)->next = ips; ips->prev = *last; }
+    else *root = ips;
+    *last = ips;
+    return ips;
+}
+
+/* the sweep must count the same common IPs as ipset_common() on every pair */
+static int check(const char *name, ipset *root) {
+    ipset *ips, *ips2, *common;
+    uint64_t *matrix;
+    size_t n, i, j;
+    int failed = 0;
+
+    ipset_optimize_all(root);
+
+    matrix = ipset_compare_all(root, &n);
+    if(!matrix) return 1;
+
+    for(ips = root, i = 0; ips; ips = ips->next, i++) {
+        for(ips2 = ips->next, j = i + 1; ips2; ips2 = ips2->next, j++) {
+            common = ipset_common(ips, ips2);
+            if(!common) return 1;
+
+            if(common->unique_ips != matrix[ipset_compare_pair(n, i, j)]) {
+                fprintf(stderr, "%s: pair %zu,%zu has %llu common IPs, the sweep found %llu\n", name, i, j,
+                        (unsigned long long)common->unique_ips, (unsigned long long)matrix[ipset_compare_pair(n, i, j)]);
+                failed = 1;
+            }
+
+            ipset_free(common);
+        }
+    }
+
+    free(matrix);
+    ipset_free_all(root);
+    return failed;
+}
+
+int main(void) {
+    ipset *root, *last, *ips;
+    uint64_t state = 31;
+    size_t n, f, i;
+    int failed = 0;
+
+    for(n = 2; n <= 40; n += 7) {
+        root = last = NULL;
+        for(f = 0; f < n; f++) {
+            ips = link_new(&root, &last);
+            for(i = 0; i < 300; i++) {
+                int prefix = 4 + (int)(rnd(&state) % 29);
+                in_addr_t addr = network(rnd(&state), prefix);
+                ipset_add_ip_range(ips, addr, broadcast(addr, prefix));
+            }
+        }
+        failed += check("random", root);
+    }
+
+    /* ranges starting and ending at the same IPs, up to the last IP, and an empty ipset */
+    root = last = NULL;
+    ips = link_new(&root, &last);
+    ipset_add_ip_range(ips, 0, 9);
+    ipset_add_ip_range(ips, 20, UINT32_MAX);
+    link_new(&root, &last);
+    ips = link_new(&root, &last);
+    ipset_add_ip_range(ips, 10, 19);
+    ipset_add_ip_range(ips, 100, UINT32_MAX);
+    ips = link_new(&root, &last);
+    ipset_add_ip_range(ips, 0, UINT32_MAX);
+    ips = link_new(&root, &last);
+    ipset_add_ip_range(ips, 9, 10);
+    ipset_add_ip_range(ips, UINT32_MAX, UINT32_MAX);
+    failed += check("edges", root);
+
+    return failed ? 1 : 0;
+}
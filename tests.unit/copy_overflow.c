@@ -3,7 +3,6 @@
 int cidr_use_network = 1;
 int default_prefix = 32;
 int active_family = 0;
-unsigned long ipv6_dropped_in_ipv4_mode = 0;
 char *PROG = "copy_overflow";
 int debug = 0;
 
@@ -0,0 +1,68 @@
+#include "iprange.h"
+#include "tests.unit/test_random.h"
+
+char *PROG = "count_matches_sets";
+int debug = 0;
+int cidr_use_network = 1;
+int default_prefix = 32;
+int active_family = 0;
+
+static int same(const char *name, const char *op, uint64_t count, ipset *ips) {
+    int failed = 0;
+
+    if(!ips) return 1;
+
+    ipset_optimize(ips);
+    if(count != ips->unique_ips) {
+        fprintf(stderr, "%s: %s counted %llu IPs, the ipset has %llu\n", name, op, (unsigned long long)count, (unsigned long long)ips->unique_ips);
+        failed = 1;
+    }
+
+    ipset_free(ips);
+    return failed;
+}
+
+/* the counts must be the unique IPs of the ipsets the set operations build */
+static int check(const char *name, ipset *ips1, ipset *ips2) {
+    size_t ratio;
+    int failed = 0;
+
+    for(ratio = 0; ratio <= 1; ratio++) {
+        ipset_gallop_ratio = ratio;
+
+        failed += same(name, "common", ipset_count_common(ips1, ips2), ipset_common(ips1, ips2));
+        failed += same(name, "union", ipset_count_union(ips1, ips2), ipset_combine(ips1, ips2));
+        failed += same(name, "diff", ipset_count_diff(ips1, ips2), ipset_diff(ips1, ips2));
+        failed += same(name, "exclude", ipset_count_exclude(ips1, ips2), ipset_exclude(ips1, ips2));
+        failed += same(name, "reverse exclude", ipset_count_exclude(ips2, ips1), ipset_exclude(ips2, ips1));
+    }
+
+    ipset_free(ips1);
+    ipset_free(ips2);
+    return failed;
+}
+
+int main(void) {
+    ipset *ips1, *ips2;
+    uint64_t state = 37;
+    size_t m;
+    int failed = 0;
+
+    for(m = 1; m <= 20000; m *= 5) {
+        failed += check("small ranges", random_ipset(&state, m, 16, 32), random_ipset(&state, 20000, 16, 32));
+        failed += check("big ranges", random_ipset(&state, m, 1, 12), random_ipset(&state, 3000, 8, 32));
+        failed += check("one empty", random_ipset(&state, m, 8, 32), random_ipset(&state, 0, 8, 32));
+    }
+
+    /* the whole address space, and ranges adjacent to each other */
+    ips1 = ipset_create("input", 0);
+    ips2 = ipset_create("input", 0);
+    if(!ips1 || !ips2) return 1;
+    ipset_add_ip_range(ips1, 0, UINT32_MAX);
+    ipset_add_ip_range(ips2, 0, 9);
+    ipset_add_ip_range(ips2, 11, 19);
+    ipset_add_ip_range(ips2, UINT32_MAX, UINT32_MAX);
+    failed += check("whole", ips1, ips2);
+
+    return failed ? 1 : 0;
+}
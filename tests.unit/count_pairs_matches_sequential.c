@@ -0,0 +1,69 @@
+#include "iprange.h"
+#include "tests.unit/test_random.h"
+
+char *PROG = "count_pairs_matches_sequential";
+int debug = 0;
+int cidr_use_network = 1;
+int default_prefix = 32;
+int active_family = 0;
+
+/* n optimized ipsets of very different sizes, linked to 'next' */
+static ipset *random_ipsets(uint64_t *state, size_t n) {
+    ipset *root = NULL, *last = NULL;
+    size_t i;
+
+    for(i = 0; i < n; i++) {
+        size_t entries = (i % 4 == 3) ? 0 : (size_t)(rnd(state) % 5000);
+
+        random_ipsets_append(&root, &last, random_optimized_ipset(state, entries, 12, 32));
+    }
+
+    return root;
+}
+
+/* the counts of the threads must be the ones of a sequential loop, in order */
+static int check(const char *name, ipset *first1, size_t n1, ipset *first2, size_t n2) {
+    ipset *ips1, *ips2;
+    uint64_t *counts;
+    size_t i, j;
+    int failed = 0;
+
+    if(!(counts = ipset_count_pairs(first1, n1, first2, n2, ipset_count_common))) return 1;
+
+    for(ips1 = first1, i = 0; i < n1; ips1 = ips1->next, i++) {
+        for(ips2 = first2, j = 0; j < n2; ips2 = ips2->next, j++) {
+            uint64_t expected = ipset_count_common(ips1, ips2);
+
+            if(counts[i * n2 + j] != expected) {
+                fprintf(stderr, "%s: pair %zu x %zu counted %llu IPs, expected %llu\n", name, i, j,
+                        (unsigned long long)counts[i * n2 + j], (unsigned long long)expected);
+                failed = 1;
+            }
+        }
+    }
+
+    free(counts);
+    return failed;
+}
+
+int main(void) {
+    ipset *root, *second;
+    uint64_t state = 41;
+    int threads, failed = 0;
+
+    root = random_ipsets(&state, 23);
+    second = random_ipsets(&state, 37);
+
+    for(threads = 1; threads <= 8; threads *= 2) {
+        parallel_threads = threads;
+
+        failed += check("next", root, 23, second, 37);
+        failed += check("first", root, 23, root->next, 1);
+        failed += check("single", root, 1, second, 1);
+        failed += check("none", root, 0, second, 37);
+    }
+
+    ipset_free_all(root);
+    ipset_free_all(second);
+    return failed ? 1 : 0;
+}
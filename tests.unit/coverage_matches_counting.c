@@ -0,0 +1,113 @@
+#include "iprange.h"
+#include "tests.unit/test_random.h"
+
+char *PROG = "coverage_matches_counting";
+int debug = 0;
+int cidr_use_network = 1;
+int default_prefix = 32;
+int active_family = 0;
+
+/* all the ranges are in BASE .. BASE + SPACE - 1, so every IP can be counted */
+#define BASE 0x0a000000U
+#define SPACE 8192U
+#define INPUTS 9
+
+static ipset *random_ipsets(uint64_t *state, unsigned char *depth) {
+    ipset *root = NULL, *last = NULL, *ips;
+    size_t f, i, entries;
+
+    for(f = 0; f < INPUTS; f++) {
+        entries = (f == 4) ? 0 : rnd(state) % 200;
+        ips = random_ipset_in(state, entries, 20, 32, BASE, SPACE);
+
+        /* count each IP once per ipset */
+        ipset_optimize(ips);
+        for(i = 0; i < ips->entries; i++) {
+            uint64_t ip;
+            for(ip = ips->netaddrs[i].addr; ip <= ips->netaddrs[i].broadcast; ip++)
+                depth[ip - BASE]++;
+        }
+
+        random_ipsets_append(&root, &last, ips);
+    }
+
+    return root;
+}
+
+/* the sweep must give exactly the IPs whose counted depth matches */
+static int check(ipset *root, const unsigned char *depth, int op, size_t wanted) {
+    ipset *coverage = ipset_coverage(root, op, wanted);
+    size_t i, e = 0;
+    int failed = 0;
+
+    if(!coverage) return 1;
+
+    for(i = 0; i + 1 < coverage->entries; i++)
+        if((uint64_t)coverage->netaddrs[i].broadcast + 1 >= coverage->netaddrs[i + 1].addr) {
+            fprintf(stderr, "op %d, depth %zu: entries %zu and %zu are not optimized\n", op, wanted, i, i + 1);
+            failed = 1;
+        }
+
+    for(i = 0; i < SPACE && !failed; i++) {
+        in_addr_t ip = BASE + (in_addr_t)i;
+        int in;
+
+        while(e < coverage->entries && coverage->netaddrs[e].broadcast < ip) e++;
+        in = (e < coverage->entries && coverage->netaddrs[e].addr <= ip);
+
+        if(in != ipset_coverage_match(op, depth[i], wanted)) {
+            fprintf(stderr, "op %d, depth %zu: IP %zu is in %d ipsets, the sweep %s it\n", op, wanted, i, depth[i], in ? "has" : "does not have");
+            failed = 1;
+        }
+    }
+
+    ipset_free(coverage);
+    return failed;
+}
+
+int main(void) {
+    static unsigned char depth[SPACE];
+    ipset *root, *whole;
+    uint64_t state = 47;
+    size_t round, wanted;
+    int failed = 0;
+
+    for(round = 0; round < 20; round++) {
+        memset(depth, 0, sizeof(depth));
+        root = random_ipsets(&state, depth);
+
+        for(wanted = 1; wanted <= INPUTS + 1; wanted++) {
+            failed += check(root, depth, IPSET_COVERAGE_AT_LEAST, wanted);
+            failed += check(root, depth, IPSET_COVERAGE_EXACTLY, wanted);
+            failed += check(root, depth, IPSET_COVERAGE_AT_MOST, wanted);
+        }
+
+        ipset_free_all(root);
+    }
+
+    /* ranges that end at the last IP */
+    root = ipset_create("input", 0);
+    whole = ipset_create("input", 0);
+    if(!root || !whole) return 1;
+    ipset_add_ip_range(root, 0, UINT32_MAX);
+    ipset_add_ip_range(whole, UINT32_MAX - 9, UINT32_MAX);
+    root->next = whole;
+    whole->prev = root;
+
+    whole = ipset_coverage(root, IPSET_COVERAGE_EXACTLY, 2);
+    if(!whole || whole->entries != 1 || whole->netaddrs[0].addr != UINT32_MAX - 9 || whole->netaddrs[0].broadcast != UINT32_MAX) {
+        fprintf(stderr, "the coverage of the last IPs is wrong\n");
+        failed++;
+    }
+    if(whole) ipset_free(whole);
+
+    whole = ipset_coverage(root, IPSET_COVERAGE_AT_LEAST, 1);
+    if(!whole || whole->entries != 1 || whole->unique_ips != UINT64_C(1) << 32) {
+        fprintf(stderr, "the coverage of the whole address space is wrong\n");
+        failed++;
+    }
+    if(whole) ipset_free(whole);
+
+    ipset_free_all(root);
+    return failed ? 1 : 0;
+}
@@ -5,7 +5,6 @@ int debug;
 int cidr_use_network = 1;
 int default_prefix = 32;
 int active_family = 0;
-unsigned long ipv6_dropped_in_ipv4_mode = 0;
 
 static ipset *make_single_ipset(const char *name, in_addr_t ip) {
     ipset *ips = ipset_create(name, 1);
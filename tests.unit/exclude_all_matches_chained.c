@@ -0,0 +1,90 @@
+#include "iprange.h"
+#include <string.h>
+#include "tests.unit/test_random.h"
+
+char *PROG = "exclude_all_matches_chained";
+int debug = 0;
+int cidr_use_network = 1;
+int default_prefix = 32;
+int active_family = 0;
+
+static ipset *random_ipsets(uint64_t *state, size_t n, size_t entries) {
+    ipset *root = NULL, *last = NULL, *ips;
+    size_t i;
+
+    for(i = 0; i < n; i++) {
+        ips = random_optimized_ipset(state, (i % 5 == 4) ? 0 : entries, 8, 32);
+        random_ipsets_append(&root, &last, ips);
+    }
+
+    return root;
+}
+
+static int same(const char *name, const char *how, ipset *expected, ipset *ips) {
+    if(!ips) return 1;
+
+    if(ips->entries != expected->entries || ips->unique_ips != expected->unique_ips || ips->lines != expected->lines
+       || memcmp(ips->netaddrs, expected->netaddrs, ips->entries * sizeof(network_addr_t))) {
+        fprintf(stderr, "%s: %s has %zu entries, %llu IPs, chained exclusion has %zu entries, %llu IPs\n",
+                name, how, ips->entries, (unsigned long long)ips->unique_ips,
+                expected->entries, (unsigned long long)expected->unique_ips);
+        ipset_free(ips);
+        return 1;
+    }
+
+    ipset_free(ips);
+    return 0;
+}
+
+/* excluding all at once must give exactly what chained ipset_exclude() calls give */
+static int check(const char *name, ipset *base, ipset *root) {
+    ipset *chained, *ips, *tmp;
+    int failed = 0;
+
+    chained = ipset_exclude(base, root);
+    for(ips = root->next; chained && ips; ips = ips->next) {
+        tmp = ipset_exclude(chained, ips);
+        ipset_free(chained);
+        chained = tmp;
+    }
+    if(!chained) return 1;
+
+    failed += same(name, "single pass", chained, ipset_exclude_all(base, root));
+
+    parallel_threads = 4;
+    failed += same(name, "sharded", chained, ipset_shard_exclude_all(base, root));
+    parallel_threads = 1;
+
+    ipset_free(chained);
+    ipset_free(base);
+    ipset_free_all(root);
+    return failed;
+}
+
+int main(void) {
+    ipset *base, *root;
+    uint64_t state = 43;
+    int failed = 0;
+
+    failed += check("many small", random_optimized_ipset(&state, 20000, 8, 32), random_ipsets(&state, 40, 2000));
+    failed += check("few big", random_optimized_ipset(&state, 5000, 16, 32), random_ipsets(&state, 3, 50));
+    failed += check("one", random_optimized_ipset(&state, 5000, 8, 32), random_ipsets(&state, 1, 5000));
+    failed += check("empty base", random_optimized_ipset(&state, 0, 8, 32), random_ipsets(&state, 4, 100));
+
+    /* the whole address space, excluding its edges and adjacent ranges */
+    base = ipset_create("input", 0);
+    root = ipset_create("input", 0);
+    if(!base || !root) return 1;
+    ipset_add_ip_range(base, 0, UINT32_MAX);
+    ipset_add_ip_range(root, 0, 9);
+    ipset_add_ip_range(root, 10, 19);
+    ipset_add_ip_range(root, UINT32_MAX, UINT32_MAX);
+    root->next = ipset_create("input", 0);
+    if(!root->next) return 1;
+    root->next->prev = root;
+    ipset_add_ip_range(root->next, 15, 30);
+    ipset_add_ip_range(root->next, UINT32_MAX - 5, UINT32_MAX);
+    failed += check("whole", base, root);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,129 @@
+#include "iprange.h"
+#include "tests.unit/test_random.h"
+
+char *PROG = "exclusive_matches_counting";
+int debug = 0;
+int cidr_use_network = 1;
+int default_prefix = 32;
+int active_family = 0;
+
+/* all the ranges are in BASE .. BASE + SPACE - 1, so every IP can be counted */
+#define BASE 0x0a000000U
+#define SPACE 8192U
+#define INPUTS 9
+
+/* depth has the number of ipsets of every IP, owner the last one it is in */
+static ipset *random_ipsets(uint64_t *state, unsigned char *depth, unsigned char *owner) {
+    ipset *root = NULL, *last = NULL, *ips;
+    size_t f, i, entries;
+
+    for(f = 0; f < INPUTS; f++) {
+        entries = (f == 4) ? 0 : rnd(state) % 120;
+        ips = random_ipset_in(state, entries, 22, 32, BASE, SPACE);
+
+        /* count each IP once per ipset */
+        ipset_optimize(ips);
+        for(i = 0; i < ips->entries; i++) {
+            uint64_t ip;
+            for(ip = ips->netaddrs[i].addr; ip <= ips->netaddrs[i].broadcast; ip++) {
+                depth[ip - BASE]++;
+                owner[ip - BASE] = (unsigned char)f;
+            }
+        }
+
+        random_ipsets_append(&root, &last, ips);
+    }
+
+    return root;
+}
+
+/* the sweep must give exactly the IPs counted in ipset id alone */
+static int check_ranges(ipset *root, const unsigned char *depth, const unsigned char *owner, size_t id) {
+    ipset *exclusive = ipset_exclusive(root, id);
+    size_t i, e = 0;
+    int failed = 0;
+
+    if(!exclusive) return 1;
+
+    for(i = 0; i + 1 < exclusive->entries; i++)
+        if((uint64_t)exclusive->netaddrs[i].broadcast + 1 >= exclusive->netaddrs[i + 1].addr) {
+            fprintf(stderr, "ipset %zu: entries %zu and %zu are not optimized\n", id, i, i + 1);
+            failed = 1;
+        }
+
+    for(i = 0; i < SPACE && !failed; i++) {
+        in_addr_t ip = BASE + (in_addr_t)i;
+        int in, wanted = (depth[i] == 1 && owner[i] == id);
+
+        while(e < exclusive->entries && exclusive->netaddrs[e].broadcast < ip) e++;
+        in = (e < exclusive->entries && exclusive->netaddrs[e].addr <= ip);
+
+        if(in != wanted) {
+            fprintf(stderr, "ipset %zu: IP %zu is in %d ipsets, the sweep %s it\n", id, i, depth[i], in ? "has" : "does not have");
+            failed = 1;
+        }
+    }
+
+    ipset_free(exclusive);
+    return failed;
+}
+
+int main(void) {
+    static unsigned char depth[SPACE], owner[SPACE];
+    uint64_t counted[INPUTS], *exclusive;
+    ipset *root, *whole;
+    uint64_t state = 53;
+    size_t round, i;
+    int failed = 0;
+
+    for(round = 0; round < 20; round++) {
+        memset(depth, 0, sizeof(depth));
+        memset(counted, 0, sizeof(counted));
+        root = random_ipsets(&state, depth, owner);
+
+        for(i = 0; i < SPACE; i++)
+            if(depth[i] == 1) counted[owner[i]]++;
+
+        exclusive = ipset_exclusive_ips(root);
+        if(!exclusive) return 1;
+
+        for(i = 0; i < INPUTS; i++) {
+            if(exclusive[i] != counted[i]) {
+                fprintf(stderr, "round %zu, ipset %zu: %llu exclusive IPs, counted %llu\n", round, i,
+                        (unsigned long long)exclusive[i], (unsigned long long)counted[i]);
+                failed++;
+            }
+
+            failed += check_ranges(root, depth, owner, i);
+        }
+
+        free(exclusive);
+        ipset_free_all(root);
+    }
+
+    /* ranges that end at the last IP */
+    root = ipset_create("input", 0);
+    whole = ipset_create("input", 0);
+    if(!root || !whole) return 1;
+    ipset_add_ip_range(root, 0, UINT32_MAX);
+    ipset_add_ip_range(whole, UINT32_MAX - 9, UINT32_MAX);
+    root->next = whole;
+    whole->prev = root;
+
+    exclusive = ipset_exclusive_ips(root);
+    if(!exclusive || exclusive[0] != (UINT64_C(1) << 32) - 10 || exclusive[1] != 0) {
+        fprintf(stderr, "the exclusive IPs of the whole address space are wrong\n");
+        failed++;
+    }
+    free(exclusive);
+
+    whole = ipset_exclusive(root, 0);
+    if(!whole || whole->entries != 1 || whole->netaddrs[0].addr != 0 || whole->netaddrs[0].broadcast != UINT32_MAX - 10) {
+        fprintf(stderr, "the exclusive ranges of the whole address space are wrong\n");
+        failed++;
+    }
+    if(whole) ipset_free(whole);
+
+    ipset_free_all(root);
+    return failed ? 1 : 0;
+}
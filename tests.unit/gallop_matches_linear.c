@@ -0,0 +1,79 @@
+#include "iprange.h"
+#include <string.h>
+#include "tests.unit/test_random.h"
+
+char *PROG = "gallop_matches_linear";
+int debug = 0;
+int cidr_use_network = 1;
+int default_prefix = 32;
+int active_family = 0;
+
+static int same(const char *name, ipset *gallop, ipset *linear) {
+    if(!gallop || !linear) return 1;
+
+    if(gallop->entries != linear->entries || gallop->unique_ips != linear->unique_ips || gallop->lines != linear->lines
+       || memcmp(gallop->netaddrs, linear->netaddrs, gallop->entries * sizeof(network_addr_t))) {
+        fprintf(stderr, "%s: galloping differs (%zu/%zu entries)\n", name, gallop->entries, linear->entries);
+        return 1;
+    }
+
+    return 0;
+}
+
+/* galloping over the larger ipset must give exactly what the linear walk gives */
+static int check(const char *name, ipset *ips1, ipset *ips2) {
+    ipset *g[3], *l[3];
+    int i, failed = 0;
+
+    ipset_gallop_ratio = 1;
+    g[0] = ipset_common(ips1, ips2);
+    g[1] = ipset_exclude(ips1, ips2);
+    g[2] = ipset_exclude(ips2, ips1);
+
+    ipset_gallop_ratio = 0;
+    l[0] = ipset_common(ips1, ips2);
+    l[1] = ipset_exclude(ips1, ips2);
+    l[2] = ipset_exclude(ips2, ips1);
+
+    failed += same(name, g[0], l[0]);
+    failed += same(name, g[1], l[1]);
+    failed += same(name, g[2], l[2]);
+
+    for(i = 0; i < 3; i++) {
+        if(g[i]) ipset_free(g[i]);
+        if(l[i]) ipset_free(l[i]);
+    }
+
+    ipset_free(ips1);
+    ipset_free(ips2);
+    return failed;
+}
+
+int main(void) {
+    ipset *ips1, *ips2;
+    uint64_t state = 23;
+    size_t m;
+    int failed = 0;
+
+    /* small ipsets of big ranges against large ipsets of small ranges, and the opposite */
+    for(m = 1; m <= 4096; m *= 4) {
+        failed += check("wide small", random_optimized_ipset(&state, m, 8, 20), random_optimized_ipset(&state, 50000, 20, 32));
+        failed += check("narrow small", random_optimized_ipset(&state, m, 24, 32), random_optimized_ipset(&state, 50000, 8, 24));
+        failed += check("same sizes", random_optimized_ipset(&state, m, 8, 28), random_optimized_ipset(&state, m, 8, 28));
+    }
+
+    /* ranges of one ipset adjacent to ranges of the other, up to the last IP */
+    ips1 = ipset_create("input", 0);
+    ips2 = ipset_create("input", 0);
+    if(!ips1 || !ips2) return 1;
+    ipset_add_ip_range(ips1, 10, 19);
+    ipset_add_ip_range(ips1, 100, UINT32_MAX);
+    ipset_add_ip_range(ips2, 0, 9);
+    ipset_add_ip_range(ips2, 20, 99);
+    ipset_add_ip_range(ips2, 101, 101);
+    ipset_add_ip_range(ips2, 200, 300);
+    ipset_add_ip_range(ips2, UINT32_MAX, UINT32_MAX);
+    failed += check("adjacent", ips1, ips2);
+
+    return failed ? 1 : 0;
+}
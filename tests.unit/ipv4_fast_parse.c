@@ -0,0 +1,92 @@
+#include "iprange.h"
+#include <string.h>
+
+char *PROG = "ipv4_fast_parse";
+int debug = 0;
+int cidr_use_network = 1;
+int default_prefix = 32;
+int active_family = 0;
+
+/* the fast parser must either reject a token, or agree with str2netaddr() */
+static int check(const char *token, int expect_fast) {
+    char buf[64];
+    network_addr_t fast, slow;
+    const char *end;
+    int err = 0;
+
+    end = ipv4_fast_parse(token, &fast);
+    if((end != NULL) != expect_fast) {
+        fprintf(stderr, "%s: fast parser %s, expected %s\n", token, end?"accepted":"rejected", expect_fast?"accept":"reject");
+        return 1;
+    }
+
+    if(!end) return 0;
+
+    if(*end != '\0') {
+        fprintf(stderr, "%s: fast parser stopped early at '%s'\n", token, end);
+        return 1;
+    }
+
+    snprintf(buf, sizeof(buf), "%s", token);
+    slow = str2netaddr(buf, &err);
+    if(err || slow.addr != fast.addr || slow.broadcast != fast.broadcast) {
+        fprintf(stderr, "%s: fast %08x-%08x, str2netaddr %08x-%08x (err %d)\n", token, fast.addr, fast.broadcast, slow.addr, slow.broadcast, err);
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(void) {
+    static const char *accepted[] = {
+        "0.0.0.0", "255.255.255.255", "1.2.3.4", "10.20.30.40", "199.99.9.0",
+        "1.2.3.4/0", "1.2.3.4/8", "1.2.3.4/24", "1.2.3.4/32", "0.0.0.0/0",
+        "255.255.255.255/31", "100.200.250.251/9",
+        NULL
+    };
+    static const char *rejected[] = {
+        "", ".", "1", "1.2", "1.2.3", "1.2.3.", "1.2.3.4.", "1.2.3.4.5",
+        "256.1.1.1", "1.2.3.256", "999.0.0.0", "1.2.3.2555",
+        "01.2.3.4", "1.02.3.4", "1.2.3.04", "1.2.3.00", "0x1.2.3.4",
+        "1.2.3.4/", "1.2.3.4/33", "1.2.3.4/99", "1.2.3.4/08", "1.2.3.4/123",
+        "1.2.3.4/255.255.255.0", "1.2.3.4/24/8", "1..2.3", "a.b.c.d",
+        NULL
+    };
+    char buf[64];
+    unsigned int seed = 12345;
+    int i, failed = 0;
+
+    for(i = 0; accepted[i]; i++)
+        failed += check(accepted[i], 1);
+
+    for(i = 0; rejected[i]; i++)
+        failed += check(rejected[i], 0);
+
+    for(i = 0; i < 100000; i++) {
+        unsigned int a, b, c, d, p;
+
+        seed = seed * 1103515245U + 12345U; a = (seed >> 8) & 0xff;
+        seed = seed * 1103515245U + 12345U; b = (seed >> 8) & 0xff;
+        seed = seed * 1103515245U + 12345U; c = (seed >> 8) & 0xff;
+        seed = seed * 1103515245U + 12345U; d = (seed >> 8) & 0xff;
+        seed = seed * 1103515245U + 12345U; p = (seed >> 8) % 34;
+
+        if(p == 33)
+            snprintf(buf, sizeof(buf), "%u.%u.%u.%u", a, b, c, d);
+        else
+            snprintf(buf, sizeof(buf), "%u.%u.%u.%u/%u", a, b, c, d, p);
+
+        failed += check(buf, 1);
+        if(failed > 10) break;
+    }
+
+    /* without network alignment, the address is kept as given */
+    cidr_use_network = 0;
+    failed += check("10.1.2.3/8", 1);
+
+    /* the token may be followed by any separator */
+    if(!ipv4_fast_parse("1.2.3.4 - 5.6.7.8", &(network_addr_t){ 0, 0 })) failed++;
+    if(!ipv4_fast_parse("1.2.3.4/24#comment", &(network_addr_t){ 0, 0 })) failed++;
+
+    return failed ? 1 : 0;
+}
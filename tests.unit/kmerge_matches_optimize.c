@@ -0,0 +1,85 @@
+#include "iprange.h"
+#include <string.h>
+#include "tests.unit/test_random.h"
+
+char *PROG = "kmerge_matches_optimize";
+int debug = 0;
+int cidr_use_network = 1;
+int default_prefix = 32;
+int active_family = 0;
+
+static ipset *link_new(ipset **root, ipset **last, const char *name) {
+    ipset *ips = ipset_create(name, 0);
+    if(!ips) exit(1);
+
+    if(*last) { (*last)->next = ips; ips->prev = *last; }
+    else *root = ips;
+    *last = ips;
+    return ips;
+}
+
+/* the k-way merge must give exactly what merging and optimizing gives */
+static int check(const char *name, ipset *root) {
+    ipset *concat = ipset_create("concat", 0), *merged, *ips;
+    int failed = 0;
+
+    if(!concat) return 1;
+    for(ips = root; ips; ips = ips->next)
+        if(ipset_merge(concat, ips)) failed = 1;
+    ipset_optimize(concat);
+
+    merged = ipset_kmerge_all(root, "kmerge");
+    if(!merged) return 1;
+
+    if(failed || !(merged->flags & IPSET_FLAG_OPTIMIZED) || merged->entries != concat->entries || merged->unique_ips != concat->unique_ips
+       || merged->lines != concat->lines || memcmp(merged->netaddrs, concat->netaddrs, merged->entries * sizeof(network_addr_t))) {
+        fprintf(stderr, "%s: k-way merge differs (%zu/%zu entries)\n", name, merged->entries, concat->entries);
+        failed = 1;
+    }
+
+    ipset_free(merged);
+    ipset_free(concat);
+    ipset_free_all(root);
+    return failed;
+}
+
+int main(void) {
+    ipset *root = NULL, *last = NULL, *ips;
+    uint64_t state = 11;
+    size_t f, i;
+    int failed = 0;
+
+    /* many random feeds, some left unoptimized and one empty */
+    for(f = 0; f < 50; f++) {
+        ips = link_new(&root, &last, "random");
+        if(f == 7) continue;
+        for(i = 0; i < 1000; i++) {
+            int prefix = 8 + (int)(rnd(&state) % 25);
+            in_addr_t addr = network(rnd(&state), prefix);
+            ipset_add_ip_range(ips, addr, broadcast(addr, prefix));
+        }
+        if(f % 3) ipset_optimize(ips);
+    }
+    failed += check("random", root);
+
+    /* ranges adjacent across feeds, and the edges of the address space */
+    root = last = NULL;
+    for(f = 0; f < 4; f++) {
+        ips = link_new(&root, &last, "adjacent");
+        for(i = f; i < 4000; i += 4)
+            ipset_add_ip_range(ips, (in_addr_t)i, (in_addr_t)i);
+        ipset_add_ip_range(ips, UINT32_MAX - (in_addr_t)f, UINT32_MAX - (in_addr_t)f);
+    }
+    failed += check("adjacent", root);
+
+    /* one feed covers everything */
+    root = last = NULL;
+    ips = link_new(&root, &last, "all");
+    ipset_add_ip_range(ips, 0, UINT32_MAX);
+    ips = link_new(&root, &last, "some");
+    ipset_add_ip_range(ips, 0x0a000000U, 0x0affffffU);
+    ipset_add_ip_range(ips, UINT32_MAX, UINT32_MAX);
+    failed += check("all", root);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,124 @@
+#include "iprange.h"
+#include "tests.unit/test_random.h"
+
+char *PROG = "membership_matches_counting";
+int debug = 0;
+int cidr_use_network = 1;
+int default_prefix = 32;
+int active_family = 0;
+
+/* all the ranges are in BASE .. BASE + SPACE - 1, so every IP can be checked */
+#define BASE 0x0a000000U
+#define SPACE 4096U
+#define WORDS 2
+
+/* n ipsets, with the bitmask of the ipsets of every IP in masks */
+static ipset *random_ipsets(uint64_t *state, size_t n, uint64_t (*masks)[WORDS]) {
+    ipset *root = NULL, *last = NULL, *ips;
+    size_t f, i, entries;
+
+    for(f = 0; f < n; f++) {
+        entries = (f % 7 == 6) ? 0 : rnd(state) % 30;
+        ips = random_ipset_in(state, entries, 22, 32, BASE, SPACE);
+
+        ipset_optimize(ips);
+        for(i = 0; i < ips->entries; i++) {
+            uint64_t ip;
+            for(ip = ips->netaddrs[i].addr; ip <= ips->netaddrs[i].broadcast; ip++)
+                masks[ip - BASE][f / 64] |= UINT64_C(1) << (f % 64);
+        }
+
+        random_ipsets_append(&root, &last, ips);
+    }
+
+    return root;
+}
+
+/* every IP must be in the range with its bitmask, and the ranges must be as few as possible */
+static int check(const char *name, ipset *root, size_t n, uint64_t (*masks)[WORDS]) {
+    static const uint64_t none[WORDS] = { 0 };
+    IPSET_MEMBERSHIP *m = ipset_membership(root);
+    size_t i, e = 0;
+    int failed = 0;
+
+    if(!m) return 1;
+
+    if(m->files != n || m->words != (n + 63) / 64) {
+        fprintf(stderr, "%s: %zu files in %zu words, expected %zu\n", name, m->files, m->words, n);
+        ipset_membership_free(m);
+        return 1;
+    }
+
+    for(i = 0; i + 1 < m->entries; i++)
+        if(m->records[i].broadcast >= m->records[i + 1].addr
+           || (m->records[i].broadcast + 1 == m->records[i + 1].addr && m->records[i].id == m->records[i + 1].id)) {
+            fprintf(stderr, "%s: ranges %zu and %zu overlap or should be joined\n", name, i, i + 1);
+            failed = 1;
+        }
+
+    for(i = 0; i < SPACE && !failed; i++) {
+        in_addr_t ip = BASE + (in_addr_t)i;
+        const uint64_t *mask = none;
+        uint64_t expected[WORDS] = { 0 };
+
+        while(e < m->entries && m->records[e].broadcast < ip) e++;
+        if(e < m->entries && m->records[e].addr <= ip)
+            mask = &m->masks[m->records[e].id * m->words];
+
+        memcpy(expected, masks[i], m->words * sizeof(uint64_t));
+        if(memcmp(mask, expected, m->words * sizeof(uint64_t))) {
+            fprintf(stderr, "%s: IP %zu has the wrong membership\n", name, i);
+            failed = 1;
+        }
+    }
+
+    /* every bitmask is kept once */
+    for(i = 0; i < m->memberships && !failed; i++) {
+        size_t j;
+        for(j = i + 1; j < m->memberships; j++)
+            if(!memcmp(&m->masks[i * m->words], &m->masks[j * m->words], m->words * sizeof(uint64_t))) {
+                fprintf(stderr, "%s: memberships %zu and %zu are the same\n", name, i, j);
+                failed = 1;
+            }
+    }
+
+    ipset_membership_free(m);
+    return failed;
+}
+
+int main(void) {
+    static uint64_t masks[SPACE][WORDS];
+    ipset *root, *second;
+    IPSET_MEMBERSHIP *m;
+    uint64_t state = 53;
+    size_t n;
+    int failed = 0;
+
+    /* one word, and more than 64 ipsets in two */
+    for(n = 1; n <= 100; n += 33) {
+        memset(masks, 0, sizeof(masks));
+        root = random_ipsets(&state, n, masks);
+        failed += check(n > 64 ? "two words" : "one word", root, n, masks);
+        ipset_free_all(root);
+    }
+
+    /* ranges that end at the last IP */
+    root = ipset_create("input", 0);
+    second = ipset_create("input", 0);
+    if(!root || !second) return 1;
+    ipset_add_ip_range(root, 0, UINT32_MAX);
+    ipset_add_ip_range(second, UINT32_MAX - 9, UINT32_MAX);
+    root->next = second;
+    second->prev = root;
+
+    m = ipset_membership(root);
+    if(!m || m->entries != 2 || m->records[1].addr != UINT32_MAX - 9 || m->records[1].broadcast != UINT32_MAX
+       || m->masks[m->records[0].id] != 1 || m->masks[m->records[1].id] != 3) {
+        fprintf(stderr, "the membership of the last IPs is wrong\n");
+        failed++;
+    }
+    if(m) ipset_membership_free(m);
+
+    ipset_free_all(root);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,82 @@
+#include "iprange.h"
+#include <string.h>
+#include "tests.unit/test_random.h"
+
+char *PROG = "parallel_optimize_matches";
+int debug = 0;
+int cidr_use_network = 1;
+int default_prefix = 32;
+int active_family = 0;
+
+/* optimizes two copies of the ipset, sequentially and in parallel */
+static int check(const char *name, ipset *ips, int threads) {
+    ipset *copy = ipset_copy(ips);
+    int failed = 0;
+
+    if(!copy) return 1;
+
+    parallel_threads = 1;
+    ipset_optimize(ips);
+
+    parallel_threads = threads;
+    ipset_optimize(copy);
+    parallel_threads = 1;
+
+    if(ips->entries != copy->entries || ips->unique_ips != copy->unique_ips || ips->lines != copy->lines
+       || memcmp(ips->netaddrs, copy->netaddrs, ips->entries * sizeof(network_addr_t))) {
+        fprintf(stderr, "%s: parallel optimize differs (%zu/%zu entries)\n", name, ips->entries, copy->entries);
+        failed = 1;
+    }
+
+    ipset_free(copy);
+    ipset_free(ips);
+    return failed;
+}
+
+int main(void) {
+    uint64_t state = 7;
+    size_t i;
+    int failed = 0;
+    ipset *ips;
+
+    ipset_optimize_parallel_min = 1000;
+
+    /* random CIDRs of all sizes: ranges cross the bucket boundaries */
+    ips = ipset_create("random", 0);
+    if(!ips) return 1;
+    for(i = 0; i < 200000; i++) {
+        int prefix = 8 + (int)(rnd(&state) % 25);
+        in_addr_t addr = network(rnd(&state), prefix);
+        ipset_add_ip_range(ips, addr, broadcast(addr, prefix));
+    }
+    failed += check("random", ips, 4);
+
+    /* adjacent single IPs, that must be joined across buckets */
+    ips = ipset_create("adjacent", 0);
+    if(!ips) return 1;
+    for(i = 0; i < 100000; i++) {
+        in_addr_t addr = 0x0a000000U + (in_addr_t)((i * 7919) % 100000);
+        ipset_add_ip_range(ips, addr, addr);
+    }
+    failed += check("adjacent", ips, 3);
+
+    /* one huge range containing everything else, and the edges of the space */
+    ips = ipset_create("nested", 0);
+    if(!ips) return 1;
+    ipset_add_ip_range(ips, 0, UINT32_MAX - 1);
+    for(i = 0; i < 50000; i++) {
+        in_addr_t addr = rnd(&state);
+        ipset_add_ip_range(ips, addr, addr);
+    }
+    ipset_add_ip_range(ips, UINT32_MAX, UINT32_MAX);
+    failed += check("nested", ips, 8);
+
+    /* all duplicates: every splitter is the same */
+    ips = ipset_create("duplicates", 0);
+    if(!ips) return 1;
+    for(i = 0; i < 20000; i++)
+        ipset_add_ip_range(ips, 0x01020304U - (in_addr_t)(i & 1), 0x01020304U);
+    failed += check("duplicates", ips, 5);
+
+    return failed ? 1 : 0;
+}
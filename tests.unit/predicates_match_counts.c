@@ -0,0 +1,132 @@
+#include "iprange.h"
+#include "tests.unit/test_random.h"
+
+char *PROG = "predicates_match_counts";
+int debug = 0;
+int cidr_use_network = 1;
+int default_prefix = 32;
+int active_family = 0;
+
+/* some of the IPs of ips, splitting its ranges; all of them when keep is 1 */
+static ipset *part_of(uint64_t *state, ipset *ips, int keep) {
+    ipset *part = ipset_create("part", ips->entries);
+    size_t i;
+
+    if(!part) exit(1);
+
+    for(i = 0; i < ips->entries; i++) {
+        in_addr_t lo = ips->netaddrs[i].addr, hi = ips->netaddrs[i].broadcast;
+        in_addr_t mid = lo + (in_addr_t)(rnd(state) % ((uint64_t)hi - lo + 1));
+
+        if(keep || rnd(state) % 2) {
+            ipset_add_ip_range(part, lo, mid);
+            if(mid < hi) ipset_add_ip_range(part, mid + 1, hi);
+        }
+        else if(rnd(state) % 2)
+            ipset_add_ip_range(part, mid, mid);
+    }
+
+    ipset_optimize(part);
+    return part;
+}
+
+/* the number of IPs of the witness that are in ips */
+static uint64_t witness_ips(network_addr_t *w, ipset *ips) {
+    ipset *range = ipset_create("witness", 1);
+    uint64_t ret;
+
+    if(!range) exit(1);
+    ipset_add_ip_range(range, w->addr, w->broadcast);
+    ipset_optimize(range);
+
+    ret = ipset_count_common(range, ips);
+    ipset_free(range);
+    return ret;
+}
+
+/* the witness must be all in one of them and none in the other (or all in both) */
+static int witness_wrong(const char *name, const char *op, network_addr_t *w, ipset *in, ipset *out) {
+    uint64_t size = (uint64_t)w->broadcast - (uint64_t)w->addr + 1;
+
+    if(witness_ips(w, in) == size && (out ? witness_ips(w, out) == 0 : 1))
+        return 0;
+
+    fprintf(stderr, "%s: the witness of %s, %u-%u, is wrong\n", name, op, w->addr, w->broadcast);
+    return 1;
+}
+
+/* the answers must match the counts, and the witnesses must prove them */
+static int check(const char *name, ipset *ips1, ipset *ips2) {
+    network_addr_t w;
+    size_t ratio;
+    int failed = 0, intersects, subset, equals;
+
+    intersects = ipset_count_common(ips1, ips2) != 0;
+    subset = ipset_count_exclude(ips1, ips2) == 0;
+    equals = ipset_count_diff(ips1, ips2) == 0;
+
+    for(ratio = 0; ratio <= 1; ratio++) {
+        ipset_gallop_ratio = ratio;
+
+        if(ipset_intersects(ips1, ips2, NULL) != intersects || ipset_intersects(ips1, ips2, &w) != intersects) {
+            fprintf(stderr, "%s: intersects is wrong\n", name);
+            failed++;
+        }
+        else if(intersects)
+            failed += witness_wrong(name, "intersects", &w, ips1, NULL) + witness_wrong(name, "intersects", &w, ips2, NULL);
+
+        if(ipset_is_subset(ips1, ips2, NULL) != subset || ipset_is_subset(ips1, ips2, &w) != subset) {
+            fprintf(stderr, "%s: subset is wrong\n", name);
+            failed++;
+        }
+        else if(!subset)
+            failed += witness_wrong(name, "subset", &w, ips1, ips2);
+
+        if(ipset_equals(ips1, ips2, NULL) != equals || ipset_equals(ips1, ips2, &w) != equals) {
+            fprintf(stderr, "%s: equals is wrong\n", name);
+            failed++;
+        }
+        else if(!equals && witness_ips(&w, ips1))
+            failed += witness_wrong(name, "equals", &w, ips1, ips2);
+        else if(!equals)
+            failed += witness_wrong(name, "equals", &w, ips2, ips1);
+    }
+
+    ipset_free(ips1);
+    ipset_free(ips2);
+    return failed;
+}
+
+int main(void) {
+    ipset *ips1, *ips2;
+    uint64_t state = 59;
+    size_t m;
+    int failed = 0;
+
+    for(m = 1; m <= 20000; m *= 5) {
+        ips2 = random_optimized_ipset(&state, m, 8, 32);
+
+        failed += check("random", random_optimized_ipset(&state, m, 16, 32), random_optimized_ipset(&state, 20000, 16, 32));
+        failed += check("part", part_of(&state, ips2, 0), ipset_copy(ips2));
+        failed += check("reverse part", ipset_copy(ips2), part_of(&state, ips2, 0));
+        failed += check("split", part_of(&state, ips2, 1), ipset_copy(ips2));
+        failed += check("one empty", random_optimized_ipset(&state, m, 8, 32), random_optimized_ipset(&state, 0, 8, 32));
+        failed += check("other empty", random_optimized_ipset(&state, 0, 8, 32), random_optimized_ipset(&state, m, 8, 32));
+
+        ipset_free(ips2);
+    }
+
+    /* the whole address space, and ranges adjacent to each other */
+    ips1 = ipset_create("input", 0);
+    ips2 = ipset_create("input", 0);
+    if(!ips1 || !ips2) return 1;
+    ipset_add_ip_range(ips1, 0, UINT32_MAX);
+    ipset_add_ip_range(ips2, 0, 9);
+    ipset_add_ip_range(ips2, 11, 19);
+    ipset_add_ip_range(ips2, UINT32_MAX, UINT32_MAX);
+    failed += check("whole", ips1, ipset_copy(ips2));
+    failed += check("whole reverse", ipset_copy(ips2), ipset_copy(ips2));
+    ipset_free(ips2);
+
+    return failed ? 1 : 0;
+}
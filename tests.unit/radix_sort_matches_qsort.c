@@ -0,0 +1,88 @@
+#include "iprange.h"
+#include <string.h>
+#include "tests.unit/test_random.h"
+
+char *PROG = "radix_sort_matches_qsort";
+int debug = 0;
+int cidr_use_network = 1;
+int default_prefix = 32;
+int active_family = 0;
+
+static int check(const char *name, network_addr_t *a, size_t n) {
+    network_addr_t *b = malloc((n ? n : 1) * sizeof(network_addr_t));
+    int ret = 0;
+
+    if(!b) return 1;
+
+    ipset_copy_entries(b, a, n);
+    ipset_sort_qsort(a, n);
+
+    if(ipset_sort_radix(b, n) || memcmp(a, b, n * sizeof(network_addr_t))) {
+        fprintf(stderr, "%s: radix sort differs from qsort()\n", name);
+        ret = 1;
+    }
+
+    free(b);
+    return ret;
+}
+
+int main(void) {
+    static network_addr_t a[50000];
+    uint64_t state = 42;
+    size_t i, n = sizeof(a) / sizeof(a[0]);
+    int failed = 0;
+    ipset *ips;
+
+    /* random CIDRs, with duplicates and nested ranges */
+    for(i = 0; i < n; i++) {
+        int prefix = (int)(rnd(&state) % 33);
+        a[i].addr = network(rnd(&state) & 0xfff0ffffU, prefix);
+        a[i].broadcast = broadcast(a[i].addr, prefix);
+        if(i && i % 7 == 0) a[i] = a[i - 1];
+    }
+    failed += check("random", a, n);
+
+    /* the extremes of the key */
+    for(i = 0; i < n; i++) {
+        a[i].addr = (i & 1) ? 0 : UINT32_MAX;
+        a[i].broadcast = (i & 2) ? UINT32_MAX : a[i].addr;
+    }
+    failed += check("extremes", a, n);
+
+    /* single IPs only: most digits are constant and get skipped */
+    for(i = 0; i < n; i++)
+        a[i].addr = a[i].broadcast = 0x0a000000U + (rnd(&state) & 0xffff);
+    failed += check("single ips", a, n);
+
+    failed += check("one entry", a, 1);
+    failed += check("empty", a, 0);
+
+    /* ipset_optimize() gives the same result with both sort engines */
+    ips = ipset_create("radix", 0);
+    if(!ips) return 1;
+    for(i = 0; i < n; i++) {
+        int prefix = 20 + (int)(rnd(&state) % 13);
+        in_addr_t addr = network(rnd(&state) & 0x0fffffffU, prefix);
+        ipset_add_ip_range(ips, addr, broadcast(addr, prefix));
+    }
+    {
+        ipset *copy = ipset_copy(ips);
+        if(!copy) return 1;
+
+        ipset_sort_radix_min = 0;
+        ipset_optimize(ips);
+        ipset_sort_radix_min = SIZE_MAX;
+        ipset_optimize(copy);
+
+        if(ips->entries != copy->entries || ips->unique_ips != copy->unique_ips
+           || memcmp(ips->netaddrs, copy->netaddrs, ips->entries * sizeof(network_addr_t))) {
+            fprintf(stderr, "optimize: radix and qsort results differ\n");
+            failed++;
+        }
+
+        ipset_free(copy);
+    }
+    ipset_free(ips);
+
+    return failed ? 1 : 0;
+}
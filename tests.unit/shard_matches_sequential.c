@@ -0,0 +1,76 @@
+#include "iprange.h"
+#include <string.h>
+#include "tests.unit/test_random.h"
+
+char *PROG = "shard_matches_sequential";
+int debug = 0;
+int cidr_use_network = 1;
+int default_prefix = 32;
+int active_family = 0;
+
+static int same(const char *name, const char *op, ipset *sharded, ipset *sequential) {
+    int failed = 0;
+
+    if(!sharded || !sequential) return 1;
+
+    if(sharded->entries != sequential->entries || sharded->unique_ips != sequential->unique_ips || sharded->lines != sequential->lines
+       || memcmp(sharded->netaddrs, sequential->netaddrs, sharded->entries * sizeof(network_addr_t))) {
+        fprintf(stderr, "%s: sharded %s differs (%zu/%zu entries)\n", name, op, sharded->entries, sequential->entries);
+        failed = 1;
+    }
+
+    ipset_free(sharded);
+    ipset_free(sequential);
+    return failed;
+}
+
+/* the sharded set operations must give exactly what the sequential ones give */
+static int check(const char *name, ipset *ips1, ipset *ips2) {
+    int failed = 0;
+
+    ipset_optimize(ips1);
+    ipset_optimize(ips2);
+
+    failed += same(name, "diff", ipset_shard_diff(ips1, ips2), ipset_diff(ips1, ips2));
+    failed += same(name, "exclude", ipset_shard_exclude_all(ips1, ips2), ipset_exclude(ips1, ips2));
+    failed += same(name, "reverse exclude", ipset_shard_exclude_all(ips2, ips1), ipset_exclude(ips2, ips1));
+
+    ips1->next = ips2;
+    ips2->prev = ips1;
+    failed += same(name, "union", ipset_shard_union(ips1, "union"), ipset_kmerge_all(ips1, "union"));
+    failed += same(name, "common", ipset_shard_common(ips1), ipset_common_all(ips1));
+
+    ipset_free_all(ips1);
+    return failed;
+}
+
+int main(void) {
+    ipset *ips1, *ips2;
+    uint64_t state = 29;
+    int threads, failed = 0;
+
+    for(threads = 2; threads <= 9; threads++) {
+        parallel_threads = threads;
+
+        failed += check("small ranges", random_ipset(&state, 20000, 16, 32), random_ipset(&state, 20000, 16, 32));
+        failed += check("big ranges", random_ipset(&state, 30, 1, 8), random_ipset(&state, 5000, 20, 32));
+        failed += check("few entries", random_ipset(&state, 3, 2, 30), random_ipset(&state, 2, 2, 30));
+        failed += check("one empty", random_ipset(&state, 1000, 8, 32), random_ipset(&state, 0, 8, 32));
+    }
+
+    /* ranges of one ipset adjacent to ranges of the other, up to the last IP */
+    parallel_threads = 4;
+    ips1 = ipset_create("input", 0);
+    ips2 = ipset_create("input", 0);
+    if(!ips1 || !ips2) return 1;
+    ipset_add_ip_range(ips1, 0, 9);
+    ipset_add_ip_range(ips1, 20, 29);
+    ipset_add_ip_range(ips1, 40, UINT32_MAX);
+    ipset_add_ip_range(ips2, 10, 19);
+    ipset_add_ip_range(ips2, 30, 39);
+    ipset_add_ip_range(ips2, 0x80000000U, 0x80000000U);
+    ipset_add_ip_range(ips2, UINT32_MAX, UINT32_MAX);
+    failed += check("adjacent", ips1, ips2);
+
+    return failed ? 1 : 0;
+}
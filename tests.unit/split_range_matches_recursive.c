@@ -0,0 +1,125 @@
+#include "iprange.h"
+#include "tests.unit/test_random.h"
+
+char *PROG = "split_range_matches_recursive";
+int debug = 0;
+int cidr_use_network = 1;
+int default_prefix = 32;
+int active_family = 0;
+
+/* ranges that need more blocks are not checked */
+#define MAX_CIDRS 5000
+
+typedef struct expected {
+    IPSET_CIDR cidrs[MAX_CIDRS];
+    size_t n;
+    int overflow;
+} EXPECTED;
+
+/* the recursive split_range() the decomposition replaced, splitting halves */
+static void recursive(EXPECTED *e, in_addr_t addr, int prefix, in_addr_t lo, in_addr_t hi) {
+    in_addr_t upper_half;
+
+    if(e->overflow) return;
+
+    if(lo == addr && hi == broadcast(addr, prefix) && prefix_enabled[prefix]) {
+        if(e->n < MAX_CIDRS) {
+            e->cidrs[e->n].addr = addr;
+            e->cidrs[e->n].prefix = prefix;
+            e->n++;
+        }
+        else e->overflow = 1;
+        return;
+    }
+
+    prefix++;
+    upper_half = set_bit(addr, prefix, 1);
+
+    if(hi < upper_half)
+        recursive(e, addr, prefix, lo, hi);
+    else if(lo >= upper_half)
+        recursive(e, upper_half, prefix, lo, hi);
+    else {
+        recursive(e, addr, prefix, lo, broadcast(addr, prefix));
+        recursive(e, upper_half, prefix, upper_half, hi);
+    }
+}
+
+/* the blocks of lo-hi must be the same, in batches of any size, and counted the same */
+static int check(EXPECTED *e, in_addr_t lo, in_addr_t hi) {
+    static const size_t batches[] = { 1, 3, SPLIT_RANGE_BATCH };
+    size_t counted[33], expected[33], total, b, i, k, n;
+    IPSET_CIDR cidrs[SPLIT_RANGE_BATCH];
+    SPLIT_RANGE_CURSOR c;
+    int failed = 0;
+
+    e->n = 0;
+    e->overflow = 0;
+    recursive(e, 0, 0, lo, hi);
+    if(e->overflow) return 0;
+
+    for(b = 0; b < sizeof(batches) / sizeof(batches[0]); b++) {
+        split_range_start(&c, lo, hi);
+        for(n = 0; (k = split_range_cidrs(&c, cidrs, batches[b])); n += k) {
+            for(i = 0; i < k && !failed; i++) {
+                if(n + i >= e->n || cidrs[i].addr != e->cidrs[n + i].addr || cidrs[i].prefix != e->cidrs[n + i].prefix) {
+                    fprintf(stderr, "%u-%u, batch %zu: block %zu is %u/%d\n", lo, hi, batches[b], n + i, cidrs[i].addr, cidrs[i].prefix);
+                    failed = 1;
+                }
+            }
+        }
+
+        if(!failed && n != e->n) {
+            fprintf(stderr, "%u-%u, batch %zu: %zu blocks, expected %zu\n", lo, hi, batches[b], n, e->n);
+            failed = 1;
+        }
+    }
+
+    memset(counted, 0, sizeof(counted));
+    memset(expected, 0, sizeof(expected));
+    for(i = 0; i < e->n; i++)
+        expected[e->cidrs[i].prefix]++;
+
+    total = split_range_count(lo, hi, counted);
+    if(total != e->n || memcmp(counted, expected, sizeof(counted))) {
+        fprintf(stderr, "%u-%u: counted %zu blocks, expected %zu\n", lo, hi, total, e->n);
+        failed = 1;
+    }
+
+    return failed;
+}
+
+int main(void) {
+    static EXPECTED e;
+    uint64_t state = 61;
+    size_t round, i;
+    int failed = 0, p;
+
+    for(round = 0; round < 200; round++) {
+        /* all the prefixes, then random ones; 32 is always enabled, like --min-prefix and --prefixes do */
+        for(p = 0; p <= 32; p++)
+            prefix_enabled[p] = (round < 50 || p == 32 || rnd(&state) % 3 == 0);
+
+        for(i = 0; i < 50; i++) {
+            in_addr_t lo = rnd(&state), hi;
+
+            switch(rnd(&state) % 3) {
+                case 0:  hi = lo + rnd(&state) % 5000; break;
+                case 1:  hi = lo | (rnd(&state) >> (rnd(&state) % 32)); break;
+                default: hi = rnd(&state); break;
+            }
+
+            if(hi < lo) { in_addr_t t = lo; lo = hi; hi = t; }
+            failed += check(&e, lo, hi);
+        }
+
+        /* the edges of the address space */
+        failed += check(&e, 0, UINT32_MAX);
+        failed += check(&e, 1, UINT32_MAX - 1);
+        failed += check(&e, 0, 0);
+        failed += check(&e, UINT32_MAX, UINT32_MAX);
+        failed += check(&e, UINT32_MAX - 1000, UINT32_MAX);
+    }
+
+    return failed ? 1 : 0;
+}
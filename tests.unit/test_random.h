@@ -0,0 +1,64 @@
+#ifndef IPRANGE_TEST_RANDOM_H
+#define IPRANGE_TEST_RANDOM_H
+
+/*
+ * the random inputs of the unit tests and the benchmarks
+ *
+ * the numbers come from a 64-bit LCG with a state given by the caller, so
+ * every run of a test sees the same inputs for the same seed
+ */
+
+static inline uint32_t rnd(uint64_t *state) {
+    *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (uint32_t)(*state >> 32);
+}
+
+/* a CIDR with a prefix from min_prefix to max_prefix, around an address from base to base + space - 1 */
+static inline void random_cidr(uint64_t *state, int min_prefix, int max_prefix, in_addr_t base, uint64_t space, network_addr_t *cidr) {
+    int prefix = min_prefix + (int)(rnd(state) % (uint32_t)(max_prefix - min_prefix + 1));
+
+    cidr->addr = network((in_addr_t)(base + rnd(state) % space), prefix);
+    cidr->broadcast = broadcast(cidr->addr, prefix);
+}
+
+/* an ipset of entries random CIDRs in base to base + space - 1; it is not optimized */
+static inline ipset *random_ipset_in(uint64_t *state, size_t entries, int min_prefix, int max_prefix, in_addr_t base, uint64_t space) {
+    ipset *ips = ipset_create("input", entries);
+    network_addr_t cidr;
+    size_t i;
+
+    if(!ips) exit(1);
+
+    for(i = 0; i < entries; i++) {
+        random_cidr(state, min_prefix, max_prefix, base, space, &cidr);
+        ipset_add_ip_range(ips, cidr.addr, cidr.broadcast);
+    }
+
+    return ips;
+}
+
+/* an ipset of entries random CIDRs anywhere; it is not optimized */
+static inline ipset *random_ipset(uint64_t *state, size_t entries, int min_prefix, int max_prefix) {
+    return random_ipset_in(state, entries, min_prefix, max_prefix, 0, UINT64_C(1) << 32);
+}
+
+/* the same, optimized */
+static inline ipset *random_optimized_ipset(uint64_t *state, size_t entries, int min_prefix, int max_prefix) {
+    ipset *ips = random_ipset(state, entries, min_prefix, max_prefix);
+
+    ipset_optimize(ips);
+    return ips;
+}
+
+/* appends ips to the list of ipsets from *root to *last */
+static inline void random_ipsets_append(ipset **root, ipset **last, ipset *ips) {
+    if(*last) {
+        (*last)->next = ips;
+        ips->prev = *last;
+    }
+    else *root = ips;
+
+    *last = ips;
+}
+
+#endif /* IPRANGE_TEST_RANDOM_H */